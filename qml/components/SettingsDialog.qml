@@ -109,6 +109,8 @@ Popup {
             // proxy / privacy
             // paths
             wallet_directory: (Script.getJsonRootObject()["wallet_directory"].length > 0) ? Script.getJsonRootObject()["wallet_directory"] : neroshopDefaultWalletDirPath,
+            // neromon (GUI <-> daemon connection)
+            neromon: (Script.getJsonRootObject()["neromon"] !== undefined) ? Script.getJsonRootObject()["neromon"] : { ipc_transport: "tcp", ipc_shared_memory: false },
         };
         
         const settings_json = JSON.stringify(settings_obj);
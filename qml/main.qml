@@ -267,6 +267,16 @@ ApplicationWindow {
                 color: "transparent"
                 //border.color: "plum"
                 property var networkStatus: null
+                // The daemon pushes the peer counts whenever they change
+                Connections {
+                    target: Backend
+                    onNetworkStatusChanged: {
+                        networkMonitor.networkStatus = networkStatus
+                        if(networkStatus.hasOwnProperty("connected_peers")) {
+                            peerCounterText.text = networkStatus.connected_peers
+                        }
+                    }
+                }
                 
                 Row {
                     id: networkMonitorRow
@@ -279,19 +289,6 @@ ApplicationWindow {
                         text: "0"
                         color: (NeroshopComponents.Style.darkTheme) ? "#ffffff" : "#000000"
                         font.pointSize: 10
-                        
-                        Timer {
-                            interval: 5000
-                            running: true
-                            repeat: true
-                            onTriggered: {
-                                networkMonitor.networkStatus = Backend.getNetworkStatus()
-                                if(networkMonitor.networkStatus === null) return;
-                                if(networkMonitor.networkStatus.hasOwnProperty("connected_peers")) {
-                                    peerCounterText.text = networkMonitor.networkStatus.connected_peers
-                                }
-                            }
-                        }
                     }
                     
                     Rectangle {
@@ -50,6 +50,17 @@ Page {
     }    
     //property alias catalogIndex: catalogStack.currentIndex
     property var model: null
+    property int listingSorting: -1 // Set when the page shows every listing, so that new listings can be added to it. -1 for search and category results
+    // New and updated listings are pushed by the daemon. A burst of them (e.g. when a node republishes) reloads the page once
+    Timer {
+        id: listingReloadTimer
+        interval: 1000
+        onTriggered: catalogPage.model = Backend.getListings(catalogPage.listingSorting, settingsDialog.hideIllegalProducts)
+    }
+    Connections {
+        target: Backend
+        onListingUpdated: if(catalogPage.listingSorting >= 0) listingReloadTimer.start()
+    }
 
         Rectangle {
             id: topPanel
@@ -110,6 +121,7 @@ Page {
                         catalogPage.model = Backend.getListings(Listing.SortByPriceHighest, settingsDialog.hideIllegalProducts)
                         settingsDialog.lastUsedListingSorting = Listing.SortByPriceHighest
                     }
+                    catalogPage.listingSorting = settingsDialog.lastUsedListingSorting
                     /*if(currentIndex == find("")) {
                         catalogPage.model = Backend.
                     }*/
@@ -167,6 +167,16 @@ Page {
                     Flow {
                         width: parent.parent.parent.width////scrollView.width
                         spacing: 5
+                        // New listings are pushed by the daemon. A burst of them (e.g. when a node republishes) reloads the list once
+                        Timer {
+                            id: recentListingsTimer
+                            interval: 1000
+                            onTriggered: itemsRepeater.model = Backend.getListingsByMostRecentLimit(6, settingsDialog.hideIllegalProducts)
+                        }
+                        Connections {
+                            target: Backend
+                            onListingUpdated: recentListingsTimer.start()
+                        }
                         Repeater {
                             id: itemsRepeater
                             model: Backend.getListingsByMostRecentLimit(6, settingsDialog.hideIllegalProducts)
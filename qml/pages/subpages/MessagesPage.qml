@@ -13,9 +13,14 @@ Page {
     ColumnLayout {
         anchors.fill: parent
         ListView {
+            id: messagesList
             Layout.fillWidth: true
             Layout.fillHeight: true
             model: User.getMessages()
+            Connections {
+                target: Backend
+                onMessageReceived: messagesList.model = User.getMessages() // New messages are pushed by the daemon
+            }
             delegate: Rectangle {
                 width: parent.width
                 height: 250
@@ -32,17 +32,18 @@ static void print_commands() {
 int main(int argc, char** argv) {
     //-------------------------------------------------------
     // Connect to daemon server (daemon must be launched first)
-    #if !defined(NEROSHOP_USE_LIBZMQ)
     neroshop::Client * client = neroshop::Client::get_main_client();
+	#if defined(NEROSHOP_USE_LIBZMQ)
+	bool connected = client->connect_zmq(NEROSHOP_DEFAULT_IPC_ZMQ_ENDPOINT);
+	#else
 	int port = NEROSHOP_IPC_DEFAULT_PORT;
 	std::string ip = "localhost"; // 0.0.0.0 means anyone can connect to your server
-	if(!client->connect(port, ip)) {
+	bool connected = client->connect(port, ip);
+	#endif
+	if(!connected) {
 	    std::cout << "Please launch neromon first\n";
 	    exit(0);
 	}
-	#else
-	neroshop::ZmqClient client("tcp://localhost:5555");
-	#endif
     //-------------------------------------------------------
     neroshop::load_nodes_from_memory();
 
@@ -105,50 +106,18 @@ int main(int argc, char** argv) {
             std::thread { std::move(download_task) }.detach();
         }
         else if(command == "send") { // This is only a test command
-            #if !defined(NEROSHOP_USE_LIBZMQ)
             if (client->is_connected()) {
             nlohmann::json arguments_obj = {
                 {"id", ""},
             };//nlohmann::json nested_array = {"item1", "item2", "item3"};
-            nlohmann::json j = {
-                {"version", std::string(NEROSHOP_DHT_VERSION)},
-                {"query", "ping"},
-                {"args", arguments_obj},
-                {"tid", 1234},
-            };
-            // send packed data to POSIX server
-            std::vector<uint8_t> packed = nlohmann::json::to_msgpack(j);
-            client->send(packed);//client.send("Hello, POSIX Server!");
-            
-            try {
-            std::vector<uint8_t> response;//std::string response;
-            client->receive(response);
-            // Deserialize the response from MessagePack to a JSON object
-            nlohmann::json j2 = nlohmann::json::from_msgpack(response);
-            std::cout << "Received response: " << j2.dump() << std::endl;
-            } catch (const nlohmann::detail::parse_error& e) {
-                std::cerr << "An error occurred: " << "Server was disconnected" << std::endl;//std::cout << "Failed to parse server response: " << e.what() << std::endl;
-            }
+            // send query to POSIX server. The response is matched to it by tid
+            std::string response = client->request("ping", arguments_obj).get().dump(); // empty if the server was disconnected
+            if (response.empty()) std::cerr << "An error occurred: " << "Server was disconnected" << std::endl;
+            else std::cout << "Received response: " << response << std::endl;
             
             } else {
                 std::cout << "Failed to establish connection to server\n";
             }
-            //------------------------------------------------------------
-            #else
-            nlohmann::json j = {
-                {"message", "Hello, ZMQ Server!"},
-                {"id", 1234}
-            };
-            // send packed data to ZMQ server
-            std::vector<uint8_t> packed = nlohmann::json::to_msgpack(j);
-            client.send(packed);//client.send("Hello, ZMQ Server!");
-            
-            std::vector<uint8_t> response;//std::string response;
-            client.receive(response);
-            // Deserialize the response from MessagePack to a JSON object
-            nlohmann::json j2 = nlohmann::json::from_msgpack(response);
-            std::cout << "Received response: " << j2.dump() << std::endl;//std::cout << "Received response: " << response << std::endl;
-            #endif
         }        
         else if(command == "put") { // This is only a test command
             if (client->is_connected()) {
@@ -156,25 +125,10 @@ int main(int argc, char** argv) {
                     {"key", "63075a22aaed744829b33ed9e16bb3aa0f06121500861bbf8fcbdfee2e708a66"},
                     {"value", "{\"name\": \"Jack\"}"}, // {"name": "Jack"}
                 };
-                nlohmann::json j = {
-                    {"version", std::string(NEROSHOP_DHT_VERSION)},
-                    {"query", "put"},
-                    {"args", arguments_obj},
-                    {"tid", nullptr}, // tid is not needed. DHT server will automatically deal with this
-                };
-                // send packed data to POSIX server
-                std::vector<uint8_t> packed = nlohmann::json::to_msgpack(j);
-                client->send(packed);//client.send("Hello, POSIX Server!");
-            
-                try {
-                std::vector<uint8_t> response;//std::string response;
-                client->receive(response);
-                // Deserialize the response from MessagePack to a JSON object
-                nlohmann::json j2 = nlohmann::json::from_msgpack(response);
-                std::cout << "Received response: " << j2.dump() << std::endl;
-                } catch (const nlohmann::detail::parse_error& e) {
-                    std::cerr << "An error occurred: " << "Server was disconnected" << std::endl;//std::cout << "Failed to parse server response: " << e.what() << std::endl;
-                }
+                // send query to POSIX server. The response is matched to it by tid
+                std::string response = client->request("put", arguments_obj).get().dump(); // empty if the server was disconnected
+                if (response.empty()) std::cerr << "An error occurred: " << "Server was disconnected" << std::endl;
+                else std::cout << "Received response: " << response << std::endl;
             }       
         } 
         else if(command == "get") { // This is only a test command
@@ -182,25 +136,10 @@ int main(int argc, char** argv) {
                 nlohmann::json arguments_obj = {
                     {"key", "63075a22aaed744829b33ed9e16bb3aa0f06121500861bbf8fcbdfee2e708a66"},
                 };
-                nlohmann::json j = {
-                    {"version", std::string(NEROSHOP_DHT_VERSION)},
-                    {"query", "get"},
-                    {"args", arguments_obj},
-                    {"tid", nullptr},
-                };
-                // send packed data to POSIX server
-                std::vector<uint8_t> packed = nlohmann::json::to_msgpack(j);
-                client->send(packed);//client.send("Hello, POSIX Server!");
-            
-                try {
-                std::vector<uint8_t> response;//std::string response;
-                client->receive(response);
-                // Deserialize the response from MessagePack to a JSON object
-                nlohmann::json j2 = nlohmann::json::from_msgpack(response);
-                std::cout << "Received response: " << j2.dump() << std::endl;
-                } catch (const nlohmann::detail::parse_error& e) {
-                    std::cerr << "An error occurred: " << "Server was disconnected" << std::endl;//std::cout << "Failed to parse server response: " << e.what() << std::endl;
-                }
+                // send query to POSIX server. The response is matched to it by tid
+                std::string response = client->request("get", arguments_obj).get().dump(); // empty if the server was disconnected
+                if (response.empty()) std::cerr << "An error occurred: " << "Server was disconnected" << std::endl;
+                else std::cout << "Received response: " << response << std::endl;
             }
         }     
         else if(command == "register") {
@@ -225,34 +164,17 @@ int main(int argc, char** argv) {
                     //{"condition", ""},
                     //{"", ""},
                 };
-                nlohmann::json j = {
-                    {"version", std::string(NEROSHOP_DHT_VERSION)},
-                    {"query", "search"},
-                    {"args", arguments_obj},
-                    {"tid", nullptr},
-                };
-                // send packed data to POSIX server
-                std::vector<uint8_t> packed = nlohmann::json::to_msgpack(j);
-                client->send(packed);//client.send("Hello, POSIX Server!");
-            
-                try {
-                std::vector<uint8_t> response;//std::string response;
-                client->receive(response);
-                // Deserialize the response from MessagePack to a JSON object
-                nlohmann::json j2 = nlohmann::json::from_msgpack(response);
-                std::cout << "Received response: " << j2.dump() << std::endl;
-                } catch (const nlohmann::detail::parse_error& e) {
-                    std::cerr << "An error occurred: " << "Server was disconnected" << std::endl;//std::cout << "Failed to parse server response: " << e.what() << std::endl;
-                }
+                // send query to POSIX server. The response is matched to it by tid
+                std::string response = client->request("search", arguments_obj).get().dump(); // empty if the server was disconnected
+                if (response.empty()) std::cerr << "An error occurred: " << "Server was disconnected" << std::endl;
+                else std::cout << "Received response: " << response << std::endl;
             }
         }   
         /*else if(command == "") {
         }*/        
         else if(command == "exit") {
-            #if !defined(NEROSHOP_USE_LIBZMQ)
             // close the connection
             client->disconnect();
-            #endif
             break;
         }
         else {
@@ -24,29 +24,20 @@ static nlohmann::json get_listing_object(const std::string& listing_key) {
     neroshop::db::Sqlite3 * database = neroshop::get_database();
     if(!database) throw std::runtime_error("database is NULL");
     // Get the value of the corresponding key from the DHT
-    std::string response;
-    client->get(listing_key, response);
-    std::cout << "Received response (get): " << response << "\n";
-    // Parse the response
-    nlohmann::json json = nlohmann::json::parse(response);
-    if(json.contains("error")) {
+    neroshop::Response response = client->get(listing_key);
+    if(response.get_status() == neroshop::Response::Status::NoResponse) return nlohmann::json();
+    if(response.get_status() == neroshop::Response::Status::Error) {
         std::cout << "get_available_stock: listing key is lost or missing from DHT\n";
         int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { listing_key });
         if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
         return nlohmann::json(); // Key is lost or missing from DHT
     }
     
-    const auto& response_obj = json["response"];
-    assert(response_obj.is_object());
-    if (response_obj.contains("value") && response_obj["value"].is_string()) {
-        const auto& value = response_obj["value"].get<std::string>();
-        nlohmann::json value_obj = nlohmann::json::parse(value);
-        assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-        std::string metadata = value_obj["metadata"].get<std::string>();
-        if (metadata != "listing") { std::cerr << "Invalid metadata. \"listing\" expected, got \"" << metadata << "\" instead\n"; return nlohmann::json(); }
-        return value_obj;
-    }
-    return nlohmann::json(); // Return an empty JSON object if "value" is not found or not a string
+    const nlohmann::json& value_obj = response.get_value_json();
+    if(!value_obj.is_object()) return nlohmann::json(); // Return an empty JSON object if "value" is not found or not json
+    std::string metadata = value_obj.value("metadata", "");
+    if (metadata != "listing") { std::cerr << "Invalid metadata. \"listing\" expected, got \"" << metadata << "\" instead\n"; return nlohmann::json(); }
+    return value_obj;
 }
 
 ////////////////////
@@ -61,7 +61,7 @@ int neroshop::db::Sqlite3::execute(const std::string& command)
 	int result = sqlite3_exec(handle, command.c_str(), neroshop::db::Sqlite3::callback, 0, &error_message);
 	if (result != SQLITE_OK) {
 		neroshop::print("sqlite3_exec: " + std::string(error_message), 1);
-		logger.push_back(std::make_pair(result, std::string(error_message)));
+		log_error(std::make_pair(result, std::string(error_message)));
 		sqlite3_free(error_message);
 		return result;
 	}
@@ -76,7 +76,7 @@ int neroshop::db::Sqlite3::execute_params(const std::string& command, const std:
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_prepare_v2: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         // Since we don't prepare a statement here, there is no need to finalise it
         return result;
     }
@@ -86,7 +86,7 @@ int neroshop::db::Sqlite3::execute_params(const std::string& command, const std:
         if(result != SQLITE_OK) {
             const std::string error_msg = std::string(sqlite3_errmsg(handle));
             neroshop::print("sqlite3_bind_*: " + error_msg, 1);
-            logger.push_back(std::make_pair(result, error_msg));
+            log_error(std::make_pair(result, error_msg));
             sqlite3_finalize(statement);
             return result;
         }
@@ -96,7 +96,7 @@ int neroshop::db::Sqlite3::execute_params(const std::string& command, const std:
     if(result != SQLITE_DONE) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_step: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         sqlite3_finalize(statement);
         return result;
     }    
@@ -105,7 +105,7 @@ int neroshop::db::Sqlite3::execute_params(const std::string& command, const std:
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_finalize: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         sqlite3_finalize(statement);
         return result;
     }        
@@ -130,26 +130,26 @@ void * neroshop::db::Sqlite3::get_blob(const std::string& command) {
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_prepare_v2: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         return nullptr;
     }
     result = sqlite3_step(statement);
     if (result != SQLITE_ROW) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_step: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         sqlite3_finalize(statement);
         return nullptr;
     }
     int column_type = sqlite3_column_type(statement, 0);
     if(column_type == SQLITE_NULL) {
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return nullptr;
     }    
     if(column_type != SQLITE_BLOB) { // NULL is the only other acceptable return type
         neroshop::print("sqlite3_column_type: invalid column return type\ncommand: " + command, 1);
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return nullptr;
     }
@@ -165,7 +165,7 @@ void * neroshop::db::Sqlite3::get_blob_params(const std::string& command, const
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_prepare_v2: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         return nullptr;
     }
     // Bind user-defined parameter arguments
@@ -174,7 +174,7 @@ void * neroshop::db::Sqlite3::get_blob_params(const std::string& command, const
         if(result != SQLITE_OK) {
             const std::string error_msg = std::string(sqlite3_errmsg(handle));
             neroshop::print("sqlite3_bind_*: " + error_msg, 1);
-            logger.push_back(std::make_pair(result, error_msg));
+            log_error(std::make_pair(result, error_msg));
             sqlite3_finalize(statement);
             return nullptr;
         }
@@ -182,13 +182,13 @@ void * neroshop::db::Sqlite3::get_blob_params(const std::string& command, const
     sqlite3_step(statement); // Don't check for error or it'll keep saying: "another row available" or "no more rows available"
     int column_type = sqlite3_column_type(statement, 0);
     if(column_type == SQLITE_NULL) {
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return nullptr;
     }    
     if(column_type != SQLITE_BLOB) {
         neroshop::print("sqlite3_column_type: invalid column return type\ncommand: " + command, 1);
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return nullptr;
     }
@@ -204,26 +204,26 @@ std::string neroshop::db::Sqlite3::get_text(const std::string& command) {//const
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_prepare_v2: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         return "";
     }
     result = sqlite3_step(stmt);
     if (result != SQLITE_ROW) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_step: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         sqlite3_finalize(stmt);
         return "";
     }
     int column_type = sqlite3_column_type(stmt, 0);
     if(column_type == SQLITE_NULL) {
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(stmt);
         return "";
     }    
     if(column_type != SQLITE_TEXT) {
         neroshop::print("sqlite3_column_type: invalid column return type\ncommand: " + command, 1);
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(stmt);
         return "";
     }
@@ -240,7 +240,7 @@ std::string neroshop::db::Sqlite3::get_text_params(const std::string& command, c
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_prepare_v2: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         return "";
     }
     // Bind user-defined parameter arguments
@@ -249,7 +249,7 @@ std::string neroshop::db::Sqlite3::get_text_params(const std::string& command, c
         if(result != SQLITE_OK) {
             const std::string error_msg = std::string(sqlite3_errmsg(handle));
             neroshop::print("sqlite3_bind_*: " + error_msg, 1);
-            logger.push_back(std::make_pair(result, error_msg));
+            log_error(std::make_pair(result, error_msg));
             sqlite3_finalize(statement);
             return "";
         }
@@ -259,13 +259,13 @@ std::string neroshop::db::Sqlite3::get_text_params(const std::string& command, c
     // Check the type of the statement's return value
     int column_type = sqlite3_column_type(statement, 0);
     if(column_type == SQLITE_NULL) {
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return "";
     }    
     if(column_type != SQLITE_TEXT) {
         neroshop::print("sqlite3_column_type: invalid column return type\ncommand: " + command, 1);
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return "";
     }
@@ -282,26 +282,26 @@ int neroshop::db::Sqlite3::get_integer(const std::string& command) {
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_prepare_v2: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         return 0;
     }
     result = sqlite3_step(statement);
     if (result != SQLITE_ROW) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_step: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         sqlite3_finalize(statement);
         return 0;
     }
     int column_type = sqlite3_column_type(statement, 0);
     if(column_type == SQLITE_NULL) {
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return 0;
     }    
     if(column_type != SQLITE_INTEGER) {
         neroshop::print("sqlite3_column_type: invalid column return type\ncommand: " + command, 1);
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return 0;
     }
@@ -318,7 +318,7 @@ int neroshop::db::Sqlite3::get_integer_params(const std::string& command, const
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_prepare_v2: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         return 0;
     }
     // Bind user-defined parameter arguments
@@ -327,7 +327,7 @@ int neroshop::db::Sqlite3::get_integer_params(const std::string& command, const
         if(result != SQLITE_OK) {
             const std::string error_msg = std::string(sqlite3_errmsg(handle));
             neroshop::print("sqlite3_bind_*: " + error_msg, 1);
-            logger.push_back(std::make_pair(result, error_msg));
+            log_error(std::make_pair(result, error_msg));
             sqlite3_finalize(statement);
             return 0;
         }
@@ -337,13 +337,13 @@ int neroshop::db::Sqlite3::get_integer_params(const std::string& command, const
     // Check the type of the statement's return value
     int column_type = sqlite3_column_type(statement, 0);
     if(column_type == SQLITE_NULL) {
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return 0;
     }    
     if(column_type != SQLITE_INTEGER) {
         neroshop::print("sqlite3_column_type: invalid column return type\ncommand: " + command, 1);
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(statement);
         return 0;
     }
@@ -360,26 +360,26 @@ double neroshop::db::Sqlite3::get_real(const std::string& command) {
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_prepare_v2: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         return 0.0;
     }
     result = sqlite3_step(stmt);
     if (result != SQLITE_ROW) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_step: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         sqlite3_finalize(stmt);
         return 0.0;
     }
     int column_type = sqlite3_column_type(stmt, 0);
     if(column_type == SQLITE_NULL) {
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(stmt);
         return 0.0;
     }    
     if(column_type != SQLITE_FLOAT) {
         neroshop::print("sqlite3_column_type: invalid column return type\ncommand: " + command, 1);
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         sqlite3_finalize(stmt);
         return 0.0;
     }
@@ -396,7 +396,7 @@ double neroshop::db::Sqlite3::get_real_params(const std::string& command, const
     if(result != SQLITE_OK) {
         const std::string error_msg = std::string(sqlite3_errmsg(handle));
         neroshop::print("sqlite3_prepare_v2: " + error_msg, 1);
-        logger.push_back(std::make_pair(result, error_msg));
+        log_error(std::make_pair(result, error_msg));
         return 0.0;
     }
     // Bind user-defined parameter arguments
@@ -405,7 +405,7 @@ double neroshop::db::Sqlite3::get_real_params(const std::string& command, const
         if(result != SQLITE_OK) {
             const std::string error_msg = std::string(sqlite3_errmsg(handle));
             neroshop::print("sqlite3_bind_*: " + error_msg, 1);
-            logger.push_back(std::make_pair(result, error_msg));
+            log_error(std::make_pair(result, error_msg));
             sqlite3_finalize(statement);
             return 0.0;
         }
@@ -416,13 +416,13 @@ double neroshop::db::Sqlite3::get_real_params(const std::string& command, const
     int column_type = sqlite3_column_type(statement, 0);
     if(column_type == SQLITE_NULL) {
         sqlite3_finalize(statement);
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         return 0.0;
     }    
     if(column_type != SQLITE_FLOAT) {
         neroshop::print("sqlite3_column_type: invalid column return type\ncommand: " + command, 1);
         sqlite3_finalize(statement);
-        ////logger.push_back(std::make_pair(, ));
+        ////log_error(std::make_pair(, ));
         return 0.0;
     }
     // Finalize (destroy) the prepared statement
@@ -470,7 +470,13 @@ std::vector<std::string> neroshop::db::Sqlite3::get_rows(const std::string& comm
 ////////////////////
 ////////////////////
 std::pair<int, std::string> neroshop::db::Sqlite3::get_error() const {
-    return logger.back();
+    return last_error;
+}
+////////////////////
+void neroshop::db::Sqlite3::log_error(const std::pair<int, std::string>& error) {
+    last_error = error;
+    std::lock_guard<std::mutex> lock(logger_mutex);
+    logger.push_back(error);
 }
 ////////////////////
 std::string neroshop::db::Sqlite3::get_select() {
@@ -496,7 +502,8 @@ bool neroshop::db::Sqlite3::table_exists(const std::string& table_name) {
 }*/
 ////////////////////
 ////////////////////
-nlohmann::json neroshop::db::Sqlite3::json_object;//({});
+thread_local nlohmann::json neroshop::db::Sqlite3::json_object;//({});
+thread_local std::pair<int, std::string> neroshop::db::Sqlite3::last_error;
 ////////////////////
 //std::vector<std::string> neroshop::db::Sqlite3::select_result {};//std::vector<std::pair<int, std::string>> neroshop::db::Sqlite3::logger {{}};
 ////////////////////
@@ -10,6 +10,7 @@
 #include <nlohmann/json.hpp>
 
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector> // std::vector
 
@@ -43,14 +44,18 @@ public:
     bool is_open() const;
     bool table_exists(const std::string& table_name);
     //bool rowid_exists(const std::string& table_name, int rowid);
-    std::pair<int, std::string> get_error() const; // returns the error result of the last query
-    static std::string get_select(); // returns the result of the last select statement 
+    std::pair<int, std::string> get_error() const; // returns the error result of the last query made by the calling thread
+    static std::string get_select(); // returns the result of the last select statement made by the calling thread
 private:
 	sqlite3 * handle;
 	bool opened;
 	static int callback(void *not_used, int argc, char **argv, char **az_col_name);
 	std::vector<std::pair<int, std::string>> logger; // arg 1 = error code, arg 2 = error message 
-    static nlohmann::json json_object;
+	std::mutex logger_mutex;
+	// Per thread, so that queries made at the same time (e.g. by the RPC server's workers) do not see each other's rows or errors
+	static thread_local std::pair<int, std::string> last_error;
+    static thread_local nlohmann::json json_object;
+    void log_error(const std::pair<int, std::string>& error);
 };
 
 }
@@ -0,0 +1,333 @@
+#include "codec.hpp"
+
+#include <cstring> // std::memcpy
+#include <type_traits>
+
+neroshop::msgpack::Reader::Reader(const uint8_t * data, std::size_t size) : data(data), size(size), position(0), error(false) {}
+
+neroshop::msgpack::Reader::Reader(const std::vector<uint8_t>& buffer) : Reader(buffer.data(), buffer.size()) {}
+
+//-----------------------------------------------------------------------------
+
+template <typename T>
+bool neroshop::msgpack::Reader::read_big_endian(T& value) {
+    if(size - position < sizeof(T)) {
+        error = true;
+        return false;
+    }
+    uint64_t result = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i) {
+        result = (result << 8) | data[position++];
+    }
+    if constexpr (sizeof(T) == sizeof(uint64_t)) {
+        std::memcpy(&value, &result, sizeof(T));
+    } else {
+        value = static_cast<T>(result);
+    }
+    return true;
+}
+
+bool neroshop::msgpack::Reader::read_length(uint8_t marker, uint8_t fix_mask, uint8_t fix_max, uint8_t marker8, uint8_t marker16, uint8_t marker32, uint32_t& length) {
+    if(fix_max != 0 && (marker & ~fix_max) == fix_mask) { // fixstr, fixarray, fixmap (binary has no fix form)
+        length = marker & fix_max;
+        position++;
+        return true;
+    }
+    if(marker8 != 0 && marker == marker8) {
+        position++;
+        uint8_t length8;
+        if(!read_big_endian(length8)) return false;
+        length = length8;
+        return true;
+    }
+    if(marker == marker16) {
+        position++;
+        uint16_t length16;
+        if(!read_big_endian(length16)) return false;
+        length = length16;
+        return true;
+    }
+    if(marker == marker32) {
+        position++;
+        return read_big_endian(length);
+    }
+    error = true;
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::msgpack::Reader::read_nil() {
+    if(position >= size || data[position] != 0xc0) {
+        error = true;
+        return false;
+    }
+    position++;
+    return true;
+}
+
+bool neroshop::msgpack::Reader::read_bool(bool& value) {
+    if(position >= size || (data[position] != 0xc2 && data[position] != 0xc3)) {
+        error = true;
+        return false;
+    }
+    value = (data[position++] == 0xc3);
+    return true;
+}
+
+bool neroshop::msgpack::Reader::read_int(int64_t& value) {
+    if(position >= size) { error = true; return false; }
+    uint8_t marker = data[position];
+    if(marker <= 0x7f) { value = marker; position++; return true; } // positive fixint
+    if(marker >= 0xe0) { value = static_cast<int8_t>(marker); position++; return true; } // negative fixint
+    position++;
+    switch(marker) {
+        case 0xcc: { uint8_t v; if(!read_big_endian(v)) return false; value = v; return true; }
+        case 0xcd: { uint16_t v; if(!read_big_endian(v)) return false; value = v; return true; }
+        case 0xce: { uint32_t v; if(!read_big_endian(v)) return false; value = v; return true; }
+        case 0xcf: { uint64_t v; if(!read_big_endian(v)) return false; value = static_cast<int64_t>(v); return true; }
+        case 0xd0: { uint8_t v; if(!read_big_endian(v)) return false; value = static_cast<int8_t>(v); return true; }
+        case 0xd1: { uint16_t v; if(!read_big_endian(v)) return false; value = static_cast<int16_t>(v); return true; }
+        case 0xd2: { uint32_t v; if(!read_big_endian(v)) return false; value = static_cast<int32_t>(v); return true; }
+        case 0xd3: { uint64_t v; if(!read_big_endian(v)) return false; value = static_cast<int64_t>(v); return true; }
+        default: position--; error = true; return false;
+    }
+}
+
+bool neroshop::msgpack::Reader::read_uint(uint64_t& value) {
+    int64_t signed_value;
+    std::size_t start = position;
+    if(position < size && data[position] == 0xcf) { // Values above INT64_MAX
+        position++;
+        return read_big_endian(value);
+    }
+    if(!read_int(signed_value)) return false;
+    if(signed_value < 0) {
+        position = start;
+        error = true;
+        return false;
+    }
+    value = static_cast<uint64_t>(signed_value);
+    return true;
+}
+
+bool neroshop::msgpack::Reader::read_double(double& value) {
+    if(position >= size) { error = true; return false; }
+    uint8_t marker = data[position];
+    if(marker == 0xca) {
+        position++;
+        uint32_t bits;
+        if(!read_big_endian(bits)) return false;
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        value = f;
+        return true;
+    }
+    if(marker == 0xcb) {
+        position++;
+        return read_big_endian(value);
+    }
+    int64_t integer; // nlohmann::json writes whole numbers as integers
+    if(!read_int(integer)) return false;
+    value = static_cast<double>(integer);
+    return true;
+}
+
+bool neroshop::msgpack::Reader::read_string(std::string_view& value) {
+    if(position >= size) { error = true; return false; }
+    uint32_t length;
+    if(!read_length(data[position], 0xa0, 0x1f, 0xd9, 0xda, 0xdb, length)) return false;
+    if(size - position < length) { error = true; return false; }
+    value = std::string_view(reinterpret_cast<const char *>(data + position), length);
+    position += length;
+    return true;
+}
+
+bool neroshop::msgpack::Reader::read_binary(std::string_view& value) {
+    if(position >= size) { error = true; return false; }
+    uint32_t length;
+    if(!read_length(data[position], 0x00, 0x00, 0xc4, 0xc5, 0xc6, length)) return false;
+    if(size - position < length) { error = true; return false; }
+    value = std::string_view(reinterpret_cast<const char *>(data + position), length);
+    position += length;
+    return true;
+}
+
+// Every element takes at least one byte, so a count that the rest of the buffer cannot hold is rejected here.
+// Callers can then reserve() the count without a hostile header making them allocate gigabytes
+bool neroshop::msgpack::Reader::read_array_header(uint32_t& count) {
+    if(position >= size) { error = true; return false; }
+    if(!read_length(data[position], 0x90, 0x0f, 0, 0xdc, 0xdd, count)) return false;
+    if(count > size - position) { error = true; return false; }
+    return true;
+}
+
+bool neroshop::msgpack::Reader::read_map_header(uint32_t& count) {
+    if(position >= size) { error = true; return false; }
+    if(!read_length(data[position], 0x80, 0x0f, 0, 0xde, 0xdf, count)) return false;
+    if(count > (size - position) / 2) { error = true; return false; } // A key and a value per entry
+    return true;
+}
+
+bool neroshop::msgpack::Reader::skip() {
+    std::string_view view;
+    uint32_t count;
+    switch(peek_type()) {
+        case Type::Nil: return read_nil();
+        case Type::Boolean: { bool b; return read_bool(b); }
+        case Type::Integer: { int64_t i; return read_int(i); }
+        case Type::Float: { double d; return read_double(d); }
+        case Type::String: return read_string(view);
+        case Type::Binary: return read_binary(view);
+        case Type::Array:
+            if(!read_array_header(count)) return false;
+            for(uint32_t i = 0; i < count; ++i) if(!skip()) return false;
+            return true;
+        case Type::Map:
+            if(!read_map_header(count)) return false;
+            for(uint32_t i = 0; i < count * 2; ++i) if(!skip()) return false;
+            return true;
+        case Type::Extension: {
+            uint8_t marker = data[position++];
+            uint32_t length = 0;
+            switch(marker) {
+                case 0xd4: length = 1; break; case 0xd5: length = 2; break; case 0xd6: length = 4; break;
+                case 0xd7: length = 8; break; case 0xd8: length = 16; break;
+                case 0xc7: { uint8_t l; if(!read_big_endian(l)) return false; length = l; break; }
+                case 0xc8: { uint16_t l; if(!read_big_endian(l)) return false; length = l; break; }
+                case 0xc9: { if(!read_big_endian(length)) return false; break; }
+            }
+            length += 1; // type byte
+            if(size - position < length) { error = true; return false; }
+            position += length;
+            return true;
+        }
+        default:
+            error = true;
+            return false;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+neroshop::msgpack::Type neroshop::msgpack::Reader::peek_type() const {
+    if(position >= size) return Type::Invalid;
+    uint8_t marker = data[position];
+    if(marker <= 0x7f || marker >= 0xe0) return Type::Integer;
+    if(marker <= 0x8f) return Type::Map;
+    if(marker <= 0x9f) return Type::Array;
+    if(marker <= 0xbf) return Type::String;
+    switch(marker) {
+        case 0xc0: return Type::Nil;
+        case 0xc2: case 0xc3: return Type::Boolean;
+        case 0xc4: case 0xc5: case 0xc6: return Type::Binary;
+        case 0xc7: case 0xc8: case 0xc9: case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8: return Type::Extension;
+        case 0xca: case 0xcb: return Type::Float;
+        case 0xcc: case 0xcd: case 0xce: case 0xcf: case 0xd0: case 0xd1: case 0xd2: case 0xd3: return Type::Integer;
+        case 0xd9: case 0xda: case 0xdb: return Type::String;
+        case 0xdc: case 0xdd: return Type::Array;
+        case 0xde: case 0xdf: return Type::Map;
+        default: return Type::Invalid; // 0xc1 is never used
+    }
+}
+
+std::size_t neroshop::msgpack::Reader::get_position() const {
+    return position;
+}
+
+bool neroshop::msgpack::Reader::is_complete() const {
+    return !error && position == size;
+}
+
+bool neroshop::msgpack::Reader::has_error() const {
+    return error;
+}
+
+//-----------------------------------------------------------------------------
+
+neroshop::msgpack::Writer::Writer(std::vector<uint8_t>& buffer) : buffer(buffer) {}
+
+template <typename T>
+void neroshop::msgpack::Writer::write_big_endian(uint8_t marker, T value) {
+    buffer.push_back(marker);
+    uint64_t bits = 0;
+    if constexpr (sizeof(T) == sizeof(uint64_t)) {
+        std::memcpy(&bits, &value, sizeof(T));
+    } else if constexpr (sizeof(T) == sizeof(uint32_t) && std::is_floating_point<T>::value) {
+        uint32_t bits32;
+        std::memcpy(&bits32, &value, sizeof(T));
+        bits = bits32;
+    } else {
+        bits = static_cast<uint64_t>(value);
+    }
+    for (int i = sizeof(T) - 1; i >= 0; --i) {
+        buffer.push_back(static_cast<uint8_t>(bits >> (i * 8)));
+    }
+}
+
+void neroshop::msgpack::Writer::write_nil() {
+    buffer.push_back(0xc0);
+}
+
+void neroshop::msgpack::Writer::write_bool(bool value) {
+    buffer.push_back(value ? 0xc3 : 0xc2);
+}
+
+void neroshop::msgpack::Writer::write_int(int64_t value) {
+    if(value >= 0) {
+        write_uint(static_cast<uint64_t>(value));
+        return;
+    }
+    if(value >= -32) buffer.push_back(static_cast<uint8_t>(static_cast<int8_t>(value)));
+    else if(value >= INT8_MIN) write_big_endian(0xd0, static_cast<uint8_t>(static_cast<int8_t>(value)));
+    else if(value >= INT16_MIN) write_big_endian(0xd1, static_cast<uint16_t>(static_cast<int16_t>(value)));
+    else if(value >= INT32_MIN) write_big_endian(0xd2, static_cast<uint32_t>(static_cast<int32_t>(value)));
+    else write_big_endian(0xd3, static_cast<uint64_t>(value));
+}
+
+void neroshop::msgpack::Writer::write_uint(uint64_t value) {
+    if(value < 128) buffer.push_back(static_cast<uint8_t>(value));
+    else if(value <= UINT8_MAX) write_big_endian(0xcc, static_cast<uint8_t>(value));
+    else if(value <= UINT16_MAX) write_big_endian(0xcd, static_cast<uint16_t>(value));
+    else if(value <= UINT32_MAX) write_big_endian(0xce, static_cast<uint32_t>(value));
+    else write_big_endian(0xcf, value);
+}
+
+void neroshop::msgpack::Writer::write_double(double value) {
+    // Like nlohmann::json, use float32 whenever it represents the value exactly
+    float f = static_cast<float>(value);
+    if(static_cast<double>(f) == value) write_big_endian(0xca, f);
+    else write_big_endian(0xcb, value);
+}
+
+void neroshop::msgpack::Writer::write_string(std::string_view value) {
+    std::size_t length = value.size();
+    if(length <= 31) buffer.push_back(static_cast<uint8_t>(0xa0 | length));
+    else if(length <= UINT8_MAX) write_big_endian(0xd9, static_cast<uint8_t>(length));
+    else if(length <= UINT16_MAX) write_big_endian(0xda, static_cast<uint16_t>(length));
+    else write_big_endian(0xdb, static_cast<uint32_t>(length));
+    buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+void neroshop::msgpack::Writer::write_binary(const uint8_t * bytes, std::size_t size) {
+    if(size <= UINT8_MAX) write_big_endian(0xc4, static_cast<uint8_t>(size));
+    else if(size <= UINT16_MAX) write_big_endian(0xc5, static_cast<uint16_t>(size));
+    else write_big_endian(0xc6, static_cast<uint32_t>(size));
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+void neroshop::msgpack::Writer::write_binary(const std::vector<uint8_t>& bytes) {
+    write_binary(bytes.data(), bytes.size());
+}
+
+void neroshop::msgpack::Writer::write_array_header(uint32_t count) {
+    if(count <= 15) buffer.push_back(static_cast<uint8_t>(0x90 | count));
+    else if(count <= UINT16_MAX) write_big_endian(0xdc, static_cast<uint16_t>(count));
+    else write_big_endian(0xdd, count);
+}
+
+void neroshop::msgpack::Writer::write_map_header(uint32_t count) {
+    if(count <= 15) buffer.push_back(static_cast<uint8_t>(0x80 | count));
+    else if(count <= UINT16_MAX) write_big_endian(0xde, static_cast<uint16_t>(count));
+    else write_big_endian(0xdf, count);
+}
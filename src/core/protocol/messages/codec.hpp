@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace neroshop {
+
+namespace msgpack {
+
+enum class Type { Nil, Boolean, Integer, Float, String, Binary, Array, Map, Extension, Invalid };
+
+// Streaming msgpack reader that decodes straight from the receive buffer without allocating.
+// Strings and binary values are returned as views into the buffer, so the buffer must outlive them
+class Reader {
+private:
+    const uint8_t * data;
+    std::size_t size;
+    std::size_t position;
+    bool error;
+    bool read_length(uint8_t marker, uint8_t fix_mask, uint8_t fix_max, uint8_t marker8, uint8_t marker16, uint8_t marker32, uint32_t& length);
+    template <typename T> bool read_big_endian(T& value);
+public:
+    Reader(const uint8_t * data, std::size_t size);
+    explicit Reader(const std::vector<uint8_t>& buffer);
+    
+    bool read_nil();
+    bool read_bool(bool& value);
+    bool read_int(int64_t& value);
+    bool read_uint(uint64_t& value);
+    bool read_double(double& value);
+    bool read_string(std::string_view& value);
+    bool read_binary(std::string_view& value);
+    bool read_array_header(uint32_t& count); // Fails if the count is more than the remaining bytes could hold
+    bool read_map_header(uint32_t& count);
+    bool skip(); // Skips a single value, including nested arrays and maps
+    
+    Type peek_type() const;
+    std::size_t get_position() const;
+    bool is_complete() const; // Returns true if the whole buffer was consumed
+    bool has_error() const;
+};
+
+// Streaming msgpack writer that produces the same bytes as nlohmann::json::to_msgpack (smallest encoding for every value).
+// To stay byte-compatible, map keys must be written in sorted order like nlohmann::json does
+class Writer {
+private:
+    std::vector<uint8_t>& buffer;
+    template <typename T> void write_big_endian(uint8_t marker, T value);
+public:
+    explicit Writer(std::vector<uint8_t>& buffer);
+    
+    void write_nil();
+    void write_bool(bool value);
+    void write_int(int64_t value);
+    void write_uint(uint64_t value);
+    void write_double(double value);
+    void write_string(std::string_view value);
+    void write_binary(const uint8_t * bytes, std::size_t size);
+    void write_binary(const std::vector<uint8_t>& bytes);
+    void write_array_header(uint32_t count);
+    void write_map_header(uint32_t count);
+};
+
+}
+
+}
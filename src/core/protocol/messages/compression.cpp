@@ -0,0 +1,219 @@
+#include "compression.hpp"
+
+#include "../../../neroshop_config.hpp"
+
+#if defined(NEROSHOP_USE_ZSTD)
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#include <cstring> // std::memcpy
+#include <iostream>
+#include <map>
+#include <memory> // std::unique_ptr
+#include <mutex>
+
+namespace neroshop {
+
+namespace compression {
+
+// Raw content dictionary made up of the JSON fragments that every neroshop value repeats (see Serializer::serialize).
+// zstd references dictionary content by offset, with later content being cheaper to reference, so the most common fragments come last
+static const std::string default_dictionary = 
+    "{\"age_range\":{\"max\":,\"min\":},\"brand\":\"\",\"country_of_origin\":\"\",\"energy_efficiency_rating\":\"\",\"gender\":\"\","
+    "\"manufacturer\":\"\",\"model\":\"\",\"quantity_per_package\":1,\"release_date\":\"\",\"safety_features\":[\"\"],\"style\":\"\","
+    "\"warranty_information\":\"\",\"dimensions\":{\"depth\":,\"height\":,\"length\":,\"width\":},\"material\":\"\",\"product_code\":\"\","
+    "{\"contents\":\"\",\"metadata\":\"message\",\"recipient_id\":\"\",\"sender_id\":\"\",\"signature\":\"\",\"timestamp\":\""
+    "{\"created_at\":\"\",\"customer_id\":\"\",\"delivery_option\":\"Delivery\",\"discount\":0.0,\"items\":[{\"product_id\":\"\",\"quantity\":1,\"seller_id\":\"\"}],"
+    "\"metadata\":\"order\",\"notes\":\"\",\"payment_option\":\"Escrow\",\"shipping_cost\":0.0,\"status\":\"New\",\"subtotal\":0.0,\"total\":0.0}"
+    "{\"comments\":\"\",\"metadata\":\"seller_rating\",\"rater_id\":\"\",\"score\":1,\"seller_id\":\"\",\"signature\":\"\"}"
+    "{\"comments\":\"\",\"metadata\":\"product_rating\",\"product_id\":\"\",\"rater_id\":\"\",\"signature\":\"\",\"stars\":5}"
+    "{\"avatar\":{\"name\":\"\",\"size\":},\"created_at\":\"\",\"display_name\":\"\",\"metadata\":\"user\",\"monero_address\":\"\","
+    "\"public_key\":\"-----BEGIN PUBLIC KEY-----\\nMIIBIjANBgkqhkiG9w0BAQEFAAOCAQ8AMIIBCgKCAQEA\",\"signature\":\"\"}"
+    "\"subcategories\":[\"\"],\"tags\":[\"\"],\"images\":[{\"id\":0,\"name\":\".jpg\",\"size\":},{\"id\":1,\"name\":\".png\",\"size\":}],"
+    "\"attributes\":[{\"color\":\"\",\"size\":\"\",\"weight\":}],\"category\":\"\",\"code\":\"\",\"description\":\"\",\"id\":\"\",\"name\":\"\"},"
+    "{\"condition\":\"New\",\"currency\":\"XMR\",\"date\":\"2023-\",\"expiration_date\":\"\",\"id\":\"\",\"last_updated\":\"\",\"location\":\"\","
+    "\"metadata\":\"listing\",\"price\":,\"product\":{\"attributes\":[{\"color\":\"\",\"size\":\"\",\"weight\":}],\"category\":\"\",\"code\":\"\","
+    "\"description\":\"\",\"id\":\"\",\"images\":[{\"id\":0,\"name\":\"\",\"size\":}],\"name\":\"\",\"subcategories\":[\"\"],\"tags\":[\"\"]},"
+    "\"quantity\":1,\"seller_id\":\"\",\"signature\":\"";
+
+// Built-in dictionaries by id. The content of a dictionary never changes once nodes use it: a new one is added under the next id
+// and becomes the current one, while the old ones are kept for the values that were compressed with them
+static const std::map<uint32_t, const std::string *> dictionaries_by_id = {
+    { 1, &default_dictionary },
+};
+static constexpr uint32_t current_dictionary_id = 1;
+
+// A zstd skippable frame carrying the dictionary id is written in front of each zstd frame
+static constexpr uint32_t dictionary_id_magic = 0x184D2A50; // ZSTD_MAGIC_SKIPPABLE_START
+static constexpr std::size_t dictionary_id_frame_size = 12; // Magic number, content size (4) and dictionary id, all little-endian
+
+static uint32_t read_u32(const char * in) {
+    uint32_t value = 0;
+    for(int i = 0; i < 4; i++) value |= static_cast<uint32_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    return value;
+}
+
+//-----------------------------------------------------------------------------
+
+#if defined(NEROSHOP_USE_ZSTD)
+static constexpr int compression_level = 3; // zstd's default level
+
+static void write_u32(char * out, uint32_t value) {
+    for(int i = 0; i < 4; i++) out[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+struct Dictionaries {
+    std::unique_ptr<ZSTD_CDict, decltype(&ZSTD_freeCDict)> cdict { nullptr, &ZSTD_freeCDict };
+    std::unique_ptr<ZSTD_DDict, decltype(&ZSTD_freeDDict)> ddict { nullptr, &ZSTD_freeDDict };
+};
+
+static std::once_flag dictionaries_flag;
+
+// Digested dictionaries are created once and shared by all threads (they are read-only). Returns nullptr for an unknown id
+static const Dictionaries * get_dictionaries(uint32_t id) {
+    static std::map<uint32_t, Dictionaries> digested_dictionaries;
+    std::call_once(dictionaries_flag, [] {
+        for(const auto& [dictionary_id, dictionary] : dictionaries_by_id) {
+            Dictionaries& dictionaries = digested_dictionaries[dictionary_id];
+            // Only values are compressed with the current dictionary, so the older ones are only needed for decompressing
+            if(dictionary_id == current_dictionary_id) {
+                dictionaries.cdict.reset(ZSTD_createCDict(dictionary->data(), dictionary->size(), compression_level));
+            }
+            dictionaries.ddict.reset(ZSTD_createDDict(dictionary->data(), dictionary->size()));
+        }
+    });
+    auto it = digested_dictionaries.find(id);
+    return (it != digested_dictionaries.end()) ? &it->second : nullptr;
+}
+
+// Compression contexts are expensive to create so each thread reuses its own
+static ZSTD_CCtx * get_compression_context() {
+    thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx { ZSTD_createCCtx(), &ZSTD_freeCCtx };
+    return cctx.get();
+}
+
+static ZSTD_DCtx * get_decompression_context() {
+    thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> dctx { ZSTD_createDCtx(), &ZSTD_freeDCtx };
+    return dctx.get();
+}
+#endif
+
+//-----------------------------------------------------------------------------
+
+std::string compress(const std::string& value) {
+    #if defined(NEROSHOP_USE_ZSTD)
+    if(value.empty()) return value;
+    if(is_compressed(value)) {
+        if(get_dictionary_id(value) == current_dictionary_id) return value;
+        std::string decompressed = decompress(value);
+        return decompressed.empty() ? value : compress(decompressed);
+    }
+    
+    std::string compressed(dictionary_id_frame_size + ZSTD_compressBound(value.size()), '\0');
+    write_u32(&compressed[0], dictionary_id_magic);
+    write_u32(&compressed[4], 4);
+    write_u32(&compressed[8], current_dictionary_id);
+    size_t result = ZSTD_compress_usingCDict(get_compression_context(), &compressed[dictionary_id_frame_size], compressed.size() - dictionary_id_frame_size,
+        value.data(), value.size(), get_dictionaries(current_dictionary_id)->cdict.get());
+    if(ZSTD_isError(result) || (dictionary_id_frame_size + result) >= value.size()) {
+        return value; // Not worth it
+    }
+    compressed.resize(dictionary_id_frame_size + result);
+    return compressed;
+    #else
+    return value;
+    #endif
+}
+
+std::string decompress(const std::string& data) {
+    if(!is_compressed(data)) return data;
+    #if defined(NEROSHOP_USE_ZSTD)
+    const Dictionaries * dictionaries = get_dictionaries(get_dictionary_id(data));
+    if(!dictionaries) {
+        std::cerr << "\033[91mValue was compressed with an unknown dictionary (" << get_dictionary_id(data) << ")\033[0m\n";
+        return "";
+    }
+    const char * frame = data.data() + dictionary_id_frame_size;
+    const std::size_t frame_size = data.size() - dictionary_id_frame_size;
+    unsigned long long content_size = ZSTD_getFrameContentSize(frame, frame_size);
+    if(content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+        std::cerr << "\033[91mInvalid zstd frame\033[0m\n";
+        return "";
+    }
+    // The size comes from the peer that sent the value, so it is checked before anything is allocated
+    if(content_size == 0 || content_size > NEROSHOP_DHT_MAX_VALUE_SIZE) {
+        std::cerr << "\033[91mCompressed value declares a size of " << content_size << " bytes\033[0m\n";
+        return "";
+    }
+    std::string value(content_size, '\0');
+    size_t result = ZSTD_decompress_usingDDict(get_decompression_context(), &value[0], value.size(), frame, frame_size, dictionaries->ddict.get());
+    if(ZSTD_isError(result)) {
+        std::cerr << "\033[91mzstd: " << ZSTD_getErrorName(result) << "\033[0m\n";
+        return "";
+    }
+    value.resize(result);
+    return value;
+    #else
+    std::cerr << "\033[91mReceived a compressed value but neroshop was built without zstd\033[0m\n";
+    return "";
+    #endif
+}
+
+//-----------------------------------------------------------------------------
+
+bool is_compressed(const std::string& data) {
+    static const unsigned char magic[4] = { 0x28, 0xB5, 0x2F, 0xFD }; // ZSTD_MAGICNUMBER (little-endian)
+    return data.size() >= dictionary_id_frame_size + 4 && read_u32(data.data()) == dictionary_id_magic && read_u32(data.data() + 4) == 4
+        && std::memcmp(data.data() + dictionary_id_frame_size, magic, 4) == 0;
+}
+
+uint32_t get_dictionary_id(const std::string& data) {
+    return is_compressed(data) ? read_u32(data.data() + 8) : 0;
+}
+
+std::string get_encoding() {
+    return is_enabled() ? "zstd:" + std::to_string(current_dictionary_id) : "";
+}
+
+bool is_enabled() {
+    #if defined(NEROSHOP_USE_ZSTD)
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+//-----------------------------------------------------------------------------
+
+std::string train_dictionary(const std::vector<std::string>& samples, std::size_t max_size) {
+    #if defined(NEROSHOP_USE_ZSTD)
+    std::string samples_buffer;
+    std::vector<size_t> sample_sizes;
+    for (const auto& sample : samples) {
+        samples_buffer += sample;
+        sample_sizes.push_back(sample.size());
+    }
+    
+    std::string trained_dictionary(max_size, '\0');
+    size_t result = ZDICT_trainFromBuffer(&trained_dictionary[0], trained_dictionary.size(), samples_buffer.data(), sample_sizes.data(), static_cast<unsigned>(sample_sizes.size()));
+    if(ZDICT_isError(result)) {
+        std::cerr << "\033[91mzstd: " << ZDICT_getErrorName(result) << "\033[0m\n";
+        return "";
+    }
+    trained_dictionary.resize(result);
+    return trained_dictionary;
+    #else
+    (void)samples;
+    (void)max_size;
+    return "";
+    #endif
+}
+
+const std::string& get_default_dictionary() {
+    return default_dictionary;
+}
+
+}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef> // std::size_t
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace neroshop {
+
+namespace compression {
+    // Compresses a DHT value with zstd using the current neroshop value dictionary. The zstd frame is preceded by a skippable frame that holds
+    // the id of the dictionary, so values that were compressed (and stored) with an older dictionary can still be decompressed.
+    // Returns the value unchanged if neroshop was built without zstd or if compressing does not make it smaller.
+    // A value that was compressed with another dictionary is compressed again with the current one
+    std::string compress(const std::string& value);
+    // Returns the value unchanged if it is not compressed (e.g. plain JSON), or an empty string if its dictionary is unknown
+    std::string decompress(const std::string& data);
+    
+    bool is_compressed(const std::string& data); // Checks for the dictionary id frame followed by a zstd frame
+    bool is_enabled(); // Whether neroshop was built with zstd (NEROSHOP_USE_ZSTD)
+    uint32_t get_dictionary_id(const std::string& data); // Id of the dictionary that data was compressed with, 0 if it is not compressed
+    // Value encoding that compress() produces ("zstd:<dictionary id>"), advertised in ping/pong and in the "accept" of get requests.
+    // Compressed values are only sent to nodes that advertise the same encoding. Empty if neroshop was built without zstd
+    std::string get_encoding();
+    
+    // Trains a dictionary from sample values (such as serialized listings, ratings and messages). A dictionary is only ever added to
+    // the built-in ones under a new id, never put in place of one, as values compressed with the old one may still be stored on other nodes
+    std::string train_dictionary(const std::vector<std::string>& samples, std::size_t max_size = 16384);
+    
+    const std::string& get_default_dictionary();
+}
+
+}
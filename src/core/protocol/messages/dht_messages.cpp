@@ -0,0 +1,396 @@
+#include "dht_messages.hpp"
+
+#include "codec.hpp"
+
+#include <new>
+
+namespace neroshop {
+
+namespace msgpack {
+
+// Reads a map, passing each key to read_field which returns false for unknown keys (their values are skipped)
+template <typename FieldReader>
+static bool read_map(Reader& reader, FieldReader read_field) {
+    uint32_t count;
+    if(!reader.read_map_header(count)) return false;
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string_view key;
+        if(!reader.read_string(key)) return false;
+        if(!read_field(key) && !reader.skip()) return false;
+        if(reader.has_error()) return false;
+    }
+    return true;
+}
+
+static bool read_string_array(Reader& reader, std::vector<std::string_view>& strings) {
+    uint32_t count;
+    if(!reader.read_array_header(count)) return false;
+    strings.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string_view string;
+        if(!reader.read_string(string)) return false;
+        strings.push_back(string);
+    }
+    return true;
+}
+
+// Strings and binary values are both accepted wherever a value can be sent compressed
+static bool read_string_or_binary(Reader& reader, std::string_view& value, bool& is_binary) {
+    is_binary = (reader.peek_type() == Type::Binary);
+    return (is_binary) ? reader.read_binary(value) : reader.read_string(value);
+}
+
+//-----------------------------------------------------------------------------
+
+static bool read_fields(Reader& reader, PingRequest& message) {
+    return read_map(reader, [&](std::string_view key) {
+        if(key == "id") return reader.read_string(message.id);
+        if(key == "ephemeral_port") return reader.read_int(message.ephemeral_port);
+        if(key == "bloom") return reader.read_binary(message.bloom);
+        if(key == "encodings") return read_string_array(reader, message.encodings);
+        if(key == "protocol") return reader.read_int(message.protocol);
+        if(key == "capabilities") return reader.read_uint(message.capabilities);
+        return false;
+    });
+}
+
+static bool read_fields(Reader& reader, PingResponse& message) {
+    return read_map(reader, [&](std::string_view key) {
+        if(key == "id") return reader.read_string(message.id);
+        if(key == "bloom") return reader.read_binary(message.bloom);
+        if(key == "encodings") return read_string_array(reader, message.encodings);
+        if(key == "protocol") return reader.read_int(message.protocol);
+        if(key == "capabilities") return reader.read_uint(message.capabilities);
+        return false;
+    });
+}
+
+static bool read_fields(Reader& reader, FindNodeRequest& message) {
+    return read_map(reader, [&](std::string_view key) {
+        if(key == "id") return reader.read_string(message.id);
+        if(key == "target") return reader.read_string(message.target);
+        return false;
+    });
+}
+
+static bool read_nodes(Reader& reader, std::vector<NodeInfo>& nodes) {
+    uint32_t count;
+    if(!reader.read_array_header(count)) return false;
+    nodes.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        NodeInfo node;
+        bool ok = read_map(reader, [&](std::string_view node_key) {
+            if(node_key == "id") return reader.read_string(node.id);
+            if(node_key == "ip_address") return reader.read_string(node.ip_address);
+            if(node_key == "port") {
+                uint64_t port;
+                if(!reader.read_uint(port)) return false;
+                node.port = static_cast<uint16_t>(port);
+                return true;
+            }
+            return false;
+        });
+        if(!ok) return false;
+        nodes.push_back(node);
+    }
+    return true;
+}
+
+static bool read_fields(Reader& reader, FindNodeResponse& message) {
+    return read_map(reader, [&](std::string_view key) {
+        if(key == "id") return reader.read_string(message.id);
+        if(key == "nodes") return read_nodes(reader, message.nodes);
+        return false;
+    });
+}
+
+static bool read_fields(Reader& reader, GetRequest& message) {
+    return read_map(reader, [&](std::string_view key) {
+        if(key == "id") return reader.read_string(message.id);
+        if(key == "key") return reader.read_string(message.key);
+        if(key == "accept") return read_string_array(reader, message.accept);
+        return false;
+    });
+}
+
+static bool read_fields(Reader& reader, GetResponse& message) {
+    return read_map(reader, [&](std::string_view key) {
+        if(key == "id") return reader.read_string(message.id);
+        if(key == "value") return read_string_or_binary(reader, message.value, message.is_binary);
+        if(key == "encoding") return reader.read_string(message.encoding);
+        if(key == "nodes") return read_nodes(reader, message.nodes);
+        return false;
+    });
+}
+
+static bool read_fields(Reader& reader, PutRequest& message) {
+    return read_map(reader, [&](std::string_view key) {
+        if(key == "id") return reader.read_string(message.id);
+        if(key == "key") return reader.read_string(message.key);
+        if(key == "value") return read_string_or_binary(reader, message.value, message.is_binary);
+        if(key == "encoding") return reader.read_string(message.encoding);
+        if(key == "clock") return reader.read_uint(message.clock);
+        if(key == "publisher") return reader.read_string(message.publisher);
+        return false;
+    });
+}
+
+static bool read_fields(Reader& reader, PutResponse& message) {
+    return read_map(reader, [&](std::string_view key) {
+        if(key == "id") return reader.read_string(message.id);
+        if(key == "code") return reader.read_int(message.code);
+        if(key == "message") return reader.read_string(message.message);
+        return false;
+    });
+}
+
+struct EnvelopeOnly {};
+
+static bool read_fields(Reader& reader, EnvelopeOnly&) {
+    return reader.skip();
+}
+
+//-----------------------------------------------------------------------------
+
+template <typename Message>
+static bool decode_message(const std::vector<uint8_t>& buffer, Envelope& envelope, Message& message) {
+    Reader reader(buffer);
+    bool ok = false;
+    try {
+        ok = read_map(reader, [&](std::string_view key) {
+            if(key == "args" || key == "response") return read_fields(reader, message);
+            if(key == "query") return reader.read_string(envelope.query);
+            if(key == "version") return reader.read_string(envelope.version);
+            if(key == "tid") {
+                if(reader.peek_type() == Type::Nil) return reader.read_nil();
+                return read_string_or_binary(reader, envelope.tid, envelope.is_tid_binary);
+            }
+            if(key == "error") {
+                envelope.is_error = true;
+                return read_map(reader, [&](std::string_view error_key) {
+                    if(error_key == "code") return reader.read_int(envelope.error_code);
+                    if(error_key == "message") return reader.read_string(envelope.error_message);
+                    return false;
+                });
+            }
+            return false;
+        });
+    } catch(const std::bad_alloc&) {
+        return false; // A datagram must never take the node down
+    }
+    return ok && reader.is_complete();
+}
+
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, PingRequest& message) { return decode_message(buffer, envelope, message); }
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, PingResponse& message) { return decode_message(buffer, envelope, message); }
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, FindNodeRequest& message) { return decode_message(buffer, envelope, message); }
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, FindNodeResponse& message) { return decode_message(buffer, envelope, message); }
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, GetRequest& message) { return decode_message(buffer, envelope, message); }
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, GetResponse& message) { return decode_message(buffer, envelope, message); }
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, PutRequest& message) { return decode_message(buffer, envelope, message); }
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, PutResponse& message) { return decode_message(buffer, envelope, message); }
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope) { EnvelopeOnly message; return decode_message(buffer, envelope, message); }
+
+// Reads the top-level "tid" of a message that failed to parse, so that the error can still be matched with its request.
+// Parsing stops at the error, so only a tid that comes before it is found. The IPC client writes the tid first for this reason
+class TidReader : public nlohmann::json::json_sax_t {
+public:
+    nlohmann::json tid;
+    bool null() override { return take(nullptr); }
+    bool boolean(bool value) override { return take(value); }
+    bool number_integer(number_integer_t value) override { return take(value); }
+    bool number_unsigned(number_unsigned_t value) override { return take(value); }
+    bool number_float(number_float_t value, const string_t&) override { return take(value); }
+    bool string(string_t& value) override { return take(value); }
+    bool binary(binary_t& value) override { return take(nlohmann::json::binary(value)); }
+    bool start_object(std::size_t) override { depth++; is_tid = false; return true; }
+    bool key(string_t& key) override { is_tid = (depth == 1 && key == "tid"); return true; }
+    bool end_object() override { depth--; return true; }
+    bool start_array(std::size_t) override { depth++; is_tid = false; return true; }
+    bool end_array() override { depth--; return true; }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override { return false; }
+private:
+    int depth = 0;
+    bool is_tid = false;
+    bool take(nlohmann::json value) {
+        if(is_tid) tid = std::move(value);
+        is_tid = false;
+        return true;
+    }
+};
+
+static nlohmann::json read_tid(const std::vector<uint8_t>& buffer) {
+    TidReader tid_reader;
+    try {
+        nlohmann::json::sax_parse(buffer, &tid_reader, nlohmann::json::input_format_t::msgpack);
+    } catch(const std::exception&) {} // Whatever was read before the error is kept
+    return tid_reader.tid;
+}
+
+bool decode(const std::vector<uint8_t>& buffer, Message& message, bool decode_ping) {
+    // The "args" map comes before "query" so a message is read as a ping first. Fields that a ping does not have are skipped
+    if(decode_ping && decode_message(buffer, message.envelope, message.ping) && message.envelope.query == "ping") {
+        message.is_typed = true;
+        return true;
+    }
+    message.envelope = {};
+    message.ping = {};
+    message.is_typed = false;
+    try {
+        message.object = nlohmann::json::from_msgpack(buffer);
+    } catch(const nlohmann::json::parse_error& exception) {
+        message.parse_error = exception.what();
+    } catch(const std::bad_alloc&) {
+        message.parse_error = "Message too large";
+    }
+    if(message.is_valid()) return true;
+    message.object = nlohmann::json::object();
+    message.object["tid"] = read_tid(buffer);
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+// nlohmann::json writes map keys in sorted order, so every map below writes its keys alphabetically
+static void write_tid(Writer& writer, const Envelope& envelope) {
+    if(envelope.tid.empty()) writer.write_nil();
+    else if(envelope.is_tid_binary) writer.write_binary(reinterpret_cast<const uint8_t *>(envelope.tid.data()), envelope.tid.size());
+    else writer.write_string(envelope.tid);
+}
+
+static void write_string_array(Writer& writer, const std::vector<std::string_view>& strings) {
+    writer.write_array_header(static_cast<uint32_t>(strings.size()));
+    for (const auto& string : strings) writer.write_string(string);
+}
+
+static void write_string_or_binary(Writer& writer, std::string_view value, bool is_binary) {
+    if(is_binary) writer.write_binary(reinterpret_cast<const uint8_t *>(value.data()), value.size());
+    else writer.write_string(value);
+}
+
+static void write_fields(Writer& writer, const PingRequest& message) {
+    writer.write_map_header(1 + !message.bloom.empty() + !message.encodings.empty() + (message.ephemeral_port >= 0) + 2 * (message.protocol > 0));
+    if(!message.bloom.empty()) { writer.write_string("bloom"); writer.write_binary(reinterpret_cast<const uint8_t *>(message.bloom.data()), message.bloom.size()); }
+    if(message.protocol > 0) { writer.write_string("capabilities"); writer.write_uint(message.capabilities); }
+    if(!message.encodings.empty()) { writer.write_string("encodings"); write_string_array(writer, message.encodings); }
+    if(message.ephemeral_port >= 0) { writer.write_string("ephemeral_port"); writer.write_int(message.ephemeral_port); }
+    writer.write_string("id"); writer.write_string(message.id);
+    if(message.protocol > 0) { writer.write_string("protocol"); writer.write_int(message.protocol); }
+}
+
+static void write_fields(Writer& writer, const PingResponse& message) {
+    writer.write_map_header(1 + !message.bloom.empty() + !message.encodings.empty() + 2 * (message.protocol > 0));
+    if(!message.bloom.empty()) { writer.write_string("bloom"); writer.write_binary(reinterpret_cast<const uint8_t *>(message.bloom.data()), message.bloom.size()); }
+    if(message.protocol > 0) { writer.write_string("capabilities"); writer.write_uint(message.capabilities); }
+    if(!message.encodings.empty()) { writer.write_string("encodings"); write_string_array(writer, message.encodings); }
+    writer.write_string("id"); writer.write_string(message.id);
+    if(message.protocol > 0) { writer.write_string("protocol"); writer.write_int(message.protocol); }
+}
+
+static void write_fields(Writer& writer, const FindNodeRequest& message) {
+    writer.write_map_header(2);
+    writer.write_string("id"); writer.write_string(message.id);
+    writer.write_string("target"); writer.write_string(message.target);
+}
+
+static void write_nodes(Writer& writer, const std::vector<NodeInfo>& nodes) {
+    writer.write_array_header(static_cast<uint32_t>(nodes.size()));
+    for (const auto& node : nodes) {
+        writer.write_map_header(2 + !node.id.empty());
+        if(!node.id.empty()) { writer.write_string("id"); writer.write_string(node.id); }
+        writer.write_string("ip_address"); writer.write_string(node.ip_address);
+        writer.write_string("port"); writer.write_uint(node.port);
+    }
+}
+
+static void write_fields(Writer& writer, const FindNodeResponse& message) {
+    writer.write_map_header(2);
+    writer.write_string("id"); writer.write_string(message.id);
+    writer.write_string("nodes"); write_nodes(writer, message.nodes);
+}
+
+static void write_fields(Writer& writer, const GetRequest& message) {
+    writer.write_map_header(2 + !message.accept.empty());
+    if(!message.accept.empty()) { writer.write_string("accept"); write_string_array(writer, message.accept); }
+    writer.write_string("id"); writer.write_string(message.id);
+    writer.write_string("key"); writer.write_string(message.key);
+}
+
+static void write_fields(Writer& writer, const GetResponse& message) {
+    bool has_value = message.nodes.empty(); // Either the value or closer contacts are sent
+    writer.write_map_header(1 + !message.encoding.empty() + 1);
+    if(!message.encoding.empty()) { writer.write_string("encoding"); writer.write_string(message.encoding); }
+    writer.write_string("id"); writer.write_string(message.id);
+    if(!has_value) { writer.write_string("nodes"); write_nodes(writer, message.nodes); }
+    if(has_value) { writer.write_string("value"); write_string_or_binary(writer, message.value, message.is_binary); }
+}
+
+static void write_fields(Writer& writer, const PutRequest& message) {
+    writer.write_map_header(3 + (message.clock > 0) + !message.encoding.empty() + (message.clock > 0 && !message.publisher.empty()));
+    if(message.clock > 0) { writer.write_string("clock"); writer.write_uint(message.clock); }
+    if(!message.encoding.empty()) { writer.write_string("encoding"); writer.write_string(message.encoding); }
+    writer.write_string("id"); writer.write_string(message.id);
+    writer.write_string("key"); writer.write_string(message.key);
+    if(message.clock > 0 && !message.publisher.empty()) { writer.write_string("publisher"); writer.write_string(message.publisher); }
+    writer.write_string("value"); write_string_or_binary(writer, message.value, message.is_binary);
+}
+
+static void write_fields(Writer& writer, const PutResponse& message) {
+    writer.write_map_header(3);
+    writer.write_string("code"); writer.write_int(message.code);
+    writer.write_string("id"); writer.write_string(message.id);
+    writer.write_string("message"); writer.write_string(message.message);
+}
+
+//-----------------------------------------------------------------------------
+
+template <typename Message>
+static std::vector<uint8_t> encode_query(const Envelope& envelope, const Message& message) {
+    std::vector<uint8_t> buffer;
+    buffer.reserve(128);
+    Writer writer(buffer);
+    writer.write_map_header(3 + !envelope.tid.empty());
+    writer.write_string("args"); write_fields(writer, message);
+    writer.write_string("query"); writer.write_string(envelope.query);
+    if(!envelope.tid.empty()) { writer.write_string("tid"); write_tid(writer, envelope); }
+    writer.write_string("version"); writer.write_string(envelope.version);
+    return buffer;
+}
+
+template <typename Message>
+static std::vector<uint8_t> encode_response(const Envelope& envelope, const Message& message) {
+    std::vector<uint8_t> buffer;
+    buffer.reserve(128);
+    Writer writer(buffer);
+    writer.write_map_header(3);
+    writer.write_string("response"); write_fields(writer, message);
+    writer.write_string("tid"); write_tid(writer, envelope);
+    writer.write_string("version"); writer.write_string(envelope.version);
+    return buffer;
+}
+
+std::vector<uint8_t> encode(const Envelope& envelope, const PingRequest& message) { return encode_query(envelope, message); }
+std::vector<uint8_t> encode(const Envelope& envelope, const PingResponse& message) { return encode_response(envelope, message); }
+std::vector<uint8_t> encode(const Envelope& envelope, const FindNodeRequest& message) { return encode_query(envelope, message); }
+std::vector<uint8_t> encode(const Envelope& envelope, const FindNodeResponse& message) { return encode_response(envelope, message); }
+std::vector<uint8_t> encode(const Envelope& envelope, const GetRequest& message) { return encode_query(envelope, message); }
+std::vector<uint8_t> encode(const Envelope& envelope, const GetResponse& message) { return encode_response(envelope, message); }
+std::vector<uint8_t> encode(const Envelope& envelope, const PutRequest& message) { return encode_query(envelope, message); }
+std::vector<uint8_t> encode(const Envelope& envelope, const PutResponse& message) { return encode_response(envelope, message); }
+
+std::vector<uint8_t> encode_error(const Envelope& envelope) {
+    std::vector<uint8_t> buffer;
+    Writer writer(buffer);
+    writer.write_map_header(2 + !envelope.version.empty());
+    writer.write_string("error");
+    writer.write_map_header(2);
+    writer.write_string("code"); writer.write_int(envelope.error_code);
+    writer.write_string("message"); writer.write_string(envelope.error_message);
+    writer.write_string("tid"); write_tid(writer, envelope);
+    if(!envelope.version.empty()) { writer.write_string("version"); writer.write_string(envelope.version); }
+    return buffer;
+}
+
+}
+
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace neroshop {
+
+namespace msgpack {
+
+// Typed DHT messages. Decoded fields are views into the receive buffer so the buffer must outlive the struct.
+// Encoding produces the same bytes as building the message with nlohmann::json and calling to_msgpack
+
+// Protocol features that a node advertises in ping/pong. Peers only use the features that a node advertises,
+// so new features can be rolled out without breaking older nodes
+enum class Capability : uint32_t {
+    Zstd         = 1 << 0, // Accepts values compressed with our current dictionary (see compression::get_encoding)
+    Batch        = 1 << 1, // Handles get_many and put_many
+    IterativeGet = 1 << 2, // Answers a get it cannot serve with closer contacts instead of looking the key up itself
+    BinaryTid    = 1 << 3, // Echoes binary transaction ids
+    KeyFilter    = 1 << 4, // Publishes a Bloom filter of its keys
+    CacheStore   = 1 << 5, // Caches a value sent with "cache" by a requester whose lookup passed through it
+};
+
+inline bool has_capability(uint32_t capabilities, Capability capability) { return (capabilities & static_cast<uint32_t>(capability)) != 0; }
+
+struct Envelope { // Fields shared by every query, response and error message
+    std::string_view version;
+    std::string_view query; // Empty for responses
+    std::string_view tid; // Empty if the tid is nil
+    bool is_tid_binary = false; // Our own tids are fixed-width bytes sent as binary. Older nodes send strings, which are echoed back as strings
+    bool is_error = false;
+    int64_t error_code = 0;
+    std::string_view error_message;
+};
+
+struct NodeInfo {
+    std::string_view id; // Optional
+    std::string_view ip_address;
+    uint16_t port = 0;
+};
+
+struct PingRequest {
+    std::string_view id;
+    int64_t ephemeral_port = -1; // -1 if absent
+    std::string_view bloom; // Binary
+    std::vector<std::string_view> encodings;
+    int64_t protocol = 0; // 0 if absent
+    uint64_t capabilities = 0; // Bitmask of Capability
+};
+
+struct PingResponse {
+    std::string_view id;
+    std::string_view bloom; // Binary
+    std::vector<std::string_view> encodings;
+    int64_t protocol = 0; // 0 if absent
+    uint64_t capabilities = 0; // Bitmask of Capability
+};
+
+struct FindNodeRequest {
+    std::string_view id;
+    std::string_view target;
+};
+
+struct FindNodeResponse {
+    std::string_view id;
+    std::vector<NodeInfo> nodes;
+};
+
+struct GetRequest {
+    std::string_view id;
+    std::string_view key;
+    std::vector<std::string_view> accept;
+};
+
+struct GetResponse {
+    std::string_view id;
+    std::string_view value; // Empty if the node does not have the key
+    bool is_binary = false; // Whether the value was sent as binary (i.e. compressed)
+    std::string_view encoding;
+    std::vector<NodeInfo> nodes; // Contacts closer to the key, if the node does not have the key
+};
+
+struct PutRequest {
+    std::string_view id;
+    std::string_view key;
+    std::string_view value;
+    bool is_binary = false;
+    std::string_view encoding;
+    uint64_t clock = 0; // 0 if absent
+    std::string_view publisher;
+};
+
+struct PutResponse {
+    std::string_view id;
+    int64_t code = 0;
+    std::string_view message;
+};
+
+// Queries are decoded from their "args" map and responses from their "response" map.
+// Returns false if the buffer is not valid msgpack or a field has an unexpected type. An error message decodes successfully with envelope.is_error set
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, PingRequest& message);
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, PingResponse& message);
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, FindNodeRequest& message);
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, FindNodeResponse& message);
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, GetRequest& message);
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, GetResponse& message);
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, PutRequest& message);
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope, PutResponse& message);
+bool decode(const std::vector<uint8_t>& buffer, Envelope& envelope); // Skips "args" and "response" (e.g. to classify a query before deciding to handle it)
+
+std::vector<uint8_t> encode(const Envelope& envelope, const PingRequest& message);
+std::vector<uint8_t> encode(const Envelope& envelope, const PingResponse& message);
+std::vector<uint8_t> encode(const Envelope& envelope, const FindNodeRequest& message);
+std::vector<uint8_t> encode(const Envelope& envelope, const FindNodeResponse& message);
+std::vector<uint8_t> encode(const Envelope& envelope, const GetRequest& message);
+std::vector<uint8_t> encode(const Envelope& envelope, const GetResponse& message);
+std::vector<uint8_t> encode(const Envelope& envelope, const PutRequest& message);
+std::vector<uint8_t> encode(const Envelope& envelope, const PutResponse& message);
+std::vector<uint8_t> encode_error(const Envelope& envelope); // Uses envelope.error_code and envelope.error_message
+
+// A received message, decoded once and shared by routing table updates, dispatch and logging.
+// Pings are decoded into the typed struct and every other message into a json object
+struct Message {
+    Envelope envelope;
+    PingRequest ping;
+    nlohmann::json object; // Null for pings. If the message failed to parse, holds only its "tid" (null if it could not be read)
+    std::string parse_error; // Empty if the message was decoded
+    bool is_typed = false;
+    bool is_valid() const { return parse_error.empty(); }
+    bool is_ping() const { return is_typed && envelope.query == "ping"; }
+};
+
+bool decode(const std::vector<uint8_t>& buffer, Message& message, bool decode_ping = true); // If decode_ping is false, pings are decoded into the json object as well
+
+}
+
+}
@@ -0,0 +1,169 @@
+#include "dispatcher.hpp"
+
+#include <algorithm> // std::min
+
+#include "../p2p/kademlia.hpp"
+
+void neroshop::msgpack::LatencyHistogram::record(std::chrono::microseconds latency) {
+    uint64_t us = (latency.count() > 0) ? static_cast<uint64_t>(latency.count()) : 0;
+    std::size_t bucket = 0;
+    while((bucket + 1) < BUCKET_COUNT && (us >> (bucket + 1)) != 0) bucket++;
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(us, std::memory_order_relaxed);
+    uint64_t current_max = max.load(std::memory_order_relaxed);
+    while(us > current_max && !max.compare_exchange_weak(current_max, us, std::memory_order_relaxed)) {}
+}
+
+uint64_t neroshop::msgpack::LatencyHistogram::get_count() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+uint64_t neroshop::msgpack::LatencyHistogram::get_max() const {
+    return max.load(std::memory_order_relaxed);
+}
+
+double neroshop::msgpack::LatencyHistogram::get_mean() const {
+    uint64_t n = get_count();
+    return (n > 0) ? static_cast<double>(total.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+uint64_t neroshop::msgpack::LatencyHistogram::get_percentile(double percentile) const {
+    uint64_t n = get_count();
+    if(n == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(percentile * n);
+    if(rank >= n) rank = n - 1;
+    uint64_t seen = 0;
+    for(std::size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if(seen > rank) return std::min<uint64_t>((uint64_t(1) << (i + 1)) - 1, get_max());
+    }
+    return get_max();
+}
+
+//-----------------------------------------------------------------------------
+
+neroshop::msgpack::Dispatcher::MethodId neroshop::msgpack::Dispatcher::add(const std::string& method, std::vector<ArgSpec> arg_specs, Handler handler) {
+    std::unique_lock<std::shared_mutex> write_lock(dispatcher_mutex);
+    if(method_ids.count(method) > 0) return INVALID_METHOD;
+
+    auto entry = std::make_unique<Entry>();
+    entry->method = method;
+    entry->arg_specs = std::move(arg_specs);
+    entry->handler = std::move(handler);
+
+    MethodId method_id = static_cast<MethodId>(entries.size());
+    entries.push_back(std::move(entry));
+    method_ids[method] = method_id;
+    return method_id;
+}
+
+neroshop::msgpack::Dispatcher::MethodId neroshop::msgpack::Dispatcher::find(const std::string& method) const {
+    std::shared_lock<std::shared_mutex> read_lock(dispatcher_mutex);
+    auto it = method_ids.find(method);
+    return (it != method_ids.end()) ? it->second : INVALID_METHOD;
+}
+
+neroshop::msgpack::Dispatcher::Entry * neroshop::msgpack::Dispatcher::get_entry(MethodId method_id) const {
+    std::shared_lock<std::shared_mutex> read_lock(dispatcher_mutex);
+    if(method_id < 0 || static_cast<std::size_t>(method_id) >= entries.size()) return nullptr;
+    return entries[method_id].get();
+}
+
+neroshop::msgpack::Dispatcher::Entry * neroshop::msgpack::Dispatcher::get_entry(const std::string& method) const {
+    std::shared_lock<std::shared_mutex> read_lock(dispatcher_mutex);
+    auto it = method_ids.find(method);
+    return (it != method_ids.end()) ? entries[it->second].get() : nullptr;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::msgpack::Dispatcher::dispatch(MethodId method_id, const Request& request, nlohmann::json& response_object) {
+    call(get_entry(method_id), request, response_object);
+}
+
+void neroshop::msgpack::Dispatcher::dispatch(const std::string& method, const Request& request, nlohmann::json& response_object) {
+    call(get_entry(method), request, response_object);
+}
+
+// The lock is not held while the handler runs since handlers may block on the network
+void neroshop::msgpack::Dispatcher::call(Entry * entry, const Request& request, nlohmann::json& response_object) {
+    if(entry == nullptr) {
+        response_object["error"]["code"] = static_cast<int>(KadResultCode::InvalidOperation);
+        response_object["error"]["message"] = "Method not found";
+        return;
+    }
+
+    std::string invalid_arg = validate(entry->arg_specs, request.args);
+    if(!invalid_arg.empty()) {
+        response_object["error"]["code"] = static_cast<int>(KadResultCode::InvalidRequest);
+        response_object["error"]["message"] = "Invalid params";
+        response_object["error"]["data"] = invalid_arg;
+        return;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    try {
+        entry->handler(request, response_object);
+    } catch (const std::exception& e) {
+        // The arg specs only cover the top-level arguments, so a handler may still trip over an optional or nested field of the wrong type.
+        // That request gets an error instead of taking the node down with it
+        response_object = nlohmann::json::object();
+        response_object["error"]["code"] = static_cast<int>(KadResultCode::InvalidRequest);
+        response_object["error"]["message"] = "Invalid params";
+        response_object["error"]["data"] = e.what();
+        return;
+    }
+    entry->latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time));
+}
+
+void neroshop::msgpack::Dispatcher::record(MethodId method_id, std::chrono::microseconds latency) {
+    if(Entry * entry = get_entry(method_id)) {
+        entry->latency.record(latency);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+std::string neroshop::msgpack::Dispatcher::validate(const std::vector<ArgSpec>& arg_specs, const nlohmann::json& args) {
+    for(const auto& arg_spec : arg_specs) {
+        auto it = args.find(arg_spec.name);
+        if(it == args.end()) {
+            if(arg_spec.required) return arg_spec.name;
+            continue;
+        }
+        bool valid = false;
+        switch(arg_spec.type) {
+            case ArgType::String: valid = it->is_string(); break;
+            case ArgType::Integer: valid = it->is_number_integer(); break;
+            case ArgType::Boolean: valid = it->is_boolean(); break;
+            case ArgType::Binary: valid = it->is_binary(); break;
+            case ArgType::StringOrBinary: valid = it->is_string() || it->is_binary(); break;
+            case ArgType::Array: valid = it->is_array(); break;
+            case ArgType::Object: valid = it->is_object(); break;
+        }
+        if(!valid) return arg_spec.name;
+    }
+    return "";
+}
+
+//-----------------------------------------------------------------------------
+
+std::vector<std::string> neroshop::msgpack::Dispatcher::get_methods() const {
+    std::shared_lock<std::shared_mutex> read_lock(dispatcher_mutex);
+    std::vector<std::string> methods;
+    for(const auto& entry : entries) {
+        methods.push_back(entry->method);
+    }
+    return methods;
+}
+
+std::vector<neroshop::msgpack::MethodStats> neroshop::msgpack::Dispatcher::get_stats() const {
+    std::shared_lock<std::shared_mutex> read_lock(dispatcher_mutex);
+    std::vector<MethodStats> stats;
+    for(const auto& entry : entries) {
+        const LatencyHistogram& latency = entry->latency;
+        stats.push_back({ entry->method, latency.get_count(), latency.get_mean(), latency.get_percentile(0.50), latency.get_percentile(0.99), latency.get_max() });
+    }
+    return stats;
+}
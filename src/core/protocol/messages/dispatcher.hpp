@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace neroshop {
+
+class Node; // forward declaration
+
+namespace msgpack {
+
+enum class ArgType { String, Integer, Boolean, Binary, StringOrBinary, Array, Object };
+
+struct ArgSpec {
+    std::string name;
+    ArgType type;
+    bool required = true;
+};
+
+// Request passed to a handler. Its "args" have already been checked against the handler's ArgSpecs
+// so required arguments can be read without checking their presence or type again
+struct Request {
+    Node& node;
+    const nlohmann::json& args;
+    const std::string& requester_id; // Our own id in IPC mode
+    const std::string& requester_address; // IP address the request came from. Empty in IPC mode
+    uint64_t client_id; // IPC connection the request came in on. 0 outside of IPC mode
+
+    const std::string& get_string(const std::string& name) const { return args[name].get_ref<const std::string&>(); }
+    int64_t get_integer(const std::string& name) const { return args[name].get<int64_t>(); }
+    bool get_boolean(const std::string& name) const { return args[name].get<bool>(); }
+    bool has(const std::string& name) const { return args.contains(name); }
+};
+
+using Handler = std::function<void(const Request& request, nlohmann::json& response_object)>;
+
+// Handler latencies in power-of-two microsecond buckets (bucket i holds latencies in [2^i, 2^(i+1)) us)
+class LatencyHistogram {
+public:
+    static constexpr std::size_t BUCKET_COUNT = 32;
+    void record(std::chrono::microseconds latency);
+    uint64_t get_count() const;
+    uint64_t get_max() const; // In microseconds
+    double get_mean() const; // In microseconds
+    uint64_t get_percentile(double percentile) const; // Upper bound (in microseconds) of the bucket that holds the percentile
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets {};
+    std::atomic<uint64_t> count { 0 };
+    std::atomic<uint64_t> total { 0 };
+    std::atomic<uint64_t> max { 0 };
+};
+
+struct MethodStats {
+    std::string method;
+    uint64_t count;
+    double mean_us;
+    uint64_t p50_us;
+    uint64_t p99_us;
+    uint64_t max_us;
+};
+
+// Routes requests to registered handlers. Method names are interned into small integer ids on registration so
+// dispatch is a single hash lookup followed by an index into the handler table, no matter how many methods there are
+class Dispatcher {
+public:
+    using MethodId = int;
+    static constexpr MethodId INVALID_METHOD = -1;
+
+    MethodId add(const std::string& method, std::vector<ArgSpec> arg_specs, Handler handler); // Returns INVALID_METHOD if the method is already registered
+    MethodId find(const std::string& method) const;
+    // Validates the args, calls the handler and records its latency. On invalid args an error is set instead
+    void dispatch(MethodId method_id, const Request& request, nlohmann::json& response_object);
+    void dispatch(const std::string& method, const Request& request, nlohmann::json& response_object); // Same as dispatch(find(method), ...) but with a single lookup under the lock
+    void record(MethodId method_id, std::chrono::microseconds latency); // For requests that are answered without going through dispatch
+
+    std::vector<std::string> get_methods() const;
+    std::vector<MethodStats> get_stats() const;
+
+    static std::string validate(const std::vector<ArgSpec>& arg_specs, const nlohmann::json& args); // Returns the name of the first invalid argument or an empty string
+private:
+    struct Entry {
+        std::string method;
+        std::vector<ArgSpec> arg_specs;
+        Handler handler;
+        LatencyHistogram latency;
+    };
+    std::unordered_map<std::string, MethodId> method_ids;
+    std::vector<std::unique_ptr<Entry>> entries; // Indexed by method id. Entries are never removed so pointers to them stay valid
+    mutable std::shared_mutex dispatcher_mutex;
+    Entry * get_entry(MethodId method_id) const;
+    Entry * get_entry(const std::string& method) const;
+    void call(Entry * entry, const Request& request, nlohmann::json& response_object);
+};
+
+}
+
+}
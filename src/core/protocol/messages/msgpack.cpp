@@ -2,350 +2,747 @@
 
 #define JSON_USE_MSGPACK
 #include <nlohmann/json.hpp>
+#include <openssl/crypto.h> // CRYPTO_memcmp
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
 #include <openssl/rand.h>
 
+#include <mutex> // std::call_once
+
 #include "../../version.hpp"
 #include "../../tools/logger.hpp"
+#include "../p2p/event_publisher.hpp"
 #include "../p2p/kademlia.hpp"
+#include "../p2p/path_cache.hpp"
+#include "../p2p/value_cache.hpp"
+#include "compression.hpp"
+#include "dht_messages.hpp"
+#include "dispatcher.hpp"
 
 
-std::vector<uint8_t> neroshop::msgpack::process(const std::vector<uint8_t>& request, Node& node, bool ipc_mode) {
-    nlohmann::json request_object;
-    
-    nlohmann::json response_object;
-    std::vector<uint8_t> response; // bytes
+namespace neroshop {
 
-    // Process (parse) the request
-    try {
-        request_object = nlohmann::json::from_msgpack(request);
-        std::cout << "\033[33m" << request_object.dump() << "\033[0m" << std::endl;
+namespace msgpack {
+
+static void set_error(nlohmann::json& response_object, KadResultCode code, const std::string& message) {
+    response_object["error"]["code"] = static_cast<int>(code); // "code" MUST be an integer
+    response_object["error"]["message"] = message;
+}
+
+//-----------------------------------------------------------------------------
+
+// Whether the requester accepts values compressed with our dictionary
+static bool accepts_compressed(const Request& request) {
+    if(!compression::is_enabled() || !request.has("accept") || !request.args["accept"].is_array()) return false;
+    const std::string encoding = compression::get_encoding();
+    return std::find(request.args["accept"].begin(), request.args["accept"].end(), encoding) != request.args["accept"].end();
+}
+
+// The value as it is sent to a requester that accepts compressed values. The copy kept at rest is used unless it was compressed
+// with an older dictionary, and cached values (which are not kept at rest) are compressed here
+static std::string get_compressed(const Node& node, const std::string& key, const std::string& value) {
+    std::string stored_value = node.get_stored(key);
+    return compression::compress(stored_value.empty() ? value : stored_value);
+}
+
+// The plain value of a put or put_many entry. Empty if it is neither a string nor a value compressed in an encoding that we accept
+static std::string get_value(const nlohmann::json& entry) {
+    const nlohmann::json& value = entry["value"];
+    if(value.is_binary() && compression::is_enabled() && entry.contains("encoding") && entry["encoding"].is_string() && entry["encoding"].get<std::string>() == compression::get_encoding()) {
+        return compression::decompress(std::string(value.get_binary().begin(), value.get_binary().end()));
     }
-    catch(nlohmann::json::parse_error& exception) {
-        neroshop::print("Error parsing client request", 1);
-        response_object["version"] = std::string(NEROSHOP_DHT_VERSION);//"0.1.0"; // neroshop version
-        response_object["error"]["code"] = static_cast<int>(KadResultCode::ParseError); // "code" MUST be an integer
-        response_object["error"]["message"] = "Parse error";
-        response_object["error"]["data"] = exception.what(); // A Primitive (non-object) or Structured (array) value which may be omitted
-        response_object["tid"] = nullptr;
-        response = nlohmann::json::to_msgpack(response_object);
-        #ifdef NEROSHOP_DEBUG//0
-        std::cout << "Response output:\n\033[91m" << response_object.dump(4) << "\033[0m\n";
-        #endif
-        return response;//return response_object.dump(4);
+    if(value.is_string()) return value.get<std::string>();
+    return "";
+}
+
+// The version of a put, put_many or map entry. The publisher defaults to the requester when it is missing or not a string
+static ValueVersion get_version(const nlohmann::json& entry, const std::string& requester_id) {
+    ValueVersion version;
+    if(entry.contains("clock") && entry["clock"].is_number_unsigned()) {
+        version.counter = entry["clock"].get<uint64_t>();
+        version.publisher = (entry.contains("publisher") && entry["publisher"].is_string()) ? entry["publisher"].get<std::string>() : requester_id;
     }
-    //-----------------------------------------------------
-    assert(request_object.is_object());
-    assert(request_object["version"].is_string());
-    std::string neroshop_version = request_object["version"];
-    assert(neroshop_version == std::string(NEROSHOP_DHT_VERSION));
-    assert(request_object["query"].is_string());
-    std::string method = request_object["query"];
-    // "args" must contain the querying node's ID 
-    assert(request_object["args"].is_object());
-    auto params_object = request_object["args"];
-    if(!ipc_mode) assert(params_object["id"].is_string()); // querying node's id
-    std::string requester_node_id = (ipc_mode) ? node.get_id() : params_object["id"].get<std::string>();
-    
-    if(!request_object.contains("tid") && !ipc_mode) {
-        std::cout << "No tid found, hence a notification that will not receive a response from the server\n";
-        return {};
+    return version;
+}
+
+//-----------------------------------------------------------------------------
+
+static void on_ping(const Request& request, nlohmann::json& response_object) {
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = request.node.get_id();
+    // Publish a summary of our keys so that the pinging node can skip us when we certainly do not have a key
+    std::vector<uint8_t> bloom = request.node.get_key_filter();
+    if(!bloom.empty()) response_object["response"]["bloom"] = nlohmann::json::binary(bloom);
+    if(compression::is_enabled()) response_object["response"]["encodings"] = { compression::get_encoding() }; // Value encodings that we accept
+    response_object["response"]["protocol"] = NEROSHOP_DHT_PROTOCOL_VERSION;
+    response_object["response"]["capabilities"] = get_capabilities(); // Features that the pinging node may use with us
+}
+
+//-----------------------------------------------------------------------------
+
+static void on_find_node(const Request& request, nlohmann::json& response_object) {
+    const std::string& target = request.get_string("target"); // target node id sought after by the querying node
+
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = request.node.get_id();
+    std::vector<Node*> nodes = request.node.find_node(target, NEROSHOP_DHT_MAX_CLOSEST_NODES);
+    if(nodes.empty()) {
+        response_object["response"]["nodes"] = nlohmann::json::array();
+    } else {
+        std::vector<nlohmann::json> nodes_array;
+        for (const auto& n : nodes) {
+            nlohmann::json node_object = {
+                {"ip_address", n->get_ip_address()},
+                {"port", n->get_port()}
+            };
+            nodes_array.push_back(node_object);
+        }
+        response_object["response"]["nodes"] = nodes_array;
     }
-    auto tid = (ipc_mode) ? nullptr : request_object["tid"];
-    int code = 0;
-    //-----------------------------------------------------
-    if(method == "ping") {
-        response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-        response_object["response"]["id"] = node.get_id();
+}
+
+//-----------------------------------------------------------------------------
+
+static void on_get_peers(const Request& request, nlohmann::json& response_object) {
+    NEROSHOP_LOG(log_level::debug, "message type is a get_peers\n");
+    Node& node = request.node;
+    const std::string& info_hash = request.get_string("info_hash");
+
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    // Check if the queried node has peers for the requested infohash
+    std::vector<Peer> peers = node.get_peers(info_hash);
+    if(peers.empty()) {
+        // If the queried node has no peers for the requested infohash,
+        // return the K closest nodes in the routing table to the requested infohash
+        std::vector<Node*> closest_nodes = node.find_node(info_hash, NEROSHOP_DHT_MAX_CLOSEST_NODES);
+        std::vector<nlohmann::json> nodes_array;
+        for (const auto& n : closest_nodes) {
+            nlohmann::json node_object = {
+                {"id", n->get_id()},
+                {"ip_address", n->get_ip_address()},
+                {"port", n->get_port()}
+            };
+            nodes_array.push_back(node_object);
+            //std::cout << "Node ID: " << n->get_id() << ", Node IP address: " << n->get_ip_address() << ", Node port: " << n->get_port() << std::endl;
+        }
+        response_object["response"]["nodes"] = nodes_array; // If the queried node has no peers for the infohash, a key "nodes" is returned containing the K nodes in the queried nodes routing table closest to the infohash supplied in the query
+    } else {
+        std::vector<nlohmann::json> peers_array;
+        for (const auto& p : peers) {
+            nlohmann::json peer_object = {
+                {"ip_address", p.address},
+                {"port", p.port}
+            };
+            peers_array.push_back(peer_object);
+            //std::cout << "Peer IP address: " << p.address << ", Peer port: " << p.port << std::endl;
+        }
+        response_object["response"]["values"] = peers_array; // If the queried node has peers for the infohash, they are returned in a key "values" as a list of strings. Each string containing "compact" format peer information for a single peer
     }
-    //-----------------------------------------------------
-    if(method == "find_node") {
-        assert(request_object["args"].is_object());
-        auto params_object = request_object["args"];
-        assert(params_object["target"].is_string()); // target node id sought after by the querying node
-        std::string target = params_object["target"];
-        
+    // Include a token in the response. It is tied to the requester's address so that only the peer that received it can announce itself with it
+    response_object["response"]["token"] = node.get_token(request.requester_address);
+}
+
+//-----------------------------------------------------------------------------
+
+static void on_announce_peer(const Request& request, nlohmann::json& response_object) {
+    NEROSHOP_LOG(log_level::debug, "message type is a announce_peer\n");
+    Node& node = request.node;
+    const std::string& info_hash = request.get_string("info_hash");
+    const std::string& token = request.get_string("token");
+    int port = request.get_integer("port");
+
+    // Verify the token
+    if (!node.verify_token(request.requester_address, token)) {
+        // Invalid token, return error response
+        set_error(response_object, KadResultCode::InvalidToken, "Invalid token");
+        return;
+    }
+
+    // Add the peer to the info_hash_peers unordered_map
+    node.add_peer(info_hash, {request.requester_address, port});
+
+    // Return success response
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["code"] = static_cast<int>(KadResultCode::Success);
+    response_object["response"]["message"] = "Peer announced"; // not needed
+}
+
+//-----------------------------------------------------------------------------
+
+// For Processing Get Requests from Other Nodes
+static void on_get(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    const std::string& key = request.get_string("key");
+
+    // Look up the value in the node's own hash table (or in its cache of popular values)
+    std::string value = node.find_value(key);
+    if (value.empty()) value = node.get_cached(key);
+    // Send the value compressed if the requester accepts it
+    bool accepts_zstd = accepts_compressed(request);
+
+    if (!value.empty()) {
+        // Key found, return success response with value
         response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
         response_object["response"]["id"] = node.get_id();
-        std::vector<Node*> nodes = node.find_node(target, NEROSHOP_DHT_MAX_CLOSEST_NODES);
-        if(nodes.empty()) {
-            response_object["response"]["nodes"] = nlohmann::json::array();
-        } else {
-            std::vector<nlohmann::json> nodes_array;
-            for (const auto& n : nodes) {
-                nlohmann::json node_object = {
-                    {"ip_address", n->get_ip_address()},
-                    {"port", n->get_port()}
-                };
-                nodes_array.push_back(node_object);
+        response_object["response"]["value"] = value;
+        if (accepts_zstd) {
+            std::string compressed_value = get_compressed(node, key, value);
+            if (compression::is_compressed(compressed_value)) {
+                response_object["response"]["value"] = nlohmann::json::binary(std::vector<uint8_t>(compressed_value.begin(), compressed_value.end()));
+                response_object["response"]["encoding"] = compression::get_encoding();
             }
-            response_object["response"]["nodes"] = nodes_array;
         }
+        return;
     }
-    //-----------------------------------------------------
-    if(method == "get_peers") {
-        std::cout << "message type is a get_peers\n"; // 
-        assert(request_object["args"].is_object());
-        auto params_object = request_object["args"];
-        assert(params_object["info_hash"].is_string()); // info hash
-        std::string info_hash = params_object["info_hash"];
+
+    // If node does not have the key, return the contacts closest to the key so that the requester can ask them next.
+    // The request is answered right away instead of blocking this node on a lookup of its own
+    std::vector<nlohmann::json> nodes_array;
+    for (const auto& closest_node : node.find_node(key, NEROSHOP_DHT_MAX_CLOSEST_NODES)) {
+        if (closest_node->get_id() == request.requester_id) continue; // The requester has already asked itself
+        nodes_array.push_back({
+            {"id", closest_node->get_id()},
+            {"ip_address", closest_node->get_ip_address()},
+            {"port", closest_node->get_port()}
+        });
+    }
+    if (nodes_array.empty()) {
+        // Key not found and no closer contacts, return error response
+        set_error(response_object, KadResultCode::RetrieveFailed, "Key not found");
+        return;
+    }
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["nodes"] = nodes_array;
+}
+
+//-----------------------------------------------------------------------------
+
+// For Processing Put Requests from Other Nodes. The key-value pair is stored in the node's own key-value store
+static void on_put(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    const nlohmann::json& params_object = request.args;
+    const std::string& key = request.get_string("key");
+    std::string value = get_value(params_object);
+    if(value.empty()) {
+        set_error(response_object, KadResultCode::InvalidValue, "Unsupported or invalid value encoding");
+        return;
+    }
+    // Version of the value (if any) so that stale updates are rejected without parsing the value
+    ValueVersion version = get_version(params_object, request.requester_id);
+
+    // Add the key-value pair to the key-value store
+    int code = (node.store(key, value, version) == false)
+           ? static_cast<int>(KadResultCode::StoreFailed)
+           : static_cast<int>(KadResultCode::Success);
+
+    // Map keys to search terms for efficient search operations
+    node.map(key, value);
+
+    // Return success response // TODO: error reply
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["code"] = code;
+    response_object["response"]["message"] = (code != 0) ? "Store failed" : "Success";
+}
+
+//-----------------------------------------------------------------------------
+
+// Kademlia cache-store: a requester that found a value asks the closest node on its lookup path that did not have it
+// to cache it, so that later lookups for a popular key end before they reach the replicas
+static void on_cache(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    const std::string& key = request.get_string("key");
+    std::string value = get_value(request.args);
+    if(key.length() != 64 || value.empty() || !node.validate(key, value)) {
+        set_error(response_object, KadResultCode::InvalidValue, "Invalid value");
+        return;
+    }
+    node.cache(key, value); // Ignored if we store the key ourselves
+
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["code"] = static_cast<int>(KadResultCode::Success);
+    response_object["response"]["message"] = "Success";
+}
+
+//-----------------------------------------------------------------------------
+
+// For Processing Batched Get Requests from Other Nodes. Only the values that this node has are returned since the requester looks up the rest itself
+static void on_get_many(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    const nlohmann::json& keys = request.args["keys"];
+    bool accepts_zstd = accepts_compressed(request);
+
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["values"] = nlohmann::json::object();
+    nlohmann::json& values = response_object["response"]["values"];
+    // Keys that are left out are listed in "more", which counts against the same size limit as the values. So each key that the node has
+    // first takes its place in "more", and is swapped for its value in a second pass while the value fits
+    struct Entry { std::string key; std::string value; bool is_compressed; };
+    std::vector<Entry> entries;
+    size_t more_size = 0;
+    size_t key_count = 0;
+    for (const auto& key_object : keys) {
+        if (!key_object.is_string()) continue;
+        const std::string& key = key_object.get_ref<const std::string&>();
+        size_t more_entry_size = key.size() + 5; // 5 bytes is the largest msgpack string header
+        // Keys beyond the batch limit are left for the requester to ask for again like the ones that do not fit
+        if (key_count++ >= NEROSHOP_DHT_MAX_BATCH_KEYS) {
+            if (more_size + more_entry_size > NEROSHOP_DHT_MAX_BATCH_SIZE) break; // Only a requester that ignores the batch limit gets here
+            entries.push_back({ key, "", false });
+            more_size += more_entry_size;
+            continue;
+        }
+        std::string value = node.find_value(key);
+        if (value.empty()) value = node.get_cached(key);
+        if (value.empty()) continue;
         
-        response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-        response_object["response"]["id"] = node.get_id();
-        // Check if the queried node has peers for the requested infohash
-        std::vector<Peer> peers = node.get_peers(info_hash);
-        if(peers.empty()) {
-            // If the queried node has no peers for the requested infohash,
-            // return the K closest nodes in the routing table to the requested infohash
-            std::vector<Node*> closest_nodes = node.find_node(info_hash, NEROSHOP_DHT_MAX_CLOSEST_NODES);
-            std::vector<nlohmann::json> nodes_array;
-            for (const auto& n : closest_nodes) {
-                nlohmann::json node_object = {
-                    {"id", n->get_id()},
-                    {"ip_address", n->get_ip_address()},
-                    {"port", n->get_port()}
-                };
-                nodes_array.push_back(node_object);
-                //std::cout << "Node ID: " << n->get_id() << ", Node IP address: " << n->get_ip_address() << ", Node port: " << n->get_port() << std::endl;
-            }
-            response_object["response"]["nodes"] = nodes_array; // If the queried node has no peers for the infohash, a key "nodes" is returned containing the K nodes in the queried nodes routing table closest to the infohash supplied in the query
+        bool is_compressed = false;
+        if (accepts_zstd) {
+            std::string compressed_value = get_compressed(node, key, value);
+            is_compressed = compression::is_compressed(compressed_value);
+            if (is_compressed) value = std::move(compressed_value);
+        }
+        entries.push_back({ key, std::move(value), is_compressed });
+        more_size += more_entry_size;
+    }
+    
+    nlohmann::json more = nlohmann::json::array();
+    size_t response_size = more_size;
+    const Entry * first_value = nullptr;
+    for (const auto& entry : entries) {
+        if (entry.value.empty()) {
+            more.push_back(entry.key);
+            continue;
+        }
+        if (first_value == nullptr) first_value = &entry;
+        size_t entry_size = entry.key.size() + entry.value.size() + 10; // Plus the msgpack headers of the key and the value
+        size_t more_entry_size = entry.key.size() + 5;
+        if (response_size - more_entry_size + entry_size > NEROSHOP_DHT_MAX_BATCH_SIZE) {
+            more.push_back(entry.key);
+            continue;
+        }
+        response_size += entry_size - more_entry_size;
+        if (entry.is_compressed) {
+            values[entry.key] = nlohmann::json::binary(std::vector<uint8_t>(entry.value.begin(), entry.value.end()));
         } else {
-            std::vector<nlohmann::json> peers_array;
-            for (const auto& p : peers) {
-                nlohmann::json peer_object = {
-                    {"ip_address", p.address},
-                    {"port", p.port}
-                };
-                peers_array.push_back(peer_object);
-                //std::cout << "Peer IP address: " << p.address << ", Peer port: " << p.port << std::endl;
-            }
-            response_object["response"]["values"] = peers_array; // If the queried node has peers for the infohash, they are returned in a key "values" as a list of strings. Each string containing "compact" format peer information for a single peer
+            values[entry.key] = entry.value;
         }
-        // Generate and include a token value in the response
-        auto secret = generate_secret(16);
-        std::string token = generate_token(node.get_id(), info_hash, secret); // The reason for concatenating the node ID and info hash is to ensure that the generated token is unique and specific to the peer making the request. This helps prevent replay attacks, where an attacker intercepts and reuses a token generated for another peer.
-        response_object["response"]["token"] = token;
     }
-    //-----------------------------------------------------
-    if(method == "announce_peer") {
-        std::cout << "message type is a announce_peer\n";
-        assert(request_object["args"].is_object());
-        auto params_object = request_object["args"];
-        assert(params_object["info_hash"].is_string()); // info hash
-        std::string info_hash = params_object["info_hash"];
-        assert(params_object["token"].is_string());
-        std::string token = params_object["token"];
-        assert(params_object["port"].is_number_integer());
-        int port = params_object["port"];
-        
-        // Verify the token
-        std::string secret = generate_secret(16);
-        std::string expected_token = generate_token(node.get_id(), info_hash, secret);
-        if (token != expected_token) {
-            // Invalid token, return error response
-            code = static_cast<int>(KadResultCode::InvalidToken);
-            response_object["error"]["code"] = code;
-            response_object["error"]["message"] = "Invalid token";
-            response_object["tid"] = tid;
-            response = nlohmann::json::to_msgpack(response_object);
-            return response;
+    // Without any value the requester would ask for the same keys again and get the same answer. So the first value is sent with only
+    // the keys that still fit in "more". The requester asks the other replicas for the keys that are left out
+    if (values.empty() && first_value != nullptr) {
+        more = nlohmann::json::array();
+        response_size = first_value->key.size() + first_value->value.size() + 10;
+        for (const auto& entry : entries) {
+            if (&entry == first_value) continue;
+            if (response_size + entry.key.size() + 5 > NEROSHOP_DHT_MAX_BATCH_SIZE) break;
+            more.push_back(entry.key);
+            response_size += entry.key.size() + 5;
+        }
+        if (first_value->is_compressed) {
+            values[first_value->key] = nlohmann::json::binary(std::vector<uint8_t>(first_value->value.begin(), first_value->value.end()));
+        } else {
+            values[first_value->key] = first_value->value;
         }
+    }
+    if (!more.empty()) response_object["response"]["more"] = more;
+}
+
+//-----------------------------------------------------------------------------
 
-        // Add the peer to the info_hash_peers unordered_map
-        node.add_peer(info_hash, {/*ip_address*/"", port});
+// For Processing Batched Put Requests from Other Nodes
+static void on_put_many(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    int count = 0;
+    for (const auto& entry : request.args["data"]) {
+        if(!entry.is_object() || !entry.contains("key") || !entry["key"].is_string() || !entry.contains("value")) continue;
+        std::string key = entry["key"];
+        std::string value = get_value(entry);
+        if(value.empty()) continue; // Unsupported or invalid value encoding
+        ValueVersion version = get_version(entry, request.requester_id);
         
-        // Return success response
-        response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-        response_object["response"]["id"] = node.get_id();
-        response_object["response"]["code"] = code;
-        response_object["response"]["message"] = "Peer announced"; // not needed
+        if(node.store(key, value, version)) count++;
+        // Map keys to search terms for efficient search operations
+        node.map(key, value);
     }
-    //-----------------------------------------------------
-    if(method == "get") {
-        if(ipc_mode == false) { // For Processing Get Requests from Other Nodes:
-            assert(request_object["args"].is_object());
-            auto params_object = request_object["args"];
-            assert(params_object["key"].is_string());
-            std::string key = params_object["key"];
-
-            // Look up the value in the node's own hash table
-            std::string value = node.find_value(key);
-                    
-            if (!value.empty()) {
-                // Key found, return success response with value
-                response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-                response_object["response"]["id"] = node.get_id();
-                response_object["response"]["value"] = value;
-            } else {
-                // If node does not have the key, check the closest nodes to see if they have it
-                std::vector<Node*> closest_nodes = node.find_node(key, NEROSHOP_DHT_MAX_CLOSEST_NODES);
-
-                std::random_device rd;
-                std::mt19937 rng(rd());
-                std::shuffle(closest_nodes.begin(), closest_nodes.end(), rng);
-
-                std::string closest_node_value;
-                for (auto const& closest_node : closest_nodes) {
-                    closest_node_value = closest_node->send_get(key);
-                    if (!closest_node_value.empty()) {
-                        break;
-                    }
-                }
-
-                if (!closest_node_value.empty()) {
-                    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-                    response_object["response"]["id"] = node.get_id();
-                    response_object["response"]["value"] = closest_node_value;
-                } else {
-                    // Key not found, return error response
-                    code = static_cast<int>(KadResultCode::RetrieveFailed);
-                    response_object["error"]["code"] = code;
-                    response_object["error"]["message"] = "Key not found";
-                    response_object["tid"] = tid;
-                    response = nlohmann::json::to_msgpack(response_object);
-                    return response;
-                }
-            }
 
-        } else { // For Sending Get Requests to Other Nodes
-            assert(request_object["args"].is_object());
-            auto params_object = request_object["args"];
-            assert(params_object["key"].is_string());
-            std::string key = params_object["key"];
-            // To get network status
-            if(key == "status") {
-                response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-                response_object["response"]["id"] = node.get_id();
-                response_object["response"]["connected_peers"] = node.get_peer_count();
-                response_object["response"]["active_peers"] = node.get_active_peer_count();
-                response_object["response"]["idle_peers"] = node.get_idle_peer_count();
-                response = nlohmann::json::to_msgpack(response_object);
-                return response;
-            }
-                        
-            // Send get messages to the closest nodes in your routing table (IPC mode)
-            std::string value = node.send_get(key);
-            
-            // Key not found, return error response
-            if (value.empty()) {
-                code = static_cast<int>(KadResultCode::RetrieveFailed);
-                response_object["error"]["code"] = code;
-                response_object["error"]["message"] = "Key not found";
-                response_object["tid"] = tid;
-                response = nlohmann::json::to_msgpack(response_object);
-                return response;
-            }
-            // Key found, return success response with value
-            response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-            response_object["response"]["id"] = node.get_id();
-            response_object["response"]["value"] = value;
-        }
-    }
-    //-----------------------------------------------------
-    if(method == "put") {
-        // If ipc_mode is false, it means the "put" message is being processed from other nodes. In this case, the key-value pair is stored in the node's own key-value store using the node.store(key, value) function.
-        if(ipc_mode == false) { // For Processing Put Requests from Other Nodes:
-            assert(request_object["args"].is_object());
-            auto params_object = request_object["args"];
-            assert(params_object["key"].is_string());
-            std::string key = params_object["key"];
-            assert(params_object["value"].is_string());
-            std::string value = params_object["value"];
-        
-            // Add the key-value pair to the key-value store
-            code = (node.store(key, value) == false) 
-                   ? static_cast<int>(KadResultCode::StoreFailed) 
-                   : static_cast<int>(KadResultCode::Success);
-            
-            // Map keys to search terms for efficient search operations
-            node.map(key, value);
-        
-            // Return success response // TODO: error reply
-            response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-            response_object["response"]["id"] = node.get_id();
-            response_object["response"]["code"] = code;
-            response_object["response"]["message"] = (code != 0) ? "Store failed" : "Success";
-        } else { // For Sending Put Requests to Other Nodes
-            // On the other hand, if ipc_mode is true, it means the "put" message is being sent from the local IPC client. In this case, the node.send_put(key, value) function is called to send the put message to the closest nodes in the routing table. Additionally, you can add a line of code to store the key-value pair in the local node's own hash table as well
-            assert(request_object["args"].is_object());
-            auto params_object = request_object["args"];
-            assert(params_object["key"].is_string());
-            std::string key = params_object["key"];
-            assert(params_object["value"].is_string());
-            std::string value = params_object["value"];
-
-            // Send put messages to the closest nodes in your routing table (IPC mode)
-            int put_messages_sent = node.send_put(key, value);
-            code = (put_messages_sent <= 0) 
-                   ? static_cast<int>(KadResultCode::StoreFailed) 
-                   : static_cast<int>(KadResultCode::Success);
-            std::cout << "Number of nodes you've sent a put message to: " << put_messages_sent << "\n";
-                   
-            // Store the key-value pair in your own node as well
-            node.store(key, value);
-            
-            // Map keys to search terms for efficient search operations
+    // Return success response (acknowledges the number of entries that were stored)
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["count"] = count;
+}
+
+//-----------------------------------------------------------------------------
+
+static void on_map(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    const nlohmann::json& params_object = request.args;
+    int count = 0;
+    if(params_object.contains("data")) { // Keyspace handoff: a chunk of keys that this node is now responsible for
+        for (const auto& entry : params_object["data"]) {
+            if(!entry.contains("key") || !entry["key"].is_string()) continue;
+            if(!entry.contains("value") || !entry["value"].is_string()) continue;
+            std::string key = entry["key"];
+            std::string value = entry["value"];
+            ValueVersion version = get_version(entry, request.requester_id);
+
+            if(node.store(key, value, version)) count++;
+            // Store indexing data in database on receiving a "map" request
             node.map(key, value);
-        
-            // Return success response
-            response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-            response_object["response"]["id"] = node.get_id();
-            response_object["response"]["code"] = (code != 0) ? static_cast<int>(KadResultCode::StorePartial) : code;
-            response_object["response"]["message"] = (code != 0) ? "Store failed" : "Success";
         }
-    }
-    //-----------------------------------------------------
-    if(method == "map") {
-        assert(request_object["args"].is_object());
-        auto params_object = request_object["args"];
-        assert(params_object["key"].is_string());
-        std::string key = params_object["key"];
-        assert(params_object["value"].is_string());
-        std::string value = params_object["value"];
-        
+    } else if(params_object.contains("key") && params_object["key"].is_string()
+        && params_object.contains("value") && params_object["value"].is_string()) {
         // Store indexing data in database on receiving a "map" request
-        node.map(key, value);
+        node.map(params_object["key"], params_object["value"]);
+        count++;
+    }
+
+    // Return success response (acknowledges the number of entries that were accepted)
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["count"] = count;
+}
+
+//-----------------------------------------------------------------------------
+
+static void on_status(const Request& request, nlohmann::json& response_object);
+
+// For Sending Get Requests to Other Nodes (IPC mode)
+static void on_ipc_get(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    const std::string& key = request.get_string("key");
+    // To get network status
+    if(key == "status") {
+        on_status(request, response_object);
+        return;
+    }
+
+    // Send get messages to the closest nodes in your routing table (IPC mode)
+    std::string value = node.send_get(key);
+
+    // Key not found, return error response
+    if (value.empty()) {
+        set_error(response_object, KadResultCode::RetrieveFailed, "Key not found");
+        return;
+    }
+    // Key found, return success response with value
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["value"] = value;
+}
+
+//-----------------------------------------------------------------------------
+
+// For Sending Put Requests to Other Nodes (IPC mode). The key-value pair is also stored in the local node's own hash table
+static void on_ipc_put(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    const std::string& key = request.get_string("key");
+    const std::string& value = request.get_string("value");
+    // Every update published by this node gets a new version
+    ValueVersion version = node.get_next_version();
+
+    // Send put messages to the closest nodes in your routing table (IPC mode)
+    int put_messages_sent = node.send_put(key, value, version);
+    int code = (put_messages_sent <= 0)
+           ? static_cast<int>(KadResultCode::StoreFailed)
+           : static_cast<int>(KadResultCode::Success);
+    NEROSHOP_LOG(log_level::debug, "Number of nodes you've sent a put message to: " << put_messages_sent << "\n");
+
+    // Store the key-value pair in your own node as well
+    node.store(key, value, version);
+
+    // Map keys to search terms for efficient search operations
+    node.map(key, value);
+
+    // Return success response
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["code"] = (code != 0) ? static_cast<int>(KadResultCode::StorePartial) : code;
+    response_object["response"]["message"] = (code != 0) ? "Store failed" : "Success";
+}
+
+//-----------------------------------------------------------------------------
+
+// For Sending Batched Get Requests to Other Nodes (IPC mode). Keys that could not be found are left out of "values"
+static void on_ipc_get_many(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    std::vector<std::string> keys;
+    for (const auto& key : request.args["keys"]) {
+        if (key.is_string()) keys.push_back(key);
+    }
+
+    std::unordered_map<std::string, std::string> values = node.send_get_many(keys);
     
-        // Return success response
-        response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-        response_object["response"]["id"] = node.get_id();
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["values"] = nlohmann::json::object();
+    for (const auto& pair : values) {
+        response_object["response"]["values"][pair.first] = pair.second;
     }
-    //-----------------------------------------------------
-    if(method == "set" && ipc_mode) { // modify/update data
-        assert(request_object["args"].is_object());
-        auto params_object = request_object["args"];
-        assert(params_object["key"].is_string());
-        std::string key = params_object["key"];
-        assert(params_object["value"].is_string());
-        std::string value = params_object["value"];
-        assert(params_object["verified"].is_boolean());
-        bool verified = params_object["verified"].get<bool>();
-        
-        if(verified == false) {
-            code = static_cast<int>(KadResultCode::DataVerificationFailed);
-            response_object["error"]["code"] = code;
-            response_object["error"]["message"] = "Data verification failed";
-            response_object["tid"] = tid;
-            response = nlohmann::json::to_msgpack(response_object);
-            return response;
+}
+
+//-----------------------------------------------------------------------------
+
+// For Sending Batched Put Requests to Other Nodes (IPC mode)
+static void on_ipc_put_many(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    std::vector<std::pair<std::string, std::string>> entries;
+    std::vector<ValueVersion> versions;
+    for (const auto& entry : request.args["data"]) {
+        if (!entry.is_object() || !entry.contains("key") || !entry["key"].is_string() || !entry.contains("value") || !entry["value"].is_string()) continue;
+        entries.emplace_back(entry["key"], entry["value"]);
+        versions.push_back(node.get_next_version()); // Every update published by this node gets a new version
+    }
+
+    // Send put_many messages to the closest nodes in your routing table (IPC mode)
+    int stored_count = node.send_put_many(entries, versions);
+    int code = (stored_count < static_cast<int>(entries.size()))
+           ? static_cast<int>(KadResultCode::StoreFailed)
+           : static_cast<int>(KadResultCode::Success);
+
+    // Store the key-value pairs in your own node as well
+    for (size_t i = 0; i < entries.size(); i++) {
+        node.store(entries[i].first, entries[i].second, versions[i]);
+        // Map keys to search terms for efficient search operations
+        node.map(entries[i].first, entries[i].second);
+    }
+
+    // Return success response
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["code"] = (code != 0) ? static_cast<int>(KadResultCode::StorePartial) : code;
+    response_object["response"]["message"] = (code != 0) ? "Store failed" : "Success";
+    response_object["response"]["count"] = stored_count;
+}
+
+//-----------------------------------------------------------------------------
+
+static void on_ipc_set(const Request& request, nlohmann::json& response_object) { // modify/update data
+    Node& node = request.node;
+    const std::string& key = request.get_string("key");
+    const std::string& value = request.get_string("value");
+    bool verified = request.get_boolean("verified");
+
+    if(verified == false) {
+        set_error(response_object, KadResultCode::DataVerificationFailed, "Data verification failed");
+        return;
+    }
+
+    // Every update published by this node gets a new version
+    ValueVersion version = node.get_next_version();
+
+    // Send put messages to the closest nodes in your routing table (IPC mode)
+    int put_messages_sent = node.send_put(key, value, version);
+    int code = (put_messages_sent <= 0)
+           ? static_cast<int>(KadResultCode::StoreFailed)
+           : static_cast<int>(KadResultCode::Success);
+    NEROSHOP_LOG(log_level::debug, "Number of nodes you've sent a put message to: " << put_messages_sent << "\n");
+
+    // Store the key-value pair in your own node as well
+    node.store(key, value, version);
+    // Mapping data already exists in database so no need to call node.map()
+    // Return success response
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["code"] = (code != 0) ? static_cast<int>(KadResultCode::StorePartial) : code;
+    response_object["response"]["message"] = (code != 0) ? "Store failed" : "Success";
+}
+
+//-----------------------------------------------------------------------------
+
+static void on_status(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["connected_peers"] = node.get_peer_count();
+    response_object["response"]["active_peers"] = node.get_active_peer_count();
+    response_object["response"]["idle_peers"] = node.get_idle_peer_count();
+    // Cache metrics to verify that popular keys are served without reaching the replicas
+    if (ValueCache * value_cache = node.get_value_cache()) {
+        response_object["response"]["cache"]["size"] = value_cache->get_size();
+        response_object["response"]["cache"]["bytes"] = value_cache->get_byte_count();
+        response_object["response"]["cache"]["hits"] = value_cache->get_hits();
+        response_object["response"]["cache"]["misses"] = value_cache->get_misses();
+        nlohmann::json hot_keys = nlohmann::json::array();
+        for (const auto& stats : value_cache->get_hottest_keys(10)) {
+            hot_keys.push_back({ {"key", stats.key}, {"hits", stats.hits}, {"misses", stats.misses}, {"hit_rate", stats.get_hit_rate()} });
         }
-        
-        // Send put messages to the closest nodes in your routing table (IPC mode)
-        int put_messages_sent = node.send_put(key, value);
-        code = (put_messages_sent <= 0) 
-               ? static_cast<int>(KadResultCode::StoreFailed) 
-               : static_cast<int>(KadResultCode::Success);
-        std::cout << "Number of nodes you've sent a put message to: " << put_messages_sent << "\n";
-                   
-        // Store the key-value pair in your own node as well
-        node.store(key, value);
-        // Mapping data already exists in database so no need to call node.map()
-        // Return success response
-        response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-        response_object["response"]["id"] = node.get_id();
-        response_object["response"]["code"] = (code != 0) ? static_cast<int>(KadResultCode::StorePartial) : code;
-        response_object["response"]["message"] = (code != 0) ? "Store failed" : "Success";
+        response_object["response"]["cache"]["hot_keys"] = hot_keys;
+    }
+    // Lookups that started from the nodes that returned the value last time
+    if (PathCache * path_cache = node.get_path_cache()) {
+        response_object["response"]["path_cache"]["size"] = path_cache->get_size();
+        response_object["response"]["path_cache"]["hits"] = path_cache->get_hits();
+        response_object["response"]["path_cache"]["misses"] = path_cache->get_misses();
+        response_object["response"]["path_cache"]["hit_rate"] = path_cache->get_hit_rate();
+        response_object["response"]["path_cache"]["mean_hops_hit"] = path_cache->get_mean_hops(true);
+        response_object["response"]["path_cache"]["mean_hops_miss"] = path_cache->get_mean_hops(false);
+        response_object["response"]["path_cache"]["hops_saved"] = path_cache->get_hops_saved();
+    }
+    // Requests from other nodes that were turned away
+    if (AdmissionControl * admission_control = node.get_admission_control()) {
+        response_object["response"]["admission"]["in_flight"] = admission_control->get_in_flight();
+        response_object["response"]["admission"]["accepted"] = admission_control->get_accepted_count();
+        response_object["response"]["admission"]["rate_limited"] = admission_control->get_rate_limited_count();
+        response_object["response"]["admission"]["busy"] = admission_control->get_busy_count();
+    }
+    // Handler latencies of the requests served to other nodes
+    nlohmann::json methods = nlohmann::json::array();
+    for (const auto& stats : get_dispatcher(false).get_stats()) {
+        if (stats.count == 0) continue;
+        methods.push_back({ {"method", stats.method}, {"count", stats.count}, {"mean_us", stats.mean_us}, {"p50_us", stats.p50_us}, {"p99_us", stats.p99_us}, {"max_us", stats.max_us} });
     }
+    response_object["response"]["methods"] = methods;
+}
+
+//-----------------------------------------------------------------------------
+
+// Asks for events to be pushed to the requesting IPC client (IPC mode). See EventPublisher for the topics
+static void on_ipc_subscribe(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    EventPublisher * event_publisher = node.get_event_publisher();
+    if (event_publisher == nullptr || request.client_id == 0) {
+        set_error(response_object, KadResultCode::InvalidOperation, "Events are not available");
+        return;
+    }
+    if (!event_publisher->subscribe(request.client_id, request.args)) {
+        set_error(response_object, KadResultCode::InvalidRequest, "No known topic");
+        return;
+    }
+    // The client starts out with the current counts so that it never has to ask for them
+    for (const auto& topic : request.args["topics"]) {
+        if (topic == EventPublisher::get_topic_name(EventPublisher::Topic::NetworkStatus)) {
+            event_publisher->send_network_status(request.client_id, node.get_peer_count(), node.get_active_peer_count(), node.get_idle_peer_count());
+            break;
+        }
+    }
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["code"] = static_cast<int>(KadResultCode::Success);
+}
+
+static void on_ipc_unsubscribe(const Request& request, nlohmann::json& response_object) {
+    Node& node = request.node;
+    EventPublisher * event_publisher = node.get_event_publisher();
+    if (event_publisher != nullptr) event_publisher->unsubscribe(request.client_id, request.args);
+    response_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    response_object["response"]["id"] = node.get_id();
+    response_object["response"]["code"] = static_cast<int>(KadResultCode::Success);
+}
+
+//-----------------------------------------------------------------------------
+
+Dispatcher& get_dispatcher(bool ipc_mode) {
+    static Dispatcher dht_dispatcher; // Handlers for queries from other nodes
+    static Dispatcher ipc_dispatcher; // Handlers for requests from the local GUI client
+    static std::once_flag handlers_added;
+    std::call_once(handlers_added, [] {
+        dht_dispatcher.add("ping", {}, on_ping);
+        dht_dispatcher.add("find_node", { {"target", ArgType::String} }, on_find_node);
+        dht_dispatcher.add("get_peers", { {"info_hash", ArgType::String} }, on_get_peers);
+        dht_dispatcher.add("announce_peer", { {"info_hash", ArgType::String}, {"token", ArgType::String}, {"port", ArgType::Integer} }, on_announce_peer);
+        dht_dispatcher.add("get", { {"key", ArgType::String}, {"accept", ArgType::Array, false} }, on_get);
+        dht_dispatcher.add("put", { {"key", ArgType::String}, {"value", ArgType::StringOrBinary}, {"encoding", ArgType::String, false}, {"clock", ArgType::Integer, false}, {"publisher", ArgType::String, false} }, on_put);
+        dht_dispatcher.add("map", { {"data", ArgType::Array, false} }, on_map);
+        dht_dispatcher.add("get_many", { {"keys", ArgType::Array}, {"accept", ArgType::Array, false} }, on_get_many);
+        dht_dispatcher.add("put_many", { {"data", ArgType::Array} }, on_put_many);
+        dht_dispatcher.add("cache", { {"key", ArgType::String}, {"value", ArgType::StringOrBinary}, {"encoding", ArgType::String, false} }, on_cache);
+
+        ipc_dispatcher.add("ping", {}, on_ping);
+        ipc_dispatcher.add("get", { {"key", ArgType::String} }, on_ipc_get);
+        ipc_dispatcher.add("put", { {"key", ArgType::String}, {"value", ArgType::String} }, on_ipc_put);
+        ipc_dispatcher.add("set", { {"key", ArgType::String}, {"value", ArgType::String}, {"verified", ArgType::Boolean} }, on_ipc_set);
+        ipc_dispatcher.add("get_many", { {"keys", ArgType::Array} }, on_ipc_get_many);
+        ipc_dispatcher.add("put_many", { {"data", ArgType::Array} }, on_ipc_put_many);
+        ipc_dispatcher.add("subscribe", { {"topics", ArgType::Array}, {"keys", ArgType::Array, false}, {"recipient_id", ArgType::String, false} }, on_ipc_subscribe);
+        ipc_dispatcher.add("unsubscribe", { {"topics", ArgType::Array, false}, {"keys", ArgType::Array, false} }, on_ipc_unsubscribe);
+    });
+    return (ipc_mode) ? ipc_dispatcher : dht_dispatcher;
+}
+
+}
+
+}
+
+//-----------------------------------------------------------------------------
+
+std::vector<uint8_t> neroshop::msgpack::process(const std::vector<uint8_t>& request, Node& node, bool ipc_mode, const std::string& requester_address, uint64_t client_id) {
+    Message message;
+    decode(request, message, !ipc_mode); // Pings from the GUI client are answered by the json handler
+    return process(message, node, ipc_mode, requester_address, client_id);
+}
+
+//-----------------------------------------------------------------------------
+
+std::vector<uint8_t> neroshop::msgpack::process(const Message& message, Node& node, bool ipc_mode, const std::string& requester_address, uint64_t client_id) {
+    nlohmann::json response_object;
+    std::vector<uint8_t> response; // bytes
+
+    Dispatcher& dispatcher = get_dispatcher(ipc_mode);
+
+    // Pings make up most of the traffic so they are answered straight from the receive buffer without building a json tree
+    if(message.is_ping() && !ipc_mode && !message.ping.id.empty()) {
+        auto start_time = std::chrono::steady_clock::now();
+        NEROSHOP_LOG(log_level::trace, "\033[33mping from " << message.ping.id << "\033[0m\n");
+        std::string version = NEROSHOP_DHT_VERSION;
+        std::string id = node.get_id();
+        std::vector<uint8_t> bloom = node.get_key_filter(); // Publish a summary of our keys so that the pinging node can skip us when we certainly do not have a key
+        std::string encoding = compression::get_encoding();
+        Envelope pong_envelope;
+        pong_envelope.version = version;
+        pong_envelope.tid = message.envelope.tid;
+        pong_envelope.is_tid_binary = message.envelope.is_tid_binary;
+        PingResponse pong;
+        pong.id = id;
+        pong.bloom = std::string_view(reinterpret_cast<const char *>(bloom.data()), bloom.size());
+        if(!encoding.empty()) pong.encodings.push_back(encoding); // Value encodings that we accept
+        pong.protocol = NEROSHOP_DHT_PROTOCOL_VERSION;
+        pong.capabilities = get_capabilities(); // Features that the pinging node may use with us
+        response = encode(pong_envelope, pong);
+        static const Dispatcher::MethodId ping_method_id = dispatcher.find("ping");
+        dispatcher.record(ping_method_id, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time));
+        return response;
+    }
+
+    // Process (parse) the request
+    if(!message.is_valid()) {
+        neroshop::print("Error parsing client request", 1);
+        response_object["version"] = std::string(NEROSHOP_DHT_VERSION);//"0.1.0"; // neroshop version
+        response_object["error"]["code"] = static_cast<int>(KadResultCode::ParseError); // "code" MUST be an integer
+        response_object["error"]["message"] = "Parse error";
+        response_object["error"]["data"] = message.parse_error; // A Primitive (non-object) or Structured (array) value which may be omitted
+        response_object["tid"] = message.object.value("tid", nlohmann::json(nullptr)); // So that the error reaches the request that caused it
+        response = nlohmann::json::to_msgpack(response_object);
+        NEROSHOP_LOG(log_level::debug, "Response output:\n\033[91m" << response_object.dump(4) << "\033[0m\n");
+        return response;//return response_object.dump(4);
+    }
+    const nlohmann::json& request_object = message.object;
+    NEROSHOP_LOG(log_level::debug, "\033[33m" << request_object.dump() << "\033[0m\n");
+    //-----------------------------------------------------
+    // "args" must contain the querying node's ID
+    if(!request_object.is_object() || !request_object.contains("query") || !request_object["query"].is_string()
+        || !request_object.contains("args") || !request_object["args"].is_object()
+        || (!ipc_mode && !(request_object["args"].contains("id") && request_object["args"]["id"].is_string()))) {
+        set_error(response_object, KadResultCode::InvalidRequest, "Invalid request");
+        response_object["tid"] = request_object.is_object() ? request_object.value("tid", nlohmann::json(nullptr)) : nullptr;
+        return nlohmann::json::to_msgpack(response_object);
+    }
+    const std::string& method = request_object["query"].get_ref<const std::string&>();
+    const nlohmann::json& params_object = request_object["args"];
+    std::string requester_node_id = (ipc_mode) ? node.get_id() : params_object["id"].get<std::string>();
+
+    if(!request_object.contains("tid") && !ipc_mode) {
+        NEROSHOP_LOG(log_level::debug, "No tid found, hence a notification that will not receive a response from the server\n");
+        return {};
+    }
+    auto tid = request_object.value("tid", nlohmann::json(nullptr)); // The IPC client pipelines its requests and matches the responses by tid
+    //-----------------------------------------------------
+    dispatcher.dispatch(method, { node, params_object, requester_node_id, requester_address, client_id }, response_object);
     //-----------------------------------------------------
     response_object["tid"] = tid; // transaction id - MUST be the same as the request object's id
     response = nlohmann::json::to_msgpack(response_object);
@@ -354,6 +751,15 @@ std::vector<uint8_t> neroshop::msgpack::process(const std::vector<uint8_t>& requ
 
 //-----------------------------------------------------------------------------
 
+uint32_t neroshop::msgpack::get_capabilities() {
+    uint32_t capabilities = static_cast<uint32_t>(Capability::Batch) | static_cast<uint32_t>(Capability::IterativeGet)
+        | static_cast<uint32_t>(Capability::BinaryTid) | static_cast<uint32_t>(Capability::KeyFilter) | static_cast<uint32_t>(Capability::CacheStore);
+    if(compression::is_enabled()) capabilities |= static_cast<uint32_t>(Capability::Zstd);
+    return capabilities;
+}
+
+//-----------------------------------------------------------------------------
+
 std::string neroshop::msgpack::generate_secret(int length) {
     std::string secret(length, ' ');
     RAND_bytes((unsigned char*)&secret[0], length);
@@ -362,45 +768,48 @@ std::string neroshop::msgpack::generate_secret(int length) {
 
 //-----------------------------------------------------------------------------
 
-std::string neroshop::msgpack::generate_token(const std::string& node_id, const std::string& info_hash, const std::string& secret) {
-    std::string token;
-    uint8_t token_data[EVP_MAX_MD_SIZE];
-    unsigned int token_length = 0;
-
-    const EVP_MD* md = EVP_get_digestbyname("sha3-256");
-    EVP_MD_CTX* md_ctx = EVP_MD_CTX_new();
-
-    EVP_DigestInit_ex(md_ctx, md, nullptr);
-    EVP_DigestUpdate(md_ctx, node_id.data(), node_id.size());
-    EVP_DigestUpdate(md_ctx, info_hash.data(), info_hash.size());
-    EVP_DigestUpdate(md_ctx, secret.data(), secret.size());
-    EVP_DigestFinal_ex(md_ctx, token_data, &token_length);
+std::string neroshop::msgpack::generate_token(const std::string& address, const std::string& secret) {
+    // As in BEP 5, the token is a keyed hash of the requester's address. HMAC-SHA256 is truncated to TOKEN_SIZE bytes
+    // which is plenty for a value that is only valid for a few minutes
+    uint8_t digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    HMAC(EVP_sha256(), secret.data(), static_cast<int>(secret.size()),
+        reinterpret_cast<const unsigned char *>(address.data()), address.size(), digest, &digest_length);
 
-    EVP_MD_CTX_free(md_ctx);
-
-    token = std::string(reinterpret_cast<char*>(token_data), token_length);
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string token(TOKEN_SIZE * 2, '0');
+    for(std::size_t i = 0; i < TOKEN_SIZE; i++) {
+        token[i * 2] = hex_digits[digest[i] >> 4];
+        token[i * 2 + 1] = hex_digits[digest[i] & 0x0f];
+    }
     return token;
 }
 
+bool neroshop::msgpack::is_token_equal(const std::string& token, const std::string& expected_token) {
+    return token.size() == expected_token.size() && CRYPTO_memcmp(token.data(), expected_token.data(), token.size()) == 0;
+}
 
 //-----------------------------------------------------------------------------
+
 std::string neroshop::msgpack::generate_transaction_id() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<std::uint32_t> dis(0, std::numeric_limits<std::uint32_t>::max());
-    std::uint32_t tid = dis(gen);
-    std::array<std::uint8_t, 4> tid_bytes;
-    tid_bytes[0] = static_cast<std::uint8_t>((tid >> 24) & 0xFF);
-    tid_bytes[1] = static_cast<std::uint8_t>((tid >> 16) & 0xFF);
-    tid_bytes[2] = static_cast<std::uint8_t>((tid >> 8) & 0xFF);
-    tid_bytes[3] = static_cast<std::uint8_t>(tid & 0xFF);
-    ////return std::string(reinterpret_cast<const char*>(tid_bytes.data()), 4);
-    std::stringstream ss;
-    for (const auto& b : tid_bytes) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(b);
-    }
-    return ss.str().substr(0, 4); // take the first 4 characters only
+    // xorshift64* seeded once per thread, so generating a tid does not touch the OS entropy source or allocate beyond the result
+    thread_local uint64_t state = [] {
+        uint64_t seed = 0;
+        while(seed == 0) RAND_bytes(reinterpret_cast<unsigned char *>(&seed), sizeof(seed)); // The state must never be zero
+        return seed;
+    }();
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    uint64_t random = state * 0x2545F4914F6CDD1DULL;
+    
+    char tid[TRANSACTION_ID_SIZE];
+    for(std::size_t i = 0; i < TRANSACTION_ID_SIZE; i++) {
+        tid[i] = static_cast<char>((random >> (56 - i * 8)) & 0xFF); // The high bits are the most random ones
+    }
+    return std::string(tid, TRANSACTION_ID_SIZE);
 }
+
 //-----------------------------------------------------------------------------
 
 bool neroshop::msgpack::send_data(int sockfd, const std::vector<uint8_t>& packed) {
@@ -442,7 +851,7 @@ std::string neroshop::msgpack::receive_data(int sockfd) {
     try {
         nlohmann::json j = nlohmann::json::from_msgpack(buffer.data(), total_recv_bytes);
         json_str = j.dump();
-        std::cout << "Request received: " << json_str << std::endl;
+        NEROSHOP_LOG(log_level::debug, "Request received: " << json_str << "\n");
     } catch (const nlohmann::json::parse_error& e) {
         std::cerr << "Error parsing message: " << e.what() << std::endl;
     }
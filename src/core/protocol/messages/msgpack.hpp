@@ -10,10 +10,21 @@ namespace neroshop {
 class Node; // forward declaration
 
 namespace msgpack {
-    std::vector<uint8_t> process(const std::vector<uint8_t>& request, Node& node, bool ipc_mode = false); // ipc_mode is for when the IPC client (A.K.A local GUI client) makes send_put and send_get requests in real-time
+    class Dispatcher;
+    struct Message;
 
-    std::string generate_transaction_id();
-    std::string generate_token(const std::string& node_id, const std::string& info_hash, const std::string& secret);
+    std::vector<uint8_t> process(const std::vector<uint8_t>& request, Node& node, bool ipc_mode = false, const std::string& requester_address = "", uint64_t client_id = 0); // ipc_mode is for when the IPC client (A.K.A local GUI client) makes send_put and send_get requests in real-time
+    std::vector<uint8_t> process(const Message& message, Node& node, bool ipc_mode = false, const std::string& requester_address = "", uint64_t client_id = 0); // For a message that has already been decoded
+
+    Dispatcher& get_dispatcher(bool ipc_mode = false); // Handlers can be added to these to support new methods
+    uint32_t get_capabilities(); // Bitmask of the Capability flags that this node advertises
+    
+    constexpr std::size_t TRANSACTION_ID_SIZE = 4; // Bytes. Sent as msgpack binary
+    constexpr std::size_t TOKEN_SIZE = 8; // Bytes. Sent hex-encoded
+    
+    std::string generate_transaction_id(); // Fixed-width random bytes from a thread-local PRNG
+    std::string generate_token(const std::string& address, const std::string& secret); // Token handed out by get_peers and checked by announce_peer
+    bool is_token_equal(const std::string& token, const std::string& expected_token); // Constant-time comparison
     std::string generate_secret(int length);
 
     bool send_data(int sockfd, const std::vector<uint8_t>& packed);
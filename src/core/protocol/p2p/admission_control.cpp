@@ -0,0 +1,107 @@
+#include "admission_control.hpp"
+
+#include <algorithm> // std::min
+
+neroshop::AdmissionControl::AdmissionControl(std::size_t max_concurrent_requests, double rate_limit, double rate_burst) 
+    : max_concurrent_requests(max_concurrent_requests), rate_limit(rate_limit), rate_burst(rate_burst), 
+      in_flight(0), accepted_count(0), rate_limited_count(0), busy_count(0) {}
+
+//-----------------------------------------------------------------------------
+
+neroshop::AdmissionControl::Slot& neroshop::AdmissionControl::Slot::operator=(Slot&& other) noexcept {
+    if(this != &other) {
+        if(admission_control != nullptr) admission_control->release();
+        admission_control = other.admission_control;
+        other.admission_control = nullptr;
+    }
+    return *this;
+}
+
+neroshop::AdmissionControl::Slot::~Slot() {
+    if(admission_control != nullptr) admission_control->release();
+}
+
+//-----------------------------------------------------------------------------
+
+neroshop::Admission neroshop::AdmissionControl::admit(const std::string& address, RequestPriority priority, Slot& slot) {
+    // Requests that do more work drain the sender's bucket faster
+    double cost = (priority == RequestPriority::High) ? 1.0 : (priority == RequestPriority::Normal) ? 2.0 : 4.0;
+    if(!consume(address, cost)) {
+        rate_limited_count.fetch_add(1, std::memory_order_relaxed);
+        return Admission::RateLimited;
+    }
+    
+    // Lower priorities may only use part of the capacity so that the rest stays available for high priority requests
+    std::size_t limit = (priority == RequestPriority::High) ? max_concurrent_requests 
+        : (priority == RequestPriority::Normal) ? (max_concurrent_requests * 3) / 4 
+        : max_concurrent_requests / 2;
+    std::size_t current = in_flight.load(std::memory_order_relaxed);
+    do {
+        if(current >= limit) {
+            busy_count.fetch_add(1, std::memory_order_relaxed);
+            return Admission::Busy;
+        }
+    } while(!in_flight.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel));
+    
+    accepted_count.fetch_add(1, std::memory_order_relaxed);
+    slot = Slot(this);
+    return Admission::Accepted;
+}
+
+void neroshop::AdmissionControl::release() {
+    in_flight.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::AdmissionControl::consume(const std::string& address, double cost) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(bucket_mutex);
+    auto it = buckets.find(address);
+    if(it == buckets.end()) {
+        // The sender that was seen least recently is evicted in constant time, since a flood of spoofed addresses reaches this for every datagram.
+        // Its bucket is the one most likely to have refilled, which makes it the same as a new one
+        if(buckets.size() >= NEROSHOP_DHT_RATE_LIMIT_MAX_PEERS) {
+            buckets.erase(lru.back());
+            lru.pop_back();
+        }
+        lru.push_front(address);
+        it = buckets.emplace(address, Bucket{ rate_burst, now, lru.begin() }).first;
+    } else {
+        lru.splice(lru.begin(), lru, it->second.lru_position); // Move to front
+    }
+    
+    Bucket& bucket = it->second;
+    double elapsed = std::chrono::duration<double>(now - bucket.last_refill).count();
+    bucket.tokens = std::min(rate_burst, bucket.tokens + elapsed * rate_limit);
+    bucket.last_refill = now;
+    if(bucket.tokens < cost) return false;
+    bucket.tokens -= cost;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+neroshop::RequestPriority neroshop::AdmissionControl::get_priority(std::string_view method) {
+    if(method == "ping" || method == "find_node" || method == "get_peers") return RequestPriority::High;
+    if(method == "put" || method == "put_many" || method == "map") return RequestPriority::Low;
+    return RequestPriority::Normal; // get, get_many, announce_peer and anything unknown
+}
+
+//-----------------------------------------------------------------------------
+
+std::size_t neroshop::AdmissionControl::get_in_flight() const {
+    return in_flight.load(std::memory_order_relaxed);
+}
+
+uint64_t neroshop::AdmissionControl::get_accepted_count() const {
+    return accepted_count.load(std::memory_order_relaxed);
+}
+
+uint64_t neroshop::AdmissionControl::get_rate_limited_count() const {
+    return rate_limited_count.load(std::memory_order_relaxed);
+}
+
+uint64_t neroshop::AdmissionControl::get_busy_count() const {
+    return busy_count.load(std::memory_order_relaxed);
+}
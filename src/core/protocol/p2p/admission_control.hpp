@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+// Cheap requests keep the routing table healthy so they are admitted ahead of requests that do more work
+enum class RequestPriority { High, Normal, Low };
+
+enum class Admission {
+    Accepted,
+    RateLimited, // The sender exceeded its request rate. The request is dropped without a response
+    Busy, // Too many requests are being handled. The sender is told to try another node
+};
+
+// Decides whether an inbound request is handled before any work is done on it. Each sender IP address
+// gets a token bucket and the number of requests being handled at once is capped, with a share of the
+// capacity reserved for high priority requests so that pings are still answered when the node is saturated
+class AdmissionControl {
+public:
+    // Releases the concurrency slot of an accepted request when it goes out of scope
+    class Slot {
+    public:
+        Slot() = default;
+        explicit Slot(AdmissionControl * admission_control) : admission_control(admission_control) {}
+        Slot(Slot&& other) noexcept : admission_control(other.admission_control) { other.admission_control = nullptr; }
+        Slot& operator=(Slot&& other) noexcept;
+        Slot(const Slot&) = delete;
+        Slot& operator=(const Slot&) = delete;
+        ~Slot();
+    private:
+        AdmissionControl * admission_control = nullptr;
+    };
+    
+    AdmissionControl(std::size_t max_concurrent_requests = NEROSHOP_DHT_MAX_CONCURRENT_REQUESTS,
+        double rate_limit = NEROSHOP_DHT_RATE_LIMIT, double rate_burst = NEROSHOP_DHT_RATE_BURST);
+    
+    Admission admit(const std::string& address, RequestPriority priority, Slot& slot); // slot holds a concurrency slot if the request is accepted
+    
+    static RequestPriority get_priority(std::string_view method);
+    
+    std::size_t get_in_flight() const;
+    uint64_t get_accepted_count() const;
+    uint64_t get_rate_limited_count() const;
+    uint64_t get_busy_count() const;
+private:
+    struct Bucket {
+        double tokens;
+        std::chrono::steady_clock::time_point last_refill;
+        std::list<std::string>::iterator lru_position;
+    };
+    std::unordered_map<std::string, Bucket> buckets; // Maps sender IP addresses to their token bucket
+    std::list<std::string> lru; // Most recently seen sender IP addresses at the front
+    std::size_t max_concurrent_requests;
+    double rate_limit; // Tokens added to each bucket per second
+    double rate_burst; // Maximum number of tokens in a bucket
+    std::atomic<std::size_t> in_flight;
+    std::atomic<uint64_t> accepted_count;
+    std::atomic<uint64_t> rate_limited_count;
+    std::atomic<uint64_t> busy_count;
+    std::mutex bucket_mutex; // Protects buckets and lru
+    bool consume(const std::string& address, double cost);
+    void release();
+};
+
+}
@@ -0,0 +1,76 @@
+#include "bloom_filter.hpp"
+
+#include <algorithm> // std::all_of
+
+neroshop::BloomFilter::BloomFilter(std::size_t bit_count, int hash_count) 
+    : bits((bit_count + 7) / 8, 0), hash_count(hash_count) 
+{}
+
+neroshop::BloomFilter::BloomFilter(const std::vector<uint8_t>& bytes, int hash_count) 
+    : bits(bytes), hash_count(hash_count) 
+{}
+
+//-----------------------------------------------------------------------------
+
+uint64_t neroshop::BloomFilter::hash(const std::string& key, uint64_t seed) {
+    uint64_t hash = 14695981039346656037ULL ^ seed; // FNV offset basis
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL; // FNV prime
+    }
+    return hash;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::BloomFilter::add(const std::string& key) {
+    if(bits.empty()) return;
+    const uint64_t bit_count = get_bit_count();
+    // Double hashing: the i-th bit index is h1 + i * h2 (Kirsch-Mitzenmacher)
+    uint64_t h1 = hash(key, 0);
+    uint64_t h2 = hash(key, h1) | 1;
+    for (int i = 0; i < hash_count; ++i) {
+        uint64_t index = (h1 + i * h2) % bit_count;
+        bits[index / 8] |= (1 << (index % 8));
+    }
+}
+
+void neroshop::BloomFilter::clear() {
+    std::fill(bits.begin(), bits.end(), 0);
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::BloomFilter::possibly_contains(const std::string& key) const {
+    if(bits.empty()) return true; // No summary, so we cannot rule anything out
+    const uint64_t bit_count = get_bit_count();
+    uint64_t h1 = hash(key, 0);
+    uint64_t h2 = hash(key, h1) | 1;
+    for (int i = 0; i < hash_count; ++i) {
+        uint64_t index = (h1 + i * h2) % bit_count;
+        if((bits[index / 8] & (1 << (index % 8))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+const std::vector<uint8_t>& neroshop::BloomFilter::get_bytes() const {
+    return bits;
+}
+
+std::size_t neroshop::BloomFilter::get_bit_count() const {
+    return bits.size() * 8;
+}
+
+int neroshop::BloomFilter::get_hash_count() const {
+    return hash_count;
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::BloomFilter::is_empty() const {
+    return std::all_of(bits.begin(), bits.end(), [](uint8_t byte) { return byte == 0; });
+}
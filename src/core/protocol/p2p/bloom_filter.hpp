@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+// Compact summary of the keys held by a node. A Bloom filter can yield false positives but never false negatives,
+// so a lookup can safely skip any contact whose filter reports that it does not have the key
+class BloomFilter {
+private:
+    std::vector<uint8_t> bits;
+    int hash_count;
+    static uint64_t hash(const std::string& key, uint64_t seed); // FNV-1a (must produce the same result on every node)
+public:
+    BloomFilter(std::size_t bit_count = NEROSHOP_DHT_BLOOM_FILTER_BITS, int hash_count = NEROSHOP_DHT_BLOOM_FILTER_HASHES);
+    BloomFilter(const std::vector<uint8_t>& bytes, int hash_count = NEROSHOP_DHT_BLOOM_FILTER_HASHES); // Rebuilds a filter that was published by another node
+    
+    void add(const std::string& key);
+    void clear();
+    
+    bool possibly_contains(const std::string& key) const; // Returns false only if the key was definitely never added
+    
+    const std::vector<uint8_t>& get_bytes() const;
+    std::size_t get_bit_count() const;
+    int get_hash_count() const;
+    
+    bool is_empty() const;
+};
+
+}
@@ -0,0 +1,193 @@
+#include "event_publisher.hpp"
+
+#include "../../version.hpp"
+
+neroshop::EventPublisher::EventPublisher() : subscribed_topics(0), network_status{ -1, -1, -1 } {}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::EventPublisher::set_sender(Sender sender) {
+    std::lock_guard<std::mutex> lock(publisher_mutex);
+    this->sender = std::move(sender);
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::EventPublisher::subscribe(uint64_t client_id, const nlohmann::json& args) {
+    uint32_t topics = 0;
+    if(args.contains("topics") && args["topics"].is_array()) {
+        for(const auto& name : args["topics"]) {
+            if(name.is_string()) topics |= get_topic(name.get<std::string>());
+        }
+    }
+    if(topics == 0) return false;
+
+    std::lock_guard<std::mutex> lock(publisher_mutex);
+    Subscription& subscription = subscriptions[client_id];
+    subscription.topics |= topics;
+    if(args.contains("keys") && args["keys"].is_array()) {
+        for(const auto& key : args["keys"]) {
+            if(subscription.keys.size() >= NEROSHOP_IPC_MAX_SUBSCRIBED_KEYS) break;
+            if(key.is_string()) subscription.keys.insert(key.get<std::string>());
+        }
+    }
+    if(args.contains("recipient_id") && args["recipient_id"].is_string()) {
+        subscription.recipient_id = args["recipient_id"].get<std::string>();
+    }
+    update_subscribed_topics();
+    return true;
+}
+
+void neroshop::EventPublisher::unsubscribe(uint64_t client_id, const nlohmann::json& args) {
+    std::lock_guard<std::mutex> lock(publisher_mutex);
+    auto it = subscriptions.find(client_id);
+    if(it == subscriptions.end()) return;
+    Subscription& subscription = it->second;
+    if(!args.contains("topics") || !args["topics"].is_array()) {
+        subscriptions.erase(it);
+        update_subscribed_topics();
+        return;
+    }
+    if(args.contains("keys") && args["keys"].is_array()) { // Only these keys, the "stored" topic stays
+        for(const auto& key : args["keys"]) {
+            if(key.is_string()) subscription.keys.erase(key.get<std::string>());
+        }
+    } else {
+        for(const auto& name : args["topics"]) {
+            if(name.is_string()) subscription.topics &= ~get_topic(name.get<std::string>());
+        }
+    }
+    if(!(subscription.topics & static_cast<uint32_t>(Topic::Stored))) subscription.keys.clear();
+    if(subscription.topics == 0) subscriptions.erase(it);
+    update_subscribed_topics();
+}
+
+void neroshop::EventPublisher::remove_client(uint64_t client_id) {
+    std::lock_guard<std::mutex> lock(publisher_mutex);
+    if(subscriptions.erase(client_id) > 0) update_subscribed_topics();
+}
+
+void neroshop::EventPublisher::update_subscribed_topics() {
+    uint32_t topics = 0;
+    for(const auto& pair : subscriptions) topics |= pair.second.topics;
+    subscribed_topics = topics;
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::EventPublisher::has_subscribers(Topic topic) const {
+    return (subscribed_topics & static_cast<uint32_t>(topic)) != 0;
+}
+
+void neroshop::EventPublisher::publish_network_status(int connected_peers, int active_peers, int idle_peers) {
+    if(!has_subscribers(Topic::NetworkStatus)) return;
+    std::vector<uint64_t> client_ids;
+    Sender sender_copy;
+    {
+        std::lock_guard<std::mutex> lock(publisher_mutex);
+        if(network_status[0] == connected_peers && network_status[1] == active_peers && network_status[2] == idle_peers) return;
+        network_status[0] = connected_peers;
+        network_status[1] = active_peers;
+        network_status[2] = idle_peers;
+        for(const auto& pair : subscriptions) {
+            if(pair.second.topics & static_cast<uint32_t>(Topic::NetworkStatus)) client_ids.push_back(pair.first);
+        }
+        sender_copy = sender;
+    }
+    if(!sender_copy || client_ids.empty()) return;
+    std::vector<uint8_t> message = encode(Topic::NetworkStatus, { {"connected_peers", connected_peers}, {"active_peers", active_peers}, {"idle_peers", idle_peers} });
+    for(uint64_t client_id : client_ids) sender_copy(client_id, message);
+}
+
+void neroshop::EventPublisher::send_network_status(uint64_t client_id, int connected_peers, int active_peers, int idle_peers) {
+    Sender sender_copy;
+    {
+        std::lock_guard<std::mutex> lock(publisher_mutex);
+        // Later changes are published relative to what the new subscriber has seen
+        network_status[0] = connected_peers;
+        network_status[1] = active_peers;
+        network_status[2] = idle_peers;
+        sender_copy = sender;
+    }
+    if(!sender_copy) return;
+    sender_copy(client_id, encode(Topic::NetworkStatus, { {"connected_peers", connected_peers}, {"active_peers", active_peers}, {"idle_peers", idle_peers} }));
+}
+
+void neroshop::EventPublisher::on_stored(const std::string& key, const std::string& value) {
+    uint32_t topics = subscribed_topics;
+    if((topics & (static_cast<uint32_t>(Topic::Stored) | static_cast<uint32_t>(Topic::Listing) | static_cast<uint32_t>(Topic::Message))) == 0) return;
+    // The value is only parsed when a client wants events by the kind of data
+    std::string metadata, recipient_id;
+    if(topics & (static_cast<uint32_t>(Topic::Listing) | static_cast<uint32_t>(Topic::Message))) {
+        nlohmann::json json = nlohmann::json::parse(value, nullptr, false);
+        if(json.is_object()) {
+            if(json.contains("metadata") && json["metadata"].is_string()) metadata = json["metadata"].get<std::string>();
+            if(json.contains("recipient_id") && json["recipient_id"].is_string()) recipient_id = json["recipient_id"].get<std::string>();
+        }
+    }
+
+    std::vector<std::pair<uint64_t, Topic>> targets;
+    Sender sender_copy;
+    {
+        std::lock_guard<std::mutex> lock(publisher_mutex);
+        for(const auto& pair : subscriptions) {
+            const Subscription& subscription = pair.second;
+            if((subscription.topics & static_cast<uint32_t>(Topic::Stored)) && subscription.keys.count(key)) {
+                targets.emplace_back(pair.first, Topic::Stored);
+            }
+            if((subscription.topics & static_cast<uint32_t>(Topic::Listing)) && metadata == "listing") {
+                targets.emplace_back(pair.first, Topic::Listing);
+            }
+            if((subscription.topics & static_cast<uint32_t>(Topic::Message)) && metadata == "message"
+                && (subscription.recipient_id.empty() || subscription.recipient_id == recipient_id)) {
+                targets.emplace_back(pair.first, Topic::Message);
+            }
+        }
+        sender_copy = sender;
+    }
+    if(!sender_copy || targets.empty()) return;
+
+    // Each kind of event is encoded once no matter how many clients receive it
+    std::unordered_map<uint32_t, std::vector<uint8_t>> messages;
+    for(const auto& target : targets) {
+        auto it = messages.find(static_cast<uint32_t>(target.second));
+        if(it == messages.end()) {
+            it = messages.emplace(static_cast<uint32_t>(target.second), encode(target.second, { {"key", key}, {"value", value} })).first;
+        }
+        sender_copy(target.first, it->second);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+std::vector<uint8_t> neroshop::EventPublisher::encode(Topic topic, const nlohmann::json& data) {
+    nlohmann::json event_object;
+    event_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    event_object["event"] = get_topic_name(topic);
+    event_object["data"] = data;
+    return nlohmann::json::to_msgpack(event_object);
+}
+
+//-----------------------------------------------------------------------------
+
+std::size_t neroshop::EventPublisher::get_client_count() const {
+    std::lock_guard<std::mutex> lock(publisher_mutex);
+    return subscriptions.size();
+}
+
+const char * neroshop::EventPublisher::get_topic_name(Topic topic) {
+    switch(topic) {
+        case Topic::NetworkStatus: return "network_status";
+        case Topic::Stored: return "stored";
+        case Topic::Listing: return "listing";
+        case Topic::Message: return "message";
+    }
+    return "";
+}
+
+uint32_t neroshop::EventPublisher::get_topic(const std::string& name) {
+    for(Topic topic : { Topic::NetworkStatus, Topic::Stored, Topic::Listing, Topic::Message }) {
+        if(name == get_topic_name(topic)) return static_cast<uint32_t>(topic);
+    }
+    return 0;
+}
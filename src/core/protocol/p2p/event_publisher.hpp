@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+// Pushes what happens on the local node to the IPC clients that subscribed to it, so that the GUI can react to changes instead of polling.
+// Events are msgpack objects without a tid: { "version", "event": <topic>, "data": { ... } }
+//   "network_status" - The peer counts changed. data: connected_peers, active_peers, idle_peers
+//   "stored"         - A key that the client subscribed to got a new value. data: key, value
+//   "listing"        - A listing was stored or updated. data: key, value
+//   "message"        - A message was stored (for the client's recipient_id if it subscribed with one). data: key, value
+class EventPublisher {
+public:
+    enum class Topic : uint32_t { NetworkStatus = 1, Stored = 2, Listing = 4, Message = 8 };
+    using Sender = std::function<void(uint64_t client_id, std::vector<uint8_t> message)>;
+
+    EventPublisher();
+
+    void set_sender(Sender sender); // Must not block, since events are published from the node's threads
+
+    // args: "topics" (array of topic names), "keys" (array, for "stored") and "recipient_id" (for "message"). Returns false if no topic is known
+    bool subscribe(uint64_t client_id, const nlohmann::json& args);
+    void unsubscribe(uint64_t client_id, const nlohmann::json& args); // Takes the same args. Without "topics", every subscription of the client is dropped
+    void remove_client(uint64_t client_id);
+
+    bool has_subscribers(Topic topic) const; // Lets the node skip work for events that nobody receives
+    void publish_network_status(int connected_peers, int active_peers, int idle_peers); // Only published if the counts changed
+    void send_network_status(uint64_t client_id, int connected_peers, int active_peers, int idle_peers); // The current counts, for a new subscriber
+    void on_stored(const std::string& key, const std::string& value);
+
+    std::size_t get_client_count() const; // Clients with at least one subscription
+
+    static const char * get_topic_name(Topic topic);
+    static uint32_t get_topic(const std::string& name); // Returns 0 for an unknown topic
+private:
+    struct Subscription {
+        uint32_t topics = 0;
+        std::unordered_set<std::string> keys;
+        std::string recipient_id;
+    };
+    std::unordered_map<uint64_t, Subscription> subscriptions;
+    std::atomic<uint32_t> subscribed_topics; // Union of the topics of every client
+    int network_status[3]; // Counts that were last published
+    Sender sender;
+    mutable std::mutex publisher_mutex;
+    void update_subscribed_topics(); // publisher_mutex must be held
+    static std::vector<uint8_t> encode(Topic topic, const nlohmann::json& data);
+};
+
+}
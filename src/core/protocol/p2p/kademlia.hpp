@@ -26,6 +26,7 @@ enum class KadResultCode {
     InvalidRequest,
     ParseError,
     DataVerificationFailed,
+    Busy, // The node is overloaded. Try another node
 };
 
 namespace kademlia {
@@ -66,6 +67,8 @@ static std::string get_result_code_as_string(KadResultCode result_code) {
             return "Invalid request";
         case KadResultCode::ParseError:
             return "Parse error";
+        case KadResultCode::Busy:
+            return "Busy";
         default:
             return "Unknown result code";
     }
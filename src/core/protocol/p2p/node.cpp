@@ -5,26 +5,61 @@
 #include "../../crypto/rsa.hpp"
 #include "routing_table.hpp"
 #include "../transport/ip_address.hpp"
+#if defined(NEROSHOP_USE_IO_URING)
+#include "../transport/io_uring_udp.hpp"
+#include "../transport/worker_pool.hpp"
+#endif
 #include "../messages/msgpack.hpp"
+#include "../messages/compression.hpp"
+#include "../messages/dht_messages.hpp"
 #include "../../version.hpp"
 #include "../../tools/base64.hpp"
 #include "mapper.hpp"
+#include "bloom_filter.hpp"
+#include "value_cache.hpp"
+#include "path_cache.hpp"
+#include "event_publisher.hpp"
 #include "../../tools/timestamp.hpp"
+#include "../../tools/logger.hpp"
 #include "../../database/database.hpp"
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm> // std::any_of
+#include <chrono>
 #include <cstring> // memset
 #include <future>
 #include <iomanip> // std::set*
+#include <map>
 #include <cassert>
+#include <limits> // std::numeric_limits
 #include <thread>
 #include <unordered_set>
 
 namespace neroshop_crypto = neroshop::crypto;
 namespace neroshop_timestamp = neroshop::timestamp;
 
-neroshop::Node::Node(const std::string& address, int port, bool local) : sockfd(-1), bootstrap(false), check_counter(0) { 
+// Transaction ids are raw bytes, so they are sent as msgpack binary rather than as a (UTF-8) string
+static nlohmann::json tid_to_json(const std::string& transaction_id) {
+    return nlohmann::json::binary(std::vector<uint8_t>(transaction_id.begin(), transaction_id.end()));
+}
+
+// Nodes that predate protocol versioning advertise no version and only their value encodings
+static int get_peer_protocol_version(int64_t protocol) {
+    return (protocol > 0) ? static_cast<int>(protocol) : 1;
+}
+
+// Compressed values are only sent to a node that has the dictionary that we compress with, whatever its capabilities say
+static uint32_t get_peer_capabilities(int64_t protocol, uint64_t capabilities, const std::vector<std::string_view>& encodings) {
+    uint32_t peer_capabilities = (protocol > 0) ? (static_cast<uint32_t>(capabilities) & ~static_cast<uint32_t>(neroshop::msgpack::Capability::Zstd)) : 0;
+    const std::string encoding = neroshop::compression::get_encoding();
+    if(!encoding.empty() && std::find(encodings.begin(), encodings.end(), encoding) != encodings.end()) {
+        peer_capabilities |= static_cast<uint32_t>(neroshop::msgpack::Capability::Zstd);
+    }
+    return peer_capabilities;
+}
+
+neroshop::Node::Node(const std::string& address, int port, bool local) : sockfd(-1), bootstrap(false), check_counter(0), key_filter_outdated(false), clock(0), protocol_version(0), capabilities(0), stopping(false) { 
     // Convert URL to IP (in case it happens to be a url)
     std::string ip_address = neroshop::ip::resolve(address);
     // Generate a random node ID - use public ip address for uniqueness
@@ -158,6 +193,15 @@ neroshop::Node::Node(const std::string& address, int port, bool local) : sockfd(
     if(!mapper.get()) {
         mapper = std::make_unique<Mapper>();
     }
+    
+    // Initialize the summary of our own keys (external nodes get theirs once they publish it)
+    if(local == true) {
+        key_filter = std::make_unique<BloomFilter>();
+        value_cache = std::make_unique<ValueCache>();
+        path_cache = std::make_unique<PathCache>();
+        admission_control = std::make_unique<AdmissionControl>();
+        event_publisher = std::make_unique<EventPublisher>();
+    }
 }
 
 neroshop::Node::Node(Node&& other) noexcept
@@ -173,7 +217,23 @@ neroshop::Node::Node(Node&& other) noexcept
       routing_table(std::move(other.routing_table)),
       public_ip_address(std::move(other.public_ip_address)),
       bootstrap(other.bootstrap),
-      check_counter(other.check_counter)
+      check_counter(other.check_counter),
+      key_filter(std::move(other.key_filter)),
+      key_filter_timestamp(other.key_filter_timestamp),
+      key_filter_outdated(other.key_filter_outdated),
+      negative_cache(std::move(other.negative_cache)),
+      value_cache(std::move(other.value_cache)),
+      path_cache(std::move(other.path_cache)),
+      admission_control(std::move(other.admission_control)),
+      event_publisher(std::move(other.event_publisher)),
+      versions(std::move(other.versions)),
+      clock(other.clock),
+      protocol_version(other.protocol_version.load()),
+      capabilities(other.capabilities.load()),
+      token_secret(std::move(other.token_secret)),
+      previous_token_secret(std::move(other.previous_token_secret)),
+      token_secret_timestamp(other.token_secret_timestamp),
+      stopping(false)
 {
     // Reset the moved-from object's members to a valid state
     other.sockfd = -1;
@@ -181,6 +241,15 @@ neroshop::Node::Node(Node&& other) noexcept
 }
 
 neroshop::Node::~Node() {
+    // Handoffs send through this node's socket and read its data, so they are stopped and waited for before either goes away
+    stopping = true;
+    std::vector<std::future<void>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(handoff_mutex);
+        tasks = std::move(handoff_tasks);
+    }
+    for(auto& task : tasks) task.wait();
+    
     if(sockfd > 0) {
         close(sockfd);
         sockfd = -1;
@@ -239,6 +308,7 @@ void neroshop::Node::join() {
         }
     }
     
+    publish_network_status();
     // Print the contents of the routing table
     routing_table->print_table();
 }
@@ -308,32 +378,93 @@ void neroshop::Node::remove_peer(const std::string& info_hash) {
     }
 }
 
-int neroshop::Node::put(const std::string& key, const std::string& value) {
+int neroshop::Node::put(const std::string& key, const std::string& value, const ValueVersion& version) {
+    // Versioned updates are ordered by their Lamport timestamp so stale and duplicate values can be rejected without parsing them
+    if(version.is_set()) {
+        std::lock_guard<std::mutex> lock(version_mutex);
+        if(version.counter > clock && version.counter - clock > NEROSHOP_DHT_MAX_CLOCK_DRIFT) {
+            NEROSHOP_LOG(log_level::debug, "Version of key (" << key << ") is too far ahead of the local clock\n");
+            return false;
+        }
+        if(is_up_to_date(key, version)) {
+            NEROSHOP_LOG(log_level::debug, "Value for key (" << key << ") is already up-to-date\n");
+            return true;
+        }
+    }
+    
     if(!validate(key, value)) {
         return false;
     }
     
+    if(version.is_set()) {
+        std::string stored_value = compression::compress(value); // Values are kept compressed at rest
+        bool is_new_key = false;
+        {
+            // Checked again under the lock that covers the write, as a put of a newer version may have been stored while value was validated
+            std::lock_guard<std::mutex> lock(version_mutex);
+            if(is_up_to_date(key, version)) {
+                NEROSHOP_LOG(log_level::debug, "Value for key (" << key << ") is already up-to-date\n");
+                return true;
+            }
+            is_new_key = !has_key(key);
+            versions[key] = version;
+            clock = std::max(clock, version.counter); // Only versions of values that validated move the clock
+            std::unique_lock<std::shared_mutex> data_lock(data_mutex);
+            data[key] = std::move(stored_value);
+        }
+        if(is_new_key) {
+            std::lock_guard<std::mutex> lock(key_filter_mutex);
+            if(key_filter.get()) key_filter->add(key);
+            negative_cache.erase(key);
+        }
+        if(value_cache.get()) value_cache->remove(key);
+        if(event_publisher.get()) event_publisher->on_stored(key, value);
+        return has_key(key); // boolean
+    }
+    
     // If data is a duplicate, skip it and return success (true)
     if (has_key(key) && get(key) == value) {
-        std::cout << "Data already exists. Skipping ...\n";
+        NEROSHOP_LOG(log_level::debug, "Data already exists. Skipping ...\n");
         return true;
     }
     
     // If node has the key but the value has been altered, verify data integrity and ownership then update the data
     if (has_key(key) && get(key) != value) {
-        std::cout << "Updating value for key (" << key << ")\n";
+        NEROSHOP_LOG(log_level::debug, "Updating value for key (" << key << ")\n");
         return set(key, value);
     }
 
-    data[key] = value;
+    {
+        std::lock_guard<std::mutex> lock(version_mutex);
+        versions.erase(key); // Unversioned, so a versioned update is not compared against a version that another value had
+        std::unique_lock<std::shared_mutex> data_lock(data_mutex);
+        data[key] = compression::compress(value); // Values are kept compressed at rest
+    }
+    {
+        std::lock_guard<std::mutex> lock(key_filter_mutex);
+        if(key_filter.get()) key_filter->add(key);
+        negative_cache.erase(key);
+    }
+    if(value_cache.get()) value_cache->remove(key); // We now hold the value ourselves
+    if(event_publisher.get()) event_publisher->on_stored(key, value);
     return has_key(key); // boolean
 }
 
-int neroshop::Node::store(const std::string& key, const std::string& value) {    
-    return put(key, value);
+int neroshop::Node::store(const std::string& key, const std::string& value, const ValueVersion& version) {    
+    return put(key, value, version);
 }
 
 std::string neroshop::Node::get(const std::string& key) const {    
+    std::shared_lock<std::shared_mutex> lock(data_mutex);
+    auto it = data.find(key);
+    if (it != data.end()) {
+        return compression::decompress(it->second);
+    }
+    return "";
+}
+
+std::string neroshop::Node::get_stored(const std::string& key) const {
+    std::shared_lock<std::shared_mutex> lock(data_mutex);
     auto it = data.find(key);
     if (it != data.end()) {
         return it->second;
@@ -341,13 +472,29 @@ std::string neroshop::Node::get(const std::string& key) const {
     return "";
 }
 
+bool neroshop::Node::is_up_to_date(const std::string& key, const ValueVersion& version) const {
+    auto it = versions.find(key);
+    return it != versions.end() && has_key(key) && !(it->second < version);
+}
+
 std::string neroshop::Node::find_value(const std::string& key) const {
     return get(key);
 }
 
 int neroshop::Node::remove(const std::string& key) {
-    data.erase(key);
-    return (data.count(key) == 0); // boolean
+    {
+        std::unique_lock<std::shared_mutex> lock(data_mutex);
+        data.erase(key);
+    }
+    {
+        std::lock_guard<std::mutex> lock(version_mutex);
+        versions.erase(key);
+    }
+    {
+        std::lock_guard<std::mutex> lock(key_filter_mutex);
+        key_filter_outdated = true; // Removed keys are only dropped from the summary when it is rebuilt
+    }
+    return !has_key(key); // boolean
 }
 
 void neroshop::Node::map(const std::string& key, const std::string& value) {
@@ -415,12 +562,129 @@ int neroshop::Node::set(const std::string& key, const std::string& value) {
         }
     }
     
-    data[key] = value;
+    {
+        // The old value's version no longer describes what is stored. Without it the next versioned update is accepted
+        std::lock_guard<std::mutex> lock(version_mutex);
+        versions.erase(key);
+        std::unique_lock<std::shared_mutex> data_lock(data_mutex);
+        data[key] = compression::compress(value);
+    }
+    if(event_publisher.get()) event_publisher->on_stored(key, value);
     return has_key(key); // boolean
 }
 
 //-------------------------------------------------------------------------------------
 
+std::vector<uint8_t> neroshop::Node::get_key_filter() {
+    std::lock_guard<std::mutex> lock(key_filter_mutex);
+    if(!key_filter.get()) return {};
+    
+    if(key_filter_outdated) {
+        key_filter->clear();
+        std::shared_lock<std::shared_mutex> data_lock(data_mutex);
+        for (const auto& pair : data) {
+            key_filter->add(pair.first);
+        }
+        key_filter_outdated = false;
+    }
+    return key_filter->get_bytes();
+}
+
+void neroshop::Node::set_key_filter(const std::vector<uint8_t>& bytes) {
+    if(bytes.empty()) return;
+    std::lock_guard<std::mutex> lock(key_filter_mutex);
+    key_filter = std::make_unique<BloomFilter>(bytes);
+    key_filter_timestamp = std::chrono::steady_clock::now();
+}
+
+void neroshop::Node::add_to_key_filter(const std::string& key) {
+    std::lock_guard<std::mutex> lock(key_filter_mutex);
+    if(key_filter.get()) key_filter->add(key);
+}
+
+bool neroshop::Node::may_have_key(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(key_filter_mutex);
+    if(!key_filter.get()) return true; // Node has not published a summary yet
+    // A stale summary may be missing keys that were stored since, so it cannot rule anything out
+    if((std::chrono::steady_clock::now() - key_filter_timestamp) > std::chrono::seconds(NEROSHOP_DHT_BLOOM_FILTER_TTL)) {
+        return true;
+    }
+    return key_filter->possibly_contains(key);
+}
+
+bool neroshop::Node::is_known_missing(const std::string& key) {
+    std::lock_guard<std::mutex> lock(key_filter_mutex);
+    auto it = negative_cache.find(key);
+    if(it == negative_cache.end()) return false;
+    
+    if(std::chrono::steady_clock::now() >= it->second) {
+        negative_cache.erase(it); // Expired
+        return false;
+    }
+    return true;
+}
+
+void neroshop::Node::set_known_missing(const std::string& key) {
+    std::lock_guard<std::mutex> lock(key_filter_mutex);
+    auto now = std::chrono::steady_clock::now();
+    if(negative_cache.size() >= NEROSHOP_DHT_NEGATIVE_CACHE_SIZE) {
+        // Purge expired entries first and if that is not enough, evict an arbitrary entry
+        for (auto it = negative_cache.begin(); it != negative_cache.end();) {
+            it = (now >= it->second) ? negative_cache.erase(it) : std::next(it);
+        }
+        if(negative_cache.size() >= NEROSHOP_DHT_NEGATIVE_CACHE_SIZE) {
+            negative_cache.erase(negative_cache.begin());
+        }
+    }
+    negative_cache[key] = now + std::chrono::seconds(NEROSHOP_DHT_NEGATIVE_CACHE_TTL);
+}
+
+void neroshop::Node::cache(const std::string& key, const std::string& value) {
+    if(!value_cache.get() || value.empty() || has_key(key)) return;
+    value_cache->put(key, value, ValueCache::get_ttl(this->id, key));
+}
+
+std::string neroshop::Node::get_cached(const std::string& key) {
+    if(!value_cache.get()) return "";
+    return value_cache->get(key);
+}
+
+//-------------------------------------------------------------------------------------
+
+void neroshop::Node::rotate_token_secret() {
+    auto now = std::chrono::steady_clock::now();
+    if(token_secret.empty()) {
+        token_secret = msgpack::generate_secret(16);
+        token_secret_timestamp = now;
+        return;
+    }
+    if(now - token_secret_timestamp < std::chrono::seconds(NEROSHOP_DHT_TOKEN_SECRET_LIFETIME)) return;
+    // A secret that expired more than one lifetime ago cannot have issued any token that is still valid
+    previous_token_secret = (now - token_secret_timestamp < std::chrono::seconds(2 * NEROSHOP_DHT_TOKEN_SECRET_LIFETIME)) ? token_secret : "";
+    token_secret = msgpack::generate_secret(16);
+    token_secret_timestamp = now;
+}
+
+std::string neroshop::Node::get_token(const std::string& address) {
+    std::lock_guard<std::mutex> lock(token_mutex);
+    rotate_token_secret();
+    return msgpack::generate_token(address, token_secret);
+}
+
+bool neroshop::Node::verify_token(const std::string& address, const std::string& token) {
+    std::string secret, previous_secret;
+    {
+        std::lock_guard<std::mutex> lock(token_mutex);
+        rotate_token_secret();
+        secret = token_secret;
+        previous_secret = previous_token_secret;
+    }
+    if(msgpack::is_token_equal(token, msgpack::generate_token(address, secret))) return true;
+    return !previous_secret.empty() && msgpack::is_token_equal(token, msgpack::generate_token(address, previous_secret));
+}
+
+//-------------------------------------------------------------------------------------
+
 void neroshop::Node::persist_routing_table(const std::string& address, int port) {
     if(!is_bootstrap_node()) return; // Regular nodes cannot run this function
     
@@ -560,39 +824,53 @@ std::vector<uint8_t> neroshop::Node::send_query(const std::string& address, uint
 bool neroshop::Node::send_ping(const std::string& address, int port) {
     // Create the ping message
     std::string transaction_id = msgpack::generate_transaction_id();
-    nlohmann::json query_object;
-    query_object["tid"] = transaction_id;
-    query_object["query"] = "ping";
-    query_object["args"]["id"] = this->id;
-    query_object["args"]["ephemeral_port"] = get_port(); // for testing on local network. This cannot be removed since the two primary sockets used in the protocol have different ports with the "ephemeral_port" being the actual port
-    query_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    std::string version = NEROSHOP_DHT_VERSION;
+    std::string encoding = compression::get_encoding();
+    msgpack::Envelope envelope;
+    envelope.tid = transaction_id;
+    envelope.is_tid_binary = true;
+    envelope.query = "ping";
+    envelope.version = version;
+    msgpack::PingRequest ping;
+    ping.id = this->id;
+    ping.ephemeral_port = get_port(); // for testing on local network. This cannot be removed since the two primary sockets used in the protocol have different ports with the "ephemeral_port" being the actual port
+    std::vector<uint8_t> bloom = get_key_filter();
+    ping.bloom = std::string_view(reinterpret_cast<const char *>(bloom.data()), bloom.size()); // Publish a summary of our keys to the pinged node
+    if(!encoding.empty()) ping.encodings.push_back(encoding); // Value encodings that we accept
+    ping.protocol = NEROSHOP_DHT_PROTOCOL_VERSION;
+    ping.capabilities = msgpack::get_capabilities();
     
-    auto ping_message = nlohmann::json::to_msgpack(query_object);
+    auto ping_message = msgpack::encode(envelope, ping);
     //--------------------------------------------
     auto receive_buffer = send_query(address, port, ping_message, NEROSHOP_DHT_PING_MESSAGE_TIMEOUT);
     //--------------------------------------------
-    // Parse the pong message and extract the transaction ID and response fields
-    nlohmann::json pong_message;
-    try {
-        pong_message = nlohmann::json::from_msgpack(receive_buffer);
-    } catch (const std::exception& e) {
+    // Decode the pong message straight from the receive buffer
+    msgpack::Envelope pong_envelope;
+    msgpack::PingResponse pong;
+    if (receive_buffer.empty()) {
         std::cerr << "Node \033[91m" << address << ":" << port << "\033[0m did not respond" << std::endl;
         return false;
     }
-    if (!pong_message.contains("response") || pong_message.contains("error")) {
+    if (!msgpack::decode(receive_buffer, pong_envelope, pong) || pong_envelope.is_error || pong.id.empty()) {
         std::cerr << "Received invalid pong message" << std::endl;
         return false;
     }
-    std::cout << "\033[32m" << pong_message.dump() << "\033[0m\n";
-    std::string received_transaction_id = pong_message["tid"].get<std::string>();
-    auto response_object = pong_message["response"];
-    std::string response_id = response_object["id"].get<std::string>();
+    NEROSHOP_LOG(log_level::debug, "\033[32mpong from " << pong.id << "\033[0m\n");
     
     // Check that the pong message corresponds to the ping message
-    if (received_transaction_id != transaction_id) {
+    if (pong_envelope.tid != transaction_id) {
         std::cerr << "Received pong message with incorrect transaction ID" << std::endl;
         return false;
     }
+    
+    // Store the pinged node's summary of its keys and the protocol features that it supports
+    Node * pinged_node = routing_table->find_node_by_id(std::string(pong.id));
+    if (pinged_node != nullptr) {
+        if (!pong.bloom.empty()) {
+            pinged_node->set_key_filter(std::vector<uint8_t>(pong.bloom.begin(), pong.bloom.end()));
+        }
+        pinged_node->set_capabilities(get_peer_protocol_version(pong.protocol), get_peer_capabilities(pong.protocol, pong.capabilities, pong.encodings));
+    }
 
     return true;
 }
@@ -601,7 +879,7 @@ std::vector<neroshop::Node*> neroshop::Node::send_find_node(const std::string& t
     std::string transaction_id = msgpack::generate_transaction_id();
 
     nlohmann::json query_object;
-    query_object["tid"] = transaction_id;
+    query_object["tid"] = tid_to_json(transaction_id);
     query_object["query"] = "find_node";
     query_object["args"]["id"] = this->id;
     query_object["args"]["target"] = target_id;
@@ -649,7 +927,7 @@ void neroshop::Node::send_get_peers(const std::string& info_hash) {
     std::string get_peers_message = bencode::encode(query);*/
     //-----------------------------------------------------
     nlohmann::json query_object;
-    query_object["tid"] = transaction_id;
+    query_object["tid"] = tid_to_json(transaction_id);
     query_object["query"] = "get_peers";
     query_object["args"]["id"] = this->id;
     query_object["args"]["info_hash"] = info_hash;
@@ -679,7 +957,7 @@ void neroshop::Node::send_announce_peer(const std::string& info_hash, int port,
     std::string announce_peer_message = bencode::encode(query);*/
     //---------------------------------------------------------
     nlohmann::json query_object;
-    query_object["tid"] = transaction_id;
+    query_object["tid"] = tid_to_json(transaction_id);
     query_object["query"] = "announce_peer";
     query_object["args"]["id"] = this->id;
     query_object["args"]["info_hash"] = info_hash;
@@ -702,13 +980,19 @@ void neroshop::Node::send_add_peer(const std::string& info_hash, const Peer& pee
 
 }
 
-int neroshop::Node::send_put(const std::string& key, const std::string& value) {
+int neroshop::Node::send_put(const std::string& key, const std::string& value, const ValueVersion& version) {
     
     nlohmann::json query_object;
     query_object["query"] = "put";
     query_object["args"]["id"] = this->id;
     query_object["args"]["key"] = key;
     query_object["args"]["value"] = value;
+    // Attach the value's version so that receiving nodes can order updates without parsing the value
+    ValueVersion value_version = (version.is_set()) ? version : get_version(key);
+    if(value_version.is_set()) {
+        query_object["args"]["clock"] = value_version.counter;
+        query_object["args"]["publisher"] = value_version.publisher;
+    }
     query_object["version"] = std::string(NEROSHOP_DHT_VERSION);
     //-----------------------------------------------
     // Determine which nodes get to put the key-value data in their hash table
@@ -718,6 +1002,26 @@ int neroshop::Node::send_put(const std::string& key, const std::string& value) {
     std::mt19937 rng(rd());
     std::shuffle(closest_nodes.begin(), closest_nodes.end(), rng);
     //-----------------------------------------------
+    // The key is no longer missing now that it is being stored, and the nodes that returned its old value may not get the new one
+    {
+        std::lock_guard<std::mutex> lock(key_filter_mutex);
+        negative_cache.erase(key);
+    }
+    if(path_cache.get()) path_cache->remove(key);
+    //-----------------------------------------------
+    // Compress the value once for all the nodes that accept compressed values
+    std::string compressed_value = compression::compress(value);
+    bool is_compressible = (compressed_value.size() < value.size());
+    auto set_value = [&](Node * node) {
+        if(is_compressible && node->has_capability(msgpack::Capability::Zstd)) {
+            query_object["args"]["value"] = nlohmann::json::binary(std::vector<uint8_t>(compressed_value.begin(), compressed_value.end()));
+            query_object["args"]["encoding"] = compression::get_encoding();
+        } else {
+            query_object["args"]["value"] = value;
+            query_object["args"].erase("encoding");
+        }
+    };
+    //-----------------------------------------------
     // Keep track of the number of nodes to which put messages have been sent
     size_t nodes_sent_count = 0;
     std::unordered_set<Node*> sent_nodes;
@@ -725,12 +1029,13 @@ int neroshop::Node::send_put(const std::string& key, const std::string& value) {
     // Send put message to the closest nodes
     for(auto const& node : closest_nodes) {
         std::string transaction_id = msgpack::generate_transaction_id();
-        query_object["tid"] = transaction_id; // tid should be unique for each put message
+        query_object["tid"] = tid_to_json(transaction_id); // tid should be unique for each put message
+        set_value(node);
         std::vector<uint8_t> put_message = nlohmann::json::to_msgpack(query_object);
     
         std::string node_ip = (node->get_ip_address() == this->public_ip_address) ? "127.0.0.1" : node->get_ip_address();
         int node_port = node->get_port();
-        std::cout << "Sending put request to \033[36m" << node_ip << ":" << node_port << "\033[0m\n";
+        NEROSHOP_LOG(log_level::debug, "Sending put request to \033[36m" << node_ip << ":" << node_port << "\033[0m\n");
         auto receive_buffer = send_query(node_ip, node_port, put_message);
         // Process the response here
         nlohmann::json put_response_message;
@@ -744,8 +1049,10 @@ int neroshop::Node::send_put(const std::string& key, const std::string& value) {
         }   
         // Add the node to the sent_nodes set
         sent_nodes.insert(node);
+        // The node now has the key even though its published summary does not reflect it yet
+        if(!put_response_message.contains("error")) node->add_to_key_filter(key);
         // Show response and increase count
-        std::cout << ((put_response_message.contains("error")) ? ("\033[91m") : ("\033[32m")) << put_response_message.dump() << "\033[0m\n";
+        NEROSHOP_LOG(log_level::debug, ((put_response_message.contains("error")) ? ("\033[91m") : ("\033[32m")) << put_response_message.dump() << "\033[0m\n");
         nodes_sent_count++;
     }
     //-----------------------------------------------
@@ -755,8 +1062,8 @@ int neroshop::Node::send_put(const std::string& key, const std::string& value) {
     // If the desired number of nodes is not reached due to non-responses, replace failed nodes with new nodes and continue sending put messages
     if (nodes_sent_count < NEROSHOP_DHT_REPLICATION_FACTOR) {
         size_t remaining_nodes = NEROSHOP_DHT_REPLICATION_FACTOR - nodes_sent_count;
-        std::cout << "Nodes remaining: " << remaining_nodes << " out of " << NEROSHOP_DHT_REPLICATION_FACTOR << "\n";
-        std::cout << "Routing table total node count: " << routing_table->get_node_count() << "\n";
+        NEROSHOP_LOG(log_level::debug, "Nodes remaining: " << remaining_nodes << " out of " << NEROSHOP_DHT_REPLICATION_FACTOR << "\n");
+        NEROSHOP_LOG(log_level::debug, "Routing table total node count: " << routing_table->get_node_count() << "\n");
         
         std::vector<Node*> all_nodes = find_node(key, routing_table->get_node_count());
         std::vector<Node*> replacement_nodes;
@@ -780,12 +1087,13 @@ int neroshop::Node::send_put(const std::string& key, const std::string& value) {
             // Send put messages to the replacement nodes
             for (const auto& replacement_node : replacement_nodes) {
                 std::string transaction_id = msgpack::generate_transaction_id();
-                query_object["tid"] = transaction_id;
+                query_object["tid"] = tid_to_json(transaction_id);
+                set_value(replacement_node);
                 std::vector<uint8_t> put_message = nlohmann::json::to_msgpack(query_object);
 
                 std::string node_ip = (replacement_node->get_ip_address() == this->public_ip_address) ? "127.0.0.1" : replacement_node->get_ip_address();
                 int node_port = replacement_node->get_port();
-                std::cout << "Sending put request to \033[36m" << node_ip << ":" << node_port << "\033[0m\n";
+                NEROSHOP_LOG(log_level::debug, "Sending put request to \033[36m" << node_ip << ":" << node_port << "\033[0m\n");
                 auto receive_buffer = send_query(node_ip, node_port, put_message);
                 // Process the response and update the nodes_sent_count and sent_nodes accordingly
                 nlohmann::json put_response_message;
@@ -796,8 +1104,9 @@ int neroshop::Node::send_put(const std::string& key, const std::string& value) {
                     replacement_node->check_counter += 1;
                     continue; // Continue with the next replacement node if this one fails
                 }   
+                if(!put_response_message.contains("error")) replacement_node->add_to_key_filter(key);
                 // Show response and increase count
-                std::cout << ((put_response_message.contains("error")) ? ("\033[91m") : ("\033[32m")) << put_response_message.dump() << "\033[0m\n";
+                NEROSHOP_LOG(log_level::debug, ((put_response_message.contains("error")) ? ("\033[91m") : ("\033[32m")) << put_response_message.dump() << "\033[0m\n");
                 nodes_sent_count++;
             }
         }
@@ -813,64 +1122,489 @@ int neroshop::Node::send_store(const std::string& key, const std::string& value)
 std::string neroshop::Node::send_get(const std::string& key) {
     std::string value;
 
-    nlohmann::json query_object;
-    query_object["query"] = "get";
-    query_object["args"]["id"] = this->id;
-    query_object["args"]["key"] = key;
-    query_object["version"] = std::string(NEROSHOP_DHT_VERSION);
-    
-    std::vector<uint8_t> get_message = nlohmann::json::to_msgpack(query_object);
-    //-----------------------------------------------
-    std::vector<Node *> closest_nodes = find_node(key, NEROSHOP_DHT_MAX_CLOSEST_NODES);
-    
-    std::random_device rd;
-    std::mt19937 rng(rd());
-    std::shuffle(closest_nodes.begin(), closest_nodes.end(), rng);
+    std::string version = NEROSHOP_DHT_VERSION;
+    std::string encoding = compression::get_encoding();
+    msgpack::Envelope envelope;
+    envelope.query = "get";
+    envelope.version = version;
+    envelope.is_tid_binary = true;
+    msgpack::GetRequest get_request;
+    get_request.id = this->id;
+    get_request.key = key;
+    if(!encoding.empty()) get_request.accept.push_back(encoding); // The value may be sent back compressed
     //-----------------------------------------------
     // First, check to see if we have the key before performing any other operations
     if(has_key(key)) return find_value(key);
     //-----------------------------------------------
-    // Send get message to the closest nodes
-    for(auto const& node : closest_nodes) {
-        std::string transaction_id = msgpack::generate_transaction_id();
-        query_object["tid"] = transaction_id; // tid should be unique for each get message
-        std::vector<uint8_t> get_message = nlohmann::json::to_msgpack(query_object);
+    // Then, check whether the key was recently looked up without success
+    if(is_known_missing(key)) {
+        NEROSHOP_LOG(log_level::debug, "Key (" << key << ") was recently not found. Skipping ...\n");
+        return "";
+    }
+    // Then, check whether the value of a popular key was recently retrieved
+    std::string cached_value = get_cached(key);
+    if(!cached_value.empty()) {
+        return cached_value;
+    }
+    //-----------------------------------------------
+    // Iterative lookup (Kademlia FIND_VALUE): the closest known nodes are asked for the value and the nodes that do not have it
+    // answer right away with the contacts closest to the key that they know of. These are asked in the next round until the value is found
+    // or the closest contacts have all been asked
+    struct Contact {
+        std::string id;
+        std::string ip_address;
+        uint16_t port;
+        Node * node; // nullptr if the contact is not in our routing table
+    };
+    std::map<std::string, Contact> shortlist; // Sorted by distance to the key
+    std::unordered_set<std::string> queried_ids;
+    auto add_contact = [&](Contact contact) {
+        if(contact.id == this->id || queried_ids.count(contact.id) > 0) return;
+        shortlist.emplace(RoutingTable::calculate_distance(contact.id, key), std::move(contact));
+    };
+    for(Node * node : find_node(key, NEROSHOP_DHT_MAX_CLOSEST_NODES)) {
+        add_contact({ node->get_id(), node->get_ip_address(), node->get_port(), node });
+    }
+    // The nodes that returned the value last time are asked first, so a repeated lookup usually takes a single round
+    std::vector<Contact> seeds;
+    if(path_cache.get()) {
+        for(const auto& path_contact : path_cache->get(key)) {
+            if(path_contact.id == this->id) continue;
+            seeds.push_back({ path_contact.id, path_contact.ip_address, path_contact.port, routing_table->find_node_by_id(path_contact.id) });
+        }
+    }
+    bool was_seeded = !seeds.empty();
     
-        std::string node_ip = (node->get_ip_address() == this->public_ip_address) ? "127.0.0.1" : node->get_ip_address();
-        int node_port = node->get_port();
-        std::cout << "Sending get request to \033[36m" << node_ip << ":" << node_port << "\033[0m\n";
-        auto receive_buffer = send_query(node_ip, node_port, get_message, 2);
-        // Process the response here
-        nlohmann::json get_response_message;
-        try {
-            get_response_message = nlohmann::json::from_msgpack(receive_buffer);
-        } catch (const std::exception& e) {
-            std::cerr << "Node \033[91m" << node_ip << ":" << node_port << "\033[0m did not respond" << std::endl;
-            node->check_counter += 1;
-            continue; // Continue with the next closest node if this one fails
-        }   
-        // Show response and handle the retrieved value
-        std::cout << ((get_response_message.contains("error")) ? ("\033[91m") : ("\033[32m")) << get_response_message.dump() << "\033[0m\n";
-        if(get_response_message.contains("error")) {
-            continue; // Skip if error
+    size_t skipped_count = 0;
+    size_t failed_count = 0;
+    size_t queried_count = 0;
+    int hops = 0;
+    std::vector<PathContact> sources; // Contacts that returned the value
+    std::map<std::string, Contact> path_contacts; // Contacts that answered with closer contacts instead of the value, sorted by distance to the key
+    while(value.empty()) {
+        // Pick the seeds, then the closest contacts that have not been asked yet
+        std::vector<Contact> round_contacts;
+        auto pick_contact = [&](const Contact& contact) {
+            if(queried_ids.count(contact.id) > 0) return;
+            queried_ids.insert(contact.id);
+            // Skip nodes whose key summary says that they certainly do not have the key
+            if(contact.node != nullptr && !contact.node->may_have_key(key)) {
+                skipped_count++;
+                return;
+            }
+            round_contacts.push_back(contact);
+        };
+        for(const auto& contact : seeds) {
+            if(round_contacts.size() >= NEROSHOP_DHT_LOOKUP_CONCURRENCY) break;
+            pick_contact(contact);
+        }
+        int rank = 0;
+        for(const auto& entry : shortlist) {
+            if(round_contacts.size() >= NEROSHOP_DHT_LOOKUP_CONCURRENCY) break;
+            if(rank++ >= NEROSHOP_DHT_MAX_CLOSEST_NODES) break; // Only the closest contacts are asked
+            pick_contact(entry.second);
+        }
+        if(round_contacts.empty()) break;
+        hops++;
+        
+        // Ask them concurrently. Every request is answered immediately so a round takes at most one timeout
+        std::vector<std::future<std::vector<uint8_t>>> responses;
+        for(const auto& contact : round_contacts) {
+            std::string node_ip = (contact.ip_address == this->public_ip_address) ? "127.0.0.1" : contact.ip_address;
+            envelope.tid = ""; // Set below since tid should be unique for each get message
+            std::string transaction_id = msgpack::generate_transaction_id();
+            envelope.tid = transaction_id;
+            std::vector<uint8_t> get_message = msgpack::encode(envelope, get_request);
+            NEROSHOP_LOG(log_level::debug, "Sending get request to \033[36m" << node_ip << ":" << contact.port << "\033[0m\n");
+            responses.push_back(std::async(std::launch::async, [this, node_ip, port = contact.port, get_message]() {
+                return send_query(node_ip, port, get_message, 2);
+            }));
+            queried_count++;
         }
-        if (get_response_message.contains("response") && get_response_message["response"].contains("value")) {
-            std::string retrieved_value = get_response_message["response"]["value"].get<std::string>();
-            if (!retrieved_value.empty()) {
-                value = retrieved_value;
-                break; // Exit the loop if a value is found
+        
+        for(size_t i = 0; i < responses.size(); i++) {
+            const Contact& contact = round_contacts[i];
+            std::vector<uint8_t> receive_buffer = responses[i].get();
+            // Process the response here. The value is a view into the receive buffer so it is copied only once
+            msgpack::Envelope response_envelope;
+            msgpack::GetResponse get_response;
+            if (!msgpack::decode(receive_buffer, response_envelope, get_response)) {
+                std::cerr << "Node \033[91m" << contact.ip_address << ":" << contact.port << "\033[0m did not respond" << std::endl;
+                if(contact.node != nullptr) contact.node->check_counter += 1;
+                failed_count++;
+                continue; // Continue with the other contacts if this one fails
+            }
+            if(response_envelope.is_error) {
+                NEROSHOP_LOG(log_level::debug, "\033[91m" << response_envelope.error_message << " (" << response_envelope.error_code << ")\033[0m\n");
+                if(response_envelope.error_code == static_cast<int>(KadResultCode::Busy)) failed_count++; // The node may still have the key
+                continue; // Skip if error
+            }
+            if (!get_response.value.empty()) {
+                NEROSHOP_LOG(log_level::debug, "\033[32mget response from " << get_response.id << " (" << get_response.value.size() << " bytes)\033[0m\n");
+                sources.push_back({ contact.id, contact.ip_address, contact.port });
+                if(!value.empty()) continue; // Another contact in this round already had the value
+                value = (get_response.is_binary) 
+                    ? compression::decompress(std::string(get_response.value)) 
+                    : std::string(get_response.value);
+                continue;
+            }
+            path_contacts.emplace(RoutingTable::calculate_distance(contact.id, key), contact);
+            if(!value.empty()) continue;
+            // The contact does not have the key but knows of contacts that are closer to it
+            for(const auto& node_info : get_response.nodes) {
+                std::string ip_address(node_info.ip_address);
+                std::string node_id = (node_info.id.empty()) ? generate_node_id(ip_address, node_info.port) : std::string(node_info.id);
+                add_contact({ node_id, ip_address, node_info.port, routing_table->find_node_by_id(node_id) });
             }
         }
     }
     //-----------------------------------------------
+    if(skipped_count > 0) NEROSHOP_LOG(log_level::debug, "Skipped " << skipped_count << " nodes that do not have key (" << key << ")\n");
+    NEROSHOP_LOG(log_level::debug, "Lookup for key (" << key << ") asked " << queried_count << " nodes\n");
+    // Only remember the miss if every node gave a definite answer
+    if(value.empty() && failed_count == 0) {
+        set_known_missing(key);
+    }
+    // Cache the retrieved value so that repeated lookups do not reach the replicas
+    cache(key, value);
+    // Also have the closest node on the lookup path that did not have the value cache it, so that the lookups of other nodes end there.
+    // It is sent from another thread so that the caller does not wait for it
+    if(!value.empty()) {
+        for(const auto& entry : path_contacts) {
+            const Contact& contact = entry.second;
+            if(contact.node == nullptr || !contact.node->has_capability(msgpack::Capability::CacheStore)) continue;
+            std::string node_ip = (contact.ip_address == this->public_ip_address) ? "127.0.0.1" : contact.ip_address;
+            bool accepts_compressed = contact.node->has_capability(msgpack::Capability::Zstd);
+            std::thread cache_thread([this, key, value, node_ip, port = contact.port, accepts_compressed]() {
+                send_cache(key, value, node_ip, port, accepts_compressed);
+            });
+            cache_thread.detach();
+            break;
+        }
+    }
+    // Remember where the value was found for the next lookup
+    if(path_cache.get()) {
+        if(!value.empty()) {
+            path_cache->put(key, sources);
+            path_cache->record_lookup(was_seeded, hops);
+        } else if(was_seeded) {
+            path_cache->remove(key); // The cached contacts no longer have the key
+        }
+    }
+    //-----------------------------------------------
     return value;
 }
 
+void neroshop::Node::send_cache(const std::string& key, const std::string& value, const std::string& address, uint16_t port, bool accepts_compressed) {
+    nlohmann::json query_object;
+    query_object["query"] = "cache";
+    query_object["args"]["id"] = this->id;
+    query_object["args"]["key"] = key;
+    query_object["args"]["value"] = value;
+    if(accepts_compressed) {
+        std::string compressed_value = compression::compress(value);
+        if(compression::is_compressed(compressed_value)) {
+            query_object["args"]["value"] = nlohmann::json::binary(std::vector<uint8_t>(compressed_value.begin(), compressed_value.end()));
+            query_object["args"]["encoding"] = compression::get_encoding();
+        }
+    }
+    query_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+    query_object["tid"] = tid_to_json(msgpack::generate_transaction_id());
+    std::vector<uint8_t> cache_message = nlohmann::json::to_msgpack(query_object);
+    
+    NEROSHOP_LOG(log_level::debug, "Sending cache request to \033[36m" << address << ":" << port << "\033[0m\n");
+    auto receive_buffer = send_query(address, port, cache_message, 2);
+    nlohmann::json cache_response;
+    try {
+        cache_response = nlohmann::json::from_msgpack(receive_buffer);
+    } catch (const std::exception& e) {
+        NEROSHOP_LOG(log_level::debug, "Node \033[91m" << address << ":" << port << "\033[0m did not respond to cache request\n");
+        return;
+    }
+    NEROSHOP_LOG(log_level::debug, ((cache_response.contains("error")) ? ("\033[91m") : ("\033[32m")) << cache_response.dump() << "\033[0m\n");
+}
+
 std::string neroshop::Node::send_find_value(const std::string& key) {
     return send_get(key);
 }
 
+std::unordered_map<std::string, std::string> neroshop::Node::send_get_many(const std::vector<std::string>& keys, std::function<void(const std::string&, const std::string&)> on_value) {
+    std::unordered_map<std::string, std::string> values;
+    std::mutex values_mutex;
+    auto add_value = [&](const std::string& key, const std::string& value) {
+        std::lock_guard<std::mutex> lock(values_mutex);
+        if(!values.emplace(key, value).second) return;
+        if(on_value) on_value(key, value); // Partial results are handed out as soon as they arrive
+    };
+    //-----------------------------------------------
+    // First, serve the keys that we have, that were recently not found or whose values were recently retrieved
+    std::vector<std::string> pending_keys;
+    std::unordered_set<std::string> seen_keys;
+    for(const auto& key : keys) {
+        if(!seen_keys.insert(key).second) continue; // Duplicate
+        if(has_key(key)) {
+            add_value(key, find_value(key));
+            continue;
+        }
+        if(is_known_missing(key)) continue;
+        std::string cached_value = get_cached(key);
+        if(!cached_value.empty()) {
+            add_value(key, cached_value);
+            continue;
+        }
+        pending_keys.push_back(key);
+    }
+    //-----------------------------------------------
+    // The nodes that returned a value last time are asked for it first
+    std::unordered_map<std::string, std::vector<Node*>> cached_nodes;
+    if(path_cache.get()) {
+        for(const auto& key : pending_keys) {
+            for(const auto& path_contact : path_cache->get(key)) {
+                if(Node * node = routing_table->find_node_by_id(path_contact.id)) cached_nodes[key].push_back(node);
+            }
+        }
+    }
+    std::unordered_map<std::string, std::unordered_set<Node*>> queried_nodes; // Nodes that have already answered for each key
+    std::unordered_set<std::string> failed_keys; // Keys for which at least one node did not respond
+    std::vector<std::string> exhausted_keys; // Keys for which every candidate node has been asked
+    std::mutex round_mutex; // Guards the per-round state and the check counters of the nodes, which are updated by the requests below
+    size_t messages_sent = 0;
+    for(int round = 0; round < NEROSHOP_DHT_MAX_CLOSEST_NODES && !pending_keys.empty(); round++) {
+        // Group the keys by the closest node that has not been asked for them yet. Keys that share the same closest nodes end up in the same message
+        std::unordered_map<Node*, std::vector<std::string>> batches;
+        for(const auto& key : pending_keys) {
+            auto is_candidate = [&](Node * node) {
+                return queried_nodes[key].count(node) == 0 && node->may_have_key(key); // Skip nodes that certainly do not have the key
+            };
+            Node * target = nullptr;
+            auto cached_it = cached_nodes.find(key);
+            if(cached_it != cached_nodes.end()) {
+                for(Node * node : cached_it->second) {
+                    if(is_candidate(node)) { target = node; break; }
+                }
+            }
+            if(target == nullptr) {
+                for(Node * node : find_node(key, NEROSHOP_DHT_MAX_CLOSEST_NODES)) {
+                    if(is_candidate(node)) { target = node; break; }
+                }
+            }
+            if(target != nullptr) batches[target].push_back(key);
+            else exhausted_keys.push_back(key); // Nobody left to ask, so the key is a miss unless a node failed to answer for it
+        }
+        if(batches.empty()) { pending_keys.clear(); break; } // Every candidate node has been asked
+        
+        // Send one get_many message per destination node (more if it has too many keys) and wait for all of them concurrently.
+        // Nodes that have not advertised support for batches are sent one get message per key instead
+        std::vector<std::string> next_pending_keys;
+        std::vector<std::future<void>> requests;
+        for(auto& batch : batches) {
+            Node * node = batch.first;
+            bool is_batched = node->has_capability(msgpack::Capability::Batch);
+            size_t batch_limit = (is_batched) ? NEROSHOP_DHT_MAX_BATCH_KEYS : 1;
+            for(size_t offset = 0; offset < batch.second.size(); offset += batch_limit) {
+                std::vector<std::string> batch_keys(batch.second.begin() + offset, batch.second.begin() + std::min(batch.second.size(), offset + batch_limit));
+                messages_sent++;
+                requests.push_back(std::async(std::launch::async, [&, node, is_batched, batch_keys]() {
+                    nlohmann::json query_object;
+                    query_object["tid"] = tid_to_json(msgpack::generate_transaction_id());
+                    query_object["query"] = (is_batched) ? "get_many" : "get";
+                    query_object["args"]["id"] = this->id;
+                    if(is_batched) query_object["args"]["keys"] = batch_keys;
+                    else query_object["args"]["key"] = batch_keys.front();
+                    if(compression::is_enabled()) query_object["args"]["accept"] = { compression::get_encoding() }; // Values may be sent back compressed
+                    query_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+                    std::vector<uint8_t> get_many_message = nlohmann::json::to_msgpack(query_object);
+                    
+                    std::string node_ip = (node->get_ip_address() == this->public_ip_address) ? "127.0.0.1" : node->get_ip_address();
+                    int node_port = node->get_port();
+                    NEROSHOP_LOG(log_level::debug, "Sending " << query_object["query"].get<std::string>() << " request (" << batch_keys.size() << " keys) to \033[36m" << node_ip << ":" << node_port << "\033[0m\n");
+                    auto receive_buffer = send_query(node_ip, node_port, get_many_message, 2);
+                    nlohmann::json get_many_response_message;
+                    try {
+                        get_many_response_message = nlohmann::json::from_msgpack(receive_buffer);
+                    } catch (const std::exception& e) {
+                        std::cerr << "Node \033[91m" << node_ip << ":" << node_port << "\033[0m did not respond" << std::endl;
+                        std::lock_guard<std::mutex> lock(round_mutex);
+                        node->check_counter += 1;
+                        for(const auto& key : batch_keys) {
+                            queried_nodes[key].insert(node);
+                            failed_keys.insert(key);
+                            next_pending_keys.push_back(key);
+                        }
+                        return;
+                    }
+                    if(get_many_response_message.contains("error") && get_many_response_message["error"].value("code", 0) == static_cast<int>(KadResultCode::Busy)) {
+                        // The node is overloaded. Its keys are asked from the next closest node instead
+                        std::lock_guard<std::mutex> lock(round_mutex);
+                        for(const auto& key : batch_keys) {
+                            queried_nodes[key].insert(node);
+                            failed_keys.insert(key);
+                            next_pending_keys.push_back(key);
+                        }
+                        return;
+                    }
+                    nlohmann::json response_object = get_many_response_message.value("response", nlohmann::json::object());
+                    if(!is_batched && response_object.contains("value")) { // A get response holds a single value
+                        response_object["values"][batch_keys.front()] = std::move(response_object["value"]);
+                    }
+                    
+                    std::unordered_set<std::string> returned_keys;
+                    if(response_object.contains("values") && response_object["values"].is_object()) {
+                        for(const auto& item : response_object["values"].items()) {
+                            const auto& value_object = item.value();
+                            std::string value = (value_object.is_binary()) 
+                                ? compression::decompress(std::string(value_object.get_binary().begin(), value_object.get_binary().end())) 
+                                : (value_object.is_string()) ? value_object.get<std::string>() : "";
+                            if(value.empty()) continue;
+                            returned_keys.insert(item.key());
+                            cache(item.key(), value); // Cache the retrieved value so that repeated lookups do not reach the replicas
+                            if(path_cache.get()) {
+                                path_cache->put(item.key(), { { node->get_id(), node->get_ip_address(), node->get_port() } });
+                                path_cache->record_lookup(cached_nodes.count(item.key()) > 0, round + 1);
+                            }
+                            add_value(item.key(), value);
+                        }
+                    }
+                    // Keys that did not fit into the response are requested from the same node again
+                    std::unordered_set<std::string> remaining_keys;
+                    if(response_object.contains("more") && response_object["more"].is_array()) {
+                        for(const auto& key : response_object["more"]) {
+                            if(key.is_string()) remaining_keys.insert(key.get<std::string>());
+                        }
+                    }
+                    
+                    std::lock_guard<std::mutex> lock(round_mutex);
+                    for(const auto& key : batch_keys) {
+                        if(returned_keys.count(key) > 0) continue;
+                        if(remaining_keys.count(key) == 0) queried_nodes[key].insert(node); // The node does not have the key
+                        next_pending_keys.push_back(key);
+                    }
+                }));
+            }
+        }
+        for(auto& request : requests) request.wait();
+        pending_keys = std::move(next_pending_keys);
+    }
+    //-----------------------------------------------
+    // Only remember the misses if every node gave a definite answer. Keys still pending ran out of rounds
+    exhausted_keys.insert(exhausted_keys.end(), pending_keys.begin(), pending_keys.end());
+    for(const auto& key : exhausted_keys) {
+        if(failed_keys.count(key) == 0) set_known_missing(key);
+    }
+    NEROSHOP_LOG(log_level::info, "Retrieved " << values.size() << " of " << seen_keys.size() << " keys with " << messages_sent << " messages\n");
+    return values;
+}
+
+//-----------------------------------------------------------------------------
+
+int neroshop::Node::send_put_many(const std::vector<std::pair<std::string, std::string>>& entries, const std::vector<ValueVersion>& versions) {
+    // Group the entries by the nodes that get to put them in their hash table
+    std::unordered_map<Node*, std::vector<size_t>> batches;
+    std::vector<ValueVersion> entry_versions(entries.size());
+    std::vector<std::string> compressed_values(entries.size());
+    for(size_t i = 0; i < entries.size(); i++) {
+        const std::string& key = entries[i].first;
+        const std::string& value = entries[i].second;
+        // Attach each value's version so that receiving nodes can order updates without parsing the value
+        entry_versions[i] = (i < versions.size() && versions[i].is_set()) ? versions[i] : get_version(key);
+        // Compress each value once for all the nodes that accept compressed values
+        std::string compressed_value = compression::compress(value);
+        if(compressed_value.size() < value.size()) compressed_values[i] = std::move(compressed_value);
+        // The key is no longer missing now that it is being stored, and the nodes that returned its old value may not get the new one
+        {
+            std::lock_guard<std::mutex> lock(key_filter_mutex);
+            negative_cache.erase(key);
+        }
+        if(path_cache.get()) path_cache->remove(key);
+        for(Node * node : find_node(key, NEROSHOP_DHT_REPLICATION_FACTOR)) {
+            batches[node].push_back(i);
+        }
+    }
+    //-----------------------------------------------
+    std::vector<bool> stored(entries.size(), false);
+    std::mutex stored_mutex;
+    std::vector<std::future<void>> requests;
+    for(auto& batch : batches) {
+        Node * node = batch.first;
+        const std::vector<size_t>& indices = batch.second;
+        requests.push_back(std::async(std::launch::async, [&, node]() {
+            std::string node_ip = (node->get_ip_address() == this->public_ip_address) ? "127.0.0.1" : node->get_ip_address();
+            int node_port = node->get_port();
+            // Nodes that have not advertised support for batches are sent one put message per entry instead
+            bool is_batched = node->has_capability(msgpack::Capability::Batch);
+            // Split the entries into messages that fit into a single datagram
+            size_t next = 0;
+            while(next < indices.size()) {
+                nlohmann::json data = nlohmann::json::array();
+                std::vector<size_t> message_indices;
+                size_t message_size = 0;
+                for(; next < indices.size(); next++) {
+                    if(!is_batched && !message_indices.empty()) break; // One entry per put message
+                    if(message_indices.size() >= NEROSHOP_DHT_MAX_BATCH_KEYS) break;
+                    size_t i = indices[next];
+                    bool send_compressed = !compressed_values[i].empty() && node->has_capability(msgpack::Capability::Zstd);
+                    const std::string& value = (send_compressed) ? compressed_values[i] : entries[i].second;
+                    nlohmann::json entry = { {"key", entries[i].first} };
+                    if(send_compressed) {
+                        entry["value"] = nlohmann::json::binary(std::vector<uint8_t>(value.begin(), value.end()));
+                        entry["encoding"] = compression::get_encoding();
+                    } else {
+                        entry["value"] = value;
+                    }
+                    if(entry_versions[i].is_set()) {
+                        entry["clock"] = entry_versions[i].counter;
+                        entry["publisher"] = entry_versions[i].publisher;
+                    }
+                    // Measured rather than estimated, since the version and encoding fields of an entry outweigh a short value
+                    size_t entry_size = nlohmann::json::to_msgpack(entry).size();
+                    if(!message_indices.empty() && (message_size + entry_size) > NEROSHOP_DHT_MAX_BATCH_SIZE) break;
+                    data.push_back(std::move(entry));
+                    message_indices.push_back(i);
+                    message_size += entry_size;
+                }
+                
+                nlohmann::json query_object;
+                query_object["tid"] = tid_to_json(msgpack::generate_transaction_id());
+                query_object["query"] = (is_batched) ? "put_many" : "put";
+                if(is_batched) query_object["args"]["data"] = std::move(data);
+                else query_object["args"] = std::move(data[0]); // A put takes the fields of a single entry
+                query_object["args"]["id"] = this->id;
+                query_object["version"] = std::string(NEROSHOP_DHT_VERSION);
+                std::vector<uint8_t> put_many_message = nlohmann::json::to_msgpack(query_object);
+                
+                NEROSHOP_LOG(log_level::debug, "Sending " << query_object["query"].get<std::string>() << " request (" << message_indices.size() << " keys) to \033[36m" << node_ip << ":" << node_port << "\033[0m\n");
+                auto receive_buffer = send_query(node_ip, node_port, put_many_message);
+                nlohmann::json put_many_response_message;
+                try {
+                    put_many_response_message = nlohmann::json::from_msgpack(receive_buffer);
+                } catch (const std::exception& e) {
+                    std::cerr << "Node \033[91m" << node_ip << ":" << node_port << "\033[0m did not respond" << std::endl;
+                    node->check_counter += 1;
+                    return; // Skip the rest of this node's entries
+                }
+                if(put_many_response_message.contains("error")) {
+                    std::cerr << "\033[91m" << put_many_response_message.dump() << "\033[0m\n";
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(stored_mutex);
+                for(size_t i : message_indices) {
+                    node->add_to_key_filter(entries[i].first); // The node now has the key even though its published summary does not reflect it yet
+                    stored[i] = true;
+                }
+            }
+        }));
+    }
+    for(auto& request : requests) request.wait();
+    //-----------------------------------------------
+    int stored_count = std::count(stored.begin(), stored.end(), true);
+    NEROSHOP_LOG(log_level::info, "Stored " << stored_count << " of " << entries.size() << " keys on " << batches.size() << " nodes\n");
+    return stored_count;
+}
+
+//-----------------------------------------------------------------------------
+
 void neroshop::Node::send_remove(const std::string& key) {
+    if(path_cache.get()) path_cache->remove(key);
     nlohmann::json query_object;
     query_object["query"] = "remove";
     query_object["args"]["key"] = key;
@@ -886,7 +1620,7 @@ void neroshop::Node::send_remove(const std::string& key) {
     // Send remove query message to the closest nodes
     for(auto const& node : closest_nodes) {
         std::string transaction_id = msgpack::generate_transaction_id();
-        query_object["tid"] = transaction_id; // tid should be unique for each query
+        query_object["tid"] = tid_to_json(transaction_id); // tid should be unique for each query
         std::vector<uint8_t> remove_query = nlohmann::json::to_msgpack(query_object);
         // Send remove query message
         std::string node_ip = (node->get_ip_address() == this->public_ip_address) ? "127.0.0.1" : node->get_ip_address();
@@ -908,48 +1642,122 @@ void neroshop::Node::send_remove(const std::string& key) {
     //-----------------------------------------------
 }
 
-void neroshop::Node::send_map(const std::string& address, int port) {
+std::vector<std::string> neroshop::Node::get_handoff_keys(const std::string& node_id) const {
+    std::vector<std::string> keys;
+    
+    for (const auto& key : get_keys()) { // A copy, so that data is not locked while the routing table is searched
+        // The new node only becomes responsible for a key if it is one of the k closest nodes to that key
+        std::vector<Node*> closest_nodes = find_node(key, NEROSHOP_DHT_REPLICATION_FACTOR);
+        bool is_responsible = std::any_of(closest_nodes.begin(), closest_nodes.end(), [&](const Node* node) {
+            return node->get_id() == node_id;
+        });
+        if(is_responsible) {
+            keys.push_back(key);
+        }
+    }
+    
+    return keys;
+}
+
+void neroshop::Node::send_map(const std::string& address, int port, const std::string& node_id) {
+    auto start_time = std::chrono::steady_clock::now();
+    
+    std::vector<std::string> keys;
+    {
+        // Acquire the lock before accessing the routing table
+        std::shared_lock<std::shared_mutex> read_lock(node_read_mutex);
+        keys = get_handoff_keys(node_id);
+    }
+    if(keys.empty()) return;
+    
     nlohmann::json query_object;
     query_object["query"] = "map";
     query_object["args"]["id"] = this->id;
     query_object["version"] = std::string(NEROSHOP_DHT_VERSION);
     
-    bool map_sent = false;
-    for (const auto& pair : data) {
-        const std::string& key = pair.first;
-        const std::string& value = pair.second;
+    // Split the keys into chunks that fit into a single datagram
+    std::vector<nlohmann::json> chunks;
+    nlohmann::json chunk = nlohmann::json::array();
+    size_t chunk_size = 0;
+    size_t keys_skipped = 0;
+    for (const auto& key : keys) {
+        std::string value = get(key);
+        if(value.empty()) continue; // Key was removed in the meantime
+        nlohmann::json entry = { {"key", key}, {"value", value} };
+        ValueVersion version = get_version(key);
+        if(version.is_set()) {
+            entry["clock"] = version.counter;
+            entry["publisher"] = version.publisher;
+        }
+        size_t entry_size = nlohmann::json::to_msgpack(entry).size();
+        if(entry_size > NEROSHOP_DHT_HANDOFF_CHUNK_SIZE) {
+            // Would not fit into a datagram even on its own. The node can still get it with a lookup
+            NEROSHOP_LOG(log_level::debug, "\033[91mValue for key (" << key << ") is too large to hand off (" << entry_size << " bytes)\033[0m\n");
+            keys_skipped++;
+            continue;
+        }
+        if(!chunk.empty() && (chunk_size + entry_size) > NEROSHOP_DHT_HANDOFF_CHUNK_SIZE) {
+            chunks.push_back(std::move(chunk));
+            chunk = nlohmann::json::array();
+            chunk_size = 0;
+        }
+        chunk.push_back(std::move(entry));
+        chunk_size += entry_size;
+    }
+    if(!chunk.empty()) chunks.push_back(std::move(chunk));
+    
+    // Send one chunk at a time and wait for its acknowledgement before sending the next (stop-and-wait flow control)
+    size_t keys_sent = 0;
+    size_t chunks_sent = 0;
+    for (auto& entries : chunks) {
+        if(stopping) break; // The node is shutting down
+        query_object["args"]["data"] = std::move(entries);
         
-        query_object["args"]["key"] = key;
-        query_object["args"]["value"] = value;
-        std::string transaction_id = msgpack::generate_transaction_id();
-        query_object["tid"] = transaction_id; // tid should be unique for each map message
-        std::vector<uint8_t> map_message = nlohmann::json::to_msgpack(query_object);
-
-        auto receive_buffer = send_query(address, port, map_message);
-        // Process the response here
-        nlohmann::json map_response_message;
-        try {
-            map_response_message = nlohmann::json::from_msgpack(receive_buffer);
-            map_sent = true;
-        } catch (const std::exception& e) {
-            std::cerr << "Node \033[91m" << address << ":" << port << "\033[0m did not respond to send_map" << std::endl;
+        bool acknowledged = false;
+        for (int attempt = 0; attempt <= NEROSHOP_DHT_HANDOFF_MAX_RETRIES && !acknowledged && !stopping; attempt++) {
+            std::string transaction_id = msgpack::generate_transaction_id();
+            query_object["tid"] = tid_to_json(transaction_id); // tid should be unique for each map message
+            std::vector<uint8_t> map_message = nlohmann::json::to_msgpack(query_object);
+            
+            auto receive_buffer = send_query(address, port, map_message);
+            nlohmann::json map_response_message;
+            try {
+                map_response_message = nlohmann::json::from_msgpack(receive_buffer);
+            } catch (const std::exception& e) {
+                std::cerr << "Node \033[91m" << address << ":" << port << "\033[0m did not acknowledge handoff chunk (attempt " << (attempt + 1) << ")" << std::endl;
+                continue;
+            }
+            if(map_response_message.contains("error") || !map_response_message.contains("response")) {
+                std::cerr << "\033[91m" << map_response_message.dump() << "\033[0m\n";
+                continue;
+            }
+            acknowledged = true;
+            keys_sent += map_response_message["response"].value("count", 0);
         }
-        // Show response
-        std::cout << ((map_response_message.contains("error")) ? ("\033[91m") : ("\033[92m")) << map_response_message.dump() << "\033[0m\n";
+        
+        if(!acknowledged) {
+            std::cerr << "Handoff to \033[91m" << address << ":" << port << "\033[0m aborted after " << chunks_sent << " of " << chunks.size() << " chunks\n";
+            break;
+        }
+        chunks_sent++;
     }
-    if(map_sent && !data.empty()) std::cout << "\033[93mIndexing data distributed to " << address << ":" << port << "\033[0m\n";
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time);
+    NEROSHOP_LOG(log_level::info, "\033[93mHanded off " << keys_sent << " of " << keys.size() << " keys in " << chunks_sent << " chunks to " << address << ":" << port << " (" << elapsed.count() << " ms)\033[0m\n");
+    if(keys_skipped > 0) NEROSHOP_LOG(log_level::info, "\033[93m" << keys_skipped << " keys were too large to hand off\033[0m\n");
 }
 
 //-----------------------------------------------------------------------------
 
 void neroshop::Node::republish() {
-    for (const auto& pair : data) {
-        const std::string& key = pair.first;
-        const std::string& value = pair.second;
+    std::vector<std::string> keys = get_keys(); // A copy, so that data is not locked while the values are sent
+    for (const auto& key : keys) {
+        std::string value = get(key); // send_put compresses the value for each node that accepts it, so it is sent as the plain value
+        if(value.empty()) continue; // Key was removed in the meantime
 
         send_put(key, value);
     }
-    if(!data.empty()) std::cout << "\033[93mData republished\033[0m\n";
+    if(!keys.empty()) std::cout << "\033[93mData republished\033[0m\n";
 }
 
 //-----------------------------------------------------------------------------
@@ -998,75 +1806,81 @@ bool neroshop::Node::validate(const std::string& key, const std::string& value)
 
 void neroshop::Node::periodic_refresh() {
     while (true) {
-        {
-            // Acquire the lock before accessing the data
-            std::shared_lock<std::shared_mutex> read_lock(node_read_mutex);
-            
-            // Perform periodic republishing here
-            // This code will run concurrently with the listen/receive loop
-            if(!data.empty()) {
-                std::cout << "\033[34;1mPerforming periodic refresh\033[0m\n";
-            }
-            
-            republish();
-            
-            // read_lock is released here
-        }
+        refresh();
         
         // Sleep for a specified interval
         std::this_thread::sleep_for(std::chrono::hours(NEROSHOP_DHT_REPUBLISH_INTERVAL));
     }
 }
 
+void neroshop::Node::refresh() {
+    // Acquire the lock before accessing the data
+    std::shared_lock<std::shared_mutex> read_lock(node_read_mutex);
+    
+    // Perform periodic republishing here
+    // This code will run concurrently with the listen/receive loop
+    if(!get_keys().empty()) {
+        std::cout << "\033[34;1mPerforming periodic refresh\033[0m\n";
+    }
+    
+    republish();
+}
+
 //-----------------------------------------------------------------------------
 
 void neroshop::Node::periodic_check() {
-    ////std::vector<std::string> dead_node_ids {};
     while(true) {
-        {
-        // Acquire the lock before accessing the routing table
-        std::shared_lock<std::shared_mutex> read_lock(node_read_mutex);
-        // Perform periodic checks here
-        // This code will run concurrently with the listen/receive loop
-        for (auto& bucket : routing_table->buckets) {
-            for (auto& node : bucket.second) {
-                if (node.get() == nullptr) continue; // It's possible that the invalid node object is being accessed or modified by another thread concurrently, even though its already been removed from the routing_table
-                std::string node_ip = (node->get_ip_address() == this->public_ip_address) ? "127.0.0.1" : node->get_ip_address();
-                uint16_t node_port = node->get_port();
-                
-                // Skip the bootstrap nodes from the periodic checks
-                if (node->is_bootstrap_node()) continue;
-                
-                std::cout << "Performing periodic check on \033[34m" << node_ip << ":" << node_port << "\033[0m\n";
-                
-                // Perform the liveness check on the current node
-                bool pinged = ping(node_ip, node_port);
-                
-                // Update the liveness status of the node in the routing table
-                node->check_counter = pinged ? 0 : (node->check_counter + 1);
-                std::cout << "Health check failures: " << node->check_counter << (" (" + node->get_status_as_string() + ")") << "\n";
-                
-                // If node is dead, remove it from the routing table
-                if(node->is_dead()) {
-                    std::cout << "\033[0;91m" << node->public_ip_address << ":" << node_port << "\033[0m marked as dead\n";
-                    if(routing_table->has_node(node->public_ip_address, node_port)) {
-                        ////dead_node_ids.push_back(node->get_id());
-                        routing_table->remove_node(node->public_ip_address, node_port); // Already has internal write_lock
-                    }
-                }
-            }
-        }
-            // read_lock is released here
-        }
+        check_peers();
         
-        /*on_dead_node(dead_node_ids);
-        // Clear the vector for the next iteration
-        dead_node_ids.clear();*/
         // Sleep for a specified interval
         std::this_thread::sleep_for(std::chrono::seconds(NEROSHOP_DHT_PERIODIC_CHECK_INTERVAL));
     }
 }
 
+void neroshop::Node::check_peers() {
+    ////std::vector<std::string> dead_node_ids {};
+    {
+    // Acquire the lock before accessing the routing table
+    std::shared_lock<std::shared_mutex> read_lock(node_read_mutex);
+    // Perform periodic checks here
+    // This code will run concurrently with the listen/receive loop
+    for (auto& bucket : routing_table->buckets) {
+        for (auto& node : bucket.second) {
+            if (node.get() == nullptr) continue; // It's possible that the invalid node object is being accessed or modified by another thread concurrently, even though its already been removed from the routing_table
+            std::string node_ip = (node->get_ip_address() == this->public_ip_address) ? "127.0.0.1" : node->get_ip_address();
+            uint16_t node_port = node->get_port();
+            
+            // Skip the bootstrap nodes from the periodic checks
+            if (node->is_bootstrap_node()) continue;
+            
+            std::cout << "Performing periodic check on \033[34m" << node_ip << ":" << node_port << "\033[0m\n";
+            
+            // Perform the liveness check on the current node
+            bool pinged = ping(node_ip, node_port);
+            
+            // Update the liveness status of the node in the routing table
+            node->check_counter = pinged ? 0 : (node->check_counter + 1);
+            std::cout << "Health check failures: " << node->check_counter << (" (" + node->get_status_as_string() + ")") << "\n";
+            
+            // If node is dead, remove it from the routing table
+            if(node->is_dead()) {
+                std::cout << "\033[0;91m" << node->public_ip_address << ":" << node_port << "\033[0m marked as dead\n";
+                if(routing_table->has_node(node->public_ip_address, node_port)) {
+                    ////dead_node_ids.push_back(node->get_id());
+                    routing_table->remove_node(node->public_ip_address, node_port); // Already has internal write_lock
+                }
+            }
+        }
+    }
+        // read_lock is released here
+    }
+    publish_network_status(); // Nodes may have gone idle, come back or been removed
+    
+    /*on_dead_node(dead_node_ids);
+    // Clear the vector for the next iteration
+    dead_node_ids.clear();*/
+}
+
 //-----------------------------------------------------------------------------
 
 /*bool neroshop::Node::on_keyword_blocked(const nlohmann::json& value) {
@@ -1109,23 +1923,79 @@ void neroshop::Node::periodic_check() {
 
 //-----------------------------------------------------------------------------
 
-void neroshop::Node::on_ping(const std::vector<uint8_t>& buffer, const struct sockaddr_in& client_addr) {
-    if (buffer.size() > 0) {
-        nlohmann::json message = nlohmann::json::from_msgpack(buffer);
-        if (message.contains("query") && message["query"] == "ping") {
-            std::string sender_id = message["args"]["id"].get<std::string>();
-            std::string sender_ip = inet_ntoa(client_addr.sin_addr);
-            uint16_t sender_port = (message["args"].contains("ephemeral_port")) ? (uint16_t)message["args"]["ephemeral_port"] : ntohs(client_addr.sin_port);//NEROSHOP_P2P_DEFAULT_PORT;
-            bool node_exists = routing_table->has_node((sender_ip == "127.0.0.1") ? this->public_ip_address : sender_ip, sender_port);
-            if (!node_exists) {
-                auto node_that_pinged = std::make_unique<Node>((sender_ip == "127.0.0.1") ? this->public_ip_address : sender_ip, sender_port, false);
-                if(!node_that_pinged->is_bootstrap_node()) { // To prevent the bootstrap node from being stored in the routing table
-                    routing_table->add_node(std::move(node_that_pinged)); // Already has internal write_lock
-                    persist_routing_table((sender_ip == "127.0.0.1") ? this->public_ip_address : sender_ip, sender_port);
-                    routing_table->print_table();
-                    // Redistribute your indexing data to the new node that recently joined the network to make product/service listings more easily discoverable by the new node
-                    send_map((sender_ip == this->public_ip_address) ? "127.0.0.1" : sender_ip, sender_port);
-                }
+bool neroshop::Node::admit_request(const std::vector<uint8_t>& buffer, const struct sockaddr_in& client_addr, AdmissionControl::Slot& slot) {
+    if(!admission_control.get()) return true;
+    // Only the envelope is read to classify the request. Malformed messages count as normal priority and get a parse error once admitted
+    msgpack::Envelope envelope;
+    msgpack::decode(buffer, envelope);
+    char sender_ip[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &client_addr.sin_addr, sender_ip, sizeof(sender_ip));
+    
+    Admission admission = admission_control->admit(sender_ip, AdmissionControl::get_priority(envelope.query), slot);
+    if(admission == Admission::Accepted) return true;
+    if(admission == Admission::RateLimited) {
+        NEROSHOP_LOG(log_level::debug, "\033[91mDropped request from " << sender_ip << " (rate limited)\033[0m\n");
+        return false; // Answering a flood would only amplify it
+    }
+    // The node is busy. Tell the sender right away so that it can ask another node instead of timing out
+    NEROSHOP_LOG(log_level::debug, "\033[91mTurned away " << envelope.query << " request from " << sender_ip << " (busy)\033[0m\n");
+    if(envelope.tid.empty()) return false; // Notifications get no response
+    std::string version = NEROSHOP_DHT_VERSION;
+    envelope.version = version;
+    envelope.is_error = true;
+    envelope.error_code = static_cast<int>(KadResultCode::Busy);
+    envelope.error_message = "Busy";
+    std::vector<uint8_t> response = msgpack::encode_error(envelope);
+    if(sendto(sockfd, response.data(), response.size(), 0, (const struct sockaddr*)&client_addr, sizeof(client_addr)) < 0) {
+        perror("sendto");
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::Node::publish_network_status() {
+    if(!event_publisher.get() || !event_publisher->has_subscribers(EventPublisher::Topic::NetworkStatus)) return;
+    event_publisher->publish_network_status(get_peer_count(), get_active_peer_count(), get_idle_peer_count());
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::Node::on_ping(const msgpack::PingRequest& ping, const struct sockaddr_in& client_addr) {
+    std::string sender_ip = inet_ntoa(client_addr.sin_addr);
+    uint16_t sender_port = (ping.ephemeral_port >= 0) ? (uint16_t)ping.ephemeral_port : ntohs(client_addr.sin_port);//NEROSHOP_P2P_DEFAULT_PORT;
+    std::vector<uint8_t> sender_bloom(ping.bloom.begin(), ping.bloom.end());
+    int sender_protocol_version = get_peer_protocol_version(ping.protocol);
+    uint32_t sender_capabilities = get_peer_capabilities(ping.protocol, ping.capabilities, ping.encodings);
+    bool node_exists = routing_table->has_node((sender_ip == "127.0.0.1") ? this->public_ip_address : sender_ip, sender_port);
+    if (node_exists) {
+        // Refresh the pinging node's summary of its keys
+        Node * node_that_pinged = routing_table->find_node_by_id(generate_node_id((sender_ip == "127.0.0.1") ? this->public_ip_address : sender_ip, sender_port));
+        if(node_that_pinged != nullptr) {
+            node_that_pinged->set_key_filter(sender_bloom);
+            node_that_pinged->set_capabilities(sender_protocol_version, sender_capabilities);
+        }
+    }
+    if (!node_exists) {
+        auto node_that_pinged = std::make_unique<Node>((sender_ip == "127.0.0.1") ? this->public_ip_address : sender_ip, sender_port, false);
+        node_that_pinged->set_key_filter(sender_bloom);
+        node_that_pinged->set_capabilities(sender_protocol_version, sender_capabilities);
+        if(!node_that_pinged->is_bootstrap_node()) { // To prevent the bootstrap node from being stored in the routing table
+            std::string node_id = node_that_pinged->get_id(); // The id under which the node is stored in the routing table
+            routing_table->add_node(std::move(node_that_pinged)); // Already has internal write_lock
+            publish_network_status();
+            persist_routing_table((sender_ip == "127.0.0.1") ? this->public_ip_address : sender_ip, sender_port);
+            routing_table->print_table();
+            // Hand off the keys that the new node is now responsible for so that product/service listings are discoverable through it.
+            // This waits for an acknowledgement of every chunk, so it runs on its own thread rather than holding up the request handler.
+            // The thread is tracked so that the node can stop it and wait for it when it is destroyed
+            std::string handoff_address = (sender_ip == this->public_ip_address) ? "127.0.0.1" : sender_ip;
+            std::lock_guard<std::mutex> lock(handoff_mutex);
+            handoff_tasks.erase(std::remove_if(handoff_tasks.begin(), handoff_tasks.end(), [](const std::future<void>& task) {
+                return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            }), handoff_tasks.end()); // Finished handoffs are dropped whenever a new one starts
+            if(!stopping) {
+                handoff_tasks.push_back(std::async(std::launch::async, [this, handoff_address, sender_port, node_id]() { send_map(handoff_address, sender_port, node_id); }));
             }
         }
     }
@@ -1175,6 +2045,9 @@ void neroshop::Node::on_ping(const std::vector<uint8_t>& buffer, const struct so
 //-----------------------------------------------------------------------------
 
 void neroshop::Node::run() {
+    #if defined(NEROSHOP_USE_IO_URING)
+    if (run_io_uring()) return;
+    #endif
     
     run_optimized();
     return;
@@ -1200,14 +2073,22 @@ void neroshop::Node::run() {
         // Resize the buffer to the actual number of received bytes
         buffer.resize(bytes_received);
 
-        if (buffer.size() > 0) std::cout << "Received request from \033[0;36m" << inet_ntoa(client_addr.sin_addr) << "\033[0m\n";
+        if (buffer.size() > 0) NEROSHOP_LOG(log_level::debug, "Received request from \033[0;36m" << inet_ntoa(client_addr.sin_addr) << "\033[0m\n");
+        
+        AdmissionControl::Slot slot;
+        if (!admit_request(buffer, client_addr, slot)) continue;
         
         // Create a lambda function to handle the request
-        auto handle_request_fn = [=]() {
+        auto handle_request_fn = [=, slot = std::move(slot)]() {
+            // Decode the message once. It is shared by dispatch and the routing table update
+            msgpack::Message message;
+            msgpack::decode(buffer, message);
             // Acquire the lock before accessing the routing table
             std::shared_lock<std::shared_mutex> read_lock(node_read_mutex);
             // Process the message
-            std::vector<uint8_t> response = neroshop::msgpack::process(buffer, *this, false);
+            char requester_ip[INET_ADDRSTRLEN] = {}; // inet_ntoa is not thread-safe
+            inet_ntop(AF_INET, &client_addr.sin_addr, requester_ip, sizeof(requester_ip));
+            std::vector<uint8_t> response = neroshop::msgpack::process(message, *this, false, requester_ip);
 
             // Send the response
             int bytes_sent = sendto(sockfd, response.data(), response.size(), 0,
@@ -1217,11 +2098,11 @@ void neroshop::Node::run() {
             }
         
             // Add the node that pinged this node to the routing table
-            on_ping(buffer, client_addr);
+            if (message.is_ping()) on_ping(message.ping, client_addr);
         };
         
         // Create a detached thread to handle the request
-        std::thread request_thread(handle_request_fn);
+        std::thread request_thread(std::move(handle_request_fn));
         request_thread.detach();
     }
     // Wait for the periodic threads to finish
@@ -1256,45 +2137,10 @@ void neroshop::Node::run_optimized() {
         }
 
         if (FD_ISSET(sockfd, &read_set)) {
-            std::vector<uint8_t> buffer(NEROSHOP_RECV_BUFFER_SIZE);
-            struct sockaddr_in client_addr;
-            socklen_t client_addr_len = sizeof(client_addr);
-            int bytes_received = recvfrom(sockfd, buffer.data(), buffer.size(), MSG_DONTWAIT,
-                                          (struct sockaddr*)&client_addr, &client_addr_len);
-            if (bytes_received == -1 && errno == EAGAIN) {
-                // No data available, continue loop
-                continue;
-            }
-            else if (bytes_received < 0) {
-                perror("recvfrom");
-            }
-            
-            if (bytes_received > 0) {
-                // Resize the buffer to the actual number of received bytes
-                buffer.resize(bytes_received);
-
-                if (buffer.size() > 0) std::cout << "Received request from \033[0;36m" << inet_ntoa(client_addr.sin_addr) << "\033[0m\n";
-                
-                // Create a lambda function to handle the request
-                auto handle_request_fn = [=]() {
-                    // Acquire the lock before accessing the routing table
-                    std::shared_lock<std::shared_mutex> read_lock(node_read_mutex);
-                    // Process the message
-                    std::vector<uint8_t> response = neroshop::msgpack::process(buffer, *this, false);
-
-                    // Send the response
-                    int bytes_sent = sendto(sockfd, response.data(), response.size(), 0,
-                                    (struct sockaddr*)&client_addr, client_addr_len);
-                    if (bytes_sent < 0) {
-                        perror("sendto");
-                    }
-                
-                    // Add the node that pinged this node to the routing table
-                    on_ping(buffer, client_addr);
-                };
-                
+            std::function<void()> handle_request_fn;
+            if (receive_request(handle_request_fn) && handle_request_fn) {
                 // Create a detached thread to handle the request
-                std::thread request_thread(handle_request_fn);
+                std::thread request_thread(std::move(handle_request_fn));
                 request_thread.detach();
             }
         }
@@ -1304,6 +2150,104 @@ void neroshop::Node::run_optimized() {
     periodic_refresh_thread.join();
 }
 
+bool neroshop::Node::receive_request(std::function<void()>& handle_request) {
+    handle_request = nullptr;
+    std::vector<uint8_t> buffer(NEROSHOP_RECV_BUFFER_SIZE);
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+    int bytes_received = recvfrom(sockfd, buffer.data(), buffer.size(), MSG_DONTWAIT,
+                                  (struct sockaddr*)&client_addr, &client_addr_len);
+    if (bytes_received < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) perror("recvfrom");
+        // No data available
+        return false;
+    }
+    if (bytes_received == 0) return true; // Empty datagram
+    
+    // Resize the buffer to the actual number of received bytes
+    buffer.resize(bytes_received);
+
+    NEROSHOP_LOG(log_level::debug, "Received request from \033[0;36m" << inet_ntoa(client_addr.sin_addr) << "\033[0m\n");
+    
+    // Drop or turn away the request before spending a thread on it if the sender or the node is overloaded
+    auto slot = std::make_shared<AdmissionControl::Slot>(); // Shared since std::function must be copyable
+    if (!admit_request(buffer, client_addr, *slot)) return true;
+    
+    // The slot is released once the request has been handled
+    handle_request = [this, buffer = std::move(buffer), client_addr, client_addr_len, slot]() {
+        respond(buffer, client_addr, [&](const std::vector<uint8_t>& response) {
+            int bytes_sent = sendto(sockfd, response.data(), response.size(), 0,
+                            (struct sockaddr*)&client_addr, client_addr_len);
+            if (bytes_sent < 0) {
+                perror("sendto");
+            }
+        });
+    };
+    return true;
+}
+
+void neroshop::Node::respond(const std::vector<uint8_t>& buffer, const struct sockaddr_in& client_addr, const std::function<void(const std::vector<uint8_t>&)>& send_response) {
+    // Decode the message once. It is shared by dispatch and the routing table update
+    msgpack::Message message;
+    msgpack::decode(buffer, message);
+    // Acquire the lock before accessing the routing table
+    std::shared_lock<std::shared_mutex> read_lock(node_read_mutex);
+    // Process the message
+    char requester_ip[INET_ADDRSTRLEN] = {}; // inet_ntoa is not thread-safe
+    inet_ntop(AF_INET, &client_addr.sin_addr, requester_ip, sizeof(requester_ip));
+    std::vector<uint8_t> response = neroshop::msgpack::process(message, *this, false, requester_ip);
+
+    // Send the response
+    send_response(response);
+
+    // Add the node that pinged this node to the routing table
+    if (message.is_ping()) on_ping(message.ping, client_addr);
+}
+
+#if defined(NEROSHOP_USE_IO_URING)
+bool neroshop::Node::run_io_uring() {
+    std::unique_ptr<IoUringUdp> ring;
+    try {
+        ring = std::make_unique<IoUringUdp>(sockfd);
+    } catch (const std::exception& e) {
+        std::cerr << "io_uring unavailable (" << e.what() << "), falling back to select\n";
+        return false;
+    }
+    // Admitted requests are handled on a fixed set of threads rather than a new thread each, and the responses go out through the ring
+    WorkerPool workers(nullptr, NEROSHOP_DHT_MAX_CONCURRENT_REQUESTS);
+    std::thread periodic_check_thread;
+    std::thread periodic_refresh_thread;
+    bool supported = ring->run([&](const uint8_t * data, std::size_t size, const struct sockaddr_in& client_addr) {
+        if (size == 0) return;
+        std::vector<uint8_t> buffer(data, data + size);
+        NEROSHOP_LOG(log_level::debug, "Received request from \033[0;36m" << inet_ntoa(client_addr.sin_addr) << "\033[0m\n");
+        
+        auto slot = std::make_shared<AdmissionControl::Slot>();
+        if (!admit_request(buffer, client_addr, *slot)) return;
+        
+        IoUringUdp * ring_ptr = ring.get();
+        workers.post([this, ring_ptr, buffer = std::move(buffer), client_addr, slot]() {
+            respond(buffer, client_addr, [&](const std::vector<uint8_t>& response) {
+                if (!response.empty()) ring_ptr->send(client_addr, response);
+            });
+        });
+    }, [&]() {
+        // Started only once the kernel has accepted the ring, as the select loop would start its own
+        periodic_check_thread = std::thread([this]() { periodic_check(); });
+        periodic_refresh_thread = std::thread([this]() { periodic_refresh(); });
+    });
+    if (!supported) {
+        std::cerr << "io_uring multishot receive is not supported by this kernel, falling back to select\n";
+        return false;
+    }
+    workers.stop();
+    // Wait for the periodic threads to finish
+    if (periodic_check_thread.joinable()) periodic_check_thread.join();
+    if (periodic_refresh_thread.joinable()) periodic_refresh_thread.join();
+    return true;
+}
+#endif
+
 //-----------------------------------------------------------------------------
 
 std::string neroshop::Node::get_id() const {
@@ -1357,6 +2301,10 @@ uint16_t neroshop::Node::get_port() const {
     return port;
 }
 
+int neroshop::Node::get_socket() const {
+    return sockfd;
+}
+
 /*neroshop::Server * neroshop::Node::get_server() const {
     return server.get();
 }*/
@@ -1365,6 +2313,22 @@ neroshop::RoutingTable * neroshop::Node::get_routing_table() const {
     return routing_table.get();
 }
 
+neroshop::AdmissionControl * neroshop::Node::get_admission_control() const {
+    return admission_control.get();
+}
+
+neroshop::EventPublisher * neroshop::Node::get_event_publisher() const {
+    return event_publisher.get();
+}
+
+neroshop::ValueCache * neroshop::Node::get_value_cache() const {
+    return value_cache.get();
+}
+
+neroshop::PathCache * neroshop::Node::get_path_cache() const {
+    return path_cache.get();
+}
+
 int neroshop::Node::get_peer_count() const {
     return routing_table->get_node_count();
 }
@@ -1411,6 +2375,7 @@ std::string neroshop::Node::get_status_as_string() const {
 
 std::vector<std::string> neroshop::Node::get_keys() const {
     std::vector<std::string> keys;
+    std::shared_lock<std::shared_mutex> lock(data_mutex);
 
     for (const auto& pair : data) {
         keys.push_back(pair.first);
@@ -1421,14 +2386,36 @@ std::vector<std::string> neroshop::Node::get_keys() const {
 
 std::vector<std::pair<std::string, std::string>> neroshop::Node::get_data() const {
     std::vector<std::pair<std::string, std::string>> data_vector;
+    std::shared_lock<std::shared_mutex> lock(data_mutex);
 
     for (const auto& pair : data) {
-        data_vector.push_back(pair);
+        data_vector.push_back({ pair.first, compression::decompress(pair.second) });
     }
 
     return data_vector;
 }
 
+neroshop::ValueVersion neroshop::Node::get_version(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(version_mutex);
+    auto it = versions.find(key);
+    if(it == versions.end()) return {};
+    return it->second;
+}
+
+neroshop::ValueVersion neroshop::Node::get_next_version() {
+    std::lock_guard<std::mutex> lock(version_mutex);
+    if(clock < std::numeric_limits<uint64_t>::max()) ++clock; // 0 means that a version is not set, so the clock must never wrap
+    return { clock, this->id };
+}
+
+int neroshop::Node::get_protocol_version() const {
+    return protocol_version;
+}
+
+uint32_t neroshop::Node::get_capabilities() const {
+    return capabilities;
+}
+
 /*const std::unordered_map<std::string, std::string>& neroshop::Node::get_data() const {
     return data;
 }*/
@@ -1436,12 +2423,19 @@ std::vector<std::pair<std::string, std::string>> neroshop::Node::get_data() cons
 //-----------------------------------------------------------------------------
 
 bool neroshop::Node::has_key(const std::string& key) const {
+    std::shared_lock<std::shared_mutex> lock(data_mutex);
     return (data.count(key) > 0);
 }
 
+bool neroshop::Node::has_capability(msgpack::Capability capability) const {
+    return msgpack::has_capability(capabilities, capability);
+}
+
 bool neroshop::Node::has_value(const std::string& value) const {
+    std::string stored_value = compression::compress(value); // Compression is deterministic so there is no need to decompress every value
+    std::shared_lock<std::shared_mutex> lock(data_mutex);
     for (const auto& pair : data) {
-        if (pair.second == value) {
+        if (pair.second == stored_value) {
             return true;
         }
     }
@@ -1471,3 +2465,8 @@ void neroshop::Node::set_bootstrap(bool bootstrap) {
     this->bootstrap = bootstrap;
 }
 
+void neroshop::Node::set_capabilities(int protocol_version, uint32_t capabilities) {
+    this->protocol_version = protocol_version;
+    this->capabilities = capabilities;
+}
+
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "../transport/server.hpp" // TCP, UDP. IP-related headers here
+#include "admission_control.hpp"
 
+#include <atomic>
+#include <future>
 #include <iostream>
 #include <string>
 #include <unordered_map>
@@ -9,6 +12,9 @@
 #include <memory> // std::unique_ptr
 #include <functional> // std::function
 #include <shared_mutex>
+#include <mutex>
+#include <chrono>
+#include <tuple> // std::tie
 
 const int NUM_BITS = 256;
 
@@ -16,6 +22,11 @@ namespace neroshop {
 
 class RoutingTable; // forward declaration
 class Mapper;
+class BloomFilter;
+class ValueCache;
+class PathCache;
+class EventPublisher;
+namespace msgpack { struct PingRequest; enum class Capability : uint32_t; }
 
 struct Peer {
     std::string address;
@@ -24,11 +35,21 @@ struct Peer {
 
 enum class NodeStatus { Inactive, Idle, Active };
 
+struct ValueVersion { // Lamport timestamp carried alongside a value so that updates can be ordered without parsing the value
+    uint64_t counter = 0;
+    std::string publisher; // ID of the node that published the update. Breaks ties between concurrent updates
+    
+    bool is_set() const { return counter > 0; }
+    bool operator<(const ValueVersion& other) const { return std::tie(counter, publisher) < std::tie(other.counter, other.publisher); }
+    bool operator==(const ValueVersion& other) const { return counter == other.counter && publisher == other.publisher; }
+};
+
 class Node {
 private:
     std::string id;
     std::string version;
     std::unordered_map<std::string, std::string> data; // internal hash table that stores key-value pairs 
+    mutable std::shared_mutex data_mutex; // Protects data. Taken after version_mutex and key_filter_mutex, never before them
     std::unordered_map<std::string, std::vector<Peer>> info_hash_peers; // maps an info_hash to a vector of Peers
     ////std::unique_ptr<Server> server;// a node acts as a server so it should have a server object
     int sockfd;
@@ -45,12 +66,43 @@ private:
     std::shared_mutex node_read_mutex; // Shared mutex for routing table access
     std::shared_mutex node_write_mutex; // Shared mutex for routing table access
     std::unique_ptr<Mapper> mapper;
+    std::unique_ptr<BloomFilter> key_filter; // Summary of the keys stored in this node (for an external node, the summary it last published to us)
+    std::chrono::steady_clock::time_point key_filter_timestamp; // When the key filter was last received
+    bool key_filter_outdated; // Set when a key is removed, since keys cannot be removed from a Bloom filter
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> negative_cache; // Maps recently-missed keys to their expiration time
+    mutable std::mutex key_filter_mutex; // Protects key_filter and negative_cache
+    std::unique_ptr<ValueCache> value_cache; // Values of popular keys that were looked up through this node
+    std::unique_ptr<PathCache> path_cache; // Nodes that last returned the value of each key that this node looked up
+    std::unique_ptr<AdmissionControl> admission_control; // Limits the inbound requests that this (local) node handles
+    std::unique_ptr<EventPublisher> event_publisher; // Pushes changes on this (local) node to the IPC clients that subscribed to them
+    std::unordered_map<std::string, ValueVersion> versions; // Maps keys to the version of their stored value
+    uint64_t clock; // Lamport clock: greater than any version counter this node has published or seen
+    mutable std::mutex version_mutex; // Protects versions and clock. Held across every write to data, so that a value and its version change together
+    // Atomic since a ping handler updates them while lookups on other threads read them
+    std::atomic<int> protocol_version; // Protocol version that this (external) node advertised in ping/pong. 0 until it has been heard from
+    std::atomic<uint32_t> capabilities; // Protocol features that this (external) node advertised (bitmask of msgpack::Capability)
+    std::string token_secret; // Secret used to generate the tokens handed out by get_peers
+    std::string previous_token_secret; // Tokens generated before the last rotation remain valid until the next one
+    std::chrono::steady_clock::time_point token_secret_timestamp; // When token_secret was generated
+    mutable std::mutex token_mutex; // Protects the token secrets
+    std::vector<std::future<void>> handoff_tasks; // Keyspace handoffs to new nodes that may still be running
+    std::mutex handoff_mutex; // Protects handoff_tasks
+    std::atomic<bool> stopping; // Set when the node is destroyed so that running handoffs stop after their current chunk
+    void rotate_token_secret(); // Rotates the secrets if the current one has expired. token_mutex must be held
+    bool is_up_to_date(const std::string& key, const ValueVersion& version) const; // Whether the stored value is at least as recent as version. version_mutex must be held
     // Generates a node id from address and port combination
     std::string generate_node_id(const std::string& address, int port);
     // Determines if node1 is closer to the target_id than node2
     bool is_closer(const std::string& target_id, const std::string& node1_id, const std::string& node2_id);
+    // Returns the keys for which node_id falls within the k closest nodes
+    std::vector<std::string> get_handoff_keys(const std::string& node_id) const;
     //---------------------------------------------------
     int set(const std::string& key, const std::string& value); // Updates the value without changing the key. set cannot be accessed directly but only through put
+    // Decides whether a received request is handled before any thread is spent on it. Overloaded senders are sent a "busy" error
+    bool admit_request(const std::vector<uint8_t>& buffer, const struct sockaddr_in& client_addr, AdmissionControl::Slot& slot);
+    // Processes an admitted request and hands the response to send_response, which sends it however the caller's loop does
+    void respond(const std::vector<uint8_t>& buffer, const struct sockaddr_in& client_addr, const std::function<void(const std::vector<uint8_t>&)>& send_response);
+    void publish_network_status(); // Tells the IPC subscribers if the peer counts have changed
 public:
     Node(const std::string& address, int port, bool local); // Binds a socket to a port and initializes the DHT
     //Node(const Node& other); // Copy constructor
@@ -72,12 +124,16 @@ public:
     void send_get_peers(const std::string& info_hash);
     void send_announce_peer(const std::string& info_hash, int port, const std::string& token);
     void send_add_peer(const std::string& info_hash, const Peer& peer);
-    int send_put(const std::string& key, const std::string& value);
+    int send_put(const std::string& key, const std::string& value, const ValueVersion& version = {}); // Uses the version of the stored value if no version is given
     int send_store(const std::string& key, const std::string& value);
     std::string send_get(const std::string& key);
+    void send_cache(const std::string& key, const std::string& value, const std::string& address, uint16_t port, bool accepts_compressed); // Asks a node on a lookup path to cache a value that it does not store
+    // Batched get/put. Keys that share the same closest node are sent to it in one message and the messages to different nodes are sent concurrently
+    std::unordered_map<std::string, std::string> send_get_many(const std::vector<std::string>& keys, std::function<void(const std::string&, const std::string&)> on_value = nullptr); // on_value is called as each value arrives
+    int send_put_many(const std::vector<std::pair<std::string, std::string>>& entries, const std::vector<ValueVersion>& versions = {}); // Returns the number of keys stored on at least one node
     std::string send_find_value(const std::string& key);
     void send_remove(const std::string& key);
-    void send_map(const std::string& address, int port); // Distributes indexing data to a single node
+    void send_map(const std::string& address, int port, const std::string& node_id); // Hands off the keys that a newly joined node is now responsible for, in acknowledged chunks
     // announce_peer, get_peers are specific to Bittorent and are not used in standard Kademlia
     //---------------------------------------------------
     ////std::vector<Node*> lookup(const std::string& key); // In Kademlia, the primary purpose of the lookup function is to find the nodes responsible for storing a particular key in the DHT, rather than retrieving the actual value of the key. The lookup function helps in locating the nodes that are likely to have the key or be able to provide information about it.
@@ -85,15 +141,23 @@ public:
     void join(/*std::function<void()> on_join_callback*/); // Sends a join message to the bootstrap peer to join the network
     void run(); // Main loop that listens for incoming messages
     void run_optimized(); // Uses less CPU than run but slower to process requests
+    #if defined(NEROSHOP_USE_IO_URING)
+    bool run_io_uring(); // Receives and sends through io_uring. Returns false right away if the kernel does not support it
+    #endif
+    // Reads one request from the socket without blocking. Returns false once there is nothing left to read. Unless the request was turned away,
+    // handle_request is set to the work of answering it, which may be run on any thread. For event loops that watch get_socket()
+    bool receive_request(std::function<void()>& handle_request);
     void periodic_check();
     void periodic_refresh(); // Periodic republishing
+    void check_peers(); // One round of periodic_check: pings the nodes in the routing table and removes the dead ones
+    void refresh(); // One round of periodic_refresh
     void republish();
     bool validate(const std::string& key, const std::string& value); // Validates data before storing it
     //---------------------------------------------------
     void persist_routing_table(const std::string& address, int port); // JIC bootstrap node faces outage and needs to recover
     void rebuild_routing_table(); // Re-builds routing table from data stored on disk
     //---------------------------------------------------
-    void on_ping(const std::vector<uint8_t>& buffer, const struct sockaddr_in& client_addr);
+    void on_ping(const msgpack::PingRequest& ping, const struct sockaddr_in& client_addr);
     ////void on_dead_node(const std::vector<std::string>& node_ids);
     ////bool on_keyword_blocked(const std::string& keyword);
     ////bool on_node_blacklisted(const std::string& address);
@@ -106,12 +170,30 @@ public:
     void announce_peer(const std::string& info_hash, int port, const std::string& token); // A query to announce that a peer has joined a specific torrent or infohash.
     void add_peer(const std::string& info_hash, const Peer& peer);
     void remove_peer(const std::string& info_hash);
-    int put(const std::string& key, const std::string& value); // A query to store a value in the DHT.    // Stores the key-value pair in the DHT
-    int store(const std::string& key, const std::string& value);
+    int put(const std::string& key, const std::string& value, const ValueVersion& version = {}); // A query to store a value in the DHT.    // Stores the key-value pair in the DHT
+    int store(const std::string& key, const std::string& value, const ValueVersion& version = {});
     std::string get(const std::string& key) const; // A query to get a specific value stored in the DHT.         // Retrieves the value associated with the key from the DHT
     std::string find_value(const std::string& key) const;
+    std::string get_stored(const std::string& key) const; // Returns the value as it is kept in memory (possibly compressed)
     int remove(const std::string& key); // Remove a key-value pair from the DHT
     //---------------------------------------------------
+    // Key summaries (Bloom filters) exchanged with neighbours to avoid get requests to nodes that certainly lack a key
+    std::vector<uint8_t> get_key_filter(); // Returns the summary of this node's keys to be published to other nodes
+    void set_key_filter(const std::vector<uint8_t>& bytes); // Updates the summary published by an external node
+    void add_to_key_filter(const std::string& key); // Records a key that an external node is known to have just stored
+    bool may_have_key(const std::string& key) const; // Returns false only if the node's (fresh) summary rules the key out
+    // Negative cache of keys that recently could not be found on any node
+    bool is_known_missing(const std::string& key);
+    void set_known_missing(const std::string& key);
+    //---------------------------------------------------
+    // Caching of popular values along the lookup path (values expire sooner the farther this node is from the key)
+    void cache(const std::string& key, const std::string& value);
+    std::string get_cached(const std::string& key); // Returns an empty string if the value is not cached
+    //---------------------------------------------------
+    // Tokens that prove a peer received a get_peers response at its address before it may announce_peer
+    std::string get_token(const std::string& address);
+    bool verify_token(const std::string& address, const std::string& token);
+    //---------------------------------------------------
     // DHT-based indexing (Inverted indexing)
     void map(const std::string& key, const std::string& value); // Maps search terms to keys
     //---------------------------------------------------
@@ -121,7 +203,12 @@ public:
     std::string get_device_ip_address() const;
     std::string get_public_ip_address() const;
     uint16_t get_port() const;
+    int get_socket() const;
     RoutingTable * get_routing_table() const;
+    ValueCache * get_value_cache() const;
+    PathCache * get_path_cache() const;
+    AdmissionControl * get_admission_control() const;
+    EventPublisher * get_event_publisher() const;
     int get_peer_count() const;
     int get_active_peer_count() const;
     int get_idle_peer_count() const;
@@ -129,13 +216,19 @@ public:
     std::string get_status_as_string() const;
     std::vector<std::string> get_keys() const;
     std::vector<std::pair<std::string, std::string>> get_data() const;
+    ValueVersion get_version(const std::string& key) const;
+    ValueVersion get_next_version(); // Advances the Lamport clock and returns a version for a new local update
+    int get_protocol_version() const;
+    uint32_t get_capabilities() const;
     ////Server * get_server() const;
     
     void set_bootstrap(bool bootstrap);
+    void set_capabilities(int protocol_version, uint32_t capabilities); // Records the features that an external node advertised
     
     bool is_bootstrap_node() const;
     static bool is_hardcoded(const std::string& address, uint16_t port);
     bool has_key(const std::string& key) const;
+    bool has_capability(msgpack::Capability capability) const; // Whether an external node advertised support for a protocol feature
     bool has_value(const std::string& value) const;
     bool is_dead() const;
 };
@@ -0,0 +1,114 @@
+#include "path_cache.hpp"
+
+#include <algorithm> // std::max
+
+neroshop::PathCache::PathCache(std::size_t max_entries, std::chrono::seconds ttl) : max_entries(max_entries), ttl(ttl), total_hits(0), total_misses(0), hit_lookups(0), hit_hops(0), miss_lookups(0), miss_hops(0) {}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::PathCache::put(const std::string& key, const std::vector<PathContact>& contacts) {
+    if(contacts.empty() || max_entries == 0) return;
+    
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = entries.find(key);
+    if(it != entries.end()) {
+        erase(it);
+    }
+    
+    // Evict the least recently used keys until the new key fits
+    while(!lru.empty() && entries.size() >= max_entries) {
+        erase(entries.find(lru.back()));
+    }
+    
+    lru.push_front(key);
+    std::vector<PathContact> bounded_contacts(contacts.begin(), contacts.begin() + std::min<std::size_t>(contacts.size(), NEROSHOP_DHT_LOOKUP_CONCURRENCY));
+    entries[key] = { std::move(bounded_contacts), std::chrono::steady_clock::now() + ttl, lru.begin() };
+}
+
+std::vector<neroshop::PathContact> neroshop::PathCache::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = entries.find(key);
+    if(it != entries.end() && std::chrono::steady_clock::now() >= it->second.expiration) {
+        erase(it); // Expired
+        it = entries.end();
+    }
+    if(it == entries.end()) {
+        total_misses++;
+        return {};
+    }
+    
+    total_hits++;
+    lru.splice(lru.begin(), lru, it->second.lru_position); // Move to front
+    return it->second.contacts;
+}
+
+void neroshop::PathCache::remove(const std::string& key) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = entries.find(key);
+    if(it != entries.end()) {
+        erase(it);
+    }
+}
+
+void neroshop::PathCache::clear() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    entries.clear();
+    lru.clear();
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::PathCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+    lru.erase(it->second.lru_position);
+    entries.erase(it);
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::PathCache::record_lookup(bool was_seeded, int hops) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if(was_seeded) {
+        hit_lookups++;
+        hit_hops += hops;
+    } else {
+        miss_lookups++;
+        miss_hops += hops;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+std::size_t neroshop::PathCache::get_size() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return entries.size();
+}
+
+uint64_t neroshop::PathCache::get_hits() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return total_hits;
+}
+
+uint64_t neroshop::PathCache::get_misses() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return total_misses;
+}
+
+double neroshop::PathCache::get_hit_rate() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return (total_hits + total_misses) > 0 ? static_cast<double>(total_hits) / (total_hits + total_misses) : 0.0;
+}
+
+double neroshop::PathCache::get_mean_hops(bool was_seeded) const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    uint64_t lookups = (was_seeded) ? hit_lookups : miss_lookups;
+    uint64_t hops = (was_seeded) ? hit_hops : miss_hops;
+    return (lookups > 0) ? static_cast<double>(hops) / lookups : 0.0;
+}
+
+double neroshop::PathCache::get_hops_saved() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if(hit_lookups == 0 || miss_lookups == 0) return 0.0;
+    // Seeded lookups are compared against the lookups that had to start from the routing table
+    double mean_miss_hops = static_cast<double>(miss_hops) / miss_lookups;
+    return std::max(0.0, mean_miss_hops * hit_lookups - static_cast<double>(hit_hops));
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+struct PathContact {
+    std::string id;
+    std::string ip_address;
+    uint16_t port;
+};
+
+// Remembers which nodes last returned the value of a key so that a repeated lookup can ask them first
+// instead of walking towards the key from the routing table again. The number of keys is bounded and
+// the least recently used keys are evicted first
+class PathCache {
+private:
+    struct Entry {
+        std::vector<PathContact> contacts;
+        std::chrono::steady_clock::time_point expiration;
+        std::list<std::string>::iterator lru_position;
+    };
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru; // Most recently used keys at the front
+    std::size_t max_entries;
+    std::chrono::seconds ttl;
+    uint64_t total_hits;
+    uint64_t total_misses;
+    uint64_t hit_lookups; // Lookups that were seeded from the cache
+    uint64_t hit_hops; // Rounds taken by the lookups that were seeded from the cache
+    uint64_t miss_lookups;
+    uint64_t miss_hops;
+    mutable std::mutex cache_mutex;
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+public:
+    PathCache(std::size_t max_entries = NEROSHOP_DHT_PATH_CACHE_SIZE, std::chrono::seconds ttl = std::chrono::seconds(NEROSHOP_DHT_PATH_CACHE_TTL));
+    
+    void put(const std::string& key, const std::vector<PathContact>& contacts);
+    std::vector<PathContact> get(const std::string& key); // Returns no contacts on a miss or if the entry has expired
+    void remove(const std::string& key); // Called when the value of a key changes or its cached contacts no longer have it
+    void clear();
+    
+    void record_lookup(bool was_seeded, int hops); // Records the number of rounds that a lookup took to find a value
+    
+    std::size_t get_size() const;
+    uint64_t get_hits() const;
+    uint64_t get_misses() const;
+    double get_hit_rate() const;
+    double get_mean_hops(bool was_seeded) const;
+    double get_hops_saved() const; // Estimated number of rounds that seeded lookups did not have to make
+};
+
+}
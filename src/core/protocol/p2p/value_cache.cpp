@@ -0,0 +1,152 @@
+#include "value_cache.hpp"
+
+#include <algorithm> // std::sort
+#include <cctype> // std::tolower
+
+neroshop::ValueCache::ValueCache(std::size_t max_bytes) : max_bytes(max_bytes), bytes(0), total_hits(0), total_misses(0) {}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::ValueCache::put(const std::string& key, const std::string& value, std::chrono::seconds ttl) {
+    std::size_t entry_size = key.size() + value.size();
+    if(entry_size > max_bytes) return; // Too large to ever fit
+    
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = entries.find(key);
+    if(it != entries.end()) {
+        erase(it);
+    }
+    
+    // Evict the least recently used values until the new value fits
+    while(!lru.empty() && (bytes + entry_size) > max_bytes) {
+        erase(entries.find(lru.back()));
+    }
+    
+    lru.push_front(key);
+    entries[key] = { value, std::chrono::steady_clock::now() + ttl, lru.begin() };
+    bytes += entry_size;
+}
+
+std::string neroshop::ValueCache::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto& key_stats = stats[key];
+    key_stats.key = key;
+    
+    auto it = entries.find(key);
+    if(it != entries.end() && std::chrono::steady_clock::now() >= it->second.expiration) {
+        erase(it); // Expired
+        it = entries.end();
+    }
+    if(it == entries.end()) {
+        key_stats.misses++;
+        total_misses++;
+        trim_stats();
+        return "";
+    }
+    
+    key_stats.hits++;
+    total_hits++;
+    lru.splice(lru.begin(), lru, it->second.lru_position); // Move to front
+    return it->second.value;
+}
+
+void neroshop::ValueCache::remove(const std::string& key) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = entries.find(key);
+    if(it != entries.end()) {
+        erase(it);
+    }
+}
+
+void neroshop::ValueCache::clear() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    entries.clear();
+    lru.clear();
+    stats.clear();
+    bytes = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::ValueCache::erase(std::unordered_map<std::string, Entry>::iterator it) {
+    bytes -= it->first.size() + it->second.value.size();
+    lru.erase(it->second.lru_position);
+    entries.erase(it);
+}
+
+void neroshop::ValueCache::trim_stats() {
+    // Misses for keys that are not cached would otherwise grow the stats without bound
+    if(stats.size() <= NEROSHOP_DHT_VALUE_CACHE_MAX_STATS) return;
+    for (auto it = stats.begin(); it != stats.end();) {
+        it = (entries.count(it->first) == 0) ? stats.erase(it) : std::next(it);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+std::chrono::seconds neroshop::ValueCache::get_ttl(const std::string& node_id, const std::string& key) {
+    // Count the number of leading bits shared by the node id and the key (i.e. the leading zero bits of their XOR distance)
+    auto hex_to_int = [](char c) -> int { return (c >= '0' && c <= '9') ? (c - '0') : ((std::tolower(c) >= 'a' && std::tolower(c) <= 'f') ? (std::tolower(c) - 'a' + 10) : -1); };
+    int common_prefix_bits = 0;
+    for (std::size_t i = 0; i < std::min(node_id.size(), key.size()); ++i) {
+        int a = hex_to_int(node_id[i]), b = hex_to_int(key[i]);
+        if(a < 0 || b < 0) break;
+        int distance = a ^ b;
+        if(distance == 0) {
+            common_prefix_bits += 4;
+            continue;
+        }
+        while((distance & 0x8) == 0) {
+            common_prefix_bits++;
+            distance <<= 1;
+        }
+        break;
+    }
+    // Every halving of the XOR distance doubles the expiration time
+    long long ttl = static_cast<long long>(NEROSHOP_DHT_VALUE_CACHE_MIN_TTL) << std::min(common_prefix_bits, 16);
+    return std::chrono::seconds(std::min(ttl, static_cast<long long>(NEROSHOP_DHT_VALUE_CACHE_MAX_TTL)));
+}
+
+//-----------------------------------------------------------------------------
+
+std::size_t neroshop::ValueCache::get_size() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return entries.size();
+}
+
+std::size_t neroshop::ValueCache::get_byte_count() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return bytes;
+}
+
+uint64_t neroshop::ValueCache::get_hits() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return total_hits;
+}
+
+uint64_t neroshop::ValueCache::get_misses() const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return total_misses;
+}
+
+neroshop::CacheStats neroshop::ValueCache::get_stats(const std::string& key) const {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = stats.find(key);
+    if(it == stats.end()) return { key, 0, 0 };
+    return it->second;
+}
+
+std::vector<neroshop::CacheStats> neroshop::ValueCache::get_hottest_keys(std::size_t count) const {
+    std::vector<CacheStats> hottest_keys;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        for (const auto& pair : stats) {
+            if(pair.second.hits > 0) hottest_keys.push_back(pair.second);
+        }
+    }
+    std::sort(hottest_keys.begin(), hottest_keys.end(), [](const CacheStats& a, const CacheStats& b) {
+        return a.hits > b.hits;
+    });
+    if(hottest_keys.size() > count) hottest_keys.resize(count);
+    return hottest_keys;
+}
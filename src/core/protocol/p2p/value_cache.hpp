@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+struct CacheStats {
+    std::string key;
+    uint64_t hits;
+    uint64_t misses;
+    double get_hit_rate() const { return (hits + misses) > 0 ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+};
+
+// Caches values of popular keys that this node does not store itself (Kademlia-style caching along the lookup path).
+// Memory usage is bounded and the least recently used values are evicted first
+class ValueCache {
+private:
+    struct Entry {
+        std::string value;
+        std::chrono::steady_clock::time_point expiration;
+        std::list<std::string>::iterator lru_position;
+    };
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> lru; // Most recently used keys at the front
+    std::unordered_map<std::string, CacheStats> stats; // Per-key hits and misses
+    std::size_t max_bytes;
+    std::size_t bytes;
+    uint64_t total_hits;
+    uint64_t total_misses;
+    mutable std::mutex cache_mutex;
+    void erase(std::unordered_map<std::string, Entry>::iterator it);
+    void trim_stats();
+public:
+    ValueCache(std::size_t max_bytes = NEROSHOP_DHT_VALUE_CACHE_SIZE);
+    
+    void put(const std::string& key, const std::string& value, std::chrono::seconds ttl);
+    std::string get(const std::string& key); // Returns an empty string on a miss or if the cached value has expired
+    void remove(const std::string& key);
+    void clear();
+    
+    static std::chrono::seconds get_ttl(const std::string& node_id, const std::string& key); // The closer this node is to the key, the longer a value is cached
+    
+    std::size_t get_size() const;
+    std::size_t get_byte_count() const;
+    uint64_t get_hits() const;
+    uint64_t get_misses() const;
+    CacheStats get_stats(const std::string& key) const;
+    std::vector<CacheStats> get_hottest_keys(std::size_t count) const; // Keys sorted by number of hits
+};
+
+}
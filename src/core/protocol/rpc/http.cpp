@@ -0,0 +1,174 @@
+#include "http.hpp"
+
+#include "json_rpc.hpp"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace {
+
+bool equals_ignore_case(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+bool is_http_1_1(std::string_view request) {
+    std::string_view request_line = request.substr(0, request.find("\r\n"));
+    return request_line.size() >= 8 && request_line.substr(request_line.size() - 8) == "HTTP/1.1";
+}
+
+std::string get_http_response(int status, const std::string& reason, const std::string& body) {
+    std::stringstream http_response;
+    http_response << "HTTP/1.1 " << status << " " << reason << "\r\n";
+    if(!body.empty()) {
+        http_response << "Content-Type: application/json\r\n";
+        http_response << "Content-Length: " << body.length() << "\r\n";
+    }
+    http_response << "\r\n";
+    http_response << body;
+    return http_response.str();
+}
+
+std::string get_chunk(const std::string& data) {
+    std::stringstream chunk;
+    chunk << std::hex << data.length() << "\r\n" << data << "\r\n";
+    return chunk.str();
+}
+
+}
+
+//-----------------------------------------------------------------------------
+
+std::size_t neroshop::rpc::http::get_request_size(std::string_view data, std::size_t max_size) {
+    const std::size_t headers_end = data.find("\r\n\r\n");
+    if(headers_end == std::string_view::npos) {
+        return (data.size() > max_size) ? std::string::npos : 0;
+    }
+    const std::size_t body_start = headers_end + 4;
+    // Only Content-Length delimits the body. Without it the request has none
+    std::size_t content_length = 0;
+    std::size_t line_start = data.find("\r\n") + 2; // Skips the request line
+    while(line_start < headers_end) {
+        std::size_t line_end = data.find("\r\n", line_start);
+        std::string_view line = data.substr(line_start, line_end - line_start);
+        std::size_t colon = line.find(':');
+        if(colon != std::string_view::npos && equals_ignore_case(line.substr(0, colon), "Content-Length")) {
+            std::string_view value = line.substr(colon + 1);
+            while(!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+            while(!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+            if(value.empty() || value.size() > 19 || !std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                return std::string::npos;
+            }
+            content_length = std::stoull(std::string(value));
+        }
+        line_start = line_end + 2;
+    }
+    if(content_length > max_size || body_start + content_length > max_size) return std::string::npos;
+    if(data.size() < body_start + content_length) return 0;
+    return body_start + content_length;
+}
+
+std::string neroshop::rpc::http::get_body(std::string_view request) {
+    const std::size_t headers_end = request.find("\r\n\r\n");
+    if(headers_end == std::string_view::npos) return "";
+    return std::string(request.substr(headers_end + 4));
+}
+
+bool neroshop::rpc::http::is_keep_alive(std::string_view request) {
+    const std::size_t headers_end = request.find("\r\n\r\n");
+    if(headers_end == std::string_view::npos || !is_http_1_1(request)) return false;
+    std::size_t line_start = request.find("\r\n") + 2;
+    while(line_start < headers_end) {
+        std::size_t line_end = request.find("\r\n", line_start);
+        std::string_view line = request.substr(line_start, line_end - line_start);
+        std::size_t colon = line.find(':');
+        if(colon != std::string_view::npos && equals_ignore_case(line.substr(0, colon), "Connection")) {
+            // A comma-separated list of options, e.g. "Upgrade, close"
+            std::string_view options = line.substr(colon + 1);
+            while(!options.empty()) {
+                std::size_t comma = options.find(',');
+                std::string_view option = options.substr(0, comma);
+                while(!option.empty() && (option.front() == ' ' || option.front() == '\t')) option.remove_prefix(1);
+                while(!option.empty() && (option.back() == ' ' || option.back() == '\t')) option.remove_suffix(1);
+                if(equals_ignore_case(option, "close")) return false;
+                options = (comma == std::string_view::npos) ? std::string_view() : options.substr(comma + 1);
+            }
+        }
+        line_start = line_end + 2;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::rpc::http::respond(std::string_view request, const std::function<void(std::string data)>& write) {
+    // Extract JSON payload from request
+    const std::string json_payload = get_body(request);
+    // Batch: the length of the body is not known until the last call completes, so HTTP/1.1 clients get it in chunks
+    const bool chunked = is_http_1_1(request);
+    std::string batch_response;
+    bool is_batch = false;
+    try {
+        is_batch = neroshop::rpc::json::process_batch(json_payload, [&](const std::string& response) {
+            if(!chunked) {
+                batch_response += (batch_response.empty() ? "[" : ",") + response;
+                return;
+            }
+            if(batch_response.empty()) {
+                batch_response = "["; // Only marks that the headers and the opening bracket were sent
+                write("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n" + get_chunk("[" + response));
+                return;
+            }
+            write(get_chunk("," + response));
+        });
+    } catch(const std::exception& e) {
+        if(batch_response.empty()) {
+            write(respond_error(500, "Internal Server Error", -32603, "Internal error"));
+            return;
+        }
+        is_batch = true; // The responses that were sent are closed off
+    }
+    if(is_batch) {
+        if(batch_response.empty()) write(get_http_response(204, "No Content", "")); // Notifications only
+        else if(chunked) write(get_chunk("]") + "0\r\n\r\n");
+        else write(get_http_response(200, "OK", batch_response + "]"));
+        return;
+    }
+    if(!neroshop::rpc::is_json_rpc(json_payload)) {
+        write(respond_error(400, "Bad Request", -32600, "Invalid Request"));
+        return;
+    }
+    // Process JSON-RPC request
+    std::string response_object;
+    try {
+        response_object = neroshop::rpc::json::process(json_payload);
+    } catch(const std::exception& e) {
+        write(respond_error(500, "Internal Server Error", -32603, "Internal error"));
+        return;
+    }
+    if(response_object.empty()) { // Notification
+        write(get_http_response(204, "No Content", ""));
+        return;
+    }
+    write(get_http_response(200, "OK", response_object));
+}
+
+std::string neroshop::rpc::http::respond(std::string_view request) {
+    std::string http_response;
+    respond(request, [&http_response](std::string data) { http_response += data; });
+    return http_response;
+}
+
+std::string neroshop::rpc::http::respond_error(int status, const std::string& reason, int code, const std::string& message) {
+    nlohmann::json error_obj;
+    error_obj["jsonrpc"] = "2.0";
+    error_obj["error"] = {};
+    error_obj["error"]["code"] = code;
+    error_obj["error"]["message"] = message;//error_obj["error"]["data"] = "Additional error information"; // may be ommited
+    error_obj["id"] = nullptr;
+    return get_http_response(status, reason, error_obj.dump());
+}
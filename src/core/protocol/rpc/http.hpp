@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+namespace rpc {
+
+// HTTP framing of the JSON-RPC server. Requests are POSTs whose body is a JSON-RPC request object
+namespace http {
+    // Returns the size of the first request in data (headers and body), 0 if it has not fully arrived yet,
+    // or std::string::npos if it is malformed or larger than max_size
+    std::size_t get_request_size(std::string_view data, std::size_t max_size = NEROSHOP_RPC_MAX_REQUEST_SIZE);
+    std::string get_body(std::string_view request); // The part after the headers
+    // Whether the connection stays open for more requests: HTTP/1.1 unless the client sent "Connection: close". HTTP/1.0 connections are closed
+    // after the response, since the responses do not carry the "Connection: keep-alive" that those clients would wait for
+    bool is_keep_alive(std::string_view request);
+    // Processes the JSON-RPC request or batch and passes the HTTP response to write. The responses of a batch are written as chunks as soon as
+    // their calls complete (HTTP/1.1 clients only; the others get the whole batch at once). A batch or a notification that has nothing to
+    // send back is answered with 204 No Content
+    void respond(std::string_view request, const std::function<void(std::string data)>& write);
+    std::string respond(std::string_view request); // Same as above, but returns the whole HTTP response
+    std::string respond_error(int status, const std::string& reason, int code, const std::string& message); // HTTP response carrying a JSON-RPC error
+} // namespace http
+
+} // namespace rpc
+
+}
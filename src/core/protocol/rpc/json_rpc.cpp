@@ -2,18 +2,21 @@
 
 #include "../../database/database.hpp"
 #include "../../tools/logger.hpp"
+#include "../../../neroshop_config.hpp"
 
 #if defined(NEROSHOP_USE_QT)
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonParseError>
-#else
-#include <nlohmann/json.hpp>
 #endif
+#include <nlohmann/json.hpp> // Batches are split with it in either case
 
 #include <random>
 #include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
 // uncomment to disable assert()
 // #define NDEBUG
 #include <cassert>
@@ -94,6 +97,12 @@ std::string neroshop::rpc::json::translate(const std::string& sql, const std::ve
 //----------------------------------------------------------------
 //----------------------------------------------------------------
 std::string neroshop::rpc::json::process(const std::string& request) {
+    std::string batch_response;
+    if(process_batch(request, [&batch_response](const std::string& response) {
+        batch_response += (batch_response.empty() ? "[" : ",") + response;
+    })) {
+        return batch_response.empty() ? "" : batch_response + "]"; // Nothing at all if the batch only had notifications
+    }
     neroshop::db::Sqlite3 * database = neroshop::get_database();
     if(!database) throw std::runtime_error("database is NULL");
     std::string response = "";
@@ -177,12 +186,9 @@ std::string neroshop::rpc::json::process(const std::string& request) {
     assert(method.isString());
     QJsonValue params = request_object.value("params"); // "params" MAY be omitted
     QJsonValue id = request_object.value("id");
-    if(id.isUndefined()) {
-        // a request object without an "id" member is assumed to be NOTIFICATION ...
-        // a Notification signifies the Client's lack of interest in the corresponding Response object, and as such no Response object needs to be returned to the client. The Server MUST NOT reply to a Notification, including those that are within a batch request.
-        // exit function, with an empty string object perhaps
-        //return "";
-    }
+    // a request object without an "id" member is assumed to be NOTIFICATION ...
+    // a Notification signifies the Client's lack of interest in the corresponding Response object, and as such no Response object needs to be returned to the client. The Server MUST NOT reply to a Notification, including those that are within a batch request.
+    const bool is_notification = id.isUndefined();
     // Execute the request (run function and get return value)
     int code = 0;
     if(method.toString() == "query") { 
@@ -214,6 +220,7 @@ std::string neroshop::rpc::json::process(const std::string& request) {
         ////if(params.isArray()) {//if(params.isObject()) {//if(params.isUndefined()) {}
     }
     //-------------------------------------------------------
+    if(is_notification) return ""; // Executed, but nobody is waiting for the result
     // After execution, get the result or error, if any and then return it as a JSON-RPC response message
     response_object.insert(QString("jsonrpc"), jsonrpc_version);
     // result
@@ -290,17 +297,19 @@ std::string neroshop::rpc::json::process(const std::string& request) {
     #ifdef NEROSHOP_DEBUG
     std::cout << /*"Request received:\n" << */"\033[33m" << request_object.dump() << "\033[0m\n";
     #endif
-    assert(request_object.is_object());
-    assert(request_object["jsonrpc"].is_string());
-    std::string jsonrpc_version = request_object["jsonrpc"];
-    assert(jsonrpc_version == "2.0");
-    assert(request_object["method"].is_string());
+    // Anything that is not a request object (e.g. an empty batch) is a single Invalid Request error
+    if(!request_object.is_object() || !request_object.contains("jsonrpc") || request_object["jsonrpc"] != "2.0"
+        || !request_object.contains("method") || !request_object["method"].is_string()) {
+        response_object["jsonrpc"] = "2.0";
+        response_object["error"]["code"] = -32600;
+        response_object["error"]["message"] = "Invalid Request";
+        response_object["id"] = nullptr;
+        return response_object.dump(4);
+    }
     std::string method = request_object["method"];
     // "params" MAY be omitted
-    if(!request_object.contains("id")) {
-        std::cout << "No id found, hence a notification that will not receive a response from the server\n";return "";
-    }
-    auto id = request_object["id"]; // could either a string, integer or null
+    const bool is_notification = !request_object.contains("id"); // Executed, but does not receive a response from the server
+    auto id = is_notification ? nlohmann::json(nullptr) : request_object["id"]; // could either a string, integer or null
     int code = 0;
     if(method == "query") {
         assert(request_object["params"].is_object());
@@ -328,8 +337,9 @@ std::string neroshop::rpc::json::process(const std::string& request) {
     //if(method == "") {
     //}
     //-------------------------------------------------------
+    if(is_notification) return "";
     // After execution, get the result or error, if any and then return it as a JSON-RPC response message
-    response_object["jsonrpc"] = jsonrpc_version;
+    response_object["jsonrpc"] = "2.0";
     // result
     if(code == 0) {
         if(method == "query") {
@@ -382,6 +392,91 @@ std::string neroshop::rpc::json::process(const std::string& request) {
     return response;
 }
 //----------------------------------------------------------------
+namespace {
+
+bool is_request_object(const nlohmann::json& call) {
+    return call.is_object() && call.contains("jsonrpc") && call["jsonrpc"].is_string() && call["jsonrpc"].get<std::string>() == "2.0"
+        && call.contains("method") && call["method"].is_string();
+}
+
+// Only reads, so it can run alongside the other calls that only read. SQLite decides whether the statement writes,
+// and since execute() runs every statement in the string, a call with more than one statement is never read-only
+bool is_read_only(const nlohmann::json& call) {
+    if(!is_request_object(call) || call["method"] != "query") return false;
+    if(!call.contains("params") || !call["params"].is_object()) return false;
+    const nlohmann::json& params = call["params"];
+    if(!params.contains("sql") || !params["sql"].is_string() || params.contains("count")) return false;
+    const std::string& sql = params["sql"].get_ref<const std::string&>();
+    sqlite3_stmt * stmt = nullptr;
+    const char * tail = nullptr;
+    if(sqlite3_prepare_v2(neroshop::get_database()->get_handle(), sql.c_str(), -1, &stmt, &tail) != SQLITE_OK || stmt == nullptr) {
+        sqlite3_finalize(stmt);
+        return false;
+    }
+    bool read_only = (sqlite3_stmt_readonly(stmt) != 0);
+    sqlite3_finalize(stmt);
+    return read_only && std::string(tail).find_first_not_of(" \t\r\n;") == std::string::npos;
+}
+
+std::string make_error(int code, const std::string& message, const nlohmann::json& id) {
+    nlohmann::json response_object;
+    response_object["jsonrpc"] = "2.0";
+    response_object["error"]["code"] = code;
+    response_object["error"]["message"] = message;
+    response_object["id"] = id;
+    return response_object.dump();
+}
+
+}
+//----------------------------------------------------------------
+bool neroshop::rpc::json::process_batch(const std::string& request, const std::function<void(const std::string& response)>& on_response) {
+    // Anything but an array is left to process() without being parsed here
+    std::size_t start = request.find_first_not_of(" \t\r\n");
+    if(start == std::string::npos || request[start] != '[') return false;
+    nlohmann::json batch = nlohmann::json::parse(request, nullptr, false);
+    if(!batch.is_array() || batch.empty()) return false;
+    if(batch.size() > NEROSHOP_RPC_MAX_BATCH_SIZE) {
+        on_response(make_error(-32600, "Invalid Request", nullptr));
+        return true;
+    }
+    std::mutex response_mutex; // on_response is called by one call at a time
+    auto run = [&](const nlohmann::json& call) {
+        std::string response;
+        if(!is_request_object(call)) {
+            response = make_error(-32600, "Invalid Request", nullptr); // Each element that is not a request gets its own error
+        } else {
+            try {
+                response = process(call.dump());
+            } catch(const std::exception& e) {
+                response = make_error(-32603, "Internal error", call.contains("id") ? call["id"] : nlohmann::json(nullptr));
+            }
+        }
+        if(response.empty()) return; // Notification
+        std::lock_guard<std::mutex> lock(response_mutex);
+        on_response(response);
+    };
+    std::size_t index = 0;
+    while(index < batch.size()) {
+        if(!is_read_only(batch[index])) {
+            run(batch[index++]);
+            continue;
+        }
+        // A run of reads is shared by a few threads that each take the next call until none is left
+        std::size_t end = index;
+        while(end < batch.size() && is_read_only(batch[end])) end++;
+        std::atomic<std::size_t> next(index);
+        std::vector<std::future<void>> runners;
+        for(std::size_t i = 0; i < std::min<std::size_t>(NEROSHOP_RPC_BATCH_CONCURRENCY, end - index); i++) {
+            runners.push_back(std::async(std::launch::async, [&]() {
+                for(std::size_t call = next++; call < end; call = next++) run(batch[call]);
+            }));
+        }
+        for(auto& runner : runners) runner.get();
+        index = end;
+    }
+    return true;
+}
+//----------------------------------------------------------------
 //----------------------------------------------------------------
 void neroshop::rpc::json::request(const std::string& json) { // TODO: this function should return a json_rpc response (string) from the server
     // Get the json which is basically a translated sqlite query or a translated c++ function name (string) + args
@@ -40,7 +40,11 @@ namespace json {
         ////methods["eat"](std::forward<Args>(args)...);
         return nullptr; // TEMPORARY
     }
-    extern std::string process(const std::string& request); // (server) processes a request from the client
+    extern std::string process(const std::string& request); // (server) processes a request or a batch from the client. Returns "" if nothing is to be sent back (notifications)
+    // (server) runs the calls of a batch (a JSON array of requests) and passes each response to on_response as soon as its call completes, so the
+    // responses come in no particular order. Queries of a single statement that SQLite reports as read-only run concurrently, while any other call
+    // waits for the calls before it and holds up the calls after it. Notifications get no response. Returns false, without calling on_response, if request is not a non-empty array
+    extern bool process_batch(const std::string& request, const std::function<void(const std::string& response)>& on_response);
     extern void request(const std::string& json); // for client - to send requests
     extern void request_batch(const std::vector<std::string>& json_batch); // sends a batch of json_rpc requests to the server and expects a batch of json_rpc responses
     extern void respond(const std::string& json); // for server - to respond to requests
@@ -3,10 +3,12 @@
 #include "../../tools/logger.hpp"
 #include "../../version.hpp" // NEROSHOP_DHT_VERSION
 
+#include <sys/un.h> // sockaddr_un
+
+#include <algorithm> // std::find, std::remove
 #include <cstring> // memset
 #include <cassert>
-
-#include <nlohmann/json.hpp>
+#include <chrono>
 
 neroshop::Client::Client() : sockfd(-1), socket_type(SocketType::Socket_TCP) {
     create();
@@ -18,6 +20,7 @@ neroshop::Client::Client(int sockfd, struct sockaddr_in client_addr) {
 }
 ////////////////////
 neroshop::Client::~Client() {
+    stop_receiving();
     if(sockfd > 0) {
         shutdown();
         close();
@@ -28,7 +31,7 @@ neroshop::Client::~Client() {
 void neroshop::Client::create() {
     #if defined(__gnu_linux__) && defined(NEROSHOP_USE_SYSTEM_SOCKETS)
     if(sockfd > 0) return; // socket must be -1 before a new one can be created (if socket is not null then it means it was never closed)
-	sockfd = ::socket(AF_INET, (socket_type == SocketType::Socket_UDP) ? SOCK_DGRAM : SOCK_STREAM, 0);
+	sockfd = ::socket((socket_type == SocketType::Socket_Unix) ? AF_UNIX : AF_INET, (socket_type == SocketType::Socket_UDP) ? SOCK_DGRAM : SOCK_STREAM, 0);
 	if(sockfd < 0) {
 		neroshop::print("::socket: failed to create a socket", 1);
 	}    
@@ -49,6 +52,12 @@ void neroshop::Client::create() {
 }
 ////////////////////
 bool neroshop::Client::connect(unsigned int port, std::string address) {
+    if (socket_type == SocketType::Socket_Unix || socket_type == SocketType::Socket_Zmq) { // Switch back from a Unix domain socket or ZeroMQ
+        close();
+        sockfd = -1;
+        socket_type = SocketType::Socket_TCP;
+        create();
+    }
     // Clear the address structure
     memset(&this->addr, 0, sizeof(this->addr));
     
@@ -71,6 +80,10 @@ bool neroshop::Client::connect(unsigned int port, std::string address) {
             continue;
         }
         freeaddrinfo(result);
+        if (socket_type == SocketType::Socket_TCP) { // Responses are read on a separate thread so that requests can be pipelined
+            start_receiving();
+            resubscribe();
+        }
         return true;  // Return true immediately after a successful connection
     }
 
@@ -104,6 +117,68 @@ bool neroshop::Client::connect(unsigned int port, std::string address) {
     return false;*/
 }
 ////////////////////
+bool neroshop::Client::connect_unix(const std::string& path, bool use_shared_memory) {
+    struct sockaddr_un unix_addr = {};
+    if (path.size() >= sizeof(unix_addr.sun_path)) {
+        std::cerr << "Unix socket path is too long: " << path << std::endl;
+        return false;
+    }
+    if (socket_type != SocketType::Socket_Unix) {
+        close();
+        sockfd = -1;
+        socket_type = SocketType::Socket_Unix;
+        create();
+    }
+    unix_addr.sun_family = AF_UNIX;
+    std::memcpy(unix_addr.sun_path, path.c_str(), path.size());
+    if (::connect(sockfd, (struct sockaddr*)&unix_addr, sizeof(unix_addr)) < 0) {
+        perror("connect failed");
+        return false;
+    }
+    // The first frame tells the daemon whether to pass large responses through shared memory. The ring is created here and its
+    // descriptor is handed over with the frame, so the daemon never has to open anything in the file system on our behalf
+    ring.reset();
+    if (use_shared_memory) {
+        ring = ShmRing::create(NEROSHOP_IPC_SHM_RING_SIZE);
+        if (!ring) std::cerr << "Shared memory is unavailable. Falling back to the Unix socket alone" << std::endl;
+    }
+    if (!framing::send_frame_with_fd(sockfd, { framing::HANDSHAKE }, (ring) ? ring->get_fd() : -1)) {
+        ring.reset();
+        return false;
+    }
+    start_receiving();
+    resubscribe();
+    return true;
+}
+////////////////////
+#if defined(NEROSHOP_USE_LIBZMQ)
+bool neroshop::Client::connect_zmq(const std::string& endpoint, void * context) {
+    close(); // Stops receiving on the previous transport
+    sockfd = -1;
+    socket_type = SocketType::Socket_Zmq;
+    try {
+        zmq_client = std::make_unique<ZmqClient>(context);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return false;
+    }
+    if (!zmq_client->connect(endpoint)) {
+        zmq_client.reset();
+        return false;
+    }
+    start_receiving();
+    // ZeroMQ connects in the background and succeeds even if nothing is listening, so a ping tells whether the daemon is there
+    std::future<Response> ping = request("ping", nlohmann::json::object());
+    if (ping.wait_for(std::chrono::seconds(2)) != std::future_status::ready || ping.get().get_status() == Response::Status::NoResponse) {
+        std::cerr << "No daemon is listening on " << endpoint << std::endl;
+        close();
+        return false;
+    }
+    resubscribe();
+    return true;
+}
+#endif
+////////////////////
 void neroshop::Client::write(const std::string& text) {
     #if defined(__gnu_linux__) && defined(NEROSHOP_USE_SYSTEM_SOCKETS)
 	ssize_t write_result = ::write(sockfd, text.c_str(), text.length());
@@ -128,12 +203,16 @@ std::string neroshop::Client::read()
 }
 ////////////////////
 void neroshop::Client::send(const std::vector<uint8_t>& message) {
-    assert(socket_type == SocketType::Socket_TCP && "Socket is not TCP");
-    // ::send - instead of sending to a specific destination like sendto, send on SOCK_STREAM (TCP) socket sends the data to the connected socket, and returns the number of bytes sent.
-    ssize_t sent_bytes = ::send(sockfd, message.data(), message.size(), 0);
-    if (sent_bytes < 0) {
-        perror("send");
+    assert(socket_type != SocketType::Socket_UDP && "Socket is not TCP");
+    #if defined(NEROSHOP_USE_LIBZMQ)
+    if (zmq_client) { // Each message is one request, so no framing is needed
+        zmq_client->send(message);
+        return;
     }
+    #endif
+    // ::send - instead of sending to a specific destination like sendto, send on SOCK_STREAM (TCP) socket sends the data to the connected socket, and returns the number of bytes sent.
+    // The message goes out as a length-prefixed frame so that the server knows where it ends
+    framing::send_frame(sockfd, message);
 }
 ////////////////////
 void neroshop::Client::send_to(const std::vector<uint8_t>& message, const struct sockaddr_in& dest_addr) {
@@ -146,36 +225,13 @@ void neroshop::Client::send_to(const std::vector<uint8_t>& message, const struct
 }
 ////////////////////
 ssize_t neroshop::Client::receive(std::vector<uint8_t>& message) {
-    assert(socket_type == SocketType::Socket_TCP && "Socket is not TCP");
-
-    const int BUFFER_SIZE = 4096;
-
-    std::vector<uint8_t> buffer(BUFFER_SIZE);
-    message.clear(); // clear the message vector before receiving new data
-    // keep reading from the socket until the entire message is received
-    size_t total_recv = 0;
-    while (true) {
-        ssize_t recv_bytes = ::recv(sockfd, buffer.data() + total_recv, BUFFER_SIZE - total_recv, 0);
-        if (recv_bytes == -1) {
-            perror("recv");
-            return recv_bytes;
-        }
-        if (recv_bytes == 0) {
-            break; // connection closed by server
-        }
-        total_recv += recv_bytes;
-        if (total_recv == BUFFER_SIZE) {
-            message.insert(message.end(), buffer.begin(), buffer.end());
-            total_recv = 0;
-        }
-        if (total_recv >= message.size()) {
-            break; // entire message received
-        }
-    }
-    if (total_recv > 0) {
-        message.insert(message.end(), buffer.begin(), buffer.begin() + total_recv);
+    assert(socket_type != SocketType::Socket_UDP && "Socket is not TCP");
+    // keep reading from the socket until the entire frame is received
+    ssize_t recv_bytes = framing::receive_frame(sockfd, frame_reader, message, ring.get());
+    if (recv_bytes == -1) {
+        perror("recv");
     }
-    return total_recv;
+    return recv_bytes;
 }
 ////////////////////
 ssize_t neroshop::Client::receive_from(std::vector<uint8_t>& message, const struct sockaddr_in& addr) {
@@ -197,70 +253,281 @@ ssize_t neroshop::Client::receive_from(std::vector<uint8_t>& message, const stru
     return recv_bytes;
 }
 ////////////////////
-void neroshop::Client::put(const std::string& key, const std::string& value, std::string& reply) {
-    // Send put - no id or tid required for IPC client requests. The DHT server will deal with that
-    nlohmann::json args_obj = { {"key", key}, {"value", value} };
-    nlohmann::json query_object = { {"version", std::string(NEROSHOP_DHT_VERSION)}, {"query", "put"}, {"args", args_obj}, {"tid", nullptr} };
-    std::vector<uint8_t> packed_data = nlohmann::json::to_msgpack(query_object);
+static thread_local const neroshop::Client * receiving_client = nullptr; // The client whose receive thread this is, if any
+
+std::future<neroshop::Response> neroshop::Client::request(const std::string& query, nlohmann::json args) {
+    return send_request(query, std::move(args)).second;
+}
+
+neroshop::Client::PendingRequest neroshop::Client::send_request(const std::string& query, nlohmann::json args) {
+    // No id required for IPC client requests. The DHT server will deal with that. The tid only has to be unique on this connection
+    uint64_t tid = next_tid++;
+    // The tid is written first so that the daemon can still read it, and answer with it, if the rest of the request does not parse
+    nlohmann::ordered_json query_object = { {"tid", tid}, {"version", std::string(NEROSHOP_DHT_VERSION)}, {"query", query}, {"args", std::move(args)} };
+    std::vector<uint8_t> packed_data = nlohmann::ordered_json::to_msgpack(query_object);
+    std::future<Response> future;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        std::promise<Response>& promise = pending[tid];
+        future = promise.get_future();
+        if(!receiving) { // Not connected, so there is no one to answer
+            promise.set_value(Response());
+            pending.erase(tid);
+            return { tid, std::move(future) };
+        }
+    }
+    std::lock_guard<std::mutex> lock(send_mutex);
     send(packed_data);
-    // Receive response
-    try {
-        std::vector<uint8_t> response;
-        receive(response);
-        try {
-            nlohmann::json response_object = nlohmann::json::from_msgpack(response);
-            reply = response_object.dump();//return response_object.dump();
-        } catch (const nlohmann::detail::parse_error& e) {
-            std::cerr << "Failed to parse server response: " << e.what() << std::endl;
+    return { tid, std::move(future) };
+}
+
+void neroshop::Client::set_event_handler(EventHandler event_handler) {
+    std::lock_guard<std::mutex> lock(event_mutex);
+    this->event_handler = std::move(event_handler);
+}
+
+std::future<neroshop::Response> neroshop::Client::subscribe(const nlohmann::json& args) {
+    {
+        std::lock_guard<std::mutex> lock(event_mutex);
+        if(std::find(subscriptions.begin(), subscriptions.end(), args) == subscriptions.end()) subscriptions.push_back(args); // The daemon merges repeated subscriptions
+    }
+    return request("subscribe", args);
+}
+
+std::future<neroshop::Response> neroshop::Client::unsubscribe(const nlohmann::json& args) {
+    {
+        std::lock_guard<std::mutex> lock(event_mutex);
+        if(!args.contains("topics") || !args["topics"].is_array()) {
+            subscriptions.clear(); // Nothing is left to make again
+        } else {
+            // Takes the same things out of the remembered subscriptions as the daemon does: only the keys if there are any, otherwise the topics
+            const std::string field = (args.contains("keys") && args["keys"].is_array()) ? "keys" : "topics";
+            for(auto it = subscriptions.begin(); it != subscriptions.end();) {
+                if(it->contains(field) && (*it)[field].is_array()) {
+                    nlohmann::json& values = (*it)[field];
+                    for(const auto& value : args[field]) values.erase(std::remove(values.begin(), values.end(), value), values.end());
+                }
+                if(!it->contains("topics") || (*it)["topics"].empty()) it = subscriptions.erase(it);
+                else ++it;
+            }
         }
-    } catch (const nlohmann::detail::parse_error& e) {
-        std::cerr << "An error occurred: " << "Node was disconnected" << std::endl;
     }
+    return request("unsubscribe", args);
+}
+
+void neroshop::Client::resubscribe() {
+    std::vector<nlohmann::json> requests;
+    {
+        std::lock_guard<std::mutex> lock(event_mutex);
+        requests = subscriptions;
+    }
+    for(const auto& args : requests) request("subscribe", args);
+}
+
+neroshop::Response neroshop::Client::wait(PendingRequest pending_request) {
+    auto& [tid, future] = pending_request;
+    // The response would have to be read by the thread that is waiting for it (e.g. a request made from the event handler)
+    bool is_receive_thread = (receiving_client == this);
+    if(is_receive_thread || future.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+        std::cerr << "An error occurred: " << ((is_receive_thread) ? "Cannot wait for a response on the receive thread" : "Node did not respond in time") << std::endl;
+        // Forget the request so that its promise does not stay in pending. A late response is then ignored
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        pending.erase(tid);
+        return Response();
+    }
+    return future.get();
+}
+////////////////////
+std::future<neroshop::Response> neroshop::Client::put_async(const std::string& key, const std::string& value) {
+    return request("put", { {"key", key}, {"value", value} });
+}
+
+std::future<neroshop::Response> neroshop::Client::get_async(const std::string& key) {
+    return request("get", { {"key", key} });
+}
+
+std::future<neroshop::Response> neroshop::Client::set_async(const std::string& key, const std::string& value, bool verified) {
+    return request("set", { {"key", key}, {"value", value}, {"verified", verified} });
+}
+
+std::future<neroshop::Response> neroshop::Client::get_many_async(const std::vector<std::string>& keys) {
+    return request("get_many", { {"keys", keys} });
+}
+
+static nlohmann::json get_put_many_data(const std::vector<std::pair<std::string, std::string>>& entries) {
+    nlohmann::json data = nlohmann::json::array();
+    for (const auto& entry : entries) {
+        data.push_back({ {"key", entry.first}, {"value", entry.second} });
+    }
+    return data;
+}
+
+std::future<neroshop::Response> neroshop::Client::put_many_async(const std::vector<std::pair<std::string, std::string>>& entries) {
+    return request("put_many", { {"data", get_put_many_data(entries)} });
+}
+////////////////////
+neroshop::Response neroshop::Client::put(const std::string& key, const std::string& value) {
+    return wait(send_request("put", { {"key", key}, {"value", value} }));
+}
+
+neroshop::Response neroshop::Client::get(const std::string& key) {
+    return wait(send_request("get", { {"key", key} }));
+}
+
+neroshop::Response neroshop::Client::set(const std::string& key, const std::string& value, bool verified) {
+    return wait(send_request("set", { {"key", key}, {"value", value}, {"verified", verified} }));
+}
+
+neroshop::Response neroshop::Client::get_many(const std::vector<std::string>& keys) {
+    return wait(send_request("get_many", { {"keys", keys} }));
+}
+
+neroshop::Response neroshop::Client::put_many(const std::vector<std::pair<std::string, std::string>>& entries) {
+    return wait(send_request("put_many", { {"data", get_put_many_data(entries)} }));
+}
+////////////////////
+void neroshop::Client::put(const std::string& key, const std::string& value, std::string& reply) {
+    Response response = put(key, value);
+    if(response.get_status() != Response::Status::NoResponse) reply = response.dump();
 }
 
 void neroshop::Client::get(const std::string& key, std::string& reply) {
-    // Send get - no id or tid required for IPC client requests. The DHT server will deal with that
-    nlohmann::json args_obj = { {"key", key} };
-    nlohmann::json query_object = { {"version", std::string(NEROSHOP_DHT_VERSION)}, {"query", "get"}, {"args", args_obj}, {"tid", nullptr} };
-    std::vector<uint8_t> packed_data = nlohmann::json::to_msgpack(query_object);
-    send(packed_data);
-    // Receive response
-    try {
-        std::vector<uint8_t> response;
-        receive(response);
-        try {
-            nlohmann::json response_object = nlohmann::json::from_msgpack(response);
-            reply = response_object.dump();//return response_object.dump();
-        } catch (const nlohmann::detail::parse_error& e) {
-            std::cerr << "Failed to parse server response: " << e.what() << std::endl;
-        }
-    } catch (const nlohmann::detail::parse_error& e) {
-        std::cerr << "An error occurred: " << "Node was disconnected" << std::endl;
-    }    
+    Response response = get(key);
+    if(response.get_status() != Response::Status::NoResponse) reply = response.dump();
 }
 
 void neroshop::Client::set(const std::string& key, const std::string& value, bool verified, std::string& reply) {
-    // Send set - no id or tid required for IPC client requests. The DHT server will deal with that
-    nlohmann::json args_obj = { {"key", key}, {"value", value}, {"verified", verified} };
-    nlohmann::json query_object = { {"version", std::string(NEROSHOP_DHT_VERSION)}, {"query", "set"}, {"args", args_obj}, {"tid", nullptr} };
-    std::vector<uint8_t> packed_data = nlohmann::json::to_msgpack(query_object);
-    send(packed_data);
-    // Receive response
-    try {
-        std::vector<uint8_t> response;
-        receive(response);
-        try {
-            nlohmann::json response_object = nlohmann::json::from_msgpack(response);
-            reply = response_object.dump();//return response_object.dump();
-        } catch (const nlohmann::detail::parse_error& e) {
-            std::cerr << "Failed to parse server response: " << e.what() << std::endl;
+    Response response = set(key, value, verified);
+    if(response.get_status() != Response::Status::NoResponse) reply = response.dump();
+}
+
+void neroshop::Client::get_many(const std::vector<std::string>& keys, std::string& reply) {
+    Response response = get_many(keys);
+    if(response.get_status() != Response::Status::NoResponse) reply = response.dump();
+}
+
+void neroshop::Client::put_many(const std::vector<std::pair<std::string, std::string>>& entries, std::string& reply) {
+    Response response = put_many(entries);
+    if(response.get_status() != Response::Status::NoResponse) reply = response.dump();
+}
+////////////////////
+void neroshop::Client::start_receiving() {
+    stop_receiving(); // In case of a reconnect
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        receiving = true;
+        echoes_tid = false; // The daemon may have been replaced by an older one
+    }
+    receive_thread = std::thread(&Client::receive_loop, this);
+}
+
+void neroshop::Client::stop_receiving() {
+    if(!receive_thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        receiving = false;
+    }
+    ::shutdown(sockfd, SHUT_RDWR); // Wakes up the receive thread if it is blocked in recv
+    #if defined(NEROSHOP_USE_LIBZMQ)
+    if(zmq_client) zmq_client->close();
+    #endif
+    if(receive_thread.get_id() == std::this_thread::get_id()) receive_thread.detach();
+    else receive_thread.join();
+}
+
+void neroshop::Client::receive_loop() {
+    receiving_client = this;
+    frame_reader.clear();
+    std::vector<uint8_t> frame;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex);
+            if(!receiving) break;
+        }
+        #if defined(NEROSHOP_USE_LIBZMQ)
+        if (zmq_client) {
+            ssize_t size = zmq_client->receive(frame, 1000);
+            if (size == 0) break; // Closed
+            if (size == -1) {
+                if (errno == EAGAIN || errno == EINTR) continue;
+                std::cerr << "zmq receive: " << zmq_strerror(errno) << std::endl;
+                break;
+            }
+            deliver(frame.data(), frame.size());
+            continue;
+        }
+        #endif
+        // A single read may hold several responses or only part of one. The frame reader keeps the remainder for the next call
+        ssize_t recv_bytes = framing::receive_frame(sockfd, frame_reader, frame, ring.get());
+        if (recv_bytes == 0) {
+            break; // connection closed by server
+        }
+        if (recv_bytes == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue; // SO_RCVTIMEO expired while idle
+            perror("recv");
+            break;
         }
+        deliver(frame.data(), frame.size());
+    }
+    fail_pending();
+}
+
+void neroshop::Client::deliver(const uint8_t * data, std::size_t size) {
+    nlohmann::json response_object;
+    try {
+        response_object = nlohmann::json::from_msgpack(data, data + size);
     } catch (const nlohmann::detail::parse_error& e) {
-        std::cerr << "An error occurred: " << "Node was disconnected" << std::endl;
+        std::cerr << "Failed to parse server response: " << e.what() << std::endl;
+        return;
+    }
+    // Events have no tid since they do not answer a request
+    if(response_object.is_object() && response_object.contains("event") && !response_object.contains("tid")) {
+        EventHandler handler;
+        {
+            std::lock_guard<std::mutex> lock(event_mutex);
+            handler = event_handler;
+        }
+        if(handler && response_object["event"].is_string()) handler(response_object["event"].get<std::string>(), response_object.value("data", nlohmann::json::object()));
+        return;
     }
+    std::promise<Response> promise;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        if(pending.empty()) return;
+        auto it = pending.end();
+        const nlohmann::json tid = response_object.is_object() ? response_object.value("tid", nlohmann::json(nullptr)) : nullptr;
+        if(tid.is_number_unsigned()) {
+            it = pending.find(tid.get<uint64_t>());
+            echoes_tid = true;
+        } else if(!echoes_tid) {
+            it = pending.begin(); // Daemons that do not echo the tid answer one request at a time, in order
+        } else {
+            // Not an answer to any request that we can tell. Giving it to the oldest one would hand that request's real answer to the next
+            std::cerr << "Dropped a response without a tid: " << response_object.dump() << std::endl;
+        }
+        if(it == pending.end()) return; // The request was already failed
+        promise = std::move(it->second);
+        pending.erase(it);
+    }
+    promise.set_value(Response(std::move(response_object))); // Decoded once here. Callers read it without parsing it again
+}
+
+void neroshop::Client::fail_pending() {
+    std::map<uint64_t, std::promise<Response>> failed;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        receiving = false;
+        failed.swap(pending);
+    }
+    for(auto& [tid, promise] : failed) promise.set_value(Response());
 }
 ////////////////////	
 void neroshop::Client::close() {
+    stop_receiving();
+    ring.reset(); // Only after the receive thread is done with it
+    #if defined(NEROSHOP_USE_LIBZMQ)
+    zmq_client.reset();
+    #endif
 	::close(sockfd);
 }
 ////////////////////
@@ -284,6 +551,10 @@ neroshop::Client * neroshop::Client::get_main_client() {
     return &client_obj;
 }
 ////////////////////
+void neroshop::Client::set_max_frame_size(std::size_t max_frame_size) {
+    frame_reader = framing::FrameReader(max_frame_size);
+}
+////////////////////
 int neroshop::Client::get_socket() const {
     return sockfd;
 }
@@ -303,6 +574,9 @@ int neroshop::Client::get_max_buffer_recv_size() const {
 ////////////////////
 ////////////////////
 bool neroshop::Client::is_connected() const { // https://stackoverflow.com/a/4142038 // can only work when close() is called
+    #if defined(NEROSHOP_USE_LIBZMQ)
+    if (zmq_client) return true;
+    #endif
     return (sockfd != -1);
 }
 ////////////////////
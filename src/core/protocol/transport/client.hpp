@@ -27,16 +27,32 @@
 #include <uv.h>
 #endif
 
+#include <atomic>
+#include <functional> // std::function
+#include <future>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <string>
 #include <memory> // std::unique_ptr
+#include <thread>
+#include <utility> // std::pair
 #include <vector>
 
+#include <nlohmann/json.hpp>
+
+#include "framing.hpp"
+#include "response.hpp"
+#include "shm_ring.hpp"
+#include "zmq_client.hpp"
+
 namespace neroshop {
 
 enum class SocketType {
     Socket_TCP = 1,//SOCK_STREAM,
     Socket_UDP = 2,//SOCK_DGRAM,
+    Socket_Unix = 3,//AF_UNIX + SOCK_STREAM
+    Socket_Zmq = 4,// ZeroMQ DEALER (see ZmqClient)
 };
 
 class Client {
@@ -47,16 +63,47 @@ public:
 	~Client();
 	void create(); // creates a new socket
 	bool connect(unsigned int port, std::string address = "0.0.0.0");
+	// Connects over a Unix domain socket instead of TCP loopback. With use_shared_memory, large responses are passed through a shared-memory ring
+	bool connect_unix(const std::string& path, bool use_shared_memory = false);
+	#if defined(NEROSHOP_USE_LIBZMQ)
+	// Connects to the daemon's ZeroMQ endpoint (NEROSHOP_DEFAULT_IPC_ZMQ_ENDPOINT), or to "inproc://..." with the context of a ZmqServer in the same process
+	bool connect_zmq(const std::string& endpoint, void * context = nullptr);
+	#endif
 	void write(const std::string& text);
 	std::string read();
-	void send(const std::vector<uint8_t>& message); // tcp
+	void send(const std::vector<uint8_t>& message); // tcp - sends the message as a length-prefixed frame
 	void send_to(const std::vector<uint8_t>& message, const struct sockaddr_in& addr); // udp
-    ssize_t receive(std::vector<uint8_t>& message); // tcp
+    ssize_t receive(std::vector<uint8_t>& message); // tcp - receives exactly one frame. Not for use on a connected IPC client, whose responses are read by the receive thread
     ssize_t receive_from(std::vector<uint8_t>& message, const struct sockaddr_in& addr); // udp
-	// Interactions with the DHT node, which only exists on the client side via IPC server
+	// Interactions with the DHT node, which only exists on the client side via IPC server.
+	// The response is decoded once and its values are parsed on first use, e.g. client->get(key).get_value_json()
+	Response put(const std::string& key, const std::string& value);
+	Response get(const std::string& key);
+	Response set(const std::string& key, const std::string& value, bool verified);
+	Response get_many(const std::vector<std::string>& keys); // Values of the keys that were found are read with get_value(key)
+	Response put_many(const std::vector<std::pair<std::string, std::string>>& entries);
+	// The same as above, with the response as a json string
 	void put(const std::string& key, const std::string& value, std::string& response);
 	void get(const std::string& key, std::string& response);
 	void set(const std::string& key, const std::string& value, bool verified, std::string& response);
+	void get_many(const std::vector<std::string>& keys, std::string& response); // Values of the keys that were found are in response["response"]["values"]
+	void put_many(const std::vector<std::pair<std::string, std::string>>& entries, std::string& response);
+	// Pipelined variants of the above. The request is sent right away and the future is fulfilled with the response once the daemon answers it,
+	// so any number of requests can be in flight at once and their responses may arrive in any order. The status is NoResponse if the connection was lost
+	std::future<Response> put_async(const std::string& key, const std::string& value);
+	std::future<Response> get_async(const std::string& key);
+	std::future<Response> set_async(const std::string& key, const std::string& value, bool verified);
+	std::future<Response> get_many_async(const std::vector<std::string>& keys);
+	std::future<Response> put_many_async(const std::vector<std::pair<std::string, std::string>>& entries);
+	std::future<Response> request(const std::string& query, nlohmann::json args); // Sends any other query to the daemon
+	// Events that the daemon pushes without being asked (see EventPublisher). The handler is called on the receive thread with the event's name and "data".
+	// No response can be received while it runs, so it must not wait on a request: the blocking get/put/set/get_many/put_many fail right away
+	// when they are called from it. Hand the event over to another thread (e.g. with a queued Qt connection) if it needs to make requests
+	using EventHandler = std::function<void(const std::string& event, const nlohmann::json& data)>;
+	void set_event_handler(EventHandler event_handler);
+	// Subscriptions are remembered and made again whenever the client reconnects, e.g. subscribe({ {"topics", {"network_status"}} })
+	std::future<Response> subscribe(const nlohmann::json& args);
+	std::future<Response> unsubscribe(const nlohmann::json& args);
 	void close(); // kills socket
 	void shutdown(); // shuts down connection (disconnects from server)
     void disconnect(); // breaks connection to server then closes the client socket // combination of shutdown() and close()
@@ -66,12 +113,39 @@ public:
     
     int get_socket() const;
     int get_max_buffer_recv_size() const;
+    
+    void set_max_frame_size(std::size_t max_frame_size); // Must be called before connecting
 
 private:
 	int sockfd;
 	struct sockaddr_in addr;
 	struct sockaddr_in6 addr6;
 	SocketType socket_type;
+	// Requests that are waiting for a response, by tid
+	std::map<uint64_t, std::promise<Response>> pending;
+	std::mutex pending_mutex;
+	std::mutex send_mutex; // Keeps the bytes of concurrently sent requests from interleaving
+	std::atomic<uint64_t> next_tid { 1 };
+	std::thread receive_thread;
+	bool receiving = false; // Guarded by pending_mutex
+	bool echoes_tid = false; // Set once the daemon has echoed a tid. From then on a response without one is not given to the oldest request. Guarded by pending_mutex
+	framing::FrameReader frame_reader; // Partially received response
+	std::unique_ptr<ShmRing> ring; // Large responses from the daemon when connected with shared memory
+	#if defined(NEROSHOP_USE_LIBZMQ)
+	std::unique_ptr<ZmqClient> zmq_client; // The transport when connected with connect_zmq
+	#endif
+	EventHandler event_handler; // Guarded by event_mutex
+	std::vector<nlohmann::json> subscriptions; // Arguments of the subscriptions that are still in effect, without duplicates. Guarded by event_mutex
+	std::mutex event_mutex;
+	void resubscribe(); // Repeats the subscriptions on a new connection
+	using PendingRequest = std::pair<uint64_t, std::future<Response>>; // tid and future of a request
+	PendingRequest send_request(const std::string& query, nlohmann::json args); // The same as request() but with the tid, so that the request can be forgotten if it times out
+	Response wait(PendingRequest pending_request); // Blocks until the response arrives or the request times out
+	void start_receiving();
+	void stop_receiving();
+	void receive_loop(); // Splits the byte stream into responses and hands each one to the request with the same tid
+	void deliver(const uint8_t * data, std::size_t size);
+	void fail_pending();
 	friend class Server;
 };
 }
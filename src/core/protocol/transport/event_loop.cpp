@@ -0,0 +1,158 @@
+#include "event_loop.hpp"
+
+#if defined(NEROSHOP_USE_LIBUV)
+#include <cstdlib> // setenv
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "../../../neroshop_config.hpp"
+
+// Freed once its handle is closed and none of its work is left on the thread pool, so that work never outlives what it refers to
+struct neroshop::EventLoop::Handle {
+    virtual ~Handle() = default;
+    virtual uv_handle_t * get() = 0;
+    int busy = 0; // Work on the thread pool that refers to it
+    bool closed = false;
+    void close() {
+        if(!uv_is_closing(get())) uv_close(get(), on_close);
+    }
+    void release() {
+        if(--busy == 0 && closed) delete this;
+    }
+};
+
+struct neroshop::EventLoop::Watch : Handle {
+    uv_poll_t poll;
+    Callback on_readable;
+    uv_handle_t * get() override { return reinterpret_cast<uv_handle_t *>(&poll); }
+};
+
+struct neroshop::EventLoop::Timer : Handle {
+    uv_timer_t timer;
+    Callback work;
+    EventLoop * event_loop;
+    bool running = false;
+    uv_handle_t * get() override { return reinterpret_cast<uv_handle_t *>(&timer); }
+};
+
+struct neroshop::EventLoop::Signal : Handle {
+    uv_signal_t signal;
+    Callback callback;
+    uv_handle_t * get() override { return reinterpret_cast<uv_handle_t *>(&signal); }
+};
+
+struct neroshop::EventLoop::Work {
+    uv_work_t request;
+    Callback work;
+    Callback after_work;
+};
+
+//-----------------------------------------------------------------------------
+
+neroshop::EventLoop::EventLoop() {
+    // The pool is created on first use and its size cannot change after that. Handlers may block on the network, so the default of 4 is too few
+    setenv("UV_THREADPOOL_SIZE", std::to_string(NEROSHOP_UV_THREADPOOL_SIZE).c_str(), 0); // Unless set by the user
+    if(uv_loop_init(&loop) != 0) {
+        throw std::runtime_error("Failed to create event loop");
+    }
+    uv_async_init(&loop, &stop_async, [](uv_async_t * async) {
+        static_cast<EventLoop *>(async->data)->close_all();
+    });
+    stop_async.data = this;
+}
+
+neroshop::EventLoop::~EventLoop() {
+    close_all();
+    uv_run(&loop, UV_RUN_DEFAULT); // Lets the handles close and the queued work finish
+    uv_loop_close(&loop);
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::EventLoop::watch(int fd, Callback on_readable) {
+    Watch * watch = new Watch();
+    watch->on_readable = std::move(on_readable);
+    if(uv_poll_init(&loop, &watch->poll, fd) != 0) {
+        delete watch;
+        throw std::runtime_error("Failed to watch descriptor " + std::to_string(fd));
+    }
+    watch->poll.data = watch;
+    uv_poll_start(&watch->poll, UV_READABLE, [](uv_poll_t * poll, int status, int events) {
+        if(status < 0) {
+            std::cerr << "uv_poll: " << uv_strerror(status) << "\n";
+            return;
+        }
+        static_cast<Watch *>(poll->data)->on_readable();
+    });
+}
+
+void neroshop::EventLoop::schedule(uint64_t delay, uint64_t interval, Callback work) {
+    Timer * timer = new Timer();
+    timer->work = std::move(work);
+    timer->event_loop = this;
+    uv_timer_init(&loop, &timer->timer);
+    timer->timer.data = timer;
+    uv_timer_start(&timer->timer, [](uv_timer_t * handle) {
+        Timer * timer = static_cast<Timer *>(handle->data);
+        if(timer->running) return;
+        timer->running = true;
+        timer->busy++;
+        timer->event_loop->queue_work(timer->work, [timer]() {
+            timer->running = false;
+            timer->release();
+        });
+    }, delay, interval);
+}
+
+void neroshop::EventLoop::queue_work(Callback work, Callback after_work) {
+    Work * request = new Work { {}, std::move(work), std::move(after_work) };
+    request->request.data = request;
+    uv_queue_work(&loop, &request->request, [](uv_work_t * handle) {
+        static_cast<Work *>(handle->data)->work();
+    }, [](uv_work_t * handle, int status) {
+        std::unique_ptr<Work> request(static_cast<Work *>(handle->data));
+        if(request->after_work) request->after_work();
+    });
+}
+
+void neroshop::EventLoop::on_signal(int signum, Callback callback) {
+    Signal * signal = new Signal();
+    signal->callback = std::move(callback);
+    uv_signal_init(&loop, &signal->signal);
+    signal->signal.data = signal;
+    uv_signal_start(&signal->signal, [](uv_signal_t * handle, int signum) {
+        static_cast<Signal *>(handle->data)->callback();
+    }, signum);
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::EventLoop::run() {
+    uv_run(&loop, UV_RUN_DEFAULT);
+}
+
+void neroshop::EventLoop::stop() {
+    uv_async_send(&stop_async);
+}
+
+void neroshop::EventLoop::close_all() {
+    uv_walk(&loop, [](uv_handle_t * handle, void * arg) {
+        EventLoop * event_loop = static_cast<EventLoop *>(arg);
+        if(uv_is_closing(handle)) return;
+        if(handle == reinterpret_cast<uv_handle_t *>(&event_loop->stop_async)) {
+            uv_close(handle, nullptr);
+            return;
+        }
+        static_cast<Handle *>(handle->data)->close();
+    }, this);
+}
+
+void neroshop::EventLoop::on_close(uv_handle_t * handle) {
+    Handle * self = static_cast<Handle *>(handle->data);
+    self->closed = true;
+    if(self->busy == 0) delete self;
+}
+
+#endif // NEROSHOP_USE_LIBUV
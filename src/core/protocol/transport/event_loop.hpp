@@ -0,0 +1,50 @@
+#pragma once
+#ifndef EVENT_LOOP_HPP_NEROSHOP
+#define EVENT_LOOP_HPP_NEROSHOP
+
+#if defined(NEROSHOP_USE_LIBUV)
+#include <uv.h>
+
+#include <cstdint>
+#include <functional>
+
+namespace neroshop {
+
+// libuv event loop that neromon's servers share instead of each blocking a thread of its own. Sockets are watched for readability,
+// timers replace the sleeping threads and anything that may block (handling a request, pinging nodes) is run on libuv's thread pool
+// so that the loop itself never waits. Everything except stop() must be called from the thread that calls run()
+class EventLoop {
+public:
+    using Callback = std::function<void()>;
+
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    void watch(int fd, Callback on_readable); // on_readable is called on the loop thread for as long as fd is readable. fd stays owned by the caller
+    // Runs work on the thread pool after delay milliseconds and then every interval milliseconds. A run is skipped while the previous one is still going
+    void schedule(uint64_t delay, uint64_t interval, Callback work);
+    void queue_work(Callback work, Callback after_work = nullptr); // after_work is called on the loop thread once work is done
+    void on_signal(int signum, Callback callback);
+
+    void run(); // Returns once stop() was called and the work that was queued has finished
+    void stop(); // Can be called from any thread
+private:
+    struct Handle; // Anything that is attached to a libuv handle
+    struct Watch;
+    struct Timer;
+    struct Signal;
+    struct Work;
+
+    uv_loop_t loop;
+    uv_async_t stop_async;
+
+    void close_all();
+    static void on_close(uv_handle_t * handle);
+};
+
+}
+
+#endif // NEROSHOP_USE_LIBUV
+#endif
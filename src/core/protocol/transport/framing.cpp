@@ -0,0 +1,258 @@
+#include "framing.hpp"
+
+#include "shm_ring.hpp"
+
+#include <sys/socket.h>
+#include <sys/uio.h> // iovec
+#include <unistd.h> // close
+
+#include <cerrno>
+#include <cstdio> // perror
+#include <cstring> // memcpy
+#include <iostream>
+
+namespace {
+
+uint32_t read_header(const uint8_t * header) {
+    return (static_cast<uint32_t>(header[0]) << 24) | (static_cast<uint32_t>(header[1]) << 16)
+        | (static_cast<uint32_t>(header[2]) << 8) | static_cast<uint32_t>(header[3]);
+}
+
+void write_header(uint32_t value, uint8_t * header) {
+    header[0] = static_cast<uint8_t>(value >> 24);
+    header[1] = static_cast<uint8_t>(value >> 16);
+    header[2] = static_cast<uint8_t>(value >> 8);
+    header[3] = static_cast<uint8_t>(value);
+}
+
+// Number of payload bytes that follow the header in the stream. A ring frame has none
+std::size_t get_stream_size(uint32_t header) {
+    return (header & neroshop::framing::RING_FLAG) ? 0 : header;
+}
+
+bool send_all(int sockfd, struct msghdr& msg) {
+    // use a loop to repeatedly call sendmsg() until all the bytes are sent
+    while(msg.msg_iovlen > 0) {
+        ssize_t sent_bytes = ::sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+        if(sent_bytes < 0) {
+            if(errno == EINTR) continue;
+            perror("sendmsg");
+            return false;
+        }
+        msg.msg_control = nullptr; // Ancillary data is only sent once
+        msg.msg_controllen = 0;
+        // Skip the part that was sent
+        while(msg.msg_iovlen > 0 && static_cast<std::size_t>(sent_bytes) >= msg.msg_iov[0].iov_len) {
+            sent_bytes -= msg.msg_iov[0].iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if(msg.msg_iovlen > 0) {
+            msg.msg_iov[0].iov_base = static_cast<uint8_t *>(msg.msg_iov[0].iov_base) + sent_bytes;
+            msg.msg_iov[0].iov_len -= sent_bytes;
+        }
+    }
+    return true;
+}
+
+}
+
+//-----------------------------------------------------------------------------
+
+neroshop::framing::FrameReader::FrameReader(std::size_t max_frame_size) : max_frame_size(max_frame_size), position(0), checked(0), ring_size(0), error(false) {}
+
+bool neroshop::framing::FrameReader::feed(const uint8_t * data, std::size_t size) {
+    if(error) return false;
+    buffer.insert(buffer.end(), data, data + size);
+    // Reject an oversized frame as soon as its header arrives rather than after buffering it
+    while(buffer.size() - checked >= HEADER_SIZE) {
+        uint32_t header = read_header(buffer.data() + checked);
+        if((header & ~RING_FLAG) > max_frame_size) {
+            error = true;
+            return false;
+        }
+        std::size_t frame_size = get_stream_size(header);
+        if(buffer.size() - checked - HEADER_SIZE < frame_size) break;
+        checked += HEADER_SIZE + frame_size;
+    }
+    return true;
+}
+
+bool neroshop::framing::FrameReader::next(std::vector<uint8_t>& frame) {
+    if(error || position == checked) return false; // Only frames that have been checked are complete
+    uint32_t header = read_header(buffer.data() + position);
+    std::size_t frame_size = get_stream_size(header);
+    ring_size = (header & RING_FLAG) ? (header & ~RING_FLAG) : 0;
+    auto begin = buffer.begin() + position + HEADER_SIZE;
+    frame.assign(begin, begin + frame_size);
+    position += HEADER_SIZE + frame_size;
+    if(position == buffer.size()) {
+        clear();
+    } else if(position >= buffer.size() / 2) { // Compact once the consumed frames make up most of the buffer
+        buffer.erase(buffer.begin(), buffer.begin() + position);
+        checked -= position;
+        position = 0;
+    }
+    return true;
+}
+
+void neroshop::framing::FrameReader::clear() {
+    buffer.clear();
+    position = 0;
+    checked = 0;
+    error = false;
+}
+
+//-----------------------------------------------------------------------------
+
+std::size_t neroshop::framing::FrameReader::get_ring_size() const {
+    return ring_size;
+}
+
+std::size_t neroshop::framing::FrameReader::get_max_frame_size() const {
+    return max_frame_size;
+}
+
+std::size_t neroshop::framing::FrameReader::get_buffered_size() const {
+    return buffer.size() - position;
+}
+
+bool neroshop::framing::FrameReader::has_error() const {
+    return error;
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::framing::send_frame(int sockfd, const uint8_t * data, std::size_t size) {
+    uint8_t header[HEADER_SIZE];
+    write_header(size, header);
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = HEADER_SIZE;
+    iov[1].iov_base = const_cast<uint8_t *>(data);
+    iov[1].iov_len = size;
+    struct msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    return send_all(sockfd, msg);
+}
+
+bool neroshop::framing::send_frame(int sockfd, const std::vector<uint8_t>& payload) {
+    return send_frame(sockfd, payload.data(), payload.size());
+}
+
+bool neroshop::framing::send_frame(int sockfd, const std::vector<uint8_t>& payload, ShmRing& ring) {
+    if(payload.size() >= RING_FLAG || !ring.write(payload.data(), payload.size())) return false;
+    // The header still goes over the socket so that the receiver wakes up and takes the payload out of the ring in order
+    uint8_t header[HEADER_SIZE];
+    write_header(RING_FLAG | static_cast<uint32_t>(payload.size()), header);
+    struct iovec iov;
+    iov.iov_base = header;
+    iov.iov_len = HEADER_SIZE;
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    return send_all(sockfd, msg);
+}
+
+void neroshop::framing::append_frame(std::vector<uint8_t>& buffer, const std::vector<uint8_t>& payload) {
+    std::size_t offset = buffer.size();
+    buffer.resize(offset + HEADER_SIZE);
+    write_header(payload.size(), buffer.data() + offset);
+    buffer.insert(buffer.end(), payload.begin(), payload.end());
+}
+
+bool neroshop::framing::append_frame(std::vector<uint8_t>& buffer, const std::vector<uint8_t>& payload, ShmRing& ring) {
+    if(payload.size() >= RING_FLAG || !ring.write(payload.data(), payload.size())) return false;
+    std::size_t offset = buffer.size();
+    buffer.resize(offset + HEADER_SIZE);
+    write_header(RING_FLAG | static_cast<uint32_t>(payload.size()), buffer.data() + offset);
+    return true;
+}
+
+ssize_t neroshop::framing::receive_frame(int sockfd, FrameReader& reader, std::vector<uint8_t>& frame, ShmRing * ring) {
+    const int BUFFER_SIZE = 4096;
+    uint8_t buffer[BUFFER_SIZE];
+    while(!reader.next(frame)) {
+        if(reader.has_error()) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+        ssize_t recv_bytes = ::recv(sockfd, buffer, BUFFER_SIZE, 0);
+        if(recv_bytes <= 0) return recv_bytes; // connection closed or error
+        if(!reader.feed(buffer, recv_bytes)) {
+            std::cerr << "Frame is larger than the maximum frame size of " << reader.get_max_frame_size() << " bytes" << std::endl;
+            errno = EMSGSIZE;
+            return -1;
+        }
+    }
+    if(std::size_t ring_size = reader.get_ring_size()) {
+        // The producer wrote the payload to the ring before it sent the header, so the whole payload must be there
+        if(ring == nullptr || !ring->read(frame, ring_size)) {
+            std::cerr << "Frame payload is missing from the shared-memory ring" << std::endl;
+            errno = EPROTO;
+            return -1;
+        }
+    }
+    return frame.size();
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::framing::send_frame_with_fd(int sockfd, const std::vector<uint8_t>& payload, int fd) {
+    uint8_t header[HEADER_SIZE];
+    write_header(payload.size(), header);
+    struct iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = HEADER_SIZE;
+    iov[1].iov_base = const_cast<uint8_t *>(payload.data());
+    iov[1].iov_len = payload.size();
+    struct msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    if(fd != -1) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    return send_all(sockfd, msg); // The descriptor travels with the first bytes and is not sent again if the rest is sent separately
+}
+
+ssize_t neroshop::framing::receive_frame_with_fd(int sockfd, std::vector<uint8_t>& frame, int& fd, std::size_t max_frame_size) {
+    fd = -1;
+    // The descriptor arrives with the first byte of the header, so the header is read with recvmsg
+    uint8_t header[HEADER_SIZE];
+    struct iovec iov;
+    iov.iov_base = header;
+    iov.iov_len = HEADER_SIZE;
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t recv_bytes = ::recvmsg(sockfd, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+    if(recv_bytes <= 0) return recv_bytes;
+    auto fail = [&fd](int error) -> ssize_t { // The descriptor is useless without the rest of the frame
+        if(fd != -1) ::close(fd);
+        fd = -1;
+        errno = error;
+        return -1;
+    };
+    for(struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if(recv_bytes < static_cast<ssize_t>(HEADER_SIZE) || (msg.msg_flags & MSG_CTRUNC)) return fail(EPROTO);
+    uint32_t frame_size = read_header(header);
+    if(frame_size > max_frame_size) return fail(EMSGSIZE);
+    frame.resize(frame_size);
+    if(frame_size > 0 && ::recv(sockfd, frame.data(), frame_size, MSG_WAITALL) != static_cast<ssize_t>(frame_size)) return fail(EPROTO);
+    return frame_size;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sys/types.h> // ssize_t
+
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+class ShmRing; // forward declaration
+
+namespace framing {
+
+constexpr std::size_t HEADER_SIZE = 4; // Payload length as a big-endian uint32
+constexpr uint32_t RING_FLAG = 0x80000000; // Set in the header of a frame whose payload was written to the shared-memory ring instead of the socket
+constexpr uint8_t HANDSHAKE = 1; // Payload of the first frame that a client sends on a Unix domain socket. The descriptor of a shared-memory ring may be attached to it
+
+// Reassembles length-prefixed frames from a TCP byte stream. Bytes may be fed in pieces of any size and a frame only takes up
+// as much memory as has actually arrived, so a large declared length does not allocate a worst-case buffer up front
+class FrameReader {
+private:
+    std::size_t max_frame_size;
+    std::vector<uint8_t> buffer;
+    std::size_t position; // Start of the first frame that has not been taken out yet
+    std::size_t checked; // Start of the first frame whose header has not been checked yet
+    std::size_t ring_size;
+    bool error;
+public:
+    explicit FrameReader(std::size_t max_frame_size = NEROSHOP_IPC_MAX_FRAME_SIZE);
+    // Returns false if a frame is larger than the maximum frame size. The stream cannot be resynchronized after that
+    bool feed(const uint8_t * data, std::size_t size);
+    bool next(std::vector<uint8_t>& frame); // Takes out the next complete frame. Returns false if there is none yet
+    std::size_t get_ring_size() const; // Payload size of the frame last taken out if its payload is in the shared-memory ring, otherwise 0
+    void clear();
+    
+    std::size_t get_max_frame_size() const;
+    std::size_t get_buffered_size() const;
+    bool has_error() const;
+};
+
+// Sends the header and the payload with a single sendmsg so that the payload does not have to be copied into a framed buffer first.
+// Returns false if the connection failed before the whole frame was sent
+bool send_frame(int sockfd, const uint8_t * data, std::size_t size);
+bool send_frame(int sockfd, const std::vector<uint8_t>& payload);
+// Writes the payload to the shared-memory ring and sends only its header over the socket. Returns false without sending anything if the ring is full
+bool send_frame(int sockfd, const std::vector<uint8_t>& payload, ShmRing& ring);
+// Appends a frame to a write buffer, for sockets that are written to without blocking
+void append_frame(std::vector<uint8_t>& buffer, const std::vector<uint8_t>& payload);
+// Writes the payload to the shared-memory ring and appends only its header to the write buffer. Returns false without appending anything if the ring is full
+bool append_frame(std::vector<uint8_t>& buffer, const std::vector<uint8_t>& payload, ShmRing& ring);
+// Reads from the socket until reader holds a complete frame. Bytes of a partially received frame stay in reader between calls.
+// Payloads that were sent through the shared-memory ring are read from ring.
+// Returns the frame size, 0 if the peer closed the connection or -1 on a socket error, an oversized frame (errno is EMSGSIZE)
+// or a ring frame that cannot be read (errno is EPROTO). Empty frames are never sent, so 0 always means that the connection was closed
+ssize_t receive_frame(int sockfd, FrameReader& reader, std::vector<uint8_t>& frame, ShmRing * ring = nullptr);
+
+// Unix domain sockets only: sends a frame with a file descriptor attached (SCM_RIGHTS), or without one if fd is -1
+bool send_frame_with_fd(int sockfd, const std::vector<uint8_t>& payload, int fd);
+// Unix domain sockets only: receives a single frame sent by send_frame_with_fd. Reads exactly the bytes of that frame so anything the peer sent
+// after it stays in the socket. fd is set to the attached file descriptor or -1. Returns the same values as receive_frame
+ssize_t receive_frame_with_fd(int sockfd, std::vector<uint8_t>& frame, int& fd, std::size_t max_frame_size = NEROSHOP_IPC_MAX_FRAME_SIZE);
+
+}
+
+}
@@ -0,0 +1,334 @@
+#include "http_server.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio> // perror
+#include <iostream>
+#include <stdexcept>
+
+#include "../rpc/http.hpp"
+#include "../../tools/logger.hpp"
+
+neroshop::HttpServer::HttpServer(Handler handler, std::size_t worker_count)
+    : handler(std::move(handler)), epoll_fd(-1), wake_fd(-1), timer_fd(-1), listen_fd(-1), next_client_id(1), client_count(0), stopped(false),
+      pool([this](uint64_t client_id, const std::vector<uint8_t>& request) {
+          this->handler(std::string_view(reinterpret_cast<const char *>(request.data()), request.size()), [this, client_id](std::string data) {
+              post({ client_id, std::move(data), false });
+          });
+          post({ client_id, "", true });
+      }, worker_count)
+{
+    epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(epoll_fd == -1 || wake_fd == -1 || timer_fd == -1) {
+        perror("epoll_create1/eventfd/timerfd_create");
+        throw std::runtime_error("Failed to create the RPC event loop");
+    }
+    struct itimerspec interval {};
+    interval.it_value.tv_sec = 1;
+    interval.it_interval.tv_sec = 1;
+    ::timerfd_settime(timer_fd, 0, &interval, nullptr);
+    for(int fd : { wake_fd, timer_fd }) {
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+neroshop::HttpServer::~HttpServer() {
+    pool.stop(); // Workers post to wake_fd, so they are done before it is closed
+
+    for(auto& [fd, connection] : connections) ::close(fd);
+    if(listen_fd != -1) ::close(listen_fd);
+    if(timer_fd != -1) ::close(timer_fd);
+    if(wake_fd != -1) ::close(wake_fd);
+    if(epoll_fd != -1) ::close(epoll_fd);
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::HttpServer::listen(const std::string& address, unsigned int port) {
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if(::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Invalid RPC address: " << address << "\n";
+        return false;
+    }
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+        perror("socket");
+        return false;
+    }
+    int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if(::bind(fd, (sockaddr *)&addr, sizeof(addr)) == -1 || ::listen(fd, SOMAXCONN) == -1) {
+        perror("bind/listen");
+        ::close(fd);
+        return false;
+    }
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        perror("epoll_ctl");
+        ::close(fd);
+        return false;
+    }
+    listen_fd = fd;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::HttpServer::run() {
+    while(!stopped) {
+        if(!poll(-1)) break;
+    }
+}
+
+bool neroshop::HttpServer::run_once() {
+    return !stopped && poll(0) && !stopped;
+}
+
+bool neroshop::HttpServer::poll(int timeout) {
+    epoll_event events[64];
+    int event_count = ::epoll_wait(epoll_fd, events, 64, timeout);
+    if(event_count == -1) {
+        if(errno == EINTR) return true;
+        perror("epoll_wait");
+        return false;
+    }
+    for(int i = 0; i < event_count; i++) {
+        int fd = events[i].data.fd;
+        if(fd == wake_fd) {
+            uint64_t value;
+            while(::read(wake_fd, &value, sizeof(value)) > 0) {}
+            flush_outbox();
+            continue;
+        }
+        if(fd == timer_fd) {
+            uint64_t expirations;
+            while(::read(timer_fd, &expirations, sizeof(expirations)) > 0) {}
+            close_idle_connections();
+            continue;
+        }
+        if(fd == listen_fd) {
+            accept_clients();
+            continue;
+        }
+        auto it = connections.find(fd);
+        if(it == connections.end()) continue; // Closed earlier in this batch
+        Connection& connection = *it->second;
+        if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            read_from(connection); // Also notices errors and hang-ups
+            if(connections.find(fd) == connections.end()) continue;
+        }
+        if(events[i].events & EPOLLOUT) {
+            flush(connection);
+        }
+    }
+    return true;
+}
+
+void neroshop::HttpServer::stop() {
+    stopped = true;
+    uint64_t value = 1;
+    ::write(wake_fd, &value, sizeof(value));
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::HttpServer::accept_clients() {
+    while(true) {
+        int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd == -1) {
+            if(errno == EINTR) continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) perror("accept4");
+            return;
+        }
+        if(connections.size() >= NEROSHOP_RPC_MAX_CLIENTS) {
+            neroshop::print("RPC client refused: too many connections are open", 1);
+            ::close(fd);
+            continue;
+        }
+        int no_delay = 1; // Whatever the handler writes is sent right away, so there is nothing to gain from waiting for more
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->id = next_client_id++;
+        connection->last_active = std::chrono::steady_clock::now();
+        connection->events = EPOLLIN;
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            perror("epoll_ctl");
+            ::close(fd);
+            continue;
+        }
+        client_fds[connection->id] = fd;
+        connections[fd] = std::move(connection);
+        client_count = connections.size();
+    }
+}
+
+void neroshop::HttpServer::read_from(Connection& connection) {
+    char buffer[65536];
+    std::size_t total_read = 0;
+    while(total_read < READ_BUDGET) {
+        ssize_t bytes_read = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+        if(bytes_read == 0) {
+            connection.read_closed = true; // The response to a request that was already sent is still delivered
+            break;
+        }
+        if(bytes_read == -1) {
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close_connection(connection);
+            return;
+        }
+        connection.read_buffer.append(buffer, bytes_read);
+        total_read += bytes_read;
+    }
+    connection.last_active = std::chrono::steady_clock::now();
+    next_request(connection);
+}
+
+void neroshop::HttpServer::next_request(Connection& connection) {
+    if(connection.busy || connection.closing) return;
+    std::size_t request_size = neroshop::rpc::http::get_request_size(connection.read_buffer);
+    if(request_size == 0) { // Not all here yet
+        if(connection.read_closed && connection.write_offset == connection.write_buffer.size()) {
+            close_connection(connection);
+            return;
+        }
+        update_events(connection);
+        return;
+    }
+    if(request_size == std::string::npos) {
+        connection.read_buffer.clear();
+        connection.write_buffer += neroshop::rpc::http::respond_error(400, "Bad Request", -32600, "Invalid Request");
+        connection.closing = true;
+        flush(connection);
+        return;
+    }
+    std::vector<std::vector<uint8_t>> requests(1);
+    requests[0].assign(connection.read_buffer.begin(), connection.read_buffer.begin() + request_size);
+    connection.keep_alive = neroshop::rpc::http::is_keep_alive(connection.read_buffer.substr(0, request_size));
+    connection.read_buffer.erase(0, request_size);
+    connection.busy = true;
+    pool.push(connection.id, requests);
+    update_events(connection);
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::HttpServer::post(Response response) {
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        outbox.push_back(std::move(response));
+    }
+    uint64_t value = 1;
+    ::write(wake_fd, &value, sizeof(value));
+}
+
+void neroshop::HttpServer::flush_outbox() {
+    std::vector<Response> responses;
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        responses.swap(outbox);
+    }
+    for(auto& response : responses) {
+        auto client_fd = client_fds.find(response.client_id);
+        if(client_fd == client_fds.end()) continue; // The client has disconnected
+        Connection& connection = *connections[client_fd->second];
+        connection.last_active = std::chrono::steady_clock::now();
+        if(response.last) {
+            connection.busy = false;
+            if(!connection.keep_alive || connection.read_closed) connection.closing = true;
+        }
+        connection.write_buffer += response.message;
+        flush(connection);
+    }
+}
+
+void neroshop::HttpServer::flush(Connection& connection) {
+    while(connection.write_offset < connection.write_buffer.size()) {
+        ssize_t bytes_sent = ::send(connection.fd, connection.write_buffer.data() + connection.write_offset,
+            connection.write_buffer.size() - connection.write_offset, MSG_NOSIGNAL);
+        if(bytes_sent == -1) {
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close_connection(connection);
+            return;
+        }
+        connection.write_offset += bytes_sent;
+    }
+    if(connection.write_offset < connection.write_buffer.size()) {
+        update_events(connection);
+        return;
+    }
+    connection.write_buffer.clear();
+    connection.write_offset = 0;
+    if(connection.closing) {
+        close_connection(connection);
+        return;
+    }
+    next_request(connection); // One that the client pipelined behind the response that was just sent
+}
+
+void neroshop::HttpServer::close_idle_connections() {
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<int> idle;
+    for(auto& [fd, connection] : connections) {
+        if(connection->busy || connection->write_offset < connection->write_buffer.size()) continue;
+        if(now - connection->last_active >= std::chrono::seconds(NEROSHOP_RPC_KEEP_ALIVE_TIMEOUT)) idle.push_back(fd);
+    }
+    for(int fd : idle) close_connection(*connections[fd]);
+}
+
+// A client is only read from while none of its requests is being handled, so a client that pipelines requests or sends a request
+// larger than NEROSHOP_RPC_MAX_REQUEST_SIZE cannot make the server buffer without bound
+void neroshop::HttpServer::update_events(Connection& connection) {
+    uint32_t events = 0;
+    if(!connection.busy && !connection.closing && !connection.read_closed) events |= EPOLLIN;
+    if(connection.write_offset < connection.write_buffer.size()) events |= EPOLLOUT;
+    if(events == connection.events) return;
+    epoll_event event {};
+    event.events = events;
+    event.data.fd = connection.fd;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+void neroshop::HttpServer::close_connection(Connection& connection) {
+    uint64_t client_id = connection.id;
+    int fd = connection.fd;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    pool.remove_client(client_id);
+    client_fds.erase(client_id);
+    connections.erase(fd); // Destroys connection
+    client_count = connections.size();
+}
+
+//-----------------------------------------------------------------------------
+
+std::size_t neroshop::HttpServer::get_client_count() const {
+    return client_count;
+}
+
+int neroshop::HttpServer::get_fd() const {
+    return epoll_fd;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory> // std::unique_ptr
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "worker_pool.hpp"
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+// Event-driven HTTP/1.1 server for the JSON-RPC interface. Like IpcServer, one thread waits on every socket with epoll and does all of the
+// reading and writing, while the requests are handled on a WorkerPool. Connections are kept alive, so a client sends any number of requests
+// without reconnecting. Requests that a client pipelines are handled one at a time so that the responses go out in order
+class HttpServer {
+public:
+    using Writer = std::function<void(std::string data)>;
+    // Passes the HTTP response to write (see rpc::http), in as many pieces as it likes. Each piece is sent as soon as the event loop gets to it
+    using Handler = std::function<void(std::string_view request, const Writer& write)>;
+
+    HttpServer(Handler handler, std::size_t worker_count = NEROSHOP_RPC_WORKER_COUNT);
+    ~HttpServer();
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    bool listen(const std::string& address, unsigned int port);
+    void run(); // Serves clients until stop() is called
+    // Handles whatever is ready without waiting, for when another event loop drives the server by watching get_fd() for readability.
+    // Returns false once stop() was called
+    bool run_once();
+    void stop(); // Can be called from any thread
+
+    std::size_t get_client_count() const;
+    int get_fd() const; // The epoll descriptor. It is readable whenever run_once() has something to do
+private:
+    struct Connection {
+        int fd;
+        uint64_t id;
+        std::string read_buffer; // Bytes received that are not part of a request that was handled yet
+        std::string write_buffer;
+        std::size_t write_offset = 0; // Bytes of write_buffer that have already been sent
+        bool busy = false; // A request is being handled
+        bool keep_alive = true; // Of the request that is being handled
+        bool closing = false; // Closed once write_buffer has been sent
+        bool read_closed = false; // The client has sent everything it is going to send
+        std::chrono::steady_clock::time_point last_active;
+        uint32_t events = 0; // epoll events that are currently enabled
+    };
+    struct Response {
+        uint64_t client_id;
+        std::string message;
+        bool last; // The handler has returned, so the next request can be handled
+    };
+    static constexpr std::size_t READ_BUDGET = 262144; // Bytes read from one client per wakeup, so that one client cannot hold up the event loop
+
+    Handler handler;
+    int epoll_fd;
+    int wake_fd; // eventfd that wakes the event loop up when workers have responses for it
+    int timer_fd; // Ticks every second to close the connections that have been idle for too long
+    int listen_fd;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections; // By fd. Only touched by the event loop
+    std::unordered_map<uint64_t, int> client_fds; // Client id -> fd. Ids are never reused so a late response cannot reach the wrong client
+    uint64_t next_client_id;
+    std::atomic<std::size_t> client_count;
+    std::atomic<bool> stopped;
+    // Filled by the workers, emptied by the event loop
+    std::mutex outbox_mutex;
+    std::vector<Response> outbox;
+    WorkerPool pool; // Last, so that it is created after everything that the workers use
+
+    void post(Response response); // Called by the workers
+    bool poll(int timeout); // Waits up to timeout milliseconds (-1 for no limit) and handles the events. Returns false on an epoll error
+    void accept_clients();
+    void read_from(Connection& connection);
+    void next_request(Connection& connection); // Hands the next complete request in read_buffer to the workers
+    void flush(Connection& connection);
+    void flush_outbox();
+    void close_idle_connections();
+    void update_events(Connection& connection);
+    void close_connection(Connection& connection);
+};
+
+}
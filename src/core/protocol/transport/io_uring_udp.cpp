@@ -0,0 +1,327 @@
+#include "io_uring_udp.hpp"
+
+#if defined(NEROSHOP_USE_IO_URING)
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+// user_data of the entries that are not sends. Sends carry the address of their Send, which is never one of these
+constexpr uint64_t RECEIVE_TAG = 1;
+constexpr uint64_t WAKE_TAG = 2;
+constexpr uint64_t CANCEL_TAG = 3;
+constexpr uint16_t BUFFER_GROUP = 0;
+
+int io_uring_setup(unsigned int entries, struct io_uring_params * params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int io_uring_register(int ring_fd, unsigned int opcode, void * arg, unsigned int arg_count) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, ring_fd, opcode, arg, arg_count));
+}
+
+}
+
+//-----------------------------------------------------------------------------
+
+neroshop::IoUringUdp::IoUringUdp(int sockfd, unsigned int entries, unsigned int buffer_count)
+    : sockfd(sockfd), ring_fd(-1), wake_fd(-1), wake_value(0), sq_array(nullptr), sqes(nullptr), sqes_size(0), cqes(nullptr), sq_tail(0),
+      buffer_ring(nullptr), buffer_ring_size(0), buffer_count(buffer_count),
+      buffer_size(sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + NEROSHOP_RECV_BUFFER_SIZE), buffer_tail(0),
+      sends_in_flight(0), receive_armed(false), wake_armed(false), stopped(false), enter_count(0)
+{
+    if(buffer_count == 0 || buffer_count > 32768 || (buffer_count & (buffer_count - 1)) != 0) {
+        throw std::invalid_argument("io_uring buffer count must be a power of 2 no greater than 32768");
+    }
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 8; // Every datagram and every send completes on its own
+    ring_fd = io_uring_setup(entries, &params);
+    if(ring_fd < 0) {
+        throw std::runtime_error(std::string("io_uring_setup: ") + std::strerror(errno));
+    }
+    // Map the submission and completion rings and the submission entries
+    sq.size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq.size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(single_mmap) sq.size = cq.size = std::max(sq.size, cq.size);
+    sq.memory = ::mmap(nullptr, sq.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if(sq.memory == MAP_FAILED) sq.memory = nullptr;
+    cq.memory = single_mmap ? sq.memory : ::mmap(nullptr, cq.size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if(cq.memory == MAP_FAILED) cq.memory = nullptr;
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void * sqes_memory = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    sqes = (sqes_memory == MAP_FAILED) ? nullptr : static_cast<struct io_uring_sqe *>(sqes_memory);
+    if(!sq.memory || !cq.memory || !sqes) {
+        close_ring();
+        throw std::runtime_error("Failed to map io_uring");
+    }
+    char * sq_memory = static_cast<char *>(sq.memory);
+    sq.head = reinterpret_cast<unsigned int *>(sq_memory + params.sq_off.head);
+    sq.tail = reinterpret_cast<unsigned int *>(sq_memory + params.sq_off.tail);
+    sq.mask = *reinterpret_cast<unsigned int *>(sq_memory + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned int *>(sq_memory + params.sq_off.array);
+    for(unsigned int i = 0; i < params.sq_entries; i++) sq_array[i] = i; // Entries are used in order
+    sq_tail = *sq.tail;
+    char * cq_memory = static_cast<char *>(cq.memory);
+    cq.head = reinterpret_cast<unsigned int *>(cq_memory + params.cq_off.head);
+    cq.tail = reinterpret_cast<unsigned int *>(cq_memory + params.cq_off.tail);
+    cq.mask = *reinterpret_cast<unsigned int *>(cq_memory + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq_memory + params.cq_off.cqes);
+
+    // Register the provided buffers (Linux 5.19)
+    buffer_ring_size = buffer_count * sizeof(struct io_uring_buf);
+    void * buffer_ring_memory = ::mmap(nullptr, buffer_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); // Must be page aligned
+    if(buffer_ring_memory == MAP_FAILED) {
+        close_ring();
+        throw std::runtime_error("Failed to allocate io_uring buffer ring");
+    }
+    buffer_ring = static_cast<struct io_uring_buf_ring *>(buffer_ring_memory);
+    struct io_uring_buf_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(buffer_ring);
+    registration.ring_entries = buffer_count;
+    registration.bgid = BUFFER_GROUP;
+    if(io_uring_register(ring_fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        std::string error = std::strerror(errno);
+        close_ring();
+        throw std::runtime_error("io_uring provided buffer rings are not supported: " + error);
+    }
+    buffers.resize(buffer_count * buffer_size);
+    for(unsigned int i = 0; i < buffer_count; i++) recycle_buffer(i);
+    __atomic_store_n(&buffer_ring->tail, buffer_tail, __ATOMIC_RELEASE);
+
+    wake_fd = ::eventfd(0, EFD_CLOEXEC);
+    if(wake_fd == -1) {
+        close_ring();
+        throw std::runtime_error("Failed to create eventfd");
+    }
+    std::memset(&receive_header, 0, sizeof(receive_header));
+    receive_header.msg_namelen = sizeof(struct sockaddr_in);
+}
+
+neroshop::IoUringUdp::~IoUringUdp() {
+    close_ring();
+}
+
+void neroshop::IoUringUdp::close_ring() {
+    if(ring_fd != -1) ::close(ring_fd); // Also unregisters the buffer ring
+    if(buffer_ring) ::munmap(buffer_ring, buffer_ring_size);
+    if(sqes) ::munmap(sqes, sqes_size);
+    if(cq.memory && cq.memory != sq.memory) ::munmap(cq.memory, cq.size);
+    if(sq.memory) ::munmap(sq.memory, sq.size);
+    if(wake_fd != -1) ::close(wake_fd);
+    ring_fd = wake_fd = -1;
+    buffer_ring = nullptr;
+    sqes = nullptr;
+    sq.memory = cq.memory = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::IoUringUdp::run(Handler handler, std::function<void()> on_ready) {
+    ring_thread = std::this_thread::get_id();
+    arm_wake();
+    arm_receive();
+    bool received = false;
+    bool supported = true;
+    // An unsupported multishot recvmsg is turned down as soon as it is submitted, so it is known before anything is received
+    if(enter(0) >= 0) {
+        unsigned int tail = __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE);
+        for(unsigned int head = *cq.head; head != tail; head++) {
+            const struct io_uring_cqe& cqe = cqes[head & cq.mask];
+            if(cqe.user_data == RECEIVE_TAG && cqe.res == -EINVAL) supported = false;
+        }
+    }
+    if(supported && on_ready) on_ready();
+    bool cancelled = false;
+    while(true) {
+        if(stopped || !supported) {
+            // Nothing may be left in flight, since the kernel still refers to the headers and buffers
+            if(!cancelled) {
+                cancelled = true;
+                for(uint64_t tag : { RECEIVE_TAG, WAKE_TAG }) {
+                    if(!((tag == RECEIVE_TAG) ? receive_armed : wake_armed)) continue;
+                    struct io_uring_sqe * sqe = get_sqe();
+                    if(!sqe) {
+                        cancelled = false; // Tried again on the next round
+                        break;
+                    }
+                    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                    sqe->fd = -1;
+                    sqe->addr = tag;
+                    sqe->user_data = CANCEL_TAG;
+                }
+            }
+            unsent.clear();
+            if(!receive_armed && !wake_armed && sends_in_flight == 0) break;
+        } else {
+            queue_sends();
+        }
+        if(enter(1) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            perror("io_uring_enter");
+            return true; // Requests may still be in flight, so the ring is left for the destructor to tear down
+        }
+
+        unsigned int head = *cq.head;
+        unsigned int tail = __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE);
+        for(; head != tail; head++) {
+            const struct io_uring_cqe& cqe = cqes[head & cq.mask];
+            if(cqe.user_data == RECEIVE_TAG) {
+                if(!(cqe.flags & IORING_CQE_F_MORE)) receive_armed = false; // Re-armed below
+                if(cqe.res < 0) {
+                    if(cqe.res == -EINVAL && !received) supported = false; // Multishot recvmsg needs Linux 6.0
+                    else if(cqe.res != -ENOBUFS && cqe.res != -ECANCELED) std::cerr << "io_uring recvmsg: " << std::strerror(-cqe.res) << "\n";
+                    continue;
+                }
+                received = true;
+                if(!(cqe.flags & IORING_CQE_F_BUFFER)) continue;
+                uint16_t buffer_id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                const uint8_t * buffer = &buffers[buffer_id * buffer_size];
+                // The kernel writes a header, then the sender's address and then the datagram
+                const struct io_uring_recvmsg_out * out = reinterpret_cast<const struct io_uring_recvmsg_out *>(buffer);
+                if(!(out->flags & MSG_TRUNC) && out->namelen == sizeof(struct sockaddr_in)) {
+                    struct sockaddr_in sender;
+                    std::memcpy(&sender, buffer + sizeof(*out), sizeof(sender));
+                    const uint8_t * payload = buffer + sizeof(*out) + receive_header.msg_namelen + receive_header.msg_controllen;
+                    handler(payload, out->payloadlen, sender);
+                }
+                recycle_buffer(buffer_id);
+            } else if(cqe.user_data == WAKE_TAG) {
+                wake_armed = false;
+            } else if(cqe.user_data != CANCEL_TAG) {
+                delete reinterpret_cast<Send *>(cqe.user_data); // A full socket buffer drops the datagram, as sendto would
+                sends_in_flight--;
+            }
+        }
+        __atomic_store_n(cq.head, head, __ATOMIC_RELEASE);
+        __atomic_store_n(&buffer_ring->tail, buffer_tail, __ATOMIC_RELEASE); // Hands the buffers that were read back to the kernel
+
+        if(!stopped && supported) {
+            if(!wake_armed) arm_wake();
+            if(!receive_armed) arm_receive();
+        }
+    }
+    return supported;
+}
+
+void neroshop::IoUringUdp::stop() {
+    stopped = true;
+    uint64_t value = 1;
+    ::write(wake_fd, &value, sizeof(value));
+}
+
+void neroshop::IoUringUdp::send(const struct sockaddr_in& destination, std::vector<uint8_t> message) {
+    std::unique_ptr<Send> request(new Send());
+    request->message = std::move(message);
+    request->destination = destination;
+    bool wake_up;
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        wake_up = outbox.empty(); // Otherwise the ring thread has already been woken up for the outbox
+        outbox.push_back(std::move(request));
+    }
+    if(wake_up && std::this_thread::get_id() != ring_thread) {
+        uint64_t value = 1;
+        ::write(wake_fd, &value, sizeof(value));
+    }
+}
+
+uint64_t neroshop::IoUringUdp::get_enter_count() const {
+    return enter_count;
+}
+
+//-----------------------------------------------------------------------------
+
+struct io_uring_sqe * neroshop::IoUringUdp::get_sqe() {
+    unsigned int head = __atomic_load_n(sq.head, __ATOMIC_ACQUIRE);
+    if(sq_tail - head > sq.mask) return nullptr;
+    struct io_uring_sqe * sqe = &sqes[sq_tail & sq.mask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_tail++;
+    return sqe;
+}
+
+void neroshop::IoUringUdp::arm_receive() {
+    struct io_uring_sqe * sqe = get_sqe();
+    if(!sqe) return; // Armed on the next round
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = sockfd;
+    sqe->addr = reinterpret_cast<uint64_t>(&receive_header);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = RECEIVE_TAG;
+    receive_armed = true;
+}
+
+void neroshop::IoUringUdp::arm_wake() {
+    struct io_uring_sqe * sqe = get_sqe();
+    if(!sqe) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wake_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&wake_value);
+    sqe->len = sizeof(wake_value);
+    sqe->user_data = WAKE_TAG;
+    wake_armed = true;
+}
+
+void neroshop::IoUringUdp::queue_sends() {
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        for(auto& request : outbox) unsent.push_back(std::move(request));
+        outbox.clear();
+    }
+    while(!unsent.empty()) {
+        struct io_uring_sqe * sqe = get_sqe();
+        if(!sqe) return; // Sent once the kernel has taken the entries that are queued
+        Send * request = unsent.front().release();
+        unsent.pop_front();
+        request->iov.iov_base = request->message.data();
+        request->iov.iov_len = request->message.size();
+        std::memset(&request->header, 0, sizeof(request->header));
+        request->header.msg_name = &request->destination;
+        request->header.msg_namelen = sizeof(request->destination);
+        request->header.msg_iov = &request->iov;
+        request->header.msg_iovlen = 1;
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = sockfd;
+        sqe->addr = reinterpret_cast<uint64_t>(&request->header);
+        sqe->len = 1;
+        sqe->user_data = reinterpret_cast<uint64_t>(request);
+        sends_in_flight++;
+    }
+}
+
+void neroshop::IoUringUdp::recycle_buffer(uint16_t buffer_id) {
+    // Not buffer_ring->bufs, which the kernel header's flexible array puts 8 bytes too far in C++. The entries start at the ring itself
+    struct io_uring_buf * entry = reinterpret_cast<struct io_uring_buf *>(buffer_ring) + (buffer_tail & (buffer_count - 1));
+    entry->addr = reinterpret_cast<uint64_t>(&buffers[buffer_id * buffer_size]);
+    entry->len = buffer_size;
+    entry->bid = buffer_id;
+    buffer_tail++; // Published to the kernel after each batch of completions
+}
+
+int neroshop::IoUringUdp::enter(unsigned int wait_count) {
+    __atomic_store_n(sq.tail, sq_tail, __ATOMIC_RELEASE);
+    unsigned int to_submit = sq_tail - __atomic_load_n(sq.head, __ATOMIC_ACQUIRE);
+    enter_count++;
+    return io_uring_enter(ring_fd, to_submit, wait_count, (wait_count > 0) ? IORING_ENTER_GETEVENTS : 0);
+}
+
+#endif // NEROSHOP_USE_IO_URING
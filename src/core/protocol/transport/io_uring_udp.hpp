@@ -0,0 +1,99 @@
+#pragma once
+#ifndef IO_URING_UDP_HPP_NEROSHOP
+#define IO_URING_UDP_HPP_NEROSHOP
+
+#if defined(NEROSHOP_USE_IO_URING)
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+// io_uring backend of a UDP socket (Linux 6.0 or later). One multishot recvmsg keeps receiving into a ring of provided buffers, so no
+// system call is made per datagram, and the datagrams that are sent while the ring thread handles a batch go out together with the next wait
+// in a single io_uring_enter. Uses the raw system calls, so liburing is not needed
+class IoUringUdp {
+public:
+    // Called on the ring thread with a datagram that is only valid until it returns
+    using Handler = std::function<void(const uint8_t * data, std::size_t size, const struct sockaddr_in& sender)>;
+
+    // Throws if io_uring or provided buffer rings are not available. sockfd stays owned by the caller
+    IoUringUdp(int sockfd, unsigned int entries = NEROSHOP_IO_URING_ENTRIES, unsigned int buffer_count = NEROSHOP_IO_URING_BUFFER_COUNT);
+    ~IoUringUdp();
+    IoUringUdp(const IoUringUdp&) = delete;
+    IoUringUdp& operator=(const IoUringUdp&) = delete;
+
+    // Until stop(). Returns false right away if the kernel does not support multishot recvmsg, otherwise on_ready is called first
+    bool run(Handler handler, std::function<void()> on_ready = nullptr);
+    void stop(); // Can be called from any thread
+    void send(const struct sockaddr_in& destination, std::vector<uint8_t> message); // Can be called from any thread
+
+    uint64_t get_enter_count() const; // io_uring_enter calls made so far
+private:
+    struct Send {
+        std::vector<uint8_t> message;
+        struct sockaddr_in destination;
+        struct iovec iov;
+        struct msghdr header;
+    };
+    struct Ring { // A mapped ring of the kernel
+        void * memory = nullptr;
+        std::size_t size = 0;
+        unsigned int * head;
+        unsigned int * tail;
+        unsigned int mask;
+    };
+
+    int sockfd;
+    int ring_fd;
+    int wake_fd; // eventfd that is read through the ring, so that send() from another thread wakes the ring thread up
+    uint64_t wake_value;
+    Ring sq;
+    unsigned int * sq_array;
+    struct io_uring_sqe * sqes;
+    std::size_t sqes_size;
+    Ring cq;
+    struct io_uring_cqe * cqes;
+    unsigned int sq_tail; // Published to the kernel on the next io_uring_enter
+    // Provided buffers that the kernel picks from for each datagram
+    struct io_uring_buf_ring * buffer_ring;
+    std::size_t buffer_ring_size;
+    std::vector<uint8_t> buffers;
+    unsigned int buffer_count;
+    std::size_t buffer_size;
+    uint16_t buffer_tail;
+    struct msghdr receive_header; // Tells the kernel how much room to leave for the sender's address
+    std::size_t sends_in_flight;
+    bool receive_armed;
+    bool wake_armed;
+    std::deque<std::unique_ptr<Send>> unsent; // Ready, waiting for room in the submission queue. Only touched by the ring thread
+    std::mutex outbox_mutex;
+    std::vector<std::unique_ptr<Send>> outbox; // Filled by other threads
+    std::thread::id ring_thread;
+    std::atomic<bool> stopped;
+    std::atomic<uint64_t> enter_count;
+
+    struct io_uring_sqe * get_sqe(); // nullptr if the submission queue is full
+    void arm_receive();
+    void arm_wake();
+    void queue_sends();
+    void recycle_buffer(uint16_t buffer_id);
+    int enter(unsigned int wait_count);
+    void close_ring();
+};
+
+}
+
+#endif // NEROSHOP_USE_IO_URING
+#endif
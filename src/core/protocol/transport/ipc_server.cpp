@@ -0,0 +1,374 @@
+#include "ipc_server.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio> // perror
+#include <cstring> // memcpy
+#include <iostream>
+
+#include "../../tools/logger.hpp"
+
+neroshop::IpcServer::IpcServer(Handler handler, std::size_t worker_count)
+    : handler(std::move(handler)), epoll_fd(-1), wake_fd(-1), next_client_id(1), client_count(0), stopped(false),
+      pool([this](uint64_t client_id, const std::vector<uint8_t>& request) { post({ client_id, this->handler(client_id, request), true }); }, worker_count)
+{
+    epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(epoll_fd == -1 || wake_fd == -1) {
+        perror("epoll_create1/eventfd");
+        throw std::runtime_error("Failed to create the IPC event loop");
+    }
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+}
+
+neroshop::IpcServer::~IpcServer() {
+    pool.stop(); // Workers post to wake_fd, so they are done before it is closed
+
+    for(auto& [fd, connection] : connections) ::close(fd);
+    for(auto& [fd, is_unix] : listeners) ::close(fd);
+    for(const auto& path : socket_paths) ::unlink(path.c_str());
+    if(wake_fd != -1) ::close(wake_fd);
+    if(epoll_fd != -1) ::close(epoll_fd);
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::IpcServer::listen(const std::string& address, unsigned int port) {
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if(::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Invalid IPC address: " << address << "\n";
+        return false;
+    }
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+        perror("socket");
+        return false;
+    }
+    int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if(::bind(fd, (sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror("bind");
+        ::close(fd);
+        return false;
+    }
+    return add_listener(fd, false);
+}
+
+bool neroshop::IpcServer::listen_unix(const std::string& path) {
+    sockaddr_un addr {};
+    if(path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Unix socket path is too long: " << path << "\n";
+        return false;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1) {
+        perror("socket");
+        return false;
+    }
+    // A socket file left behind by a daemon that did not exit cleanly would make bind fail. Anything that is not a socket is left alone
+    struct stat path_stat;
+    if(::lstat(path.c_str(), &path_stat) == 0 && S_ISSOCK(path_stat.st_mode)) {
+        ::unlink(path.c_str());
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    if(::bind(fd, (sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror("bind");
+        ::close(fd);
+        return false;
+    }
+    socket_paths.push_back(path);
+    ::chmod(path.c_str(), S_IRUSR | S_IWUSR); // Only the user who runs the daemon may connect
+    return add_listener(fd, true);
+}
+
+bool neroshop::IpcServer::add_listener(int fd, bool is_unix) {
+    if(::listen(fd, SOMAXCONN) == -1) {
+        perror("listen");
+        ::close(fd);
+        return false;
+    }
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        perror("epoll_ctl");
+        ::close(fd);
+        return false;
+    }
+    listeners[fd] = is_unix;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::IpcServer::run() {
+    while(!stopped) {
+        if(!poll(-1)) break;
+    }
+}
+
+bool neroshop::IpcServer::run_once() {
+    return !stopped && poll(0) && !stopped;
+}
+
+bool neroshop::IpcServer::poll(int timeout) {
+    epoll_event events[64];
+    int event_count = ::epoll_wait(epoll_fd, events, 64, timeout);
+    if(event_count == -1) {
+        if(errno == EINTR) return true;
+        perror("epoll_wait");
+        return false;
+    }
+    for(int i = 0; i < event_count; i++) {
+        int fd = events[i].data.fd;
+        if(fd == wake_fd) {
+            uint64_t value;
+            while(::read(wake_fd, &value, sizeof(value)) > 0) {}
+            flush_outbox();
+            continue;
+        }
+        auto listener = listeners.find(fd);
+        if(listener != listeners.end()) {
+            accept_clients(fd, listener->second);
+            continue;
+        }
+        auto it = connections.find(fd);
+        if(it == connections.end()) continue; // Closed earlier in this batch
+        Connection& connection = *it->second;
+        if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            read_from(connection); // Also notices errors and hang-ups
+            if(connections.find(fd) == connections.end()) continue;
+        }
+        if(events[i].events & EPOLLOUT) {
+            flush(connection);
+        }
+    }
+    return true;
+}
+
+void neroshop::IpcServer::stop() {
+    stopped = true;
+    uint64_t value = 1;
+    ::write(wake_fd, &value, sizeof(value));
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::IpcServer::accept_clients(int listen_fd, bool is_unix) {
+    while(true) {
+        int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd == -1) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("accept4");
+            if(errno == EINTR) continue;
+            return;
+        }
+        if(connections.size() >= NEROSHOP_IPC_MAX_CLIENTS) {
+            neroshop::print("IPC client refused: too many clients are connected", 1);
+            ::close(fd);
+            continue;
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->id = next_client_id++;
+        connection->handshake_pending = is_unix;
+        connection->events = EPOLLIN;
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            perror("epoll_ctl");
+            ::close(fd);
+            continue;
+        }
+        NEROSHOP_LOG(log_level::debug, "IPC client " << connection->id << " connected\n");
+        client_fds[connection->id] = fd;
+        connections[fd] = std::move(connection);
+        client_count = connections.size();
+    }
+}
+
+void neroshop::IpcServer::read_from(Connection& connection) {
+    if(connection.handshake_pending) {
+        if(!read_handshake(connection)) return;
+    }
+
+    uint8_t buffer[65536];
+    std::size_t total_read = 0;
+    while(total_read < READ_BUDGET) {
+        ssize_t bytes_read = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+        if(bytes_read == 0) {
+            close_connection(connection);
+            return;
+        }
+        if(bytes_read == -1) {
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close_connection(connection);
+            return;
+        }
+        if(!connection.reader.feed(buffer, bytes_read)) {
+            std::cerr << "IPC client " << connection.id << " sent a frame that is too large\n";
+            close_connection(connection);
+            return;
+        }
+        total_read += bytes_read;
+    }
+
+    std::vector<std::vector<uint8_t>> requests;
+    std::vector<uint8_t> frame;
+    while(connection.reader.next(frame)) {
+        if(connection.reader.get_ring_size() != 0) { // Clients never write to the ring
+            close_connection(connection);
+            return;
+        }
+        requests.push_back(std::move(frame));
+    }
+    connection.outstanding += requests.size();
+    pool.push(connection.id, requests);
+    update_events(connection);
+}
+
+bool neroshop::IpcServer::read_handshake(Connection& connection) {
+    std::vector<uint8_t> frame;
+    int ring_fd = -1;
+    ssize_t frame_size = framing::receive_frame_with_fd(connection.fd, frame, ring_fd, 1);
+    if(frame_size == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false; // Nothing to read yet
+    if(frame_size != 1 || frame[0] != framing::HANDSHAKE) {
+        if(ring_fd != -1) ::close(ring_fd);
+        close_connection(connection);
+        return false;
+    }
+    connection.handshake_pending = false;
+    if(ring_fd != -1) {
+        connection.ring = ShmRing::attach(ring_fd); // Takes ownership of ring_fd
+        if(!connection.ring) {
+            close_connection(connection);
+            return false;
+        }
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::IpcServer::send(uint64_t client_id, std::vector<uint8_t> message) {
+    post({ client_id, std::move(message), false });
+}
+
+void neroshop::IpcServer::post(Outgoing outgoing) {
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        outbox.push_back(std::move(outgoing));
+    }
+    uint64_t value = 1;
+    ::write(wake_fd, &value, sizeof(value));
+}
+
+void neroshop::IpcServer::flush_outbox() {
+    std::vector<Outgoing> messages;
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        messages.swap(outbox);
+    }
+    std::vector<int> touched;
+    for(auto& message : messages) {
+        auto client_fd = client_fds.find(message.client_id);
+        if(client_fd == client_fds.end()) continue; // The client has disconnected
+        Connection& connection = *connections[client_fd->second];
+        if(message.is_response && connection.outstanding > 0) connection.outstanding--;
+        if(connection.write_buffer.size() == connection.write_offset) touched.push_back(connection.fd);
+        // Large responses go through the ring when the client set one up. If it is full they are sent over the socket instead
+        bool in_ring = connection.ring && message.message.size() >= NEROSHOP_IPC_SHM_THRESHOLD
+            && framing::append_frame(connection.write_buffer, message.message, *connection.ring);
+        if(!in_ring) framing::append_frame(connection.write_buffer, message.message);
+    }
+    for(int fd : touched) {
+        auto it = connections.find(fd);
+        if(it == connections.end()) continue;
+        flush(*it->second);
+    }
+}
+
+void neroshop::IpcServer::flush(Connection& connection) {
+    while(connection.write_offset < connection.write_buffer.size()) {
+        ssize_t bytes_sent = ::send(connection.fd, connection.write_buffer.data() + connection.write_offset,
+            connection.write_buffer.size() - connection.write_offset, MSG_NOSIGNAL);
+        if(bytes_sent == -1) {
+            if(errno == EINTR) continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+            close_connection(connection);
+            return;
+        }
+        connection.write_offset += bytes_sent;
+    }
+    if(connection.write_offset == connection.write_buffer.size()) {
+        connection.write_buffer.clear();
+        connection.write_offset = 0;
+    } else if(connection.write_offset >= MAX_WRITE_BACKLOG) {
+        connection.write_buffer.erase(connection.write_buffer.begin(), connection.write_buffer.begin() + connection.write_offset);
+        connection.write_offset = 0;
+    }
+    update_events(connection);
+}
+
+// A client is only read from while it has room for more requests and is keeping up with its responses,
+// so a client that floods the daemon or never reads cannot make it buffer without bound
+void neroshop::IpcServer::update_events(Connection& connection) {
+    std::size_t backlog = connection.write_buffer.size() - connection.write_offset;
+    uint32_t events = 0;
+    if(connection.outstanding < NEROSHOP_IPC_MAX_IN_FLIGHT && backlog < MAX_WRITE_BACKLOG) events |= EPOLLIN;
+    if(backlog > 0) events |= EPOLLOUT;
+    if(events == connection.events) return;
+    epoll_event event {};
+    event.events = events;
+    event.data.fd = connection.fd;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+void neroshop::IpcServer::close_connection(Connection& connection) {
+    uint64_t client_id = connection.id;
+    int fd = connection.fd;
+    ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    NEROSHOP_LOG(log_level::debug, "IPC client " << client_id << " disconnected\n");
+    pool.remove_client(client_id);
+    DisconnectHandler on_disconnect;
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        on_disconnect = disconnect_handler;
+    }
+    if(on_disconnect) pool.post([on_disconnect, client_id]() { on_disconnect(client_id); });
+    client_fds.erase(client_id);
+    connections.erase(fd); // Destroys connection
+    client_count = connections.size();
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::IpcServer::set_disconnect_handler(DisconnectHandler disconnect_handler) {
+    std::lock_guard<std::mutex> lock(outbox_mutex);
+    this->disconnect_handler = std::move(disconnect_handler);
+}
+
+std::size_t neroshop::IpcServer::get_client_count() const {
+    return client_count;
+}
+
+int neroshop::IpcServer::get_fd() const {
+    return epoll_fd;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory> // std::unique_ptr
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "framing.hpp"
+#include "shm_ring.hpp"
+#include "worker_pool.hpp"
+#include "../../../neroshop_config.hpp"
+
+namespace neroshop {
+
+// Event-driven IPC server for the local GUI, CLI and scripts. One thread waits on every socket with epoll and does all of the
+// reading and writing without blocking, while requests are handled on a WorkerPool that serves the clients in turn
+class IpcServer {
+public:
+    using Handler = std::function<std::vector<uint8_t>(uint64_t client_id, const std::vector<uint8_t>& request)>;
+    using DisconnectHandler = std::function<void(uint64_t client_id)>;
+
+    IpcServer(Handler handler, std::size_t worker_count = NEROSHOP_IPC_WORKER_COUNT);
+    ~IpcServer();
+    IpcServer(const IpcServer&) = delete;
+    IpcServer& operator=(const IpcServer&) = delete;
+
+    bool listen(const std::string& address, unsigned int port); // tcp
+    bool listen_unix(const std::string& path);
+    void run(); // Serves clients until stop() is called
+    // Handles whatever is ready without waiting, for when another event loop drives the server by watching get_fd() for readability.
+    // Returns false once stop() was called
+    bool run_once();
+    void stop(); // Can be called from any thread
+    void send(uint64_t client_id, std::vector<uint8_t> message); // Queues a message that the client did not ask for. Can be called from any thread
+
+    void set_disconnect_handler(DisconnectHandler disconnect_handler); // Called on a worker thread
+
+    std::size_t get_client_count() const;
+    int get_fd() const; // The epoll descriptor. It is readable whenever run_once() has something to do
+private:
+    struct Connection {
+        int fd;
+        uint64_t id;
+        bool handshake_pending; // Clients on the Unix socket send a handshake frame first
+        framing::FrameReader reader;
+        std::vector<uint8_t> write_buffer;
+        std::size_t write_offset = 0; // Bytes of write_buffer that have already been sent
+        std::unique_ptr<ShmRing> ring;
+        std::size_t outstanding = 0; // Requests that are queued or being handled
+        uint32_t events = 0; // epoll events that are currently enabled
+    };
+    struct Outgoing {
+        uint64_t client_id;
+        std::vector<uint8_t> message;
+        bool is_response;
+    };
+    static constexpr std::size_t READ_BUDGET = 262144; // Bytes read from one client per wakeup, so that one client cannot hold up the event loop
+    static constexpr std::size_t MAX_WRITE_BACKLOG = 4194304; // A client whose unsent responses exceed this is not read from until it catches up
+
+    Handler handler;
+    DisconnectHandler disconnect_handler; // Guarded by outbox_mutex
+    int epoll_fd;
+    int wake_fd; // eventfd that wakes the event loop up when workers have responses for it
+    std::unordered_map<int, bool> listeners; // fd -> is a Unix domain socket
+    std::vector<std::string> socket_paths;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections; // By fd. Only touched by the event loop
+    std::unordered_map<uint64_t, int> client_fds; // Client id -> fd. Ids are never reused so a late response cannot reach the wrong client
+    uint64_t next_client_id;
+    std::atomic<std::size_t> client_count;
+    std::atomic<bool> stopped;
+    // Filled by the workers, emptied by the event loop
+    std::mutex outbox_mutex;
+    std::vector<Outgoing> outbox;
+    WorkerPool pool; // Last, so that it is created after everything that the workers use
+
+    bool poll(int timeout); // Waits up to timeout milliseconds (-1 for no limit) and handles the events. Returns false on an epoll error
+    bool add_listener(int fd, bool is_unix);
+    void accept_clients(int listen_fd, bool is_unix);
+    void read_from(Connection& connection);
+    bool read_handshake(Connection& connection);
+    void flush(Connection& connection);
+    void flush_outbox();
+    void update_events(Connection& connection);
+    void close_connection(Connection& connection);
+    void post(Outgoing outgoing);
+};
+
+}
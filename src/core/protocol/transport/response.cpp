@@ -0,0 +1,106 @@
+#include "response.hpp"
+
+static const nlohmann::json null_json;
+static const nlohmann::json discarded_json(nlohmann::json::value_t::discarded);
+
+neroshop::Response::Response() {}
+
+neroshop::Response::Response(nlohmann::json response_object) {
+    auto new_data = std::make_shared<Data>();
+    new_data->object = std::move(response_object);
+    data = std::move(new_data);
+}
+
+//-----------------------------------------------------------------------------
+
+neroshop::Response::Status neroshop::Response::get_status() const {
+    if(!data || !data->object.is_object()) return Status::NoResponse;
+    return data->object.contains("error") ? Status::Error : Status::Ok;
+}
+
+bool neroshop::Response::is_ok() const {
+    return get_status() == Status::Ok;
+}
+
+int neroshop::Response::get_error_code() const {
+    if(get_status() == Status::NoResponse) return -1;
+    const nlohmann::json& object = data->object;
+    if(!object.contains("error") || !object["error"].is_object()) return 0;
+    return object["error"].value("code", 0);
+}
+
+std::string neroshop::Response::get_error_message() const {
+    Status status = get_status();
+    if(status == Status::NoResponse) return "No response from the daemon";
+    if(status == Status::Ok) return "";
+    const nlohmann::json& error = data->object["error"];
+    return (error.is_object()) ? error.value("message", "") : "";
+}
+
+//-----------------------------------------------------------------------------
+
+const nlohmann::json& neroshop::Response::get_object() const {
+    return (data) ? data->object : null_json;
+}
+
+const nlohmann::json& neroshop::Response::get_result() const {
+    if(get_status() != Status::Ok) return null_json;
+    auto it = data->object.find("response");
+    return (it != data->object.end()) ? *it : null_json;
+}
+
+const nlohmann::json * neroshop::Response::find_value(const std::string& key) const {
+    const nlohmann::json& result = get_result();
+    if(!result.is_object()) return nullptr;
+    const nlohmann::json * container = &result;
+    if(!key.empty()) {
+        auto values = result.find("values");
+        if(values == result.end() || !values->is_object()) return nullptr;
+        container = &(*values);
+    }
+    auto it = container->find(key.empty() ? "value" : key);
+    if(it == container->end() || !it->is_string()) return nullptr;
+    return &(*it);
+}
+
+std::string_view neroshop::Response::get_value() const {
+    const nlohmann::json * value = find_value("");
+    return (value) ? std::string_view(value->get_ref<const std::string&>()) : std::string_view();
+}
+
+std::string_view neroshop::Response::get_value(const std::string& key) const {
+    const nlohmann::json * value = find_value(key);
+    return (value) ? std::string_view(value->get_ref<const std::string&>()) : std::string_view();
+}
+
+const nlohmann::json& neroshop::Response::parse_value(const std::string& key, const nlohmann::json * value) const {
+    if(value == nullptr) return discarded_json;
+    std::lock_guard<std::mutex> lock(data->parse_mutex);
+    auto it = data->parsed_values.find(key);
+    if(it == data->parsed_values.end()) { // Elements of an unordered_map do not move, so references to them stay valid as more values are parsed
+        it = data->parsed_values.emplace(key, nlohmann::json::parse(value->get_ref<const std::string&>(), nullptr, false)).first;
+    }
+    return it->second;
+}
+
+const nlohmann::json& neroshop::Response::get_value_json() const {
+    return parse_value("", find_value(""));
+}
+
+const nlohmann::json& neroshop::Response::get_value_json(const std::string& key) const {
+    return parse_value(key, find_value(key));
+}
+
+std::vector<std::string> neroshop::Response::get_keys() const {
+    std::vector<std::string> keys;
+    const nlohmann::json& result = get_result();
+    if(!result.is_object() || !result.contains("values") || !result["values"].is_object()) return keys;
+    for(const auto& item : result["values"].items()) keys.push_back(item.key());
+    return keys;
+}
+
+//-----------------------------------------------------------------------------
+
+std::string neroshop::Response::dump() const {
+    return (data && !data->object.is_null()) ? data->object.dump() : "";
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory> // std::shared_ptr
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace neroshop {
+
+// Decoded response of the daemon to a Client request. The message is decoded from msgpack once, when it arrives,
+// and each stored value (which is itself json) is parsed at most once, the first time it is asked for.
+// Copies share the decoded message and the parsed values, so a response can be handed around and read from any thread
+class Response {
+public:
+    enum class Status {
+        Ok,
+        Error, // The daemon answered with an error
+        NoResponse, // Not connected, the connection was lost or the daemon did not answer in time
+    };
+
+    Response(); // NoResponse
+    explicit Response(nlohmann::json response_object);
+
+    Status get_status() const;
+    bool is_ok() const;
+    int get_error_code() const; // KadResultCode. -1 if there was no response
+    std::string get_error_message() const;
+
+    const nlohmann::json& get_object() const; // The whole message. Null if there was no response
+    const nlohmann::json& get_result() const; // Its "response" object
+    // The value of a get, or of one key of a get_many. The view stays valid as long as a copy of this response exists
+    std::string_view get_value() const;
+    std::string_view get_value(const std::string& key) const;
+    // The same values parsed as json. Discarded (see nlohmann::json::is_discarded) if there is no such value or it is not json
+    const nlohmann::json& get_value_json() const;
+    const nlohmann::json& get_value_json(const std::string& key) const;
+    std::vector<std::string> get_keys() const; // Keys that a get_many found
+
+    std::string dump() const; // The whole message as a json string. Empty if there was no response
+private:
+    struct Data {
+        nlohmann::json object;
+        mutable std::mutex parse_mutex;
+        mutable std::unordered_map<std::string, nlohmann::json> parsed_values; // By key. The value of a get is under ""
+    };
+    std::shared_ptr<const Data> data;
+    const nlohmann::json * find_value(const std::string& key) const; // The key is ignored for a get
+    const nlohmann::json& parse_value(const std::string& key, const nlohmann::json * value) const;
+};
+
+}
@@ -1,5 +1,8 @@
 #include "server.hpp"
 
+#include <sys/stat.h> // chmod
+#include <sys/un.h> // sockaddr_un
+
 #include <cassert>
 
 #include "../../tools/logger.hpp"
@@ -27,6 +30,11 @@ neroshop::Server::Server(SocketType socket_type) : sockfd(-1), socket_type(socke
 neroshop::Server::Server(const std::string& address, unsigned int port, SocketType socket_type) : sockfd(-1), socket_type(socket_type) {
     init_socket(address, port);
 }
+
+neroshop::Server::Server(const std::string& path, SocketType socket_type) : sockfd(-1), socket_type(socket_type) {
+    assert(socket_type == SocketType::Socket_Unix && "Socket is not a Unix domain socket");
+    init_unix_socket(path);
+}
 ////////////////////
 neroshop::Server::~Server() {
     if(sockfd > 0) {
@@ -117,9 +125,9 @@ bool neroshop::Server::listen(int backlog)
 }
 ////////////////////
 bool neroshop::Server::accept() {
-    struct sockaddr_in client_addr;
+    struct sockaddr_in client_addr = {};
     socklen_t addr_len = sizeof(client_addr);
-    int client_fd = ::accept(sockfd, (struct sockaddr*) &client_addr, &addr_len);
+    int client_fd = (socket_type == SocketType::Socket_Unix) ? ::accept(sockfd, nullptr, nullptr) : ::accept(sockfd, (struct sockaddr*) &client_addr, &addr_len);
 
     if (client_fd == -1) {
         perror("accept");
@@ -127,6 +135,17 @@ bool neroshop::Server::accept() {
     }
     
     // Add the new client to the list of connected clients
+    frame_reader.clear(); // Discard whatever the previous client left unfinished
+    ring.reset();
+    if (socket_type == SocketType::Socket_Unix) {
+        if (!accept_handshake(client_fd)) {
+            ::close(client_fd);
+            return false;
+        }
+        clients.emplace_back(std::make_unique<Client>(client_fd, client_addr));
+        std::cout << "\033[0;37mReceived connection on " + socket_path + ((ring) ? " (shared memory)" : "") + "\033[0m\n";
+        return true;
+    }
     auto client = std::make_unique<Client>(client_fd, client_addr);
     clients.emplace_back(std::move(client));
     
@@ -134,6 +153,21 @@ bool neroshop::Server::accept() {
     return true;
 }
 ////////////////////
+bool neroshop::Server::accept_handshake(int client_fd) {
+    std::vector<uint8_t> handshake;
+    int ring_fd = -1;
+    if (framing::receive_frame_with_fd(client_fd, handshake, ring_fd, 1) <= 0 || handshake[0] != framing::HANDSHAKE) {
+        std::cerr << "Client did not complete the handshake" << std::endl;
+        if (ring_fd != -1) ::close(ring_fd);
+        return false;
+    }
+    if (ring_fd != -1) {
+        ring = ShmRing::attach(ring_fd);
+        if (!ring) std::cerr << "Ignoring invalid shared-memory ring from client" << std::endl; // The client will then get every response over the socket
+    }
+    return true;
+}
+////////////////////
 void neroshop::Server::write(const std::string& message) {
     #if defined(__gnu_linux__) && defined(NEROSHOP_USE_SYSTEM_SOCKETS)
 	ssize_t write_result = ::write(clients.back()->sockfd, message.c_str(), message.length()/*buffer, strlen(buffer)*/);
@@ -165,26 +199,18 @@ std::string neroshop::Server::read() // receive data
 }
 ////////////////////
 void neroshop::Server::send(const std::vector<uint8_t>& message) {
-    assert(socket_type == SocketType::Socket_TCP && "Socket is not TCP");
+    assert(socket_type != SocketType::Socket_UDP && "Socket is not TCP");
 
     if (message.empty()) {
         std::cerr << "Message is empty!" << std::endl;
         return;
     }
     
-    const uint8_t* data = message.data();
-    size_t size = message.size();
-    
-    // use a loop to repeatedly call send() until all the bytes are sent
-    size_t total_sent = 0;
-    while (total_sent < size) {
-        int bytes_sent = ::send(clients.back()->sockfd, data + total_sent, size - total_sent, 0);
-        if (bytes_sent == -1) {
-            perror("send");
-            break;
-        }
-        total_sent += bytes_sent;
+    // The receiver knows where the message ends from the length prefix, so large messages can span any number of reads
+    if (ring && message.size() >= NEROSHOP_IPC_SHM_THRESHOLD && framing::send_frame(clients.back()->sockfd, message, *ring)) {
+        return;
     }
+    framing::send_frame(clients.back()->sockfd, message); // Also when the ring is too full to take the message
 }
 
 void neroshop::Server::send_to(const std::vector<uint8_t>& message, const struct sockaddr_in& addr) {
@@ -210,18 +236,11 @@ void neroshop::Server::send_to(const std::vector<uint8_t>& message, const struct
 }
 ////////////////////
 ssize_t neroshop::Server::receive(std::vector<uint8_t>& message) { 
-    assert(socket_type == SocketType::Socket_TCP && "Socket is not TCP");
-
-    const int BUFFER_SIZE = 4096;
-        
-    std::vector<uint8_t> buffer(BUFFER_SIZE);
-    ssize_t recv_bytes = ::recv(clients.back()->sockfd, buffer.data(), BUFFER_SIZE, 0); // In the case of TCP, the server should receive from the client's sockfd, as this is the socket that is connected to the client and is used to communicate with the client.
+    assert(socket_type != SocketType::Socket_UDP && "Socket is not TCP");
+    // In the case of TCP, the server should receive from the client's sockfd, as this is the socket that is connected to the client and is used to communicate with the client.
+    ssize_t recv_bytes = framing::receive_frame(clients.back()->sockfd, frame_reader, message);
     if (recv_bytes == -1) {
         perror("recv");
-        return recv_bytes;
-    }
-    if (recv_bytes > 0) {
-        message.assign(buffer.data(), buffer.data() + recv_bytes);
     }
     return recv_bytes;
 }
@@ -252,6 +271,11 @@ void neroshop::Server::close() {
     // Close all connected clients
     for (auto& client : clients) client->close();
     clients.clear();
+    ring.reset();
+    if (!socket_path.empty()) {
+        ::unlink(socket_path.c_str());
+        socket_path.clear();
+    }
 }
 ////////////////////
 void neroshop::Server::shutdown() {
@@ -287,6 +311,37 @@ The setsockopt() function is used to set the socket option, and the SO_REUSEADDR
 	#endif    
 }
 ////////////////////
+void neroshop::Server::init_unix_socket(const std::string& path) {
+	#if defined(__gnu_linux__) && defined(NEROSHOP_USE_SYSTEM_SOCKETS)
+    struct sockaddr_un unix_addr = {};
+    if (path.size() >= sizeof(unix_addr.sun_path)) {
+        throw std::runtime_error("Unix socket path is too long");
+    }
+	sockfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+		throw std::runtime_error("Failed to create socket.");
+	}
+	// A socket file left behind by a daemon that did not exit cleanly would make bind fail. Anything that is not a socket is left alone
+	struct stat path_stat;
+	if (::lstat(path.c_str(), &path_stat) == 0 && S_ISSOCK(path_stat.st_mode)) {
+	    ::unlink(path.c_str());
+	}
+	
+    unix_addr.sun_family = AF_UNIX;
+    std::memcpy(unix_addr.sun_path, path.c_str(), path.size());
+    if (::bind(sockfd, (struct sockaddr*)&unix_addr, sizeof(unix_addr)) == -1) {
+        perror("bind");
+        throw std::runtime_error("Failed to bind to " + path);
+    }
+    socket_path = path;
+    ::chmod(path.c_str(), S_IRUSR | S_IWUSR); // Only the user who runs the daemon may connect
+	
+	if(!listen()) {
+	    throw std::runtime_error("Failed to listen for connection");
+	}
+	#endif
+}
+////////////////////
 ////////////////////
 int neroshop::Server::get_socket() const {
     return sockfd;
@@ -326,3 +381,7 @@ void neroshop::Server::set_nonblocking(bool nonblocking) {
     }
 }        
 ////////////////////
+void neroshop::Server::set_max_frame_size(std::size_t max_frame_size) {
+    frame_reader = framing::FrameReader(max_frame_size);
+}
+////////////////////
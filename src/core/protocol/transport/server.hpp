@@ -41,6 +41,7 @@ extern "C" {
 #include <vector>
 
 #include "client.hpp" // Client, SocketType::
+#include "framing.hpp"
 //#include "ip_address.hpp"
 
 #define DEFAULT_BACKLOG 511
@@ -52,6 +53,7 @@ public:
     Server(); // creates TCP socket but requires user to bind and listen manually.
     Server(SocketType socket_type); // creates socket but requires user to bind and listen manually.
     Server(const std::string& address, unsigned int port, SocketType socket_type = SocketType::Socket_TCP); // creates socket, binds, then listens
+    Server(const std::string& path, SocketType socket_type); // creates a Unix domain socket at path, binds, then listens
     
 	~Server();
 	
@@ -67,9 +69,9 @@ public:
 	
 	/* sendto() and recvfrom() are specific to UDP sockets. They are used to send and receive datagrams (packets) over a UDP socket.
     For TCP sockets, you would typically use send() and recv() instead. These functions provide a reliable, stream-oriented data transfer mechanism, rather than the packet-oriented mechanism provided by UDP.*/
-    void send(const std::vector<uint8_t>& message);
+    void send(const std::vector<uint8_t>& message); // tcp - sends the message as a length-prefixed frame
     void send_to(const std::vector<uint8_t>& message, const struct sockaddr_in& addr);
-    ssize_t receive(std::vector<uint8_t>& message);
+    ssize_t receive(std::vector<uint8_t>& message); // tcp - receives exactly one frame, which may have arrived over several reads
     ssize_t receive_from(std::vector<uint8_t>& message, const struct sockaddr_in& addr);
 	void close(); // closes socket
 	void shutdown(); // shuts down entire connection, ending receiving and sending
@@ -80,9 +82,12 @@ public:
 	int get_client_count() const;
 	
 	void set_nonblocking(bool nonblocking); // it is recommended to use non-blocking sockets when implementing DHT (Distributed Hash Table) over UDP.
+	void set_max_frame_size(std::size_t max_frame_size);
 
 private:
     void init_socket(const std::string& address, unsigned int port);
+    void init_unix_socket(const std::string& path);
+    bool accept_handshake(int client_fd);
 
     int sockfd;
     SocketType socket_type;
@@ -90,6 +95,9 @@ private:
     struct sockaddr_in6 addr6;
     struct sockaddr_storage storage;
     std::vector<std::unique_ptr<Client>> clients;
+    framing::FrameReader frame_reader; // Partially received frame of the connected client
+    std::unique_ptr<ShmRing> ring; // Shared-memory ring of the connected client, if it asked for one
+    std::string socket_path; // Unix domain sockets only
     std::string public_ip_address;
     //raft_server_t* raft;
     friend class Node; // node can now access the server's private members
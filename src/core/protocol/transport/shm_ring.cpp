@@ -0,0 +1,123 @@
+#include "shm_ring.hpp"
+
+#include <fcntl.h> // F_ADD_SEALS, F_GET_SEALS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm> // std::min
+#include <cstdio> // perror
+#include <cstring> // memcpy
+#include <new> // placement new
+
+neroshop::ShmRing::ShmRing(int fd, std::size_t mapping_size, Header * header)
+    : fd(fd), mapping_size(mapping_size), capacity(mapping_size - sizeof(Header)), header(header), data(reinterpret_cast<uint8_t *>(header) + sizeof(Header)) {}
+
+neroshop::ShmRing::~ShmRing() {
+    ::munmap(header, mapping_size);
+    ::close(fd);
+}
+
+//-----------------------------------------------------------------------------
+
+std::unique_ptr<neroshop::ShmRing> neroshop::ShmRing::create(std::size_t capacity) {
+    int fd = ::memfd_create("neroshop-ipc-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd == -1) {
+        perror("memfd_create");
+        return nullptr;
+    }
+    std::size_t mapping_size = sizeof(Header) + capacity;
+    if(::ftruncate(fd, mapping_size) == -1) {
+        perror("ftruncate");
+        ::close(fd);
+        return nullptr;
+    }
+    // The daemon refuses a ring whose size can still change, since accessing a page past the end of a shrunk memfd raises SIGBUS
+    if(::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+        perror("fcntl");
+        ::close(fd);
+        return nullptr;
+    }
+    void * memory = ::mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(memory == MAP_FAILED) {
+        perror("mmap");
+        ::close(fd);
+        return nullptr;
+    }
+    Header * header = new (memory) Header();
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    header->capacity = capacity;
+    return std::unique_ptr<ShmRing>(new ShmRing(fd, mapping_size, header));
+}
+
+std::unique_ptr<neroshop::ShmRing> neroshop::ShmRing::attach(int fd) {
+    // The other process could otherwise shrink the memfd after it is mapped and crash us with SIGBUS
+    int seals = ::fcntl(fd, F_GET_SEALS);
+    if(seals == -1 || (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW)) {
+        ::close(fd);
+        return nullptr;
+    }
+    struct stat file_stat;
+    if(::fstat(fd, &file_stat) == -1 || static_cast<std::size_t>(file_stat.st_size) <= sizeof(Header)) {
+        ::close(fd);
+        return nullptr;
+    }
+    std::size_t mapping_size = file_stat.st_size;
+    void * memory = ::mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(memory == MAP_FAILED) {
+        perror("mmap");
+        ::close(fd);
+        return nullptr;
+    }
+    Header * header = reinterpret_cast<Header *>(memory);
+    // The ring comes from another process, so it must describe itself consistently before it is used
+    uint64_t used = header->head.load(std::memory_order_acquire) - header->tail.load(std::memory_order_acquire);
+    if(header->capacity != mapping_size - sizeof(Header) || used > header->capacity) {
+        ::munmap(memory, mapping_size);
+        ::close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<ShmRing>(new ShmRing(fd, mapping_size, header));
+}
+
+//-----------------------------------------------------------------------------
+
+bool neroshop::ShmRing::write(const uint8_t * bytes, std::size_t size) {
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    uint64_t tail = header->tail.load(std::memory_order_acquire); // The consumer is done with everything before tail
+    if(head - tail > capacity || size > capacity - (head - tail)) return false;
+    std::size_t offset = head % capacity;
+    std::size_t first = std::min<std::size_t>(size, capacity - offset); // The rest wraps around to the start
+    std::memcpy(data + offset, bytes, first);
+    std::memcpy(data, bytes + first, size - first);
+    header->head.store(head + size, std::memory_order_release); // Publishes the bytes to the consumer
+    return true;
+}
+
+bool neroshop::ShmRing::read(std::vector<uint8_t>& bytes, std::size_t size) {
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    if(head - tail > capacity || size > head - tail) return false;
+    std::size_t offset = tail % capacity;
+    std::size_t first = std::min<std::size_t>(size, capacity - offset);
+    bytes.resize(size);
+    std::memcpy(bytes.data(), data + offset, first);
+    std::memcpy(bytes.data() + first, data, size - first);
+    header->tail.store(tail + size, std::memory_order_release); // Hands the space back to the producer
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+int neroshop::ShmRing::get_fd() const {
+    return fd;
+}
+
+std::size_t neroshop::ShmRing::get_capacity() const {
+    return capacity;
+}
+
+std::size_t neroshop::ShmRing::get_free_space() const {
+    return capacity - (header->head.load(std::memory_order_acquire) - header->tail.load(std::memory_order_acquire));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory> // std::unique_ptr
+#include <vector>
+
+namespace neroshop {
+
+// Single-producer single-consumer byte ring in shared memory. The GUI creates it and hands its file descriptor to the
+// daemon over the Unix domain socket. The daemon writes large responses into it and only sends a short notice over the
+// socket, so the response bytes do not have to pass through the kernel. The ring is backed by a memfd and is never
+// visible in the file system
+class ShmRing {
+private:
+    struct Header {
+        alignas(64) std::atomic<uint64_t> head; // Total number of bytes written. Only stored by the producer
+        alignas(64) std::atomic<uint64_t> tail; // Total number of bytes read. Only stored by the consumer
+        alignas(64) uint64_t capacity;
+    };
+    int fd;
+    std::size_t mapping_size;
+    std::size_t capacity; // Kept out of shared memory so that the other process cannot change it under us
+    Header * header;
+    uint8_t * data;
+    ShmRing(int fd, std::size_t mapping_size, Header * header);
+public:
+    ~ShmRing();
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+    
+    static std::unique_ptr<ShmRing> create(std::size_t capacity); // Returns nullptr on failure
+    static std::unique_ptr<ShmRing> attach(int fd); // Takes ownership of fd. Returns nullptr if fd is not a valid ring or its size is not sealed
+    
+    bool write(const uint8_t * bytes, std::size_t size); // Producer only. Returns false (and writes nothing) if there is not enough free space
+    bool read(std::vector<uint8_t>& bytes, std::size_t size); // Consumer only. Returns false (and reads nothing) if fewer bytes are available
+    
+    int get_fd() const;
+    std::size_t get_capacity() const;
+    std::size_t get_free_space() const;
+};
+
+}
@@ -0,0 +1,85 @@
+#include "worker_pool.hpp"
+
+neroshop::WorkerPool::WorkerPool(Handler handler, std::size_t worker_count) : handler(std::move(handler)), stopping(false) {
+    if(worker_count == 0) worker_count = 1;
+    for(std::size_t i = 0; i < worker_count; i++) {
+        workers.emplace_back(&WorkerPool::work, this);
+    }
+}
+
+neroshop::WorkerPool::~WorkerPool() {
+    stop();
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::WorkerPool::push(uint64_t client_id, std::vector<std::vector<uint8_t>>& requests) {
+    if(requests.empty()) return;
+    bool notify_all = requests.size() > 1;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        auto& queue = request_queues[client_id];
+        if(queue.empty()) ready_clients.push_back(client_id);
+        for(auto& request : requests) queue.push_back(std::move(request));
+    }
+    requests.clear();
+    if(notify_all) queue_cv.notify_all();
+    else queue_cv.notify_one();
+}
+
+void neroshop::WorkerPool::remove_client(uint64_t client_id) {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    request_queues.erase(client_id); // Workers skip its entry in ready_clients
+}
+
+void neroshop::WorkerPool::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        tasks.push_back(std::move(task));
+    }
+    queue_cv.notify_one();
+}
+
+void neroshop::WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    for(auto& worker : workers) {
+        if(worker.joinable()) worker.join();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::WorkerPool::work() {
+    while(true) {
+        std::function<void()> task;
+        uint64_t client_id = 0;
+        std::vector<uint8_t> request;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]() { return stopping || !tasks.empty() || !ready_clients.empty(); });
+            if(stopping) return;
+            if(!tasks.empty()) {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            } else {
+                client_id = ready_clients.front();
+                ready_clients.pop_front();
+                auto queue = request_queues.find(client_id);
+                if(queue == request_queues.end() || queue->second.empty()) continue; // Removed
+                request = std::move(queue->second.front());
+                queue->second.pop_front();
+                // Round robin: a client with more requests goes to the back of the line behind every other waiting client
+                if(!queue->second.empty()) ready_clients.push_back(client_id);
+            }
+        }
+        if(task) {
+            task();
+            continue;
+        }
+        handler(client_id, request);
+    }
+}
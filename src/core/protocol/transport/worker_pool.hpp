@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace neroshop {
+
+// Threads that handle the requests of the IPC servers' clients. Each client has its own request queue and the workers take one request
+// from each client in turn, so a client that sends a burst of bulk requests only delays an interactive client by about one request
+// rather than by its whole backlog
+class WorkerPool {
+public:
+    using Handler = std::function<void(uint64_t client_id, const std::vector<uint8_t>& request)>;
+
+    WorkerPool(Handler handler, std::size_t worker_count);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void push(uint64_t client_id, std::vector<std::vector<uint8_t>>& requests); // Moves the requests into the client's queue
+    void remove_client(uint64_t client_id); // Requests of the client that were not taken yet are dropped
+    void post(std::function<void()> task); // Runs on a worker ahead of any queued request
+    void stop(); // Waits for the requests that are being handled, drops the rest and joins the workers
+private:
+    Handler handler;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::unordered_map<uint64_t, std::deque<std::vector<uint8_t>>> request_queues;
+    std::deque<uint64_t> ready_clients; // Clients with queued requests, in the order in which they are served
+    std::deque<std::function<void()>> tasks;
+    bool stopping;
+    std::vector<std::thread> workers;
+    void work();
+};
+
+}
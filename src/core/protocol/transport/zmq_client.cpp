@@ -1,95 +1,119 @@
 #include "zmq_client.hpp"
 
 #if defined(NEROSHOP_USE_LIBZMQ)
-#include <cstring>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <iostream>
 #include <stdexcept>
 
-neroshop::ZmqClient::ZmqClient(const std::string& endpoint) {
-        init_socket(endpoint);
+neroshop::ZmqClient::ZmqClient(void * context) : context(context), owns_context(context == nullptr), socket(nullptr), wake_fd(-1), closed(false) {
+    if(owns_context) this->context = zmq_ctx_new();
+    if(!this->context) {
+        throw std::runtime_error("Failed to create ZMQ context");
+    }
+    socket = zmq_socket(this->context, ZMQ_DEALER);
+    wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(!socket || wake_fd == -1) {
+        if(socket) zmq_close(socket);
+        if(wake_fd != -1) ::close(wake_fd);
+        if(owns_context) zmq_ctx_destroy(this->context);
+        throw std::runtime_error("Failed to create ZMQ socket");
+    }
+    int linger = 100; // Long enough for the goodbye to go out
+    zmq_setsockopt(socket, ZMQ_LINGER, &linger, sizeof(linger));
 }
 
 neroshop::ZmqClient::~ZmqClient() {
-        close();
+    zmq_close(socket);
+    if(owns_context) zmq_ctx_term(context);
+    ::close(wake_fd);
 }
 
-void neroshop::ZmqClient::receive(std::string& message) {
-        zmq_msg_t msg;
-        zmq_msg_init(&msg);
-        int rc = zmq_msg_recv(&msg, socket_, 0);
-        if (rc == -1) {
-            zmq_msg_close(&msg);
-            throw std::runtime_error("Failed to receive message");
-        }
-        message.assign(static_cast<char*>(zmq_msg_data(&msg)), zmq_msg_size(&msg));
-        zmq_msg_close(&msg);
+//-----------------------------------------------------------------------------
+
+bool neroshop::ZmqClient::connect(const std::string& endpoint) {
+    if(zmq_connect(socket, endpoint.c_str()) != 0) {
+        std::cerr << "Failed to connect to ZeroMQ IPC endpoint " << endpoint << ": " << zmq_strerror(zmq_errno()) << "\n";
+        return false;
+    }
+    return true;
 }
 
-void neroshop::ZmqClient::receive(std::vector<uint8_t>& message) {
-    zmq_msg_t msg;
-    zmq_msg_init(&msg);
-    int rc = zmq_msg_recv(&msg, socket_, 0);
-    if (rc == -1) {
-        zmq_msg_close(&msg);
-        throw std::runtime_error("Failed to receive message");
+void neroshop::ZmqClient::send(std::vector<uint8_t> message) {
+    if(message.empty()) return; // An empty message means goodbye
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        outbox.push_back(std::move(message));
     }
-    message.resize(zmq_msg_size(&msg));
-    memcpy(message.data(), zmq_msg_data(&msg), zmq_msg_size(&msg));
-    zmq_msg_close(&msg);
+    uint64_t value = 1;
+    ::write(wake_fd, &value, sizeof(value));
 }
 
-void neroshop::ZmqClient::send(const std::string& message) {
+ssize_t neroshop::ZmqClient::receive(std::vector<uint8_t>& message, long timeout) {
+    while(true) {
+        flush();
+        if(closed) {
+            zmq_send(socket, nullptr, 0, ZMQ_DONTWAIT); // Goodbye, so the server can drop our subscriptions right away
+            return 0;
+        }
         zmq_msg_t msg;
-        zmq_msg_init_size(&msg, message.size());
-        memcpy(zmq_msg_data(&msg), message.c_str(), message.size());
-        int rc = zmq_msg_send(&msg, socket_, 0);
-        if (rc == -1) {
+        zmq_msg_init(&msg);
+        int size = zmq_msg_recv(&msg, socket, ZMQ_DONTWAIT);
+        if(size > 0) {
+            const uint8_t * data = static_cast<const uint8_t *>(zmq_msg_data(&msg));
+            message.assign(data, data + size);
             zmq_msg_close(&msg);
-            throw std::runtime_error("Failed to send message");
+            return size;
         }
         zmq_msg_close(&msg);
-}
-
-void neroshop::ZmqClient::send(const std::vector<uint8_t>& message) {
-    zmq_msg_t msg;
-    zmq_msg_init_size(&msg, message.size());
-    memcpy(zmq_msg_data(&msg), message.data(), message.size());
-    int rc = zmq_msg_send(&msg, socket_, 0);
-    if (rc == -1) {
-        zmq_msg_close(&msg);
-        throw std::runtime_error("Failed to send message");
+        if(size == 0) continue; // The server checking whether we are still here
+        if(zmq_errno() != EAGAIN) {
+            errno = zmq_errno();
+            return -1;
+        }
+        zmq_pollitem_t items[] = {
+            { socket, 0, static_cast<short>(ZMQ_POLLIN | (unsent.empty() ? 0 : ZMQ_POLLOUT)), 0 },
+            { nullptr, wake_fd, ZMQ_POLLIN, 0 },
+        };
+        int rc = zmq_poll(items, 2, timeout);
+        if(rc == -1) {
+            if(zmq_errno() == EINTR) continue;
+            errno = zmq_errno();
+            return -1;
+        }
+        if(rc == 0) {
+            errno = EAGAIN;
+            return -1;
+        }
+        if(items[1].revents & ZMQ_POLLIN) {
+            uint64_t value;
+            while(::read(wake_fd, &value, sizeof(value)) > 0) {}
+        }
     }
-    zmq_msg_close(&msg);
 }
 
-void neroshop::ZmqClient::send_receive(const std::string& message, std::string& response) {
-    send(message);
-    receive(response);
+void neroshop::ZmqClient::flush() {
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        for(auto& message : outbox) unsent.push_back(std::move(message));
+        outbox.clear();
+    }
+    while(!unsent.empty()) {
+        const std::vector<uint8_t>& message = unsent.front();
+        if(zmq_send(socket, message.data(), message.size(), ZMQ_DONTWAIT) == -1) {
+            if(zmq_errno() == EAGAIN) return; // The queue to the server is full. Sent once it has room
+            std::cerr << "zmq_send: " << zmq_strerror(zmq_errno()) << "\n";
+        }
+        unsent.pop_front();
+    }
 }
 
 void neroshop::ZmqClient::close() {
-        zmq_close(socket_);
-        zmq_ctx_destroy(context_);
+    closed = true;
+    uint64_t value = 1;
+    ::write(wake_fd, &value, sizeof(value));
 }
 
-void neroshop::ZmqClient::init_socket(const std::string& endpoint) {
-        context_ = zmq_ctx_new();
-        if (!context_) {
-            throw std::runtime_error("Failed to create ZMQ context");
-        }
-        socket_ = zmq_socket(context_, ZMQ_REQ);
-        if (!socket_) {
-            zmq_ctx_destroy(context_);
-            throw std::runtime_error("Failed to create ZMQ socket");
-        }
-        int rc = zmq_connect(socket_, endpoint.c_str());
-        if (rc != 0) {
-            zmq_close(socket_);
-            zmq_ctx_destroy(context_);
-            throw std::runtime_error("Failed to connect ZMQ socket");
-        }
-}
-
-/*int main() {
-
-}*/ // g++ -D NEROSHOP_USE_LIBZMQ zmq_client.cpp zmq_server.cpp -lzmq
 #endif // NEROSHOP_USE_LIBZMQ
@@ -5,31 +5,44 @@
 #if defined(NEROSHOP_USE_LIBZMQ)
 #include <zmq.h>
 
-#include <iostream>
+#include <sys/types.h> // ssize_t
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace neroshop {
 
+// DEALER socket connected to a ZmqServer. It is the transport of a Client that called connect_zmq: requests may be sent from
+// any thread, while the thread that receives the responses is the only one that touches the socket, as ZeroMQ requires
 class ZmqClient {
 public:
-    ZmqClient(const std::string& endpoint);
+    ZmqClient(void * context = nullptr); // Pass the context of a ZmqServer in the same process to use its inproc:// endpoint. Otherwise the client has its own
     ~ZmqClient();
-
-    void receive(std::string& message);
-    void receive(std::vector<uint8_t>& message);
-    void send(const std::string& message);
-    void send(const std::vector<uint8_t>& data);
-    void send_receive(const std::string& message, std::string& response);
-    void close();
-
+    ZmqClient(const ZmqClient&) = delete;
+    ZmqClient& operator=(const ZmqClient&) = delete;
+
+    bool connect(const std::string& endpoint); // Must be called before receive(). ZeroMQ connects (and reconnects) in the background
+    void send(std::vector<uint8_t> message); // Queued for the receiving thread to send. Can be called from any thread
+    // Waits up to timeout milliseconds for a message while sending the queued ones. Returns its size, 0 once close() was called,
+    // or -1 with errno set to EAGAIN on timeout
+    ssize_t receive(std::vector<uint8_t>& message, long timeout);
+    void close(); // Says goodbye to the server and wakes receive() up. Can be called from any thread
 private:
-    void init_socket(const std::string& endpoint);
-
-    void* context_ = nullptr;
-    void* socket_ = nullptr;
+    void * context;
+    bool owns_context;
+    void * socket;
+    int wake_fd; // eventfd that wakes the receiving thread up when there is something to send
+    std::atomic<bool> closed;
+    std::mutex outbox_mutex;
+    std::vector<std::vector<uint8_t>> outbox;
+    std::deque<std::vector<uint8_t>> unsent; // Only touched by the receiving thread
+    void flush();
 };
- 
+
 }
 
 #endif // NEROSHOP_USE_LIBZMQ
@@ -1,140 +1,281 @@
 #include "zmq_server.hpp"
 
 #if defined(NEROSHOP_USE_LIBZMQ)
-#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <iostream>
 #include <stdexcept>
 
-neroshop::ZmqServer::ZmqServer(const std::string& endpoint, bool async) {
-        init_socket(endpoint, async);
+#include "../../tools/logger.hpp"
+
+neroshop::ZmqServer::ZmqServer(Handler handler, std::size_t worker_count, void * context)
+    : handler(std::move(handler)), context(context), owns_context(context == nullptr), socket(nullptr), wake_fd(-1), next_client_id(1),
+      outstanding(0), backlog_count(0), client_count(0), stopped(false),
+      pool([this](uint64_t client_id, const std::vector<uint8_t>& request) { post({ client_id, this->handler(client_id, request), true }); }, worker_count)
+{
+    if(owns_context) this->context = zmq_ctx_new();
+    if(!this->context) {
+        throw std::runtime_error("Failed to create ZMQ context");
+    }
+    socket = zmq_socket(this->context, ZMQ_ROUTER);
+    wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(!socket || wake_fd == -1) {
+        if(socket) zmq_close(socket);
+        if(wake_fd != -1) ::close(wake_fd);
+        if(owns_context) zmq_ctx_destroy(this->context);
+        throw std::runtime_error("Failed to create ZMQ socket");
+    }
+    int mandatory = 1; // A message to a client that is gone fails instead of being dropped, which is how we learn that it left
+    zmq_setsockopt(socket, ZMQ_ROUTER_MANDATORY, &mandatory, sizeof(mandatory));
+    int64_t max_message_size = NEROSHOP_IPC_MAX_FRAME_SIZE; // A larger request disconnects the client
+    zmq_setsockopt(socket, ZMQ_MAXMSGSIZE, &max_message_size, sizeof(max_message_size));
+    int linger = 0;
+    zmq_setsockopt(socket, ZMQ_LINGER, &linger, sizeof(linger));
 }
 
 neroshop::ZmqServer::~ZmqServer() {
-        close();
+    pool.stop(); // Workers post to wake_fd, so they are done before it is closed
+    zmq_close(socket);
+    if(owns_context) zmq_ctx_term(context); // Waits for the sockets of inproc clients that share the context to be closed
+    ::close(wake_fd);
 }
 
-void neroshop::ZmqServer::receive(std::string& message) {
-        zmq_msg_t msg;
-        zmq_msg_init(&msg);
-        int rc = zmq_msg_recv(&msg, socket_, 0);
-        if (rc == -1) {
-            zmq_msg_close(&msg);
-            throw std::runtime_error("Failed to receive message");
-        }
-        message.assign(static_cast<char*>(zmq_msg_data(&msg)), zmq_msg_size(&msg));
-        zmq_msg_close(&msg);
-}
+//-----------------------------------------------------------------------------
 
-void neroshop::ZmqServer::receive(std::vector<uint8_t>& message) {
-    zmq_msg_t msg;
-    zmq_msg_init(&msg);
-    int rc = zmq_msg_recv(&msg, socket_, 0);
-    if (rc == -1) {
-        zmq_msg_close(&msg);
-        throw std::runtime_error("Failed to receive message");
+bool neroshop::ZmqServer::listen(const std::string& endpoint) {
+    // ZeroMQ removes a socket file left behind by a daemon that did not exit cleanly before binding to an ipc:// endpoint
+    if(zmq_bind(socket, endpoint.c_str()) != 0) {
+        std::cerr << "Failed to bind ZeroMQ IPC endpoint " << endpoint << ": " << zmq_strerror(zmq_errno()) << "\n";
+        return false;
     }
-    size_t size = zmq_msg_size(&msg);
-    message.resize(size);
-    memcpy(message.data(), zmq_msg_data(&msg), size);
-    zmq_msg_close(&msg);
-}
-
-// use the zmq_poll() function to wait for incoming messages from the client. The zmq_poll() function blocks until there is at least one message available to receive, or until a timeout occurs. You can set the timeout to zero to make the function return immediately if there are no messages to receive.
-void neroshop::ZmqServer::receive_poll(std::string& message) {
-    zmq_msg_t msg;
-    zmq_msg_init(&msg);
-    
-    zmq_pollitem_t items[] = {
-        { socket_, 0, ZMQ_POLLIN, 0 }
-    };
-    
-    int rc = zmq_poll(items, 1, 0);
-    if (rc == -1) {
-        zmq_msg_close(&msg);
-        throw std::runtime_error("Failed to poll for messages");
+    if(endpoint.compare(0, 6, "ipc://") == 0) {
+        ::chmod(endpoint.substr(6).c_str(), S_IRUSR | S_IWUSR); // Only the user who runs the daemon may connect
     }
-    
-    if (items[0].revents & ZMQ_POLLIN) {
-        rc = zmq_msg_recv(&msg, socket_, 0);
-        if (rc == -1) {
-            zmq_msg_close(&msg);
-            throw std::runtime_error("Failed to receive message");
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::ZmqServer::run() {
+    while(!stopped) {
+        zmq_pollitem_t items[] = {
+            { socket, 0, 0, 0 },
+            { nullptr, wake_fd, ZMQ_POLLIN, 0 },
+        };
+        if(outstanding < MAX_OUTSTANDING) items[0].events = ZMQ_POLLIN;
+        // A ROUTER is always writable, so clients whose queue was full are simply retried a little later
+        long timeout = (backlog_count > 0) ? 10 : -1;
+        int rc = zmq_poll(items, 2, timeout);
+        if(rc == -1) {
+            if(zmq_errno() == EINTR) continue;
+            std::cerr << "zmq_poll: " << zmq_strerror(zmq_errno()) << "\n";
+            break;
+        }
+        if(items[1].revents & ZMQ_POLLIN) {
+            uint64_t value;
+            while(::read(wake_fd, &value, sizeof(value)) > 0) {}
+            flush_outbox();
+        }
+        if(items[0].revents & ZMQ_POLLIN) {
+            read_requests();
+        }
+        if(backlog_count > 0) {
+            std::vector<uint64_t> waiting;
+            for(const auto& [client_id, peer] : peers) {
+                if(!peer.backlog.empty()) waiting.push_back(client_id);
+            }
+            for(uint64_t client_id : waiting) {
+                auto it = peers.find(client_id);
+                if(it != peers.end()) flush_backlog(it->second);
+            }
         }
-        message.assign(static_cast<char*>(zmq_msg_data(&msg)), zmq_msg_size(&msg));
-        zmq_msg_close(&msg);
-    } else {
-        message.clear();
     }
 }
 
-void neroshop::ZmqServer::send(const std::string& message) {
-        zmq_msg_t msg;
-        zmq_msg_init_size(&msg, message.size());
-        memcpy(zmq_msg_data(&msg), message.c_str(), message.size());
-        int rc = zmq_msg_send(&msg, socket_, 0);
-        if (rc == -1) {
-            zmq_msg_close(&msg);
-            throw std::runtime_error("Failed to send message");
+void neroshop::ZmqServer::stop() {
+    stopped = true;
+    uint64_t value = 1;
+    ::write(wake_fd, &value, sizeof(value));
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::ZmqServer::read_requests() {
+    std::unordered_map<uint64_t, std::vector<std::vector<uint8_t>>> requests; // Handed to the workers together
+    for(int i = 0; i < READ_BUDGET && outstanding < MAX_OUTSTANDING; i++) {
+        // A ROUTER puts the routing id of the client in front of each message
+        zmq_msg_t part;
+        zmq_msg_init(&part);
+        if(zmq_msg_recv(&part, socket, ZMQ_DONTWAIT) == -1) {
+            zmq_msg_close(&part);
+            break; // Nothing left to read
+        }
+        std::string routing_id(static_cast<char *>(zmq_msg_data(&part)), zmq_msg_size(&part));
+        bool more = zmq_msg_more(&part);
+        zmq_msg_close(&part);
+        // The request is the next part. Any further parts are not part of the protocol and are dropped
+        std::vector<uint8_t> request;
+        for(bool first = true; more; first = false) {
+            zmq_msg_init(&part);
+            if(zmq_msg_recv(&part, socket, 0) == -1) {
+                zmq_msg_close(&part);
+                break;
+            }
+            if(first) {
+                const uint8_t * data = static_cast<const uint8_t *>(zmq_msg_data(&part));
+                request.assign(data, data + zmq_msg_size(&part));
+            }
+            more = zmq_msg_more(&part);
+            zmq_msg_close(&part);
+        }
+
+        auto peer_id = peer_ids.find(routing_id);
+        if(request.empty()) { // Goodbye
+            if(peer_id != peer_ids.end()) remove_peer(peer_id->second);
+            continue;
         }
-        zmq_msg_close(&msg);
+        Peer * peer = (peer_id != peer_ids.end()) ? &peers[peer_id->second] : add_peer(routing_id);
+        if(peer == nullptr) continue;
+        peer->outstanding++;
+        outstanding++;
+        requests[peer->id].push_back(std::move(request));
+    }
+    for(auto& [client_id, client_requests] : requests) pool.push(client_id, client_requests);
 }
 
-void neroshop::ZmqServer::send(const std::vector<uint8_t>& message) {
-    zmq_msg_t msg;
-    zmq_msg_init_size(&msg, message.size());
-    memcpy(zmq_msg_data(&msg), message.data(), message.size());
-    int rc = zmq_msg_send(&msg, socket_, 0);
-    if (rc == -1) {
-        zmq_msg_close(&msg);
-        throw std::runtime_error("Failed to send message");
+neroshop::ZmqServer::Peer * neroshop::ZmqServer::add_peer(const std::string& routing_id) {
+    if(peers.size() >= NEROSHOP_IPC_MAX_CLIENTS) prune_peers();
+    if(peers.size() >= NEROSHOP_IPC_MAX_CLIENTS) {
+        neroshop::print("IPC client refused: too many clients are connected", 1);
+        return nullptr;
     }
-    zmq_msg_close(&msg);
+    uint64_t client_id = CLIENT_ID_BIT | next_client_id++; // Ids are never reused so a late response cannot reach the wrong client
+    Peer& peer = peers[client_id];
+    peer.routing_id = routing_id;
+    peer.id = client_id;
+    peer_ids[routing_id] = client_id;
+    client_count = peers.size();
+    NEROSHOP_LOG(log_level::debug, "ZeroMQ IPC client " << (client_id & ~CLIENT_ID_BIT) << " connected\n");
+    return &peer;
 }
 
-void neroshop::ZmqServer::send(const std::string& message, const std::string& topic) {
-    zmq_msg_t msg;
-    zmq_msg_init_size(&msg, message.size());
-    memcpy(zmq_msg_data(&msg), message.c_str(), message.size());
-    int rc = zmq_msg_send(&msg, socket_, ZMQ_SNDMORE);
-    if (rc == -1) {
-        zmq_msg_close(&msg);
-        throw std::runtime_error("Failed to send message");
+// Clients that vanished without saying goodbye are only noticed when a message to them cannot be routed, so when every slot
+// is taken, the idle clients are sent an empty message (which clients ignore) to find out which of them are still there
+void neroshop::ZmqServer::prune_peers() {
+    std::vector<uint64_t> gone;
+    for(auto& [client_id, peer] : peers) {
+        if(peer.outstanding > 0 || !peer.backlog.empty()) continue;
+        if(send_to(peer, {}) == EHOSTUNREACH) gone.push_back(client_id);
     }
-    zmq_msg_t topic_msg;
-    zmq_msg_init_size(&topic_msg, topic.size());
-    memcpy(zmq_msg_data(&topic_msg), topic.c_str(), topic.size());
-    rc = zmq_msg_send(&topic_msg, socket_, 0);
-    if (rc == -1) {
-        zmq_msg_close(&msg);
-        zmq_msg_close(&topic_msg);
-        throw std::runtime_error("Failed to send message");
+    for(uint64_t client_id : gone) remove_peer(client_id);
+}
+
+void neroshop::ZmqServer::remove_peer(uint64_t client_id) {
+    auto it = peers.find(client_id);
+    if(it == peers.end()) return;
+    Peer& peer = it->second;
+    outstanding -= peer.outstanding; // Responses to its requests are dropped when they arrive
+    if(!peer.backlog.empty()) backlog_count--;
+    peer_ids.erase(peer.routing_id);
+    peers.erase(it);
+    client_count = peers.size();
+    NEROSHOP_LOG(log_level::debug, "ZeroMQ IPC client " << (client_id & ~CLIENT_ID_BIT) << " disconnected\n");
+
+    pool.remove_client(client_id);
+    DisconnectHandler on_disconnect;
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        on_disconnect = disconnect_handler;
     }
-    zmq_msg_close(&msg);
-    zmq_msg_close(&topic_msg);
+    if(on_disconnect) pool.post([on_disconnect, client_id]() { on_disconnect(client_id); });
 }
 
-void neroshop::ZmqServer::close() {
-        zmq_close(socket_);
-        zmq_ctx_destroy(context_);
+//-----------------------------------------------------------------------------
+
+void neroshop::ZmqServer::send(uint64_t client_id, std::vector<uint8_t> message) {
+    post({ client_id, std::move(message), false });
+}
+
+void neroshop::ZmqServer::post(Outgoing outgoing) {
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        outbox.push_back(std::move(outgoing));
+    }
+    uint64_t value = 1;
+    ::write(wake_fd, &value, sizeof(value));
 }
 
-void neroshop::ZmqServer::init_socket(const std::string& endpoint, bool async) {
-        context_ = zmq_ctx_new();
-        if (!context_) {
-            throw std::runtime_error("Failed to create ZMQ context");
+void neroshop::ZmqServer::flush_outbox() {
+    std::vector<Outgoing> messages;
+    {
+        std::lock_guard<std::mutex> lock(outbox_mutex);
+        messages.swap(outbox);
+    }
+    for(auto& message : messages) {
+        auto it = peers.find(message.client_id);
+        if(it == peers.end()) continue; // The client has disconnected
+        Peer& peer = it->second;
+        if(message.is_response && peer.outstanding > 0) {
+            peer.outstanding--;
+            outstanding--;
+        }
+        if(!peer.backlog.empty()) { // Keeps the messages in order
+            peer.backlog.push_back(std::move(message.message));
+            continue;
+        }
+        int error = send_to(peer, message.message);
+        if(error == EAGAIN) {
+            peer.backlog.push_back(std::move(message.message));
+            backlog_count++;
+        } else if(error == EHOSTUNREACH) {
+            remove_peer(peer.id);
         }
-        socket_ = zmq_socket(context_, (async == true) ? ZMQ_PUB: ZMQ_REP);
-        if (!socket_) {
-            zmq_ctx_destroy(context_);
-            throw std::runtime_error("Failed to create ZMQ socket");
+    }
+}
+
+void neroshop::ZmqServer::flush_backlog(Peer& peer) {
+    while(!peer.backlog.empty()) {
+        int error = send_to(peer, peer.backlog.front());
+        if(error == EAGAIN) {
+            // A client that stopped reading is let go rather than buffered for without bound
+            if(peer.backlog.size() > NEROSHOP_IPC_MAX_IN_FLIGHT) {
+                std::cerr << "ZeroMQ IPC client " << (peer.id & ~CLIENT_ID_BIT) << " is not reading its responses\n";
+                remove_peer(peer.id);
+            }
+            return;
         }
-        int rc = zmq_bind(socket_, endpoint.c_str());
-        if (rc != 0) {
-            zmq_close(socket_);
-            zmq_ctx_destroy(context_);
-            throw std::runtime_error("Failed to bind ZMQ socket");
+        if(error == EHOSTUNREACH) {
+            remove_peer(peer.id);
+            return;
         }
+        peer.backlog.pop_front();
+    }
+    backlog_count--;
+}
+
+int neroshop::ZmqServer::send_to(Peer& peer, const std::vector<uint8_t>& message) {
+    // Both parts are queued together or not at all: a ROUTER only checks the routing id part against the client's queue
+    if(zmq_send(socket, peer.routing_id.data(), peer.routing_id.size(), ZMQ_SNDMORE | ZMQ_DONTWAIT) == -1) return zmq_errno();
+    if(zmq_send(socket, message.data(), message.size(), ZMQ_DONTWAIT) == -1) return zmq_errno();
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+
+void neroshop::ZmqServer::set_disconnect_handler(DisconnectHandler disconnect_handler) {
+    std::lock_guard<std::mutex> lock(outbox_mutex);
+    this->disconnect_handler = std::move(disconnect_handler);
 }
 
-//int main() {} // g++ -D NEROSHOP_USE_LIBZMQ zmq_client.cpp zmq_server.cpp -lzmq
+std::size_t neroshop::ZmqServer::get_client_count() const {
+    return client_count;
+}
+
+void * neroshop::ZmqServer::get_context() const {
+    return context;
+}
 
 #endif // NEROSHOP_USE_LIBZMQ
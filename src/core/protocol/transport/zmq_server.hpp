@@ -5,30 +5,86 @@
 #if defined(NEROSHOP_USE_LIBZMQ)
 #include <zmq.h>
 
-#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "worker_pool.hpp"
+#include "../../../neroshop_config.hpp"
+
 namespace neroshop {
 
+// IPC server on a ZeroMQ ROUTER socket, with the same interface as IpcServer. Clients connect with a DEALER socket (see Client::connect_zmq)
+// over tcp://, ipc:// or, when the daemon is embedded in the same process, inproc://. Each message from a client is one msgpack request
+// and each response goes back as one message, so a client may pipeline requests and match the responses by tid as on the TCP path.
+// ZeroMQ does not report disconnects to a ROUTER, so a client says goodbye with an empty message and a client that vanished is forgotten
+// the first time a message to it cannot be routed
 class ZmqServer {
 public:
-    ZmqServer(const std::string& endpoint, bool async = false);
+    using Handler = std::function<std::vector<uint8_t>(uint64_t client_id, const std::vector<uint8_t>& request)>;
+    using DisconnectHandler = std::function<void(uint64_t client_id)>;
+    static constexpr uint64_t CLIENT_ID_BIT = uint64_t(1) << 63; // Set in every client id, so they never collide with the ids of an IpcServer
+
+    ZmqServer(Handler handler, std::size_t worker_count = NEROSHOP_IPC_WORKER_COUNT, void * context = nullptr); // Creates its own context unless given one
     ~ZmqServer();
+    ZmqServer(const ZmqServer&) = delete;
+    ZmqServer& operator=(const ZmqServer&) = delete;
 
-    void receive(std::string& message);
-    void receive(std::vector<uint8_t>& message);
-    void receive_poll(std::string& message);
-    void send(const std::string& message);
-    void send(const std::vector<uint8_t>& message);
-    void send(const std::string& message, const std::string& topic); // for async
-    void close();
+    bool listen(const std::string& endpoint); // e.g. "tcp://127.0.0.1:57741", "ipc:///path/to/socket" or "inproc://neromon". Must be called before run()
+    void run(); // Serves clients until stop() is called
+    void stop(); // Can be called from any thread
+    void send(uint64_t client_id, std::vector<uint8_t> message); // Queues a message that the client did not ask for. Can be called from any thread
 
+    void set_disconnect_handler(DisconnectHandler disconnect_handler); // Called on a worker thread
+
+    std::size_t get_client_count() const;
+    void * get_context() const; // For clients of an inproc:// endpoint, which must share it
 private:
-    void init_socket(const std::string& endpoint, bool async);
+    struct Peer {
+        std::string routing_id;
+        uint64_t id;
+        std::size_t outstanding = 0; // Requests that are queued or being handled
+        std::deque<std::vector<uint8_t>> backlog; // Messages that did not fit in its ZeroMQ queue yet
+    };
+    struct Outgoing {
+        uint64_t client_id;
+        std::vector<uint8_t> message;
+        bool is_response;
+    };
+    static constexpr int READ_BUDGET = 256; // Messages read per wakeup, so that responses are not held back by a flood of requests
+    static constexpr std::size_t MAX_OUTSTANDING = NEROSHOP_IPC_MAX_IN_FLIGHT * NEROSHOP_IPC_MAX_CLIENTS; // Requests held at once. Beyond this, further requests wait in ZeroMQ's queues
+
+    Handler handler;
+    DisconnectHandler disconnect_handler; // Guarded by outbox_mutex
+    void * context;
+    bool owns_context;
+    void * socket;
+    int wake_fd; // eventfd that wakes the event loop up when workers have responses for it
+    std::unordered_map<std::string, uint64_t> peer_ids; // Routing id -> client id. Only touched by the event loop
+    std::unordered_map<uint64_t, Peer> peers;
+    uint64_t next_client_id;
+    std::size_t outstanding; // Total over every peer
+    std::size_t backlog_count; // Peers with a backlog
+    std::atomic<std::size_t> client_count;
+    std::atomic<bool> stopped;
+    // Filled by the workers, emptied by the event loop
+    std::mutex outbox_mutex;
+    std::vector<Outgoing> outbox;
+    WorkerPool pool; // Last, so that it is created after everything that the workers use
 
-    void* context_ = nullptr;
-    void* socket_ = nullptr;
+    void read_requests();
+    Peer * add_peer(const std::string& routing_id);
+    void prune_peers();
+    void remove_peer(uint64_t client_id);
+    void flush_outbox();
+    void flush_backlog(Peer& peer);
+    int send_to(Peer& peer, const std::vector<uint8_t>& message); // 0, or the zmq errno
+    void post(Outgoing outgoing);
 };
 
 }
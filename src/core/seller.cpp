@@ -114,22 +114,14 @@ void neroshop::Seller::delist_item(const std::string& listing_key) {
     Client * client = Client::get_main_client();
     // TODO: remove product from table cart_item, table images, table products, and table product_ratings as well
     // Get the value of the corresponding key from the DHT
-    std::string response;
-    client->get(listing_key, response); // TODO: error handling
-    std::cout << "Received response (get): " << response << "\n";
-    // Parse the response
-    nlohmann::json json = nlohmann::json::parse(response);
-    if(json.contains("error")) {
+    neroshop::Response response = client->get(listing_key);
+    if(response.get_status() == neroshop::Response::Status::Error) {
         neroshop::print("set_stock_quantity: key is lost or missing from DHT", 1);
         return; // Key is lost or missing from DHT, return
     }    
     
-    const auto& response_obj = json["response"];
-    assert(response_obj.is_object());
-    if (response_obj.contains("value") && response_obj["value"].is_string()) {
-        const auto& value = response_obj["value"].get<std::string>();
-        nlohmann::json value_obj = nlohmann::json::parse(value);
-        assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
+    nlohmann::json value_obj = response.get_value_json(); // Copied since it is modified below
+    if (value_obj.is_object()) {
         std::string metadata = value_obj["metadata"].get<std::string>();
         if (metadata != "listing") { std::cerr << "Invalid metadata. \"listing\" expected, got \"" << metadata << "\" instead\n"; return; }
         // Verify ownership
@@ -328,22 +320,14 @@ void neroshop::Seller::set_stock_quantity(const std::string& listing_key, int qu
     Client * client = Client::get_main_client();
 
     // Get the value of the corresponding key from the DHT
-    std::string response;
-    client->get(listing_key, response); // TODO: error handling
-    std::cout << "Received response (get): " << response << "\n";
-    // Parse the response
-    nlohmann::json json = nlohmann::json::parse(response);
-    if(json.contains("error")) {
+    neroshop::Response response = client->get(listing_key);
+    if(response.get_status() == neroshop::Response::Status::Error) {
         neroshop::print("set_stock_quantity: key is lost or missing from DHT", 1);
         return; // Key is lost or missing from DHT, return 
     }    
     
-    const auto& response_obj = json["response"];
-    assert(response_obj.is_object());
-    if (response_obj.contains("value") && response_obj["value"].is_string()) {
-        const auto& value = response_obj["value"].get<std::string>();
-        nlohmann::json value_obj = nlohmann::json::parse(value);
-        assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
+    nlohmann::json value_obj = response.get_value_json(); // Copied since it is modified below
+    if (value_obj.is_object()) {
         std::string metadata = value_obj["metadata"].get<std::string>();
         if (metadata != "listing") { std::cerr << "Invalid metadata. \"listing\" expected, got \"" << metadata << "\" instead\n"; return; }
         // Verify ownership of the data (listing)
@@ -181,6 +181,10 @@ bool neroshop::create_json() {
         root_obj.insert(QString("hide_homepage_button"), QJsonValue(false));
         root_obj.insert(QString("hide_price_display"), QJsonValue(false));
         root_obj.insert(QString("wallet_directory"), QJsonValue(""));
+        QJsonObject neromon_obj;
+        neromon_obj.insert(QString("ipc_transport"), QJsonValue("tcp")); // "tcp", "unix" or "zmq"
+        neromon_obj.insert(QString("ipc_shared_memory"), QJsonValue(false)); // Unix socket only
+        root_obj.insert(QString("neromon"), QJsonValue(neromon_obj));
         /*root_obj.insert(QString("window_width"), QJsonValue(1280));
         root_obj.insert(QString("window_height"), QJsonValue(900));//720));
         root_obj.insert(QString("window_mode"), QJsonValue(0));*/
@@ -252,6 +256,8 @@ bool neroshop::create_json() {
         settings_json["hide_homepage_button"] = false;
         settings_json["hide_price_display"] = false;
         settings_json["wallet_directory"] = ""; // leave blank to use default
+        settings_json["neromon"]["ipc_transport"] = "tcp"; // "tcp", "unix" or "zmq"
+        settings_json["neromon"]["ipc_shared_memory"] = false; // Unix socket only
         /*settings_json["window_width"] = 1280;
         settings_json["window_height"] = 900;//720;
         settings_json["window_mode"] = 0;*/
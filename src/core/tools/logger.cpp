@@ -1,5 +1,6 @@
 #include "logger.hpp"
 
+#include <atomic>
 #include <fstream>
 #include <sstream>
 #include <chrono>
@@ -7,6 +8,12 @@
 
 #include "../../neroshop_config.hpp"
 
+#if defined(NEROSHOP_DEBUG)
+static std::atomic<neroshop::log_level> current_log_level { neroshop::log_level::debug };
+#else
+static std::atomic<neroshop::log_level> current_log_level { neroshop::log_level::info };
+#endif
+
 void neroshop::logger(log_priority priority, const std::string& message) {
     std::string config_path = NEROSHOP_DATA_DIRECTORY_PATH;
     std::string log_path = config_path + "/" + NEROSHOP_LOG_FILENAME;
@@ -43,3 +50,15 @@ void neroshop::io_write(const std::string& text) {
     std::cout << "\033[1;35;49m" << "[neroshop]: " << "\033[1;37;49m" << text << "\033[0m";
 }
     
+
+void neroshop::set_log_level(log_level level) {
+    current_log_level.store(level, std::memory_order_relaxed);
+}
+
+neroshop::log_level neroshop::get_log_level() {
+    return current_log_level.load(std::memory_order_relaxed);
+}
+
+bool neroshop::is_log_enabled(log_level level) {
+    return static_cast<int>(level) <= static_cast<int>(current_log_level.load(std::memory_order_relaxed));
+}
@@ -3,6 +3,9 @@
 #define NEROSHOP_TAG_OUT neroshop::io_write("");
 #define NEROSHOP_TAG_IN std::string("\033[1;35;49m[neroshop]: \033[0m") +
 #define NEROSHOP_TAG NEROSHOP_TAG_IN
+// Streams the message to stdout only if its level is enabled. The message is not formatted otherwise
+// e.g. NEROSHOP_LOG(neroshop::log_level::debug, "Received " << buffer.size() << " bytes\n");
+#define NEROSHOP_LOG(level, message) do { if(neroshop::is_log_enabled(level)) { std::cout << message; } } while(0)
 
 #include <iostream>
 #include <string>
@@ -13,8 +16,16 @@ namespace neroshop {
         trace, error, warn, info
     };
     
+    enum class log_level : int { // Verbosity of the console output. Each level includes the ones before it
+        none, error, warn, info, debug, trace
+    };
+    
     void logger(log_priority priority, const std::string& message);
     
+    void set_log_level(log_level level);
+    log_level get_log_level();
+    bool is_log_enabled(log_level level);
+    
     void print(const std::string& text, int code = 0, bool log_msg = true); // 0=normal, 1=error, 2=warning, 3=success, 
     void io_write(const std::string& text); // like print but without a newline
 }
@@ -11,5 +11,6 @@
 #define NEROSHOP_VERSION_FULL "neroshop v" NEROSHOP_VERSION NEROSHOP_VERSION_METADATA " " NEROSHOP_VERSION_CODENAME
 #define NEROSHOP_DAEMON_VERSION NEROSHOP_VERSION
 #define NEROSHOP_DHT_VERSION "1.0"//"NS" NEROSHOP_VERSION_MAJOR NEROSHOP_VERSION_MINOR
+#define NEROSHOP_DHT_PROTOCOL_VERSION 2 // Advertised in ping/pong along with the capabilities. Nodes that advertise neither are protocol version 1
 
 #endif
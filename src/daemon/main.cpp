@@ -3,11 +3,18 @@
 #include <future>
 #include <thread>
 #include <shared_mutex>
+#include <algorithm> // std::min, std::max
 // neroshop
 #include "../core/crypto/sha3.hpp"
 #include "../core/protocol/p2p/node.hpp" // server.hpp included here (hopefully)
 #include "../core/protocol/p2p/routing_table.hpp" // uncomment if using routing_table
+#include "../core/protocol/p2p/event_publisher.hpp"
+#include "../core/protocol/transport/event_loop.hpp"
+#include "../core/protocol/transport/http_server.hpp"
 #include "../core/protocol/transport/ip_address.hpp"
+#include "../core/protocol/transport/ipc_server.hpp"
+#include "../core/protocol/transport/zmq_server.hpp"
+#include "../core/protocol/rpc/http.hpp"
 #include "../core/protocol/rpc/json_rpc.hpp"
 #include "../core/protocol/messages/msgpack.hpp"
 #include "../core/database/database.hpp"
@@ -25,90 +32,26 @@
 
 using namespace neroshop;
 
-std::mutex server_mutex;
 std::shared_mutex node_mutex; // Define a shared mutex to protect concurrent access to the Node object
 
 std::atomic<bool> running(true);
 //-----------------------------------------------------------------------------
 
-std::string extract_json_payload(const std::string& request) {
-    // Find the start of the JSON payload
-    const std::string json_start = "\r\n\r\n";
-    const auto json_pos = request.find(json_start);
-    if (json_pos == std::string::npos) {
-        // JSON payload not found
-        return "";
-    }
-    // Extract the JSON payload
-    const auto json_payload = request.substr(json_pos + json_start.size());
-    return json_payload;
-}
-
-//-----------------------------------------------------------------------------
-
+// Clients keep their connection open for as many JSON-RPC requests as they like, and the requests are handled on the server's worker pool
 void rpc_server(const std::string& address) {
-    Server server(address, NEROSHOP_RPC_DEFAULT_PORT);
-    
-    while (running) {
-        // Accept incoming connections and handle clients concurrently
-        if(server.accept() != -1) {            
-            std::thread request_thread([&]() {
-                // Lock the server mutex
-                std::lock_guard<std::mutex> lock(server_mutex);
-
-                // Read json-rpc request object from client
-                std::string request_object = server.read();
-
-                // Extract JSON payload from request
-                const std::string json_payload = extract_json_payload(request_object);
-
-                std::stringstream http_response;
-
-                // Process JSON-RPC request
-                std::string response_object = "";
-                if(neroshop::rpc::is_json_rpc(json_payload)) {
-                    response_object = neroshop::rpc::json::process(json_payload);
-                    http_response << "HTTP/1.1 200 OK\r\n";
-                } else {
-                    std::stringstream error_msg;
-                    nlohmann::json error_obj;
-                    error_obj["jsonrpc"] = "2.0";
-                    error_obj["error"] = {};
-                    error_obj["error"]["code"] = -32600;
-                    error_obj["error"]["message"] = "Invalid Request";//error_obj["error"]["data"] = "Additional error information"; // may be ommited
-                    error_obj["id"] = nullptr;
-                    error_msg << error_obj.dump();
-                    response_object = error_msg.str();
-                    http_response << "HTTP/1.1 400 Bad Request\r\n";
-                }
-
-                // Build HTTP response string
-                http_response << "Content-Type: application/json\r\n";
-                http_response << "Content-Length: " << response_object.length() << "\r\n";
-                http_response << "\r\n";
-                http_response << response_object;
-
-                // Send HTTP response to client
-                server.write(http_response.str());
-            });
-
-            request_thread.detach();
-        }
-        
-        if (!running) {
-            // Stop accepting new connections and exit the loop
-            break;
-        }        
+    HttpServer server([](std::string_view request, const HttpServer::Writer& write) { neroshop::rpc::http::respond(request, write); });
+    if (!server.listen(address, NEROSHOP_RPC_DEFAULT_PORT)) {
+        std::cerr << "RPC server failed to start\n";
+        return;
     }
-    // Close the server socket before exiting
+    server.run();
     std::cout << "RPC server closed\n";
-    server.shutdown();
-    server.close();
 }
 
 //-----------------------------------------------------------------------------
 
-void ipc_server(Node& node) {
+// serve runs the server until the daemon exits, either on this thread or on an EventLoop
+void ipc_server(Node& node, const std::function<void(IpcServer&)>& serve) {
     // Prevent bootstrap node from being accepted by IPC server 
     // since its only meant to act as an initial contact point for new nodes joining the network
     if (node.is_bootstrap_node()) {
@@ -116,39 +59,61 @@ void ipc_server(Node& node) {
         return;
     }
     
-    Server server("127.0.0.1", NEROSHOP_IPC_DEFAULT_PORT);
-    
-    while (running) {        
-        if(server.accept() != -1) {  // ONLY accepts a single client            
-            while (true) {
-                std::vector<uint8_t> request;
-                // wait for incoming message from client
-                int recv_size = server.receive(request);
-                if (recv_size == 0) {
-                    // Republish data before exiting (or in case of client app crashes)
-                    node.republish();
-                    // Set running to false to close the server (TODO: find a way to gracefully close all threads)
-                    ////running = false;
-                    // Connection closed by client, break out of loop
-                    break;
-                }
-                std::vector<uint8_t> response;
-                {
-                    
-                    //std::shared_lock<std::shared_mutex> read_lock(node_mutex); // Locking the node_mutex may cause the IPC server to not respond to the client requests for some reason
-                    // Perform both read and write operations on the node object
-                    // process JSON request and generate response
-                    response = neroshop::msgpack::process(request, node, true);
-                }
-                // The shared_lock is destroyed and the lock is released here          
-                // send response to client
-                server.send(response);
+    // Any number of GUIs, CLIs and scripts may be connected at once. The client pipelines its requests and matches the responses by tid,
+    // so each response is sent as soon as a worker has it ready, in any order
+    auto handler = [&node](uint64_t client_id, const std::vector<uint8_t>& request) {
+        //std::shared_lock<std::shared_mutex> read_lock(node_mutex); // Locking the node_mutex may cause the IPC server to not respond to the client requests for some reason
+        // process JSON request and generate response
+        return neroshop::msgpack::process(request, node, true, "", client_id);
+    };
+    IpcServer server(handler);
+    #if defined(NEROSHOP_USE_LIBZMQ)
+    // The same requests over ZeroMQ. Its client ids have ZmqServer::CLIENT_ID_BIT set, which tells which server a client is on
+    ZmqServer zmq_server(handler);
+    #endif
+    // Clients that subscribed to events are sent them as they happen instead of polling
+    EventPublisher * event_publisher = node.get_event_publisher();
+    if (event_publisher != nullptr) {
+        event_publisher->set_sender([&](uint64_t client_id, std::vector<uint8_t> message) {
+            #if defined(NEROSHOP_USE_LIBZMQ)
+            if (client_id & ZmqServer::CLIENT_ID_BIT) {
+                zmq_server.send(client_id, std::move(message));
+                return;
             }
-        } 
-    }  
-    // Close the server socket before exiting // TODO: implement SIGINT (Ctrl+C)
+            #endif
+            server.send(client_id, std::move(message));
+        });
+    }
+    // Drop the subscriptions of a client that disconnects (or crashes); its data is republished by the periodic refresh
+    auto disconnect_handler = [event_publisher](uint64_t client_id) {
+        if (event_publisher != nullptr) event_publisher->remove_client(client_id);
+    };
+    server.set_disconnect_handler(disconnect_handler);
+    #if defined(NEROSHOP_USE_LIBZMQ)
+    zmq_server.set_disconnect_handler(disconnect_handler);
+    std::thread zmq_thread;
+    if (zmq_server.listen("tcp://127.0.0.1:" + std::to_string(NEROSHOP_IPC_ZMQ_PORT)) | zmq_server.listen(NEROSHOP_DEFAULT_IPC_ZMQ_ENDPOINT)) {
+        zmq_thread = std::thread([&zmq_server]() { zmq_server.run(); });
+    } else {
+        std::cerr << "ZeroMQ IPC server unavailable\n";
+    }
+    #endif
+    // The GUI picks the transport in its settings, so both are served: TCP loopback and a Unix domain socket, which skips the TCP stack
+    // and can hand large responses over in shared memory
+    if (!server.listen("127.0.0.1", NEROSHOP_IPC_DEFAULT_PORT)) {
+        throw std::runtime_error("Failed to start the IPC server on port " + std::to_string(NEROSHOP_IPC_DEFAULT_PORT));
+    }
+    if (!server.listen_unix(NEROSHOP_DEFAULT_IPC_SOCKET_PATH)) {
+        std::cerr << "Unix socket IPC server unavailable\n"; // The GUI can still use TCP
+    }
+    
+    serve(server);
+    #if defined(NEROSHOP_USE_LIBZMQ)
+    zmq_server.stop();
+    if (zmq_thread.joinable()) zmq_thread.join();
+    #endif
+    if (event_publisher != nullptr) event_publisher->set_sender(nullptr);
     std::cout << "IPC server closed\n";
-    server.close();
 }
 
 //-----------------------------------------------------------------------------
@@ -180,6 +145,61 @@ void dht_server(Node& node) {
 
 //-----------------------------------------------------------------------------
 
+#if defined(NEROSHOP_USE_LIBUV)
+// Replaces the threads above with one libuv loop on the main thread: the DHT socket and the IPC and RPC servers are watched by the loop,
+// the health checks and republishing are timers, and DHT requests are handled on libuv's thread pool
+void event_loop(Node& node, bool rpc_enabled, const std::string& rpc_address) {
+    EventLoop loop;
+    loop.on_signal(SIGINT, [&loop]() { loop.stop(); });
+    loop.on_signal(SIGTERM, [&loop]() { loop.stop(); });
+    
+    std::cout << "******************************************************\n";
+    std::cout << "Node ID: " << node.get_id() << "\n";
+    std::cout << "IP address: " << node.get_ip_address() << "\n";
+    std::cout << "Port number: " << node.get_port() << "\n\n";
+    std::cout << "******************************************************\n";
+    // A burst of datagrams is read in one go, but not so many that the other sockets wait
+    loop.watch(node.get_socket(), [&loop, &node]() {
+        for (int i = 0; i < 64; i++) {
+            std::function<void()> handle_request;
+            if (!node.receive_request(handle_request)) break;
+            if (handle_request) loop.queue_work(std::move(handle_request));
+        }
+    });
+    loop.queue_work([&node]() {
+        if (node.is_bootstrap_node()) {
+            node.rebuild_routing_table();
+        } else {
+            node.join(); // A bootstrap node cannot join the network
+        }
+    });
+    loop.schedule(NEROSHOP_DHT_PERIODIC_CHECK_INTERVAL * 1000, NEROSHOP_DHT_PERIODIC_CHECK_INTERVAL * 1000, [&node]() { node.check_peers(); });
+    loop.schedule(NEROSHOP_DHT_REPUBLISH_INTERVAL * 3600000, NEROSHOP_DHT_REPUBLISH_INTERVAL * 3600000, [&node]() { node.refresh(); });
+    
+    std::unique_ptr<HttpServer> rpc;
+    if (rpc_enabled) {
+        std::cout << "RPC enabled\n";
+        rpc = std::make_unique<HttpServer>([](std::string_view request, const HttpServer::Writer& write) { neroshop::rpc::http::respond(request, write); });
+        if (rpc->listen(rpc_address, NEROSHOP_RPC_DEFAULT_PORT)) {
+            loop.watch(rpc->get_fd(), [&rpc]() { rpc->run_once(); });
+        }
+    }
+    
+    if (node.is_bootstrap_node()) {
+        ipc_server(node, nullptr); // Bootstrap nodes have no IPC server. This only tells the user so
+        loop.run();
+        return;
+    }
+    ipc_server(node, [&loop](IpcServer& server) {
+        loop.watch(server.get_fd(), [&server]() { server.run_once(); });
+        loop.run();
+    });
+    std::cout << "Event loop stopped\n";
+}
+#endif
+
+//-----------------------------------------------------------------------------
+
 int main(int argc, char** argv)
 {
     std::string daemon { "neromon" };
@@ -192,6 +212,7 @@ int main(int argc, char** argv)
         ("b,bootstrap", "Run this node as a bootstrap node")//("bl,bootstrap-lazy", "Run this node as a bootstrap node without specifying multiaddress")//("c,config", "Path to configuration file", cxxopts::value<std::string>())
         ("rpc,enable-rpc", "Enables the RPC daemon server")
         ("public,public-node", "Make your daemon into a public node")
+        ("l,log-level", "Console log level (0=none, 1=error, 2=warn, 3=info, 4=debug, 5=trace)", cxxopts::value<int>())
     ;
     
     auto result = options.parse(argc, argv);
@@ -211,6 +232,11 @@ int main(int argc, char** argv)
         if(!config_path.empty()) {}
     }
     
+    if(result.count("log-level")) {
+        int log_level = result["log-level"].as<int>();
+        neroshop::set_log_level(static_cast<neroshop::log_level>(std::max(0, std::min(log_level, static_cast<int>(neroshop::log_level::trace)))));
+    }
+    
     std::string ip_address = NEROSHOP_LOOPBACK_ADDRESS;
     if(result.count("public")) {
         ip_address = NEROSHOP_ANY_ADDRESS;
@@ -247,7 +273,10 @@ int main(int argc, char** argv)
         // ALWAYS use address "0.0.0.0" for bootstrap nodes so that it is reachable by all nodes in the network, regardless of their location.
     }
     //-------------------------------------------------------
-    std::thread ipc_thread([&node]() { ipc_server(node); }); // For IPC communication between the local GUI client and the local daemon server
+    #if defined(NEROSHOP_USE_LIBUV)
+    event_loop(node, result.count("rpc") > 0, ip_address);
+    #else
+    std::thread ipc_thread([&node]() { ipc_server(node, [](IpcServer& server) { server.run(); }); }); // For IPC communication between the local GUI clients and the local daemon server
     std::thread dht_thread([&node]() { dht_server(node); }); // DHT communication for peer discovery and data storage
     std::thread rpc_thread;  // Declare the thread object // RPC communication for processing requests from outside clients (disabled by default)
     
@@ -262,6 +291,7 @@ int main(int argc, char** argv)
     }
     ipc_thread.join();
     dht_thread.join();
+    #endif
     
     #if defined(NEROSHOP_USE_LIBJUICE)
     ////juice_server_destroy(server);
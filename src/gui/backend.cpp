@@ -48,9 +48,31 @@
 
 namespace neroshop_filesystem = neroshop::filesystem;
 
-neroshop::Backend::Backend(QObject *parent) : QObject(parent) {}
+neroshop::Backend::Backend(QObject *parent) : QObject(parent) {
+    // Events arrive on the client's receive thread and are handed to the GUI thread as signals
+    Client * client = Client::get_main_client();
+    client->set_event_handler([this](const std::string& event, const nlohmann::json& data) {
+        if(event == "network_status") {
+            QVariantMap network_status;
+            network_status["connected_peers"] = data.value("connected_peers", 0);
+            network_status["active_peers"] = data.value("active_peers", 0);
+            network_status["idle_peers"] = data.value("idle_peers", 0);
+            QMetaObject::invokeMethod(this, [this, network_status]() { emit networkStatusChanged(network_status); }, Qt::QueuedConnection);
+            return;
+        }
+        QString key = QString::fromStdString(data.value("key", ""));
+        if(event == "listing") {
+            QMetaObject::invokeMethod(this, [this, key]() { emit listingUpdated(key); }, Qt::QueuedConnection);
+        }
+        if(event == "message") {
+            QMetaObject::invokeMethod(this, [this, key]() { emit messageReceived(key); }, Qt::QueuedConnection);
+        }
+    });
+    client->subscribe({ {"topics", { "network_status", "listing" }} }); // Made once connected if the daemon is not up yet
+}
 
 neroshop::Backend::~Backend() {
+    Client::get_main_client()->set_event_handler(nullptr);
     #ifdef NEROSHOP_DEBUG
     std::cout << "backend deleted\n";
     #endif
@@ -586,31 +608,23 @@ QVariantList neroshop::Backend::getProductRatings(const QString& product_id) {
             QString key = QString::fromStdString(column_value);//std::cout << key.toStdString() << "\n";
             
             // Get the value of the corresponding key from the DHT
-            std::string response;
-            client->get(key.toStdString(), response); // TODO: error handling
-            std::cout << "Received response (get): " << response << "\n";
-            // Parse the response
-            nlohmann::json json = nlohmann::json::parse(response);
-            if(json.contains("error")) {
+            neroshop::Response response = client->get(key.toStdString());
+            if(response.get_status() == neroshop::Response::Status::Error) {
                 int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key.toStdString() });
                 if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
                 //emit productRatingsChanged();
                 continue; // Key is lost or missing from DHT, skip to next iteration
             }
             
-            const auto& response_obj = json["response"];
-            assert(response_obj.is_object());
-            if (response_obj.contains("value") && response_obj["value"].is_string()) {
-                const auto& value = response_obj["value"].get<std::string>();
-                nlohmann::json value_obj = nlohmann::json::parse(value);
-                assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-                std::string metadata = value_obj["metadata"].get<std::string>();
+            const nlohmann::json& value_obj = response.get_value_json();
+            if (value_obj.is_object()) {
+                std::string metadata = value_obj.at("metadata").get<std::string>();
                 if (metadata != "product_rating") { std::cerr << "Invalid metadata. \"product_rating\" expected, got \"" << metadata << "\" instead\n"; continue; }
                 product_rating_obj.insert("key", key);
-                product_rating_obj.insert("rater_id", QString::fromStdString(value_obj["rater_id"].get<std::string>()));
-                product_rating_obj.insert("comments", QString::fromStdString(value_obj["comments"].get<std::string>()));
-                product_rating_obj.insert("signature", QString::fromStdString(value_obj["signature"].get<std::string>()));
-                product_rating_obj.insert("stars", value_obj["stars"].get<int>());
+                product_rating_obj.insert("rater_id", QString::fromStdString(value_obj.at("rater_id").get<std::string>()));
+                product_rating_obj.insert("comments", QString::fromStdString(value_obj.at("comments").get<std::string>()));
+                product_rating_obj.insert("signature", QString::fromStdString(value_obj.at("signature").get<std::string>()));
+                product_rating_obj.insert("stars", value_obj.at("stars").get<int>());
             }
             
             product_ratings.append(product_rating_obj);
@@ -719,31 +733,23 @@ QVariantList neroshop::Backend::getSellerRatings(const QString& user_id) {
             QString key = QString::fromStdString(column_value);//std::cout << key.toStdString() << "\n";
             
             // Get the value of the corresponding key from the DHT
-            std::string response;
-            client->get(key.toStdString(), response); // TODO: error handling
-            std::cout << "Received response (get): " << response << "\n";
-            // Parse the response
-            nlohmann::json json = nlohmann::json::parse(response);
-            if(json.contains("error")) {
+            neroshop::Response response = client->get(key.toStdString());
+            if(response.get_status() == neroshop::Response::Status::Error) {
                 int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key.toStdString() });
                 if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
                 //emit sellerRatingsChanged();
                 continue; // Key is lost or missing from DHT, skip to next iteration
             }
             
-            const auto& response_obj = json["response"];
-            assert(response_obj.is_object());
-            if (response_obj.contains("value") && response_obj["value"].is_string()) {
-                const auto& value = response_obj["value"].get<std::string>();
-                nlohmann::json value_obj = nlohmann::json::parse(value);
-                assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-                std::string metadata = value_obj["metadata"].get<std::string>();
+            const nlohmann::json& value_obj = response.get_value_json();
+            if (value_obj.is_object()) {
+                std::string metadata = value_obj.at("metadata").get<std::string>();
                 if (metadata != "seller_rating") { std::cerr << "Invalid metadata. \"seller_rating\" expected, got \"" << metadata << "\" instead\n"; continue; }
                 seller_rating_obj.insert("key", key);
-                seller_rating_obj.insert("rater_id", QString::fromStdString(value_obj["rater_id"].get<std::string>()));
-                seller_rating_obj.insert("comments", QString::fromStdString(value_obj["comments"].get<std::string>()));
-                seller_rating_obj.insert("signature", QString::fromStdString(value_obj["signature"].get<std::string>()));
-                seller_rating_obj.insert("score", value_obj["score"].get<int>());
+                seller_rating_obj.insert("rater_id", QString::fromStdString(value_obj.at("rater_id").get<std::string>()));
+                seller_rating_obj.insert("comments", QString::fromStdString(value_obj.at("comments").get<std::string>()));
+                seller_rating_obj.insert("signature", QString::fromStdString(value_obj.at("signature").get<std::string>()));
+                seller_rating_obj.insert("score", value_obj.at("score").get<int>());
             }
             
             seller_ratings.append(seller_rating_obj);
@@ -788,12 +794,8 @@ QVariantMap neroshop::Backend::getUser(const QString& user_id) {
     std::string key = database->get_text_params("SELECT key FROM mappings WHERE search_term = $1 AND content = 'account' LIMIT 1;", { user_id.toStdString() });
     if(key.empty()) return {};
     // Get the value of the corresponding key from the DHT
-    std::string response;
-    client->get(key, response); // TODO: error handling
-    std::cout << "Received response (get): " << response << "\n";
-    // Parse the response
-    nlohmann::json json = nlohmann::json::parse(response);
-    if(json.contains("error")) {
+    neroshop::Response response = client->get(key);
+    if(response.get_status() == neroshop::Response::Status::Error) {
         int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key });
         if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
         return {}; // Key is lost or missing from DHT, skip to next iteration
@@ -801,29 +803,25 @@ QVariantMap neroshop::Backend::getUser(const QString& user_id) {
     
     QVariantMap user_object;
             
-    const auto& response_obj = json["response"];
-    assert(response_obj.is_object());
-    if (response_obj.contains("value") && response_obj["value"].is_string()) {
-        const auto& value = response_obj["value"].get<std::string>();
-        nlohmann::json value_obj = nlohmann::json::parse(value);
-        assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-        std::string metadata = value_obj["metadata"].get<std::string>();
+    const nlohmann::json& value_obj = response.get_value_json();
+    if (value_obj.is_object()) {
+        std::string metadata = value_obj.at("metadata").get<std::string>();
         if (metadata != "user") { std::cerr << "Invalid metadata. \"user\" expected, got \"" << metadata << "\" instead\n"; return {}; }
         user_object.insert("key", QString::fromStdString(key));
-        if(value_obj.contains("display_name") && value_obj["display_name"].is_string()) {
-            std::string display_name = value_obj["display_name"].get<std::string>();
+        if(value_obj.contains("display_name") && value_obj.at("display_name").is_string()) {
+            std::string display_name = value_obj.at("display_name").get<std::string>();
             user_object.insert("display_name", QString::fromStdString(display_name));
         }
-        user_object.insert("monero_address", QString::fromStdString(value_obj["monero_address"].get<std::string>()));
-        user_object.insert("user_id", QString::fromStdString(value_obj["monero_address"].get<std::string>())); // alias
-        user_object.insert("public_key", QString::fromStdString(value_obj["public_key"].get<std::string>()));
-        if(value_obj.contains("avatar") && value_obj["avatar"].is_object()) {
-            const auto& avatar_obj = value_obj["avatar"];
+        user_object.insert("monero_address", QString::fromStdString(value_obj.at("monero_address").get<std::string>()));
+        user_object.insert("user_id", QString::fromStdString(value_obj.at("monero_address").get<std::string>())); // alias
+        user_object.insert("public_key", QString::fromStdString(value_obj.at("public_key").get<std::string>()));
+        if(value_obj.contains("avatar") && value_obj.at("avatar").is_object()) {
+            const auto& avatar_obj = value_obj.at("avatar");
             QVariantMap avatar;
             avatar.insert("name", QString::fromStdString(avatar_obj["name"].get<std::string>()));
             user_object.insert("avatar", avatar);
         }
-        user_object.insert("signature", QString::fromStdString(value_obj["signature"].get<std::string>()));
+        user_object.insert("signature", QString::fromStdString(value_obj.at("signature").get<std::string>()));
     }
 
     return user_object;
@@ -847,26 +845,18 @@ int neroshop::Backend::getStockAvailable(const QString& product_id) {
     std::string key = database->get_text_params("SELECT key FROM mappings WHERE search_term = $1 AND content = 'listing'", { product_id.toStdString() });
     if(key.empty()) return 0;
     // Get the value of the corresponding key from the DHT
-    std::string response;
-    client->get(key, response); // TODO: error handling
-    std::cout << "Received response (get): " << response << "\n";
-    // Parse the response
-    nlohmann::json json = nlohmann::json::parse(response);
-    if(json.contains("error")) {
+    neroshop::Response response = client->get(key);
+    if(response.get_status() == neroshop::Response::Status::Error) {
         int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key });
         if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
         return 0; // Key is lost or missing from DHT, return 
     }    
     
-    const auto& response_obj = json["response"];
-    assert(response_obj.is_object());
-    if (response_obj.contains("value") && response_obj["value"].is_string()) {
-        const auto& value = response_obj["value"].get<std::string>();
-        nlohmann::json value_obj = nlohmann::json::parse(value);
-        assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-        std::string metadata = value_obj["metadata"].get<std::string>();
+    const nlohmann::json& value_obj = response.get_value_json();
+    if (value_obj.is_object()) {
+        std::string metadata = value_obj.at("metadata").get<std::string>();
         if (metadata != "listing") { std::cerr << "Invalid metadata. \"listing\" expected, got \"" << metadata << "\" instead\n"; return 0; }
-        int quantity = value_obj["quantity"].get<int>();
+        int quantity = value_obj.at("quantity").get<int>();
         return quantity;
     }
     
@@ -911,38 +901,30 @@ QVariantList neroshop::Backend::getInventory(const QString& user_id, bool hide_i
             if(column_value == "NULL") continue; // Skip invalid columns
             QString key = QString::fromStdString(column_value);
             // Get the value of the corresponding key from the DHT
-            std::string response;
-            client->get(key.toStdString(), response); // TODO: error handling
-            std::cout << "Received response (get): " << response << "\n";
-            // Parse the response
-            nlohmann::json json = nlohmann::json::parse(response);
-            if(json.contains("error")) {
+            neroshop::Response response = client->get(key.toStdString());
+            if(response.get_status() == neroshop::Response::Status::Error) {
                 int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key.toStdString() });
                 if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
                 continue; // Key is lost or missing from DHT, skip to next iteration
             }
             
-            const auto& response_obj = json["response"];
-            assert(response_obj.is_object());
-            if (response_obj.contains("value") && response_obj["value"].is_string()) {
-                const auto& value = response_obj["value"].get<std::string>();
-                nlohmann::json value_obj = nlohmann::json::parse(value);
-                assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-                std::string metadata = value_obj["metadata"].get<std::string>();
+            const nlohmann::json& value_obj = response.get_value_json();
+            if (value_obj.is_object()) {
+                std::string metadata = value_obj.at("metadata").get<std::string>();
                 if (metadata != "listing") { std::cerr << "Invalid metadata. \"listing\" expected, got \"" << metadata << "\" instead\n"; continue; }
                 inventory_object.insert("key", key);
-                inventory_object.insert("listing_uuid", QString::fromStdString(value_obj["id"].get<std::string>()));
-                inventory_object.insert("seller_id", QString::fromStdString(value_obj["seller_id"].get<std::string>()));
-                inventory_object.insert("quantity", value_obj["quantity"].get<int>());
-                inventory_object.insert("price", value_obj["price"].get<double>());
-                inventory_object.insert("currency", QString::fromStdString(value_obj["currency"].get<std::string>()));
-                inventory_object.insert("condition", QString::fromStdString(value_obj["condition"].get<std::string>()));
-                if(value_obj.contains("location") && value_obj["location"].is_string()) {
-                    inventory_object.insert("location", QString::fromStdString(value_obj["location"].get<std::string>()));
+                inventory_object.insert("listing_uuid", QString::fromStdString(value_obj.at("id").get<std::string>()));
+                inventory_object.insert("seller_id", QString::fromStdString(value_obj.at("seller_id").get<std::string>()));
+                inventory_object.insert("quantity", value_obj.at("quantity").get<int>());
+                inventory_object.insert("price", value_obj.at("price").get<double>());
+                inventory_object.insert("currency", QString::fromStdString(value_obj.at("currency").get<std::string>()));
+                inventory_object.insert("condition", QString::fromStdString(value_obj.at("condition").get<std::string>()));
+                if(value_obj.contains("location") && value_obj.at("location").is_string()) {
+                    inventory_object.insert("location", QString::fromStdString(value_obj.at("location").get<std::string>()));
                 }
-                inventory_object.insert("date", QString::fromStdString(value_obj["date"].get<std::string>()));
-                assert(value_obj["product"].is_object());
-                const auto& product_obj = value_obj["product"];
+                inventory_object.insert("date", QString::fromStdString(value_obj.at("date").get<std::string>()));
+                assert(value_obj.at("product").is_object());
+                const auto& product_obj = value_obj.at("product");
                 inventory_object.insert("product_uuid", QString::fromStdString(product_obj["id"].get<std::string>()));
                 inventory_object.insert("product_name", QString::fromStdString(product_obj["name"].get<std::string>()));
                 inventory_object.insert("product_description", QString::fromStdString(product_obj["description"].get<std::string>()));
@@ -1040,12 +1022,8 @@ QVariantList neroshop::Backend::getListingsBySearchTerm(const QString& searchTer
             if(column_value == "NULL") continue; // Skip invalid columns
             QString key = QString::fromStdString(column_value);
             // Get the value of the corresponding key from the DHT
-            std::string response;
-            client->get(key.toStdString(), response); // TODO: error handling
-            std::cout << "Received response (get): " << response << "\n";
-            // Parse the response
-            nlohmann::json json = nlohmann::json::parse(response);
-            if(json.contains("error")) { 
+            neroshop::Response response = client->get(key.toStdString());
+            if(response.get_status() == neroshop::Response::Status::Error) { 
                 int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key.toStdString() });
                 if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
                 //emit categoryProductCountChanged();//(category_id);
@@ -1053,26 +1031,22 @@ QVariantList neroshop::Backend::getListingsBySearchTerm(const QString& searchTer
                 continue; // Key is lost or missing from DHT, skip to next iteration
             }
             
-            const auto& response_obj = json["response"];
-            assert(response_obj.is_object());
-            if (response_obj.contains("value") && response_obj["value"].is_string()) {
-                const auto& value = response_obj["value"].get<std::string>();
-                nlohmann::json value_obj = nlohmann::json::parse(value);
-                assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-                std::string metadata = value_obj["metadata"].get<std::string>();
+            const nlohmann::json& value_obj = response.get_value_json();
+            if (value_obj.is_object()) {
+                std::string metadata = value_obj.at("metadata").get<std::string>();
                 listing.insert("key", key);
-                listing.insert("listing_uuid", QString::fromStdString(value_obj["id"].get<std::string>()));
-                listing.insert("seller_id", QString::fromStdString(value_obj["seller_id"].get<std::string>()));
-                listing.insert("quantity", value_obj["quantity"].get<int>());
-                listing.insert("price", value_obj["price"].get<double>());
-                listing.insert("currency", QString::fromStdString(value_obj["currency"].get<std::string>()));
-                listing.insert("condition", QString::fromStdString(value_obj["condition"].get<std::string>()));
-                if(value_obj.contains("location") && value_obj["location"].is_string()) {
-                    listing.insert("location", QString::fromStdString(value_obj["location"].get<std::string>()));
+                listing.insert("listing_uuid", QString::fromStdString(value_obj.at("id").get<std::string>()));
+                listing.insert("seller_id", QString::fromStdString(value_obj.at("seller_id").get<std::string>()));
+                listing.insert("quantity", value_obj.at("quantity").get<int>());
+                listing.insert("price", value_obj.at("price").get<double>());
+                listing.insert("currency", QString::fromStdString(value_obj.at("currency").get<std::string>()));
+                listing.insert("condition", QString::fromStdString(value_obj.at("condition").get<std::string>()));
+                if(value_obj.contains("location") && value_obj.at("location").is_string()) {
+                    listing.insert("location", QString::fromStdString(value_obj.at("location").get<std::string>()));
                 }
-                listing.insert("date", QString::fromStdString(value_obj["date"].get<std::string>()));
-                assert(value_obj["product"].is_object());
-                const auto& product_obj = value_obj["product"];
+                listing.insert("date", QString::fromStdString(value_obj.at("date").get<std::string>()));
+                assert(value_obj.at("product").is_object());
+                const auto& product_obj = value_obj.at("product");
                 listing.insert("product_uuid", QString::fromStdString(product_obj["id"].get<std::string>()));
                 listing.insert("product_name", QString::fromStdString(product_obj["name"].get<std::string>()));
                 listing.insert("product_description", QString::fromStdString(product_obj["description"].get<std::string>()));
@@ -1141,6 +1115,16 @@ QVariantList neroshop::Backend::getListings(ListingSorting sorting, bool hide_il
         return {};
     }
     
+    // Get the values of all the keys from the DHT at once instead of one lookup per key
+    std::vector<std::string> keys;
+    while(sqlite3_step(stmt) == SQLITE_ROW) {
+        if(sqlite3_column_text(stmt, 0) != nullptr) keys.push_back(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+    }
+    sqlite3_reset(stmt);
+    neroshop::Response response = client->get_many(keys);
+    // Mappings are only removed if the lookup itself succeeded
+    bool values_received = response.is_ok() && response.get_result().contains("values");
+    
     QVariantList catalog;
     // Get all table values row by row
     while(sqlite3_step(stmt) == SQLITE_ROW) {
@@ -1152,41 +1136,34 @@ QVariantList neroshop::Backend::getListings(ListingSorting sorting, bool hide_il
             std::string column_value = (sqlite3_column_text(stmt, i) == nullptr) ? "NULL" : reinterpret_cast<const char *>(sqlite3_column_text(stmt, i));//std::cout << column_value  << " (" << i << ")" << std::endl;
             if(column_value == "NULL") continue; // Skip invalid columns
             QString key = QString::fromStdString(column_value);
-            // Get the value of the corresponding key from the DHT
-            std::string response;
-            client->get(key.toStdString(), response); // TODO: error handling
-            std::cout << "Received response (get): " << response << "\n";
-            // Parse the response
-            nlohmann::json json = nlohmann::json::parse(response);
-            if(json.contains("error")) {
-                int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key.toStdString() });
-                if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
+            // Get the value of the corresponding key from the values retrieved above
+            if(response.get_value(key.toStdString()).empty()) {
+                if(values_received) {
+                    int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key.toStdString() });
+                    if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
+                }
                 //emit categoryProductCountChanged();//(category_id);
                 //emit searchResultsChanged();
                 continue; // Key is lost or missing from DHT, skip to next iteration
             }
             
-            const auto& response_obj = json["response"];
-            assert(response_obj.is_object());
-            if (response_obj.contains("value") && response_obj["value"].is_string()) {
-                const auto& value = response_obj["value"].get<std::string>();
-                nlohmann::json value_obj = nlohmann::json::parse(value);
-                assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-                std::string metadata = value_obj["metadata"].get<std::string>();
+            const nlohmann::json& value_obj = response.get_value_json(key.toStdString());
+            if (value_obj.is_object()) {
+                std::string metadata = value_obj.at("metadata").get<std::string>();
                 if (metadata != "listing") { std::cerr << "Invalid metadata. \"listing\" expected, got \"" << metadata << "\" instead\n"; continue; }
                 listing.insert("key", key);
-                listing.insert("listing_uuid", QString::fromStdString(value_obj["id"].get<std::string>()));
-                listing.insert("seller_id", QString::fromStdString(value_obj["seller_id"].get<std::string>()));
-                listing.insert("quantity", value_obj["quantity"].get<int>());
-                listing.insert("price", value_obj["price"].get<double>());
-                listing.insert("currency", QString::fromStdString(value_obj["currency"].get<std::string>()));
-                listing.insert("condition", QString::fromStdString(value_obj["condition"].get<std::string>()));
-                if(value_obj.contains("location") && value_obj["location"].is_string()) {
-                    listing.insert("location", QString::fromStdString(value_obj["location"].get<std::string>()));
+                listing.insert("listing_uuid", QString::fromStdString(value_obj.at("id").get<std::string>()));
+                listing.insert("seller_id", QString::fromStdString(value_obj.at("seller_id").get<std::string>()));
+                listing.insert("quantity", value_obj.at("quantity").get<int>());
+                listing.insert("price", value_obj.at("price").get<double>());
+                listing.insert("currency", QString::fromStdString(value_obj.at("currency").get<std::string>()));
+                listing.insert("condition", QString::fromStdString(value_obj.at("condition").get<std::string>()));
+                if(value_obj.contains("location") && value_obj.at("location").is_string()) {
+                    listing.insert("location", QString::fromStdString(value_obj.at("location").get<std::string>()));
                 }
-                listing.insert("date", QString::fromStdString(value_obj["date"].get<std::string>()));
-                assert(value_obj["product"].is_object());
-                const auto& product_obj = value_obj["product"];
+                listing.insert("date", QString::fromStdString(value_obj.at("date").get<std::string>()));
+                assert(value_obj.at("product").is_object());
+                const auto& product_obj = value_obj.at("product");
                 listing.insert("product_uuid", QString::fromStdString(product_obj["id"].get<std::string>()));
                 listing.insert("product_name", QString::fromStdString(product_obj["name"].get<std::string>()));
                 listing.insert("product_description", QString::fromStdString(product_obj["description"].get<std::string>()));
@@ -1379,12 +1356,8 @@ QVariantList neroshop::Backend::getListingsByCategory(int category_id, bool hide
             if(column_value == "NULL") continue; // Skip invalid columns
             QString key = QString::fromStdString(column_value);
             // Get the value of the corresponding key from the DHT
-            std::string response;
-            client->get(key.toStdString(), response); // TODO: error handling
-            std::cout << "Received response (get): " << response << "\n";
-            // Parse the response
-            nlohmann::json json = nlohmann::json::parse(response);
-            if(json.contains("error")) {
+            neroshop::Response response = client->get(key.toStdString());
+            if(response.get_status() == neroshop::Response::Status::Error) {
                 int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key.toStdString() });
                 if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
                 //emit categoryProductCountChanged();//(category_id);
@@ -1392,27 +1365,23 @@ QVariantList neroshop::Backend::getListingsByCategory(int category_id, bool hide
                 continue; // Key is lost or missing from DHT, skip to next iteration
             }
             
-            const auto& response_obj = json["response"];
-            assert(response_obj.is_object());
-            if (response_obj.contains("value") && response_obj["value"].is_string()) {
-                const auto& value = response_obj["value"].get<std::string>();
-                nlohmann::json value_obj = nlohmann::json::parse(value);
-                assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-                std::string metadata = value_obj["metadata"].get<std::string>();
+            const nlohmann::json& value_obj = response.get_value_json();
+            if (value_obj.is_object()) {
+                std::string metadata = value_obj.at("metadata").get<std::string>();
                 if (metadata != "listing") { std::cerr << "Invalid metadata. \"listing\" expected, got \"" << metadata << "\" instead\n"; continue; }
                 listing.insert("key", key);
-                listing.insert("listing_uuid", QString::fromStdString(value_obj["id"].get<std::string>()));
-                listing.insert("seller_id", QString::fromStdString(value_obj["seller_id"].get<std::string>()));
-                listing.insert("quantity", value_obj["quantity"].get<int>());
-                listing.insert("price", value_obj["price"].get<double>());
-                listing.insert("currency", QString::fromStdString(value_obj["currency"].get<std::string>()));
-                listing.insert("condition", QString::fromStdString(value_obj["condition"].get<std::string>()));
-                if(value_obj.contains("location") && value_obj["location"].is_string()) {
-                    listing.insert("location", QString::fromStdString(value_obj["location"].get<std::string>()));
+                listing.insert("listing_uuid", QString::fromStdString(value_obj.at("id").get<std::string>()));
+                listing.insert("seller_id", QString::fromStdString(value_obj.at("seller_id").get<std::string>()));
+                listing.insert("quantity", value_obj.at("quantity").get<int>());
+                listing.insert("price", value_obj.at("price").get<double>());
+                listing.insert("currency", QString::fromStdString(value_obj.at("currency").get<std::string>()));
+                listing.insert("condition", QString::fromStdString(value_obj.at("condition").get<std::string>()));
+                if(value_obj.contains("location") && value_obj.at("location").is_string()) {
+                    listing.insert("location", QString::fromStdString(value_obj.at("location").get<std::string>()));
                 }
-                listing.insert("date", QString::fromStdString(value_obj["date"].get<std::string>()));
-                assert(value_obj["product"].is_object());
-                const auto& product_obj = value_obj["product"];
+                listing.insert("date", QString::fromStdString(value_obj.at("date").get<std::string>()));
+                assert(value_obj.at("product").is_object());
+                const auto& product_obj = value_obj.at("product");
                 listing.insert("product_uuid", QString::fromStdString(product_obj["id"].get<std::string>()));
                 listing.insert("product_name", QString::fromStdString(product_obj["name"].get<std::string>()));
                 listing.insert("product_description", QString::fromStdString(product_obj["description"].get<std::string>()));
@@ -1685,6 +1654,8 @@ QVariantList neroshop::Backend::registerUser(WalletController* wallet_controller
     //---------------------------------------------
     emit user_controller->userChanged();
     emit user_controller->userLogged();
+    // Messages sent to this user are pushed by the daemon as they arrive
+    subscribeToMessages(user_controller->_user->get_id());
     // temp - remove soon
     //user_controller->rateItem("8e12c9e7-7017-4bd0-95fe-9abbcd82c1ff", 3, "This product is aiight");
     //user_controller->rateSeller("5AQFFwoqqBWMYCh6b2V6RyEKZS5ozqfCP1uLnf5FTHiqjk9qyDGoj62Vva2jz71nFGPsDgXAfv2q4GGaWyV2EQ2xTfgFPCw", 1, "This seller rocks");
@@ -1780,6 +1751,8 @@ int neroshop::Backend::loginWithWalletFile(WalletController* wallet_controller,
     //----------------------------------------
     emit user_controller->userChanged();
     emit user_controller->userLogged();
+    // Messages sent to this user are pushed by the daemon as they arrive
+    subscribeToMessages(user_controller->_user->get_id());
     // temp - remove soon
     //getSellerRatings(wallet_controller->getPrimaryAddress());
     //getSellerRatingsCount("5AncSFWauoN8bfA68uYpWJRM8fFxEqztuhXSGkeQn5Xd9yU6XqJPW7cZmtYETUAjTK1fCfYQX1CP3Dnmy5a8eUSM5n3C6aL");
@@ -1871,6 +1844,15 @@ int neroshop::Backend::loginWithHW(WalletController* wallet_controller, UserCont
     return false;
 }
 //----------------------------------------------------------------
+void neroshop::Backend::subscribeToMessages(const std::string& recipient_id) {
+    if(recipient_id == message_recipient_id) return; // Already subscribed, e.g. the same user logged in again
+    Client * client = Client::get_main_client();
+    // The daemon keeps one recipient per client, so the previous user's subscription is dropped first
+    if(!message_recipient_id.empty()) client->unsubscribe({ {"topics", { "message" }} });
+    message_recipient_id = recipient_id;
+    if(!recipient_id.empty()) client->subscribe({ {"topics", { "message" }}, {"recipient_id", recipient_id} });
+}
+//----------------------------------------------------------------
 //----------------------------------------------------------------
 QVariantMap neroshop::Backend::getNetworkStatus() const {
     // Make sure daemon is connected first
@@ -1881,19 +1863,14 @@ QVariantMap neroshop::Backend::getNetworkStatus() const {
     Client * client = Client::get_main_client();
     
     // Get network status from local node in IPC mode
-    std::string response;
-    client->get("status", response); //std::cout << "Received response (get): " << response << "\n";
-    
-    // Parse the response
-    nlohmann::json json = nlohmann::json::parse(response);
-    if(json.contains("error")) {
+    neroshop::Response response = client->get("status");
+    if(!response.is_ok()) {
         return {};
     }
     
     QVariantMap network_status;
             
-    const auto& response_obj = json["response"];
-    assert(response_obj.is_object());
+    const nlohmann::json& response_obj = response.get_result();
     if (response_obj.contains("connected_peers") && response_obj["connected_peers"].is_number_integer()) {
         int connected_peers = response_obj["connected_peers"].get<int>();
         network_status["connected_peers"] = connected_peers;
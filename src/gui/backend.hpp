@@ -121,7 +121,13 @@ public:
 signals:
     //void categoryProductCountChanged();//(int category_id);
     //void searchResultsChanged();
+    // Pushed by the daemon instead of being polled for
+    void networkStatusChanged(const QVariantMap& networkStatus);
+    void listingUpdated(const QString& key);
+    void messageReceived(const QString& key);
 private:
+    std::string message_recipient_id; // User whose messages the daemon pushes, empty until a user logs in
+    void subscribeToMessages(const std::string& recipient_id); // Replaces the subscription of the previous user
 };
 }
 #endif
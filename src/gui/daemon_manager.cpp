@@ -8,6 +8,7 @@
 
 #include "../neroshop_config.hpp"
 #include "../core/protocol/transport/client.hpp"
+#include "../core/settings.hpp"
 
 neroshop::DaemonManager::DaemonManager(QObject *parent)
     : QObject{parent}, m_daemonRunning(false), m_daemonConnected(false)//, pid(-1)
@@ -24,6 +25,24 @@ neroshop::DaemonManager::~DaemonManager() {
 
 qint64 neroshop::DaemonManager::pid(-1);
 
+// Connects over the transport chosen in settings.json: "tcp" (loopback, the default), "unix" (Unix domain socket, optionally with shared memory)
+// or "zmq" (ZeroMQ, when built with it)
+static bool connect_to_daemon(neroshop::Client * client) {
+    nlohmann::json settings = nlohmann::json::parse(neroshop::load_json(), nullptr, false); // allow_exceptions set to false
+    if (!settings.is_discarded() && settings.contains("neromon") && settings["neromon"].is_object()) {
+        const nlohmann::json& neromon = settings["neromon"];
+        if (neromon.value("ipc_transport", "tcp") == "unix") {
+            return client->connect_unix(NEROSHOP_DEFAULT_IPC_SOCKET_PATH, neromon.value("ipc_shared_memory", false));
+        }
+        #if defined(NEROSHOP_USE_LIBZMQ)
+        if (neromon.value("ipc_transport", "tcp") == "zmq") {
+            return client->connect_zmq(NEROSHOP_DEFAULT_IPC_ZMQ_ENDPOINT);
+        }
+        #endif
+    }
+    return client->connect(NEROSHOP_IPC_DEFAULT_PORT, "127.0.0.1");
+}
+
 void neroshop::DaemonManager::startDaemonProcess()
 {
     // Check if the daemon is already running
@@ -135,7 +154,7 @@ void neroshop::DaemonManager::connect() {
     
     neroshop::Client * client = neroshop::Client::get_main_client();
 
-    if (!client->connect(NEROSHOP_IPC_DEFAULT_PORT, "127.0.0.1")) {
+    if (!connect_to_daemon(client)) {
         onConnectionFailure();
         return;
     }
@@ -153,7 +172,7 @@ void neroshop::DaemonManager::onConnectionFailure() {
 
     std::this_thread::sleep_until(std::chrono::steady_clock::now() + std::chrono::seconds(5));
     Client* client = Client::get_main_client();
-    client->connect(NEROSHOP_IPC_DEFAULT_PORT, "127.0.0.1");
+    connect_to_daemon(client);
 }
 
 void neroshop::DaemonManager::disconnect() {
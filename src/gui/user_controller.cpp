@@ -305,12 +305,8 @@ QVariantList neroshop::UserController::getInventory(InventorySorting sorting) co
             if(column_value == "NULL") continue; // Skip invalid columns
             QString key = QString::fromStdString(column_value);
             // Get the value of the corresponding key from the DHT
-            std::string response;
-            client->get(key.toStdString(), response); // TODO: error handling
-            std::cout << "Received response (get): " << response << "\n";
-            // Parse the response
-            nlohmann::json json = nlohmann::json::parse(response);
-            if(json.contains("error")) {
+            neroshop::Response response = client->get(key.toStdString());
+            if(response.get_status() == neroshop::Response::Status::Error) {
                 int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key.toStdString() });
                 if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
                 //emit productsCountChanged();
@@ -318,27 +314,23 @@ QVariantList neroshop::UserController::getInventory(InventorySorting sorting) co
                 continue; // Key is lost or missing from DHT, skip to next iteration
             }
             
-            const auto& response_obj = json["response"];
-            assert(response_obj.is_object());
-            if (response_obj.contains("value") && response_obj["value"].is_string()) {
-                const auto& value = response_obj["value"].get<std::string>();
-                nlohmann::json value_obj = nlohmann::json::parse(value);
-                assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-                std::string metadata = value_obj["metadata"].get<std::string>();
+            const nlohmann::json& value_obj = response.get_value_json();
+            if (value_obj.is_object()) {
+                std::string metadata = value_obj.at("metadata").get<std::string>();
                 if (metadata != "listing") { std::cerr << "Invalid metadata. \"listing\" expected, got \"" << metadata << "\" instead\n"; continue; }
                 inventory_object.insert("key", key);
-                inventory_object.insert("listing_uuid", QString::fromStdString(value_obj["id"].get<std::string>()));
-                inventory_object.insert("seller_id", QString::fromStdString(value_obj["seller_id"].get<std::string>()));
-                inventory_object.insert("quantity", value_obj["quantity"].get<int>());
-                inventory_object.insert("price", value_obj["price"].get<double>());
-                inventory_object.insert("currency", QString::fromStdString(value_obj["currency"].get<std::string>()));
-                inventory_object.insert("condition", QString::fromStdString(value_obj["condition"].get<std::string>()));
-                if(value_obj.contains("location") && value_obj["location"].is_string()) {
-                    inventory_object.insert("location", QString::fromStdString(value_obj["location"].get<std::string>()));
+                inventory_object.insert("listing_uuid", QString::fromStdString(value_obj.at("id").get<std::string>()));
+                inventory_object.insert("seller_id", QString::fromStdString(value_obj.at("seller_id").get<std::string>()));
+                inventory_object.insert("quantity", value_obj.at("quantity").get<int>());
+                inventory_object.insert("price", value_obj.at("price").get<double>());
+                inventory_object.insert("currency", QString::fromStdString(value_obj.at("currency").get<std::string>()));
+                inventory_object.insert("condition", QString::fromStdString(value_obj.at("condition").get<std::string>()));
+                if(value_obj.contains("location") && value_obj.at("location").is_string()) {
+                    inventory_object.insert("location", QString::fromStdString(value_obj.at("location").get<std::string>()));
                 }
-                inventory_object.insert("date", QString::fromStdString(value_obj["date"].get<std::string>()));
-                assert(value_obj["product"].is_object());
-                const auto& product_obj = value_obj["product"];
+                inventory_object.insert("date", QString::fromStdString(value_obj.at("date").get<std::string>()));
+                assert(value_obj.at("product").is_object());
+                const auto& product_obj = value_obj.at("product");
                 inventory_object.insert("product_uuid", QString::fromStdString(product_obj["id"].get<std::string>()));
                 inventory_object.insert("product_name", QString::fromStdString(product_obj["name"].get<std::string>()));
                 inventory_object.insert("product_description", QString::fromStdString(product_obj["description"].get<std::string>()));
@@ -507,33 +499,25 @@ QVariantList neroshop::UserController::getMessages() const {
             if(column_value == "NULL") continue; // Skip invalid columns
             QString key = QString::fromStdString(column_value);
             // Get the value of the corresponding key from the DHT
-            std::string response;
-            client->get(key.toStdString(), response); // TODO: error handling
-            std::cout << "Received response (get): " << response << "\n";
-            // Parse the response
-            nlohmann::json json = nlohmann::json::parse(response);
-            if(json.contains("error")) {
+            neroshop::Response response = client->get(key.toStdString());
+            if(response.get_status() == neroshop::Response::Status::Error) {
                 int rescode = database->execute_params("DELETE FROM mappings WHERE key = ?1", { key.toStdString() });
                 if(rescode != SQLITE_OK) neroshop::print("sqlite error: DELETE failed", 1);
                 continue; // Key is lost or missing from DHT, skip to next iteration
             }
             
-            const auto& response_obj = json["response"];
-            assert(response_obj.is_object());
-            if (response_obj.contains("value") && response_obj["value"].is_string()) {
-                const auto& value = response_obj["value"].get<std::string>();
-                nlohmann::json value_obj = nlohmann::json::parse(value);
-                assert(value_obj.is_object());//std::cout << value_obj.dump(4) << "\n";
-                std::string metadata = value_obj["metadata"].get<std::string>();
+            const nlohmann::json& value_obj = response.get_value_json();
+            if (value_obj.is_object()) {
+                std::string metadata = value_obj.at("metadata").get<std::string>();
                 if (metadata != "message") { std::cerr << "Invalid metadata. \"message\" expected, got \"" << metadata << "\" instead\n"; continue; }
                 message_object.insert("key", key);
-                std::string content = value_obj["content"].get<std::string>();
-                std::string sender_id = value_obj["sender_id"].get<std::string>();
+                std::string content = value_obj.at("content").get<std::string>();
+                std::string sender_id = value_obj.at("sender_id").get<std::string>();
                 auto message_decrypted = _user->decrypt_message(content, sender_id);
                 message_object.insert("content", QString::fromStdString(message_decrypted.first));
                 message_object.insert("sender_id", QString::fromStdString(message_decrypted.second));
-                message_object.insert("recipient_id", QString::fromStdString(value_obj["recipient_id"].get<std::string>()));
-                message_object.insert("timestamp", QString::fromStdString(value_obj["timestamp"].get<std::string>()));
+                message_object.insert("recipient_id", QString::fromStdString(value_obj.at("recipient_id").get<std::string>()));
+                message_object.insert("timestamp", QString::fromStdString(value_obj.at("timestamp").get<std::string>()));
             }
             messages_array.append(message_object);
         }
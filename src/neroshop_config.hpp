@@ -18,20 +18,38 @@
 #endif
 
 #define NEROSHOP_IPC_DEFAULT_PORT 57740
+#define NEROSHOP_IPC_MAX_IN_FLIGHT 32 // Maximum number of pipelined requests from one IPC client that the daemon holds at once. Further requests wait in the socket buffer
+#define NEROSHOP_IPC_MAX_CLIENTS 64 // Maximum number of GUIs, CLIs and scripts connected to the daemon at once
+#define NEROSHOP_IPC_MAX_SUBSCRIBED_KEYS 4096 // Maximum number of keys that one IPC client may watch for new values
+#define NEROSHOP_IPC_WORKER_COUNT 8 // Number of threads that handle IPC requests. Requests may block on the network, so this is not tied to the number of cores
+#define NEROSHOP_IPC_MAX_FRAME_SIZE 16777216 // Maximum size of a single IPC message in bytes (16 MiB). A larger frame closes the connection
+#define NEROSHOP_IPC_SHM_RING_SIZE 8388608 // Size in bytes of the shared-memory ring that carries large responses to a GUI connected over the Unix socket (8 MiB)
+#define NEROSHOP_IPC_SHM_THRESHOLD 16384 // Responses of at least this many bytes go through the shared-memory ring. Smaller ones are cheaper to send over the socket
+#define NEROSHOP_IPC_ZMQ_PORT 57741 // ZeroMQ (ROUTER) IPC endpoint on TCP loopback. Only served when built with NEROSHOP_USE_LIBZMQ
 // This port will be used by the daemon to establish connections with p2p network
 #define NEROSHOP_P2P_DEFAULT_PORT 50881 // Use ports between 49152-65535 that are not currently registered with IANA and are rarely used
 // This port will allow outside clients to interact with neroshop daemon RPC server
 #define NEROSHOP_RPC_DEFAULT_PORT 50882
+#define NEROSHOP_RPC_MAX_REQUEST_SIZE 1048576 // Maximum size of an HTTP request (headers and body) to the RPC server in bytes (1 MiB)
+#define NEROSHOP_RPC_WORKER_COUNT 8 // Number of threads that handle RPC requests
+#define NEROSHOP_RPC_MAX_CLIENTS 256 // Maximum number of open connections to the RPC server. Further connections are refused until one is closed
+#define NEROSHOP_RPC_KEEP_ALIVE_TIMEOUT 30 // Seconds that an idle keep-alive connection to the RPC server is kept open
+#define NEROSHOP_RPC_MAX_BATCH_SIZE 1000 // Maximum number of calls in a JSON-RPC batch. A larger batch is answered with an Invalid Request error
+#define NEROSHOP_RPC_BATCH_CONCURRENCY 8 // Maximum number of calls of one JSON-RPC batch that run at the same time
+#define NEROSHOP_UV_THREADPOOL_SIZE 72 // Threads that handle requests when neromon runs on a libuv event loop. Enough for NEROSHOP_DHT_MAX_CONCURRENT_REQUESTS plus the timers
 
 #define NEROSHOP_DAEMON_WAIT_TIME 20 // Measured in seconds
 
 #define NEROSHOP_LOOPBACK_ADDRESS            "127.0.0.1"
 #define NEROSHOP_ANY_ADDRESS                 "0.0.0.0"
 
+#define NEROSHOP_IO_URING_ENTRIES            256 // Submission queue size of the DHT node's io_uring (NEROSHOP_USE_IO_URING). Sends beyond this wait for the next submission
+#define NEROSHOP_IO_URING_BUFFER_COUNT       1024 // Receive buffers that the kernel fills with datagrams (a power of 2). A burst larger than this is dropped like a full socket buffer would drop it
 #define NEROSHOP_RECV_BUFFER_SIZE            4096//8192// no IP packet can be above 64000 (64 KB), not even with fragmentation, thus recv on an UDP socket can at most return 64 KB (and what is not returned is discarded for the current packet!)
 
 #define NEROSHOP_DHT_REPLICATION_FACTOR      10 // 10 to 20 (or even higher) // Usually 3 or 5 but a higher number would improve fault tolerant, mitigating the risk of data loss even if multiple nodes go offline simultaneously. It also helps distribute the load across more nodes, potentially improving read performance by allowing concurrent access from multiple replicas.
 #define NEROSHOP_DHT_MAX_CLOSEST_NODES       20 // 50 to 100 (or even higher)
+#define NEROSHOP_DHT_LOOKUP_CONCURRENCY      3 // Number of nodes queried in parallel during each round of an iterative lookup (alpha)
 #define NEROSHOP_DHT_QUERY_RECV_TIMEOUT      5 // A reasonable timeout value for a DHT node could be between 5 to 30 seconds.
 #define NEROSHOP_DHT_PING_MESSAGE_TIMEOUT    2
 #define NEROSHOP_DHT_ROUTING_TABLE_BUCKETS   256 // recommended to use a number of buckets that is equal to the number of bits in the node id (in this case, sha-3-256 so 256 bits)
@@ -42,6 +60,28 @@
 #define NEROSHOP_DHT_PERIODIC_CHECK_INTERVAL 60 // Number of seconds between each periodic health check
 #define NEROSHOP_DHT_REPUBLISH_INTERVAL      1 // Number of hours between each periodic refresh/republishing
 #define NEROSHOP_DHT_MAX_SEARCHES            3
+#define NEROSHOP_DHT_HANDOFF_CHUNK_SIZE      3072 // Maximum number of key-value bytes packed into a single handoff message (must stay below NEROSHOP_RECV_BUFFER_SIZE)
+#define NEROSHOP_DHT_HANDOFF_MAX_RETRIES     2 // Number of times an unacknowledged handoff chunk is resent before the handoff is aborted
+#define NEROSHOP_DHT_BLOOM_FILTER_BITS       8192 // Size of the key summary that each node publishes to its neighbours in ping/pong messages (1 KB)
+#define NEROSHOP_DHT_BLOOM_FILTER_HASHES     4
+#define NEROSHOP_DHT_BLOOM_FILTER_TTL        (NEROSHOP_DHT_PERIODIC_CHECK_INTERVAL * 3) // Number of seconds after which a neighbour's key summary is considered stale and ignored
+#define NEROSHOP_DHT_MAX_VALUE_SIZE          NEROSHOP_IPC_MAX_FRAME_SIZE // Maximum size of a value in bytes. A compressed value that declares a larger size is rejected before it is decompressed
+#define NEROSHOP_DHT_MAX_CLOCK_DRIFT         4294967296ULL // Versions whose counter is further than this ahead of the local Lamport clock are rejected, so a peer cannot push the clock to its limit
+#define NEROSHOP_DHT_NEGATIVE_CACHE_TTL      60 // Number of seconds that a key which could not be found anywhere is remembered as missing
+#define NEROSHOP_DHT_MAX_CONCURRENT_REQUESTS 64 // Maximum number of inbound requests handled at once. Normal and low priority requests may only use 3/4 and 1/2 of it respectively
+#define NEROSHOP_DHT_RATE_LIMIT              50 // Number of tokens per second that each sender IP address gets to spend on requests (a ping costs 1, a get 2 and a put or map 4)
+#define NEROSHOP_DHT_RATE_BURST              200 // Maximum number of tokens that a sender IP address can save up
+#define NEROSHOP_DHT_RATE_LIMIT_MAX_PEERS    4096 // Maximum number of sender IP addresses whose request rate is tracked
+#define NEROSHOP_DHT_TOKEN_SECRET_LIFETIME   300 // Number of seconds before the secret used to generate announce tokens is rotated. Tokens made with the previous secret are still accepted (BEP 5)
+#define NEROSHOP_DHT_NEGATIVE_CACHE_SIZE     1024 // Maximum number of recently-missed keys to remember
+#define NEROSHOP_DHT_VALUE_CACHE_SIZE        8388608 // Maximum number of bytes (8 MB) used to cache the values of popular keys that this node does not store itself
+#define NEROSHOP_DHT_VALUE_CACHE_MIN_TTL     60 // Number of seconds that a value is cached by a node that is far (in XOR distance) from its key
+#define NEROSHOP_DHT_VALUE_CACHE_MAX_TTL     3600 // Number of seconds that a value is cached by a node that is very close to its key
+#define NEROSHOP_DHT_PATH_CACHE_SIZE         4096 // Maximum number of keys for which the nodes that last returned their value are remembered
+#define NEROSHOP_DHT_PATH_CACHE_TTL          600 // Number of seconds that the nodes that returned a value are asked first for it
+#define NEROSHOP_DHT_VALUE_CACHE_MAX_STATS   4096 // Maximum number of keys to keep hit/miss statistics for
+#define NEROSHOP_DHT_MAX_BATCH_KEYS          32 // Maximum number of keys requested in a single get_many message or stored by a single put_many message
+#define NEROSHOP_DHT_MAX_BATCH_SIZE          3072 // Maximum number of bytes of entries (and keys left in "more") packed into a single get_many response or put_many message (must stay below NEROSHOP_RECV_BUFFER_SIZE)
 
 #define NEROSHOP_PUBLIC_KEY_FILENAME              "<user_id>.pub"
 #define NEROSHOP_PRIVATE_KEY_FILENAME             "<user_id>.key"
@@ -61,6 +101,8 @@
 #define NEROSHOP_SETTINGS_FILENAME      "settings.json"
 #define NEROSHOP_NODES_FILENAME         "nodes.lua"
 #define NEROSHOP_LOG_FILENAME           "neroshop.log"
+#define NEROSHOP_IPC_SOCKET_FILENAME    "neromon.sock" // Unix domain socket in the data directory
+#define NEROSHOP_IPC_ZMQ_SOCKET_FILENAME "neromon-zmq.sock" // ZeroMQ ipc:// endpoint in the data directory
 
 #define NEROSHOP_CACHE_FOLDER_NAME   "datastore"
 #define NEROSHOP_CATALOG_FOLDER_NAME "listings"
@@ -107,6 +149,9 @@
 #define NEROSHOP_DEFAULT_DATABASE_PATH                 NEROSHOP_DATA_DIRECTORY_PATH
 #endif // endif NOT NEROSHOP_USE_QT
 
+#define NEROSHOP_DEFAULT_IPC_SOCKET_PATH std::string(NEROSHOP_DATA_DIRECTORY_PATH) + "/" + NEROSHOP_IPC_SOCKET_FILENAME // Both the GUI and the daemon must resolve it to the same file
+#define NEROSHOP_DEFAULT_IPC_ZMQ_ENDPOINT std::string("ipc://") + NEROSHOP_DATA_DIRECTORY_PATH + "/" + NEROSHOP_IPC_ZMQ_SOCKET_FILENAME
+
 namespace neroshop {
 //TODO Add here your network seed or bootstrap nodes
 const std::initializer_list<std::string> BOOTSTRAP_NODES = {
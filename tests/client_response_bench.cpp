@@ -0,0 +1,141 @@
+// Measures what the GUI spends decoding the daemon's responses on a listings page load, before and after Client returned a typed Response.
+// "string" is the old path: the msgpack response is decoded, dumped to a string, parsed back by the caller and the embedded value parsed once more.
+// "typed" decodes the msgpack once and parses each value at most once, the first time it is read (a second read of the page is served from the cache)
+// g++ -std=c++17 -O2 client_response_bench.cpp ../src/core/protocol/transport/response.cpp -I../external/json/single_include -o client_response_bench
+// ./client_response_bench [listings] [iterations]
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+// neroshop
+#include "../src/core/protocol/transport/response.hpp"
+
+static const std::string node_id = "3f8e1c7a9b2d4e6f8a0c1e3d5b7f9a2c4e6d8b0f1a3c5e7d9b2f4a6c8e0d1b3f";
+
+static std::string make_key(int i) {
+    std::string key = std::to_string(i);
+    return std::string(64 - key.size(), 'a') + key;
+}
+
+static std::string make_listing(int i) {
+    nlohmann::json listing;
+    listing["metadata"] = "listing";
+    listing["id"] = "6c0bd6cd-3b24-4c3a-9d3e-" + std::to_string(100000000000 + i);
+    listing["seller_id"] = "5AncSFWauoN8bfA68uYpGQLnJyCZfiaFNbfGPG9BqiNvDHLbZuPeFQkjbm6xqsAhz2bnbXDd3Vg7HwYZXk6jvQ9mEpSDdp1";
+    listing["quantity"] = 1 + i % 50;
+    listing["price"] = 12.5 + i;
+    listing["currency"] = "USD";
+    listing["condition"] = "New";
+    listing["location"] = "Worldwide";
+    listing["date"] = "2024-01-01T00:00:00Z";
+    listing["product"]["id"] = "0b8c1a2e-" + std::to_string(i);
+    listing["product"]["name"] = "Product " + std::to_string(i);
+    listing["product"]["description"] = std::string(400, 'd');
+    listing["product"]["category"] = "Electronics";
+    listing["product"]["subcategories"] = { "Phones", "Accessories" };
+    listing["product"]["attributes"] = { { {"weight", 0.5} } };
+    listing["product"]["images"] = { { {"name", "front.jpg"}, {"id", 0} }, { {"name", "back.jpg"}, {"id", 1} } };
+    listing["signature"] = "SigV2" + std::string(88, 's');
+    return listing.dump();
+}
+
+static std::vector<uint8_t> make_get_response(const std::string& value) {
+    nlohmann::json response_object;
+    response_object["version"] = "1.0";
+    response_object["response"]["id"] = node_id;
+    response_object["response"]["value"] = value;
+    response_object["tid"] = 1;
+    return nlohmann::json::to_msgpack(response_object);
+}
+
+// What the page reads from each listing
+static double read_listing(const nlohmann::json& value_obj) {
+    if(!value_obj.is_object() || value_obj.value("metadata", "") != "listing") return 0;
+    const auto& product_obj = value_obj.at("product");
+    return value_obj.at("price").get<double>() + value_obj.at("quantity").get<int>() + product_obj.at("name").get_ref<const std::string&>().size();
+}
+
+template <typename Function>
+static double measure(int iterations, Function function) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) function();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+static void report(const std::string& name, double string_us, double typed_us) {
+    std::cout << name << ": string " << static_cast<int>(string_us) << " us, typed " << static_cast<int>(typed_us) << " us (" << (string_us / typed_us) << "x)\n";
+}
+
+int main(int argc, char** argv) {
+    int listing_count = (argc > 1) ? std::stoi(argv[1]) : 200;
+    int iterations = (argc > 2) ? std::stoi(argv[2]) : 200;
+
+    std::vector<std::string> keys;
+    nlohmann::json get_many_object;
+    get_many_object["version"] = "1.0";
+    get_many_object["response"]["id"] = node_id;
+    get_many_object["tid"] = 1;
+    std::vector<std::vector<uint8_t>> get_responses;
+    for(int i = 0; i < listing_count; ++i) {
+        keys.push_back(make_key(i));
+        std::string value = make_listing(i);
+        get_many_object["response"]["values"][keys.back()] = value;
+        get_responses.push_back(make_get_response(value));
+    }
+    std::vector<uint8_t> get_many_bytes = nlohmann::json::to_msgpack(get_many_object);
+    std::cout << listing_count << " listings, " << get_many_bytes.size() << " bytes per get_many response\n";
+
+    volatile double sink = 0;
+
+    // One get_many for the whole page (Backend::getListings)
+    double string_get_many = measure(iterations, [&]() {
+        std::string reply = nlohmann::json::from_msgpack(get_many_bytes).dump(); // Client
+        nlohmann::json json = nlohmann::json::parse(reply); // Caller
+        const auto& values_obj = json["response"]["values"];
+        for(const auto& key : keys) {
+            sink = sink + read_listing(nlohmann::json::parse(values_obj[key].get<std::string>()));
+        }
+    });
+    double typed_get_many = measure(iterations, [&]() {
+        neroshop::Response response(nlohmann::json::from_msgpack(get_many_bytes));
+        for(const auto& key : keys) sink = sink + read_listing(response.get_value_json(key));
+    });
+    report("get_many page", string_get_many, typed_get_many);
+
+    // One get per listing (inventory, search results and the other pages that still look keys up one by one)
+    double string_get = measure(iterations, [&]() {
+        for(const auto& bytes : get_responses) {
+            std::string reply = nlohmann::json::from_msgpack(bytes).dump();
+            nlohmann::json json = nlohmann::json::parse(reply);
+            sink = sink + read_listing(nlohmann::json::parse(json["response"]["value"].get<std::string>()));
+        }
+    });
+    double typed_get = measure(iterations, [&]() {
+        for(const auto& bytes : get_responses) {
+            neroshop::Response response(nlohmann::json::from_msgpack(bytes));
+            sink = sink + read_listing(response.get_value_json());
+        }
+    });
+    report("get per listing", string_get, typed_get);
+
+    // The page read twice (e.g. sorted, then filtered) from the same response. The string path has to parse every value again
+    double string_twice = measure(iterations, [&]() {
+        std::string reply = nlohmann::json::from_msgpack(get_many_bytes).dump();
+        nlohmann::json json = nlohmann::json::parse(reply);
+        const auto& values_obj = json["response"]["values"];
+        for(int pass = 0; pass < 2; ++pass) {
+            for(const auto& key : keys) sink = sink + read_listing(nlohmann::json::parse(values_obj[key].get<std::string>()));
+        }
+    });
+    double typed_twice = measure(iterations, [&]() {
+        neroshop::Response response(nlohmann::json::from_msgpack(get_many_bytes));
+        neroshop::Response shared = response; // Copies share the parsed values
+        for(const auto& key : keys) sink = sink + read_listing(response.get_value_json(key));
+        for(const auto& key : keys) sink = sink + read_listing(shared.get_value_json(key));
+    });
+    report("get_many page read twice", string_twice, typed_twice);
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Measures bytes-on-wire and resident-memory reductions of zstd-compressed DHT values on a synthetic listing corpus
+// g++ -std=c++17 -O2 -DNEROSHOP_USE_ZSTD compression_bench.cpp ../src/core/protocol/messages/compression.cpp -I../external/json/single_include -lzstd -o compression_bench
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <zstd.h>
+
+#define JSON_USE_MSGPACK
+#include <nlohmann/json.hpp>
+// neroshop
+#include "../src/core/protocol/messages/compression.hpp"
+
+static std::mt19937 rng(1337);
+
+static std::string random_hex(int length) {
+    static const char * digits = "0123456789abcdef";
+    std::uniform_int_distribution<int> dist(0, 15);
+    std::string hex;
+    for(int i = 0; i < length; ++i) hex += digits[dist(rng)];
+    return hex;
+}
+
+static std::string pick(const std::vector<std::string>& words) {
+    std::uniform_int_distribution<size_t> dist(0, words.size() - 1);
+    return words[dist(rng)];
+}
+
+// Same schema as Serializer::serialize(Listing)
+static std::string make_listing() {
+    static const std::vector<std::string> names = { "Wireless Headphones", "Leather Wallet", "Organic Coffee Beans", "Mechanical Keyboard", "Hand-knitted Scarf", "USB-C Charger", "Monero Hoodie", "Hardware Wallet" };
+    static const std::vector<std::string> categories = { "Electronics", "Clothing & Apparel", "Food & Beverages", "Computers & Accessories", "Miscellaneous" };
+    static const std::vector<std::string> colors = { "Black", "White", "Orange", "Grey", "Red" };
+    static const std::vector<std::string> conditions = { "New", "Used", "Renewed" };
+    static const std::vector<std::string> words = { "high", "quality", "fast", "shipping", "privacy", "durable", "handmade", "original", "warranty", "included", "monero", "only" };
+    
+    nlohmann::json listing;
+    listing["id"] = random_hex(8) + "-" + random_hex(4) + "-" + random_hex(4) + "-" + random_hex(4) + "-" + random_hex(12);
+    listing["seller_id"] = "4" + random_hex(94);
+    listing["quantity"] = std::uniform_int_distribution<int>(1, 100)(rng);
+    listing["price"] = std::uniform_real_distribution<double>(0.01, 5.0)(rng);
+    listing["currency"] = "XMR";
+    listing["condition"] = pick(conditions);
+    listing["date"] = "2023-0" + std::to_string(std::uniform_int_distribution<int>(1, 9)(rng)) + "-1" + std::to_string(std::uniform_int_distribution<int>(0, 9)(rng)) + " 12:34:56";
+    listing["signature"] = "SigV2" + random_hex(88);
+    listing["metadata"] = "listing";
+    nlohmann::json product;
+    product["id"] = random_hex(8) + "-" + random_hex(4) + "-" + random_hex(4) + "-" + random_hex(4) + "-" + random_hex(12);
+    product["name"] = pick(names);
+    std::string description;
+    for(int i = 0; i < 20; ++i) description += pick(words) + " ";
+    product["description"] = description;
+    product["attributes"].push_back({ {"color", pick(colors)}, {"size", "M"}, {"weight", 0.5} });
+    product["category"] = pick(categories);
+    product["tags"] = { pick(words), pick(words), pick(words) };
+    product["images"].push_back({ {"id", 0}, {"name", random_hex(10) + ".jpg"}, {"size", std::uniform_int_distribution<int>(10000, 500000)(rng)} });
+    listing["product"] = product;
+    return listing.dump();
+}
+
+static size_t put_message_size(const std::string& key, const std::string& value, bool compressed) {
+    nlohmann::json query_object;
+    query_object["query"] = "put";
+    query_object["args"]["id"] = random_hex(64);
+    query_object["args"]["key"] = key;
+    if(compressed) {
+        query_object["args"]["value"] = nlohmann::json::binary(std::vector<uint8_t>(value.begin(), value.end()));
+        query_object["args"]["encoding"] = neroshop::compression::get_encoding();
+    } else {
+        query_object["args"]["value"] = value;
+    }
+    query_object["tid"] = random_hex(4);
+    query_object["version"] = "1.0";
+    return nlohmann::json::to_msgpack(query_object).size();
+}
+
+static size_t compress_with(const std::string& value, ZSTD_CDict * cdict) {
+    static ZSTD_CCtx * cctx = ZSTD_createCCtx();
+    std::string compressed(ZSTD_compressBound(value.size()), '\0');
+    size_t result = (cdict) ? ZSTD_compress_usingCDict(cctx, &compressed[0], compressed.size(), value.data(), value.size(), cdict)
+                            : ZSTD_compressCCtx(cctx, &compressed[0], compressed.size(), value.data(), value.size(), 3);
+    return ZSTD_isError(result) ? value.size() : std::min(result, value.size());
+}
+
+int main(int argc, char** argv) {
+    size_t corpus_size = (argc > 1) ? std::stoul(argv[1]) : 2000;
+    std::vector<std::string> corpus;
+    for(size_t i = 0; i < corpus_size; ++i) corpus.push_back(make_listing());
+    
+    // Train a dictionary on the first half and evaluate on the second half so the results are not overfitted
+    std::vector<std::string> training_set(corpus.begin(), corpus.begin() + corpus_size / 2);
+    std::vector<std::string> evaluation_set(corpus.begin() + corpus_size / 2, corpus.end());
+    std::string trained_dictionary = neroshop::compression::train_dictionary(training_set);
+    ZSTD_CDict * trained_cdict = ZSTD_createCDict(trained_dictionary.data(), trained_dictionary.size(), 3);
+    
+    size_t raw_bytes = 0, plain_bytes = 0, default_dict_bytes = 0, trained_dict_bytes = 0;
+    size_t raw_wire_bytes = 0, compressed_wire_bytes = 0;
+    for(const auto& value : evaluation_set) {
+        std::string key = random_hex(64);
+        std::string compressed = neroshop::compression::compress(value); // built-in dictionary
+        if(neroshop::compression::decompress(compressed) != value) {
+            std::cerr << "Round trip failed\n";
+            return 1;
+        }
+        raw_bytes += value.size();
+        plain_bytes += compress_with(value, nullptr);
+        default_dict_bytes += compressed.size();
+        trained_dict_bytes += compress_with(value, trained_cdict);
+        raw_wire_bytes += put_message_size(key, value, false);
+        compressed_wire_bytes += put_message_size(key, compressed, true);
+    }
+    ZSTD_freeCDict(trained_cdict);
+    
+    auto report = [&](const std::string& label, size_t bytes) {
+        std::cout << label << bytes << " bytes (" << (100.0 * bytes / raw_bytes) << "% of raw)\n";
+    };
+    std::cout << evaluation_set.size() << " listings, average " << (raw_bytes / evaluation_set.size()) << " bytes\n";
+    std::cout << "Resident (Node::data values):\n";
+    report("  uncompressed:             ", raw_bytes);
+    report("  zstd (no dictionary):     ", plain_bytes);
+    report("  zstd (built-in):          ", default_dict_bytes);
+    report("  zstd (trained, " + std::to_string(trained_dictionary.size()) + " B): ", trained_dict_bytes);
+    std::cout << "On the wire (put messages):\n";
+    std::cout << "  uncompressed: " << raw_wire_bytes << " bytes\n";
+    std::cout << "  zstd:         " << compressed_wire_bytes << " bytes (" << (100.0 * compressed_wire_bytes / raw_wire_bytes) << "%)\n";
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Decodes DHT messages with the typed msgpack reader, including datagrams whose array and map headers claim more elements than they hold
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define JSON_USE_MSGPACK
+#include <nlohmann/json.hpp>
+// neroshop
+#include "../src/core/protocol/messages/codec.hpp"
+#include "../src/core/protocol/messages/dht_messages.hpp"
+
+using namespace neroshop;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& description) {
+    if(!condition) {
+        std::cerr << "FAILED: " << description << "\n";
+        failures++;
+    }
+}
+
+// {"args": {"<field>": <header with count> ...}, "query": "<query>"} with the array or map header claiming count elements
+static std::vector<uint8_t> make_hostile(const std::string& query, const std::string& field, uint8_t marker, uint32_t count) {
+    std::vector<uint8_t> buffer;
+    msgpack::Writer writer(buffer);
+    writer.write_map_header(2);
+    writer.write_string("args");
+    writer.write_map_header(1);
+    writer.write_string(field);
+    buffer.push_back(marker);
+    for(int shift = 24; shift >= 0; shift -= 8) buffer.push_back(static_cast<uint8_t>(count >> shift));
+    writer.write_string("query");
+    writer.write_string(query);
+    return buffer;
+}
+
+int main() {
+    const std::string node_id(64, 'a');
+
+    // A ping survives a round trip through the typed codec
+    {
+        msgpack::Envelope envelope;
+        envelope.query = "ping";
+        envelope.tid = "ab";
+        envelope.version = "0.1.0";
+        msgpack::PingRequest ping;
+        ping.id = node_id;
+        ping.ephemeral_port = 50882;
+        ping.encodings.push_back("zstd:1");
+        std::vector<uint8_t> buffer = msgpack::encode(envelope, ping);
+
+        msgpack::Envelope decoded_envelope;
+        msgpack::PingRequest decoded_ping;
+        check(msgpack::decode(buffer, decoded_envelope, decoded_ping), "ping decodes");
+        check(decoded_envelope.query == "ping" && decoded_envelope.tid == "ab", "ping envelope");
+        check(decoded_ping.id == node_id && decoded_ping.ephemeral_port == 50882, "ping fields");
+        check(decoded_ping.encodings.size() == 1 && decoded_ping.encodings[0] == "zstd:1", "ping encodings");
+        check(nlohmann::json::from_msgpack(buffer)["args"]["id"] == node_id, "ping is readable by nlohmann::json");
+    }
+
+    // Hostile array and map lengths are rejected instead of being reserved
+    {
+        msgpack::Envelope envelope;
+        msgpack::PingRequest ping;
+        check(!msgpack::decode(make_hostile("ping", "encodings", 0xdd, 0xffffffff), envelope, ping), "ping with array32 encodings of 0xffffffff");
+        msgpack::GetRequest get_request;
+        check(!msgpack::decode(make_hostile("get", "accept", 0xdd, 0x7fffffff), envelope, get_request), "get with array32 accept of 0x7fffffff");
+        msgpack::FindNodeResponse find_node_response;
+        check(!msgpack::decode(make_hostile("find_node", "nodes", 0xdd, 0xffffffff), envelope, find_node_response), "find_node with array32 nodes of 0xffffffff");
+        msgpack::GetResponse get_response;
+        check(!msgpack::decode(make_hostile("get", "nodes", 0xdd, 1000), envelope, get_response), "get with more nodes than bytes");
+        check(!msgpack::decode(make_hostile("get", "unknown", 0xdf, 0x80000000), envelope, get_response), "map32 of 0x80000000 is not skipped as empty");
+        msgpack::Message message;
+        check(!msgpack::decode(make_hostile("ping", "encodings", 0xdd, 0xffffffff), message), "untyped decode of a hostile ping");
+    }
+
+    // The count check does not reject arrays that fit exactly
+    {
+        std::vector<uint8_t> buffer;
+        msgpack::Writer writer(buffer);
+        writer.write_array_header(3);
+        writer.write_nil(); writer.write_nil(); writer.write_nil();
+        msgpack::Reader reader(buffer);
+        uint32_t count = 0;
+        check(reader.read_array_header(count) && count == 3, "array that fits exactly");
+        msgpack::Reader truncated_reader(buffer.data(), buffer.size() - 1);
+        check(!truncated_reader.read_array_header(count) && truncated_reader.has_error(), "array one byte short");
+    }
+
+    // A message that fails to parse still gives back its tid, so that the error can be matched to the request
+    {
+        nlohmann::ordered_json request = { {"tid", 42}, {"version", "0.1.0"}, {"query", "get"}, {"args", { {"key", node_id} }} };
+        std::vector<uint8_t> buffer = nlohmann::ordered_json::to_msgpack(request);
+        buffer.resize(buffer.size() - 8);
+        msgpack::Message message;
+        check(!msgpack::decode(buffer, message), "truncated request is rejected");
+        check(message.object.is_object() && message.object.value("tid", nlohmann::json(nullptr)) == 42, "tid of a truncated request");
+        msgpack::Message garbage;
+        check(!msgpack::decode(std::vector<uint8_t>{ 0xc1 }, garbage), "garbage is rejected");
+        check(garbage.object.value("tid", nlohmann::json(0)).is_null(), "garbage has a null tid");
+    }
+
+    if(failures > 0) return 1;
+    std::cout << "dht_messages_test passed\n";
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Checks that FrameReader reassembles length-prefixed frames however the byte stream is split, and rejects oversized headers
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm> // std::min
+#include <iostream>
+#include <string>
+#include <vector>
+// neroshop
+#include "../src/core/protocol/transport/framing.hpp"
+#include "../src/core/protocol/transport/shm_ring.hpp"
+
+using namespace neroshop;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& description) {
+    if(!condition) {
+        std::cerr << "FAILED: " << description << "\n";
+        failures++;
+    }
+}
+
+static std::vector<uint8_t> make_payload(std::size_t size, uint8_t seed) {
+    std::vector<uint8_t> payload(size);
+    for(std::size_t i = 0; i < size; i++) payload[i] = static_cast<uint8_t>(seed + i);
+    return payload;
+}
+
+int main() {
+    std::vector<std::vector<uint8_t>> payloads;
+    std::vector<uint8_t> stream;
+    for(int i = 0; i < 20; i++) {
+        payloads.push_back(make_payload(1 + i * 37, static_cast<uint8_t>(i)));
+        framing::append_frame(stream, payloads.back());
+    }
+
+    // Coalesced: every frame arrives in a single read
+    {
+        framing::FrameReader reader(4096);
+        check(reader.feed(stream.data(), stream.size()), "feed coalesced frames");
+        std::vector<uint8_t> frame;
+        std::size_t count = 0;
+        while(reader.next(frame)) {
+            check(count < payloads.size() && frame == payloads[count], "coalesced frame " + std::to_string(count));
+            count++;
+        }
+        check(count == payloads.size(), "all coalesced frames");
+        check(reader.get_buffered_size() == 0, "nothing left after coalesced frames");
+    }
+
+    // Split: the stream arrives in pieces of every size from 1 to 7 bytes, cutting through headers and payloads
+    for(std::size_t piece = 1; piece <= 7; piece++) {
+        framing::FrameReader reader(4096);
+        std::vector<uint8_t> frame;
+        std::size_t count = 0;
+        for(std::size_t offset = 0; offset < stream.size(); offset += piece) {
+            std::size_t size = std::min(piece, stream.size() - offset);
+            check(reader.feed(stream.data() + offset, size), "feed split frames");
+            while(reader.next(frame)) {
+                check(count < payloads.size() && frame == payloads[count], "split frame " + std::to_string(count) + " in pieces of " + std::to_string(piece));
+                count++;
+            }
+        }
+        check(count == payloads.size(), "all split frames in pieces of " + std::to_string(piece));
+    }
+
+    // Oversized: the frame is rejected as soon as its header arrives, before any of its payload is buffered
+    {
+        framing::FrameReader reader(1024);
+        std::vector<uint8_t> small = make_payload(16, 1);
+        std::vector<uint8_t> oversized_stream;
+        framing::append_frame(oversized_stream, small);
+        const uint8_t header[] = { 0x00, 0x00, 0x04, 0x01 }; // 1025 bytes
+        oversized_stream.insert(oversized_stream.end(), header, header + sizeof(header));
+        check(!reader.feed(oversized_stream.data(), oversized_stream.size()), "oversized header is rejected");
+        check(reader.has_error(), "reader is in error after an oversized header");
+        std::vector<uint8_t> frame;
+        check(!reader.next(frame), "no frames after an error");
+        check(!reader.feed(small.data(), small.size()), "no more bytes are accepted after an error");
+        reader.clear();
+        check(!reader.has_error(), "clear resets the error");
+
+        framing::FrameReader ring_reader(1024);
+        const uint8_t ring_header[] = { 0x80, 0x00, 0x04, 0x01 }; // Ring frames are limited to the same size
+        check(!ring_reader.feed(ring_header, sizeof(ring_header)), "oversized ring header is rejected");
+
+        framing::FrameReader max_reader(1024);
+        std::vector<uint8_t> max_stream;
+        framing::append_frame(max_stream, make_payload(1024, 2));
+        check(max_reader.feed(max_stream.data(), max_stream.size()) && max_reader.next(frame) && frame.size() == 1024, "frame of exactly the maximum size");
+    }
+
+    // Round trip through a socket, with the frames coalesced by the kernel
+    {
+        int sockets[2];
+        check(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0, "socketpair");
+        for(const auto& payload : payloads) check(framing::send_frame(sockets[0], payload), "send_frame");
+        framing::FrameReader reader(4096);
+        std::vector<uint8_t> frame;
+        for(std::size_t i = 0; i < payloads.size(); i++) {
+            ssize_t size = framing::receive_frame(sockets[1], reader, frame);
+            check(size == static_cast<ssize_t>(payloads[i].size()) && frame == payloads[i], "receive_frame " + std::to_string(i));
+        }
+        ::close(sockets[0]);
+        check(framing::receive_frame(sockets[1], reader, frame) == 0, "receive_frame after the peer closed");
+        ::close(sockets[1]);
+    }
+
+    if(failures > 0) return 1;
+    std::cout << "framing_test passed\n";
+    return 0;
+}
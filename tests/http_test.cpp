@@ -0,0 +1,80 @@
+// Checks how the JSON-RPC server delimits HTTP requests on a keep-alive connection and decides whether to keep it open
+#include <cstdio> // std::remove
+#include <iostream>
+#include <string>
+// neroshop
+#include "../src/core/database/database.hpp"
+#include "../src/core/protocol/rpc/http.hpp"
+
+#include <nlohmann/json.hpp>
+
+using namespace neroshop;
+
+static const std::string database_file = "http_test.sqlite3";
+
+neroshop::db::Sqlite3 * neroshop::get_database() {
+    static neroshop::db::Sqlite3 database_obj { database_file };
+    return &database_obj;
+}
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& description) {
+    if(!condition) {
+        std::cerr << "FAILED: " << description << "\n";
+        failures++;
+    }
+}
+
+static std::string make_request(const std::string& body, const std::string& headers = "", const std::string& version = "HTTP/1.1") {
+    return "POST / " + version + "\r\nHost: localhost\r\n" + headers + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+int main() {
+    const std::string body = "{\"jsonrpc\":\"2.0\",\"method\":\"query\",\"params\":{\"sql\":\"SELECT 1;\"},\"id\":1}";
+    const std::string request = make_request(body);
+
+    // get_request_size
+    check(rpc::http::get_request_size(request) == request.size(), "size of a complete request");
+    check(rpc::http::get_request_size(request + make_request(body)) == request.size(), "size of the first of two pipelined requests");
+    for(std::size_t size = 0; size < request.size(); size++) {
+        if(rpc::http::get_request_size(request.substr(0, size)) != 0) {
+            check(false, "partial request of " + std::to_string(size) + " bytes is incomplete");
+            break;
+        }
+    }
+    std::string no_body = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    check(rpc::http::get_request_size(no_body) == no_body.size(), "request without Content-Length has no body");
+    std::string lowercase = "POST / HTTP/1.1\r\ncontent-length:  2 \r\n\r\n{}";
+    check(rpc::http::get_request_size(lowercase) == lowercase.size(), "header names are case-insensitive and values are trimmed");
+    check(rpc::http::get_request_size("POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n") == std::string::npos, "negative Content-Length");
+    check(rpc::http::get_request_size("POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n") == std::string::npos, "non-numeric Content-Length");
+    check(rpc::http::get_request_size("POST / HTTP/1.1\r\nContent-Length:\r\n\r\n") == std::string::npos, "empty Content-Length");
+    check(rpc::http::get_request_size("POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n") == std::string::npos, "Content-Length that overflows");
+    check(rpc::http::get_request_size(make_request(std::string(200, ' ')), 100) == std::string::npos, "body larger than the maximum size");
+    check(rpc::http::get_request_size(std::string(101, 'a'), 100) == std::string::npos, "headers larger than the maximum size");
+    check(rpc::http::get_request_size(std::string(100, 'a'), 100) == 0, "headers that may still end within the maximum size");
+
+    // is_keep_alive
+    check(rpc::http::is_keep_alive(request), "HTTP/1.1 stays open");
+    check(!rpc::http::is_keep_alive(make_request(body, "Connection: close\r\n")), "Connection: close");
+    check(!rpc::http::is_keep_alive(make_request(body, "connection: Upgrade, CLOSE\r\n")), "close among other options, in any case");
+    check(rpc::http::is_keep_alive(make_request(body, "Connection: keep-alive\r\n")), "Connection: keep-alive");
+    check(rpc::http::is_keep_alive(make_request(body, "X-Connection: close\r\n")), "a header that only ends with Connection");
+    check(!rpc::http::is_keep_alive(make_request(body, "", "HTTP/1.0")), "HTTP/1.0 is closed");
+    check(!rpc::http::is_keep_alive(make_request(body, "Connection: keep-alive\r\n", "HTTP/1.0")), "HTTP/1.0 is closed even with keep-alive");
+    check(!rpc::http::is_keep_alive("POST / HTTP/1.1\r\nHost: localhost\r\n"), "incomplete headers");
+
+    // respond: a notification gets 204 No Content and a call gets its result
+    std::string notification = "{\"jsonrpc\":\"2.0\",\"method\":\"query\",\"params\":{\"sql\":\"SELECT 1;\"}}";
+    check(rpc::http::respond(make_request(notification)).rfind("HTTP/1.1 204", 0) == 0, "notification is answered with 204");
+    std::string response = rpc::http::respond(request);
+    check(response.rfind("HTTP/1.1 200", 0) == 0, "call is answered with 200");
+    nlohmann::json response_object = nlohmann::json::parse(rpc::http::get_body(response), nullptr, false);
+    check(response_object.is_object() && response_object.value("id", 0) == 1 && response_object.contains("result"), "call is answered with its id and result");
+
+    std::remove(database_file.c_str());
+    if(failures > 0) return 1;
+    std::cout << "http_test passed\n";
+    return 0;
+}
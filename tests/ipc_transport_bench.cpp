@@ -0,0 +1,125 @@
+// Compares the GUI <-> daemon IPC transports: TCP loopback, a Unix domain socket and a Unix domain socket with the shared-memory ring.
+// "latency" issues small get requests one at a time (what the GUI does for a single key) and reports the per-call round trip.
+// "throughput" keeps a window of requests in flight whose responses are large (a page of listings) and reports MiB/s of responses
+// g++ -std=c++17 -O2 -DNEROSHOP_USE_SYSTEM_SOCKETS ipc_transport_bench.cpp ../src/core/protocol/transport/client.cpp ../src/core/protocol/transport/server.cpp ../src/core/protocol/transport/framing.cpp ../src/core/protocol/transport/response.cpp ../src/core/protocol/transport/shm_ring.cpp ../src/core/tools/logger.cpp -I../external/json/single_include -I../external/raft/include -lpthread -o ipc_transport_bench
+// ./ipc_transport_bench
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+// neroshop
+#include "../src/core/protocol/transport/client.hpp"
+#include "../src/core/protocol/transport/server.hpp"
+
+static const unsigned int tcp_port = 57749;
+static const std::string unix_path = "/tmp/neroshop_ipc_transport_bench.sock";
+static const int latency_calls = 20000;
+static const std::size_t small_value_size = 256;
+static const int throughput_calls = 2000;
+static const std::size_t large_value_size = 256 * 1024;
+static const int window = 32; // Requests in flight
+
+enum class Transport { Tcp, Unix, UnixShm };
+
+static const char * get_name(Transport transport) {
+    switch(transport) {
+        case Transport::Tcp: return "tcp";
+        case Transport::Unix: return "unix";
+        case Transport::UnixShm: return "unix+shm";
+    }
+    return "";
+}
+
+//-----------------------------------------------------------------------------
+
+// Answers every get with a value whose size is given by the key, like the daemon would answer with a stored listing
+static void serve(neroshop::Server& server) {
+    if(!server.accept()) return;
+    std::vector<uint8_t> request;
+    while(server.receive(request) > 0) {
+        nlohmann::json request_object = nlohmann::json::from_msgpack(request);
+        std::size_t value_size = std::stoul(request_object["args"]["key"].get<std::string>());
+        nlohmann::json response_object;
+        response_object["version"] = "1";
+        response_object["response"]["value"] = std::string(value_size, 'v');
+        response_object["tid"] = request_object["tid"];
+        server.send(nlohmann::json::to_msgpack(response_object));
+    }
+}
+
+static bool connect(neroshop::Client& client, Transport transport) {
+    for(int attempt = 0; attempt < 100; attempt++) { // The server thread may not be listening yet
+        bool connected = (transport == Transport::Tcp) ? client.connect(tcp_port, "127.0.0.1") : client.connect_unix(unix_path, transport == Transport::UnixShm);
+        if(connected) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static void run(Transport transport) {
+    std::unique_ptr<neroshop::Server> server = (transport == Transport::Tcp) ? std::make_unique<neroshop::Server>("127.0.0.1", tcp_port)
+        : std::make_unique<neroshop::Server>(unix_path, neroshop::SocketType::Socket_Unix);
+    std::thread server_thread([&server] { serve(*server); });
+
+    neroshop::Client client;
+    if(!connect(client, transport)) {
+        std::cerr << get_name(transport) << ": could not connect\n";
+        server->close();
+        server_thread.join();
+        return;
+    }
+
+    // Latency: one call at a time
+    std::vector<double> latencies;
+    latencies.reserve(latency_calls);
+    const std::string small_key = std::to_string(small_value_size);
+    for(int i = 0; i < latency_calls; i++) {
+        auto start_time = std::chrono::steady_clock::now();
+        client.get(small_key);
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start_time).count());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double mean = 0.0;
+    for(double latency : latencies) mean += latency;
+    mean /= latencies.size();
+
+    // Throughput: a window of large responses in flight
+    const std::string large_key = std::to_string(large_value_size);
+    std::deque<std::future<neroshop::Response>> in_flight;
+    std::size_t received_bytes = 0;
+    int sent = 0, received = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    while(received < throughput_calls) {
+        while(sent < throughput_calls && static_cast<int>(in_flight.size()) < window) {
+            in_flight.push_back(client.get_async(large_key));
+            sent++;
+        }
+        neroshop::Response reply = in_flight.front().get();
+        in_flight.pop_front();
+        if(reply.get_status() == neroshop::Response::Status::NoResponse) break; // Disconnected
+        received_bytes += reply.get_value().size();
+        received++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    client.disconnect();
+    server_thread.join();
+    server->close();
+
+    std::cout << get_name(transport) << ":\n";
+    std::cout << "  latency:    mean " << mean << " us, p50 " << latencies[latencies.size() / 2] << " us, p99 " << latencies[latencies.size() * 99 / 100] << " us\n";
+    std::cout << "  throughput: " << (received / seconds) << " calls/s, " << (received_bytes / seconds / (1024 * 1024)) << " MiB/s\n";
+}
+
+int main() {
+    run(Transport::Tcp);
+    run(Transport::Unix);
+    run(Transport::UnixShm);
+    return 0;
+}
@@ -0,0 +1,106 @@
+// Checks JSON-RPC 2.0 batch handling: one response per call that has an id, none for notifications and an error for each invalid element
+#include <cstdio> // std::remove
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+// neroshop
+#include "../src/core/database/database.hpp"
+#include "../src/core/protocol/rpc/json_rpc.hpp"
+#include "../src/neroshop_config.hpp"
+
+using namespace neroshop;
+
+static const std::string database_file = "json_rpc_test.sqlite3";
+
+neroshop::db::Sqlite3 * neroshop::get_database() {
+    static neroshop::db::Sqlite3 database_obj { database_file };
+    return &database_obj;
+}
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& description) {
+    if(!condition) {
+        std::cerr << "FAILED: " << description << "\n";
+        failures++;
+    }
+}
+
+static std::string make_query(const std::string& sql, int id = -1) {
+    nlohmann::json call = { {"jsonrpc", "2.0"}, {"method", "query"}, {"params", { {"sql", sql} }} };
+    if(id >= 0) call["id"] = id;
+    return call.dump();
+}
+
+static std::vector<nlohmann::json> run_batch(const std::string& batch, bool& is_batch) {
+    std::vector<nlohmann::json> responses;
+    is_batch = rpc::json::process_batch(batch, [&](const std::string& response) {
+        responses.push_back(nlohmann::json::parse(response, nullptr, false));
+    });
+    return responses;
+}
+
+int main() {
+    get_database()->execute("CREATE TABLE IF NOT EXISTS batch_test(value INTEGER);");
+    get_database()->execute("DELETE FROM batch_test;");
+    bool is_batch = false;
+
+    // Not batches: process() handles these
+    run_batch(make_query("SELECT 1;", 1), is_batch);
+    check(!is_batch, "a single request is not a batch");
+    std::vector<nlohmann::json> responses = run_batch("[]", is_batch);
+    check(!is_batch && responses.empty(), "an empty array is left to process()");
+    nlohmann::json empty_response = nlohmann::json::parse(rpc::json::process("[]"), nullptr, false);
+    check(empty_response.is_object() && empty_response.contains("error") && empty_response["id"].is_null(), "process() answers an empty array with a single error");
+
+    // Notifications run but get no response
+    responses = run_batch("[" + make_query("INSERT INTO batch_test VALUES(7);") + "," + make_query("INSERT INTO batch_test VALUES(8);") + "]", is_batch);
+    check(is_batch && responses.empty(), "a batch of notifications has no responses");
+    check(get_database()->get_integer("SELECT COUNT(*) FROM batch_test;") == 2, "notifications were executed");
+    check(rpc::json::process("[" + make_query("INSERT INTO batch_test VALUES(9);") + "]").empty(), "process() returns nothing for a batch of notifications");
+
+    // Invalid elements each get their own error, and the valid calls around them still run
+    std::string mixed = "[" + make_query("SELECT COUNT(*) AS count FROM batch_test;", 1) + ", 5, {\"foo\":1}, \"call\", "
+        + make_query("INSERT INTO batch_test VALUES(10);") + "," + make_query("SELECT 1;", 2) + "]";
+    responses = run_batch(mixed, is_batch);
+    check(is_batch && responses.size() == 5, "one response per call with an id and per invalid element");
+    std::set<int> ids;
+    int invalid_count = 0;
+    for(const auto& response : responses) {
+        check(response.is_object() && response.value("jsonrpc", "") == "2.0", "responses are JSON-RPC 2.0 objects");
+        if(!response.is_object()) continue;
+        if(response.contains("error")) {
+            check(response["error"].value("code", 0) == -32600 && response["id"].is_null(), "invalid element is answered with Invalid Request and a null id");
+            invalid_count++;
+        } else if(response.contains("id") && response["id"].is_number_integer()) {
+            ids.insert(response["id"].get<int>());
+        }
+    }
+    check(invalid_count == 3, "every invalid element is answered");
+    check(ids == std::set<int>({ 1, 2 }), "every call with an id is answered once");
+    check(get_database()->get_integer("SELECT COUNT(*) FROM batch_test;") == 4, "the notification in a mixed batch was executed");
+
+    // A SELECT followed by a write is not treated as a read: it runs on its own and the write is done before the calls after it
+    responses = run_batch("[" + make_query("SELECT 1; DELETE FROM batch_test;", 3) + "," + make_query("SELECT COUNT(*) AS count FROM batch_test;", 4) + "]", is_batch);
+    check(is_batch && responses.size() == 2, "a query with a trailing statement is answered");
+    check(get_database()->get_integer("SELECT COUNT(*) FROM batch_test;") == 0, "the trailing statement was executed");
+
+    // A batch that is not valid JSON is one parse error rather than a batch
+    responses = run_batch("[" + make_query("SELECT 1;", 1) + ",", is_batch);
+    check(!is_batch, "malformed batch is left to process()");
+
+    // Oversized batches are refused as a whole
+    std::string oversized = "[";
+    for(int i = 0; i <= NEROSHOP_RPC_MAX_BATCH_SIZE; i++) oversized += ((i > 0) ? "," : "") + make_query("SELECT 1;", i);
+    oversized += "]";
+    responses = run_batch(oversized, is_batch);
+    check(is_batch && responses.size() == 1 && responses[0].contains("error"), "oversized batch gets a single error");
+
+    std::remove(database_file.c_str());
+    if(failures > 0) return 1;
+    std::cout << "json_rpc_test passed\n";
+    return 0;
+}
@@ -35,27 +35,22 @@ std::string extract_json_payload(const std::string& request) {
 void ipc_server() {
     try {
         // create ZmqServer instance
-        neroshop::ZmqServer server("tcp://*:5555", false);
-        
-        while (true) {
-            std::vector<uint8_t> request;//std::string request;
-            // wait for incoming message from client
-            server.receive(request);
+        neroshop::ZmqServer server([](uint64_t client_id, const std::vector<uint8_t>& request) {
             nlohmann::json j = nlohmann::json::from_msgpack(request);
-            std::cout << "Received request: " << j.dump() << std::endl;//std::cout << "Received request: " << request << std::endl;
+            std::cout << "Received request: " << j.dump() << std::endl;
             
             // process JSON request and generate response
             std::string message = j["message"];
             nlohmann::json response_json = {
                 {"message", "Response to " + message}
-            };//std::string response = "Response to " + request;
+            };
+            std::cout << "Sent response: " << response_json.dump() << std::endl;
             // serialize response JSON object to binary
-            std::vector<uint8_t> response = nlohmann::json::to_msgpack(response_json);
-            
-            // send response to client
-            server.send(response);
-            std::cout << "Sent response: " << response_json.dump() << std::endl;//std::cout << "Sent response: " << response << std::endl;
-        }
+            return nlohmann::json::to_msgpack(response_json);
+        });
+        if (!server.listen("tcp://*:5555")) return;
+        // serve clients until the process is killed
+        server.run();
     } catch (std::exception& e) {
         std::cerr << "Error occurred: " << e.what() << std::endl;
         return;
@@ -82,4 +77,4 @@ int main()
     //rpc_thread.join();
 
     return 0;
-} // g++ -D NEROSHOP_USE_LIBZMQ zmq_client.cpp zmq_server.cpp main.cpp -lzmq
+} // g++ -D NEROSHOP_USE_LIBZMQ zmq_client.cpp zmq_server.cpp worker_pool.cpp main.cpp -lzmq
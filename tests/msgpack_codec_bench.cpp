@@ -0,0 +1,100 @@
+// Compares the typed msgpack codec with the nlohmann::json path for DHT messages (byte compatibility and speed)
+// g++ -std=c++17 -O2 msgpack_codec_bench.cpp ../src/core/protocol/messages/codec.cpp ../src/core/protocol/messages/dht_messages.cpp -I../external/json/single_include -o msgpack_codec_bench
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define JSON_USE_MSGPACK
+#include <nlohmann/json.hpp>
+// neroshop
+#include "../src/core/protocol/messages/dht_messages.hpp"
+
+using namespace neroshop;
+
+static const std::string node_id = "3f8e1c7a9b2d4e6f8a0c1e3d5b7f9a2c4e6d8b0f1a3c5e7d9b2f4a6c8e0d1b3f";
+static const std::string key = "9a7c5e3b1d2f4a6c8e0b1d3f5a7c9e2b4d6f8a0c1e3b5d7f9a2c4e6b8d0f1a3c";
+
+template <typename Function>
+static double measure(int iterations, Function function) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) function();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+static void report(const std::string& name, double nlohmann_ns, double codec_ns) {
+    std::cout << name << ": nlohmann " << static_cast<int>(nlohmann_ns) << " ns, codec " << static_cast<int>(codec_ns) << " ns (" << (nlohmann_ns / codec_ns) << "x)\n";
+}
+
+int main(int argc, char** argv) {
+    int iterations = (argc > 1) ? std::stoi(argv[1]) : 100000;
+    
+    // ping
+    nlohmann::json ping_object;
+    ping_object["tid"] = "a1b2";
+    ping_object["query"] = "ping";
+    ping_object["args"]["id"] = node_id;
+    ping_object["args"]["ephemeral_port"] = 50881;
+    ping_object["version"] = "1.0";
+    std::vector<uint8_t> ping_bytes = nlohmann::json::to_msgpack(ping_object);
+    
+    // get response with a listing-sized value
+    std::string value(800, 'x');
+    nlohmann::json get_response_object;
+    get_response_object["version"] = "1.0";
+    get_response_object["response"]["id"] = node_id;
+    get_response_object["response"]["value"] = value;
+    get_response_object["tid"] = "c3d4";
+    std::vector<uint8_t> get_response_bytes = nlohmann::json::to_msgpack(get_response_object);
+    
+    // find_node response with 20 nodes
+    nlohmann::json find_node_object;
+    find_node_object["version"] = "1.0";
+    find_node_object["response"]["id"] = node_id;
+    std::vector<nlohmann::json> nodes_array;
+    for (int i = 0; i < 20; ++i) nodes_array.push_back({ {"ip_address", "192.168.1." + std::to_string(i)}, {"port", 50881 + i} });
+    find_node_object["response"]["nodes"] = nodes_array;
+    find_node_object["tid"] = "e5f6";
+    std::vector<uint8_t> find_node_bytes = nlohmann::json::to_msgpack(find_node_object);
+    
+    // Byte compatibility
+    msgpack::Envelope ping_envelope; msgpack::PingRequest ping;
+    msgpack::Envelope get_envelope; msgpack::GetResponse get_response;
+    msgpack::Envelope find_node_envelope; msgpack::FindNodeResponse find_node_response;
+    if (!msgpack::decode(ping_bytes, ping_envelope, ping) || msgpack::encode(ping_envelope, ping) != ping_bytes
+     || !msgpack::decode(get_response_bytes, get_envelope, get_response) || msgpack::encode(get_envelope, get_response) != get_response_bytes
+     || !msgpack::decode(find_node_bytes, find_node_envelope, find_node_response) || msgpack::encode(find_node_envelope, find_node_response) != find_node_bytes) {
+        std::cerr << "\033[91mEncoded bytes differ from nlohmann::json::to_msgpack\033[0m\n";
+        return 1;
+    }
+    std::cout << "Encoded bytes are identical to nlohmann::json::to_msgpack\n";
+    
+    // Decoding
+    volatile size_t sink = 0;
+    report("decode ping", 
+        measure(iterations, [&] { auto json = nlohmann::json::from_msgpack(ping_bytes); sink += json["args"]["id"].get_ref<const std::string&>().size(); }),
+        measure(iterations, [&] { msgpack::Envelope e; msgpack::PingRequest m; msgpack::decode(ping_bytes, e, m); sink += m.id.size(); }));
+    report("decode get response", 
+        measure(iterations, [&] { auto json = nlohmann::json::from_msgpack(get_response_bytes); sink += json["response"]["value"].get_ref<const std::string&>().size(); }),
+        measure(iterations, [&] { msgpack::Envelope e; msgpack::GetResponse m; msgpack::decode(get_response_bytes, e, m); sink += m.value.size(); }));
+    report("decode find_node response", 
+        measure(iterations, [&] { auto json = nlohmann::json::from_msgpack(find_node_bytes); sink += json["response"]["nodes"].size(); }),
+        measure(iterations, [&] { msgpack::Envelope e; msgpack::FindNodeResponse m; msgpack::decode(find_node_bytes, e, m); sink += m.nodes.size(); }));
+    
+    // Encoding (building the message from its fields, as the protocol code does)
+    report("encode ping", 
+        measure(iterations, [&] { 
+            nlohmann::json object; object["tid"] = "a1b2"; object["query"] = "ping"; object["args"]["id"] = node_id; object["args"]["ephemeral_port"] = 50881; object["version"] = "1.0";
+            sink += nlohmann::json::to_msgpack(object).size(); }),
+        measure(iterations, [&] { 
+            msgpack::Envelope e; e.tid = "a1b2"; e.query = "ping"; e.version = "1.0"; msgpack::PingRequest m; m.id = node_id; m.ephemeral_port = 50881;
+            sink += msgpack::encode(e, m).size(); }));
+    report("encode get response", 
+        measure(iterations, [&] { 
+            nlohmann::json object; object["version"] = "1.0"; object["response"]["id"] = node_id; object["response"]["value"] = value; object["tid"] = "c3d4";
+            sink += nlohmann::json::to_msgpack(object).size(); }),
+        measure(iterations, [&] { 
+            msgpack::Envelope e; e.tid = "c3d4"; e.version = "1.0"; msgpack::GetResponse m; m.id = node_id; m.value = value;
+            sink += msgpack::encode(e, m).size(); }));
+    return 0;
+}
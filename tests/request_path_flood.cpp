@@ -0,0 +1,166 @@
+// Loopback UDP flood comparing the request path before and after decoding each datagram once:
+// "before" parses every datagram into a json tree, dumps it to stdout, builds the response with nlohmann and then parses the datagram again to update the routing table.
+// "after" decodes once into msgpack::Message, shares the decoded ping with the routing table update and only formats log output when the log level enables it
+// g++ -std=c++17 -O2 request_path_flood.cpp ../src/core/protocol/messages/codec.cpp ../src/core/protocol/messages/dht_messages.cpp ../src/core/tools/logger.cpp -I../external/json/single_include -lpthread -o request_path_flood
+// ./request_path_flood > /dev/null (results are printed to stderr)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define JSON_USE_MSGPACK
+#include <nlohmann/json.hpp>
+// neroshop
+#include "../src/core/protocol/messages/dht_messages.hpp"
+#include "../src/core/tools/logger.hpp"
+
+static const std::string node_id = "a1b2c3d4e5f60718293a4b5c6d7e8f9012345678";
+static const std::string version = "1";
+static const int message_count = 200000;
+static const int window = 64; // Requests in flight
+
+static std::vector<uint8_t> make_ping(int i) {
+    nlohmann::json query_object;
+    query_object["tid"] = std::to_string(i);
+    query_object["query"] = "ping";
+    query_object["args"]["id"] = node_id;
+    query_object["args"]["ephemeral_port"] = 50881;
+    query_object["args"]["bloom"] = nlohmann::json::binary(std::vector<uint8_t>(128, 0x5a));
+    query_object["args"]["encodings"] = { "zstd" };
+    query_object["version"] = version;
+    return nlohmann::json::to_msgpack(query_object);
+}
+
+static std::vector<uint8_t> make_get(int i) {
+    nlohmann::json query_object;
+    query_object["tid"] = std::to_string(i);
+    query_object["query"] = "get";
+    query_object["args"]["id"] = node_id;
+    query_object["args"]["key"] = "0f3c1d2e4b5a69788796a5b4c3d2e1f00f1e2d3c4b5a69788796a5b4c3d2e1f0";
+    query_object["args"]["accept"] = { "zstd" };
+    query_object["version"] = version;
+    return nlohmann::json::to_msgpack(query_object);
+}
+
+static std::atomic<uint64_t> routing_updates { 0 }; // Keeps the routing table update from being optimized away
+
+//-----------------------------------------------------------------------------
+
+static std::vector<uint8_t> handle_before(const std::vector<uint8_t>& buffer) {
+    std::cout << "Received request from \033[0;36m127.0.0.1\033[0m\n";
+    nlohmann::json request_object = nlohmann::json::from_msgpack(buffer);
+    std::cout << "\033[33m" << request_object.dump() << "\033[0m" << std::endl;
+    nlohmann::json response_object;
+    if(request_object["query"] == "ping") {
+        response_object["version"] = version;
+        response_object["response"]["id"] = node_id;
+        response_object["response"]["encodings"] = { "zstd" };
+    } else {
+        response_object["error"]["code"] = 10;
+        response_object["error"]["message"] = "Key not found";
+    }
+    response_object["tid"] = request_object["tid"];
+    std::vector<uint8_t> response = nlohmann::json::to_msgpack(response_object);
+    // on_ping parsed the datagram a second time
+    nlohmann::json message = nlohmann::json::from_msgpack(buffer);
+    if(message.contains("query") && message["query"] == "ping") {
+        routing_updates += message["args"]["id"].get<std::string>().size();
+    }
+    return response;
+}
+
+static std::vector<uint8_t> handle_after(const std::vector<uint8_t>& buffer) {
+    NEROSHOP_LOG(neroshop::log_level::debug, "Received request from \033[0;36m127.0.0.1\033[0m\n");
+    neroshop::msgpack::Message message;
+    neroshop::msgpack::decode(buffer, message);
+    std::vector<uint8_t> response;
+    if(message.is_ping()) {
+        NEROSHOP_LOG(neroshop::log_level::trace, "\033[33mping from " << message.ping.id << "\033[0m\n");
+        neroshop::msgpack::Envelope envelope;
+        envelope.version = version;
+        envelope.tid = message.envelope.tid;
+        neroshop::msgpack::PingResponse pong;
+        pong.id = node_id;
+        pong.encodings.push_back("zstd");
+        response = neroshop::msgpack::encode(envelope, pong);
+        routing_updates += message.ping.id.size(); // on_ping reuses the decoded ping
+    } else {
+        NEROSHOP_LOG(neroshop::log_level::debug, "\033[33m" << message.object.dump() << "\033[0m\n");
+        nlohmann::json response_object;
+        response_object["error"]["code"] = 10;
+        response_object["error"]["message"] = "Key not found";
+        response_object["tid"] = message.object["tid"];
+        response = nlohmann::json::to_msgpack(response_object);
+    }
+    return response;
+}
+
+//-----------------------------------------------------------------------------
+
+static double flood(bool optimized) {
+    int server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in server_addr {};
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_addr.sin_port = 0;
+    bind(server_fd, (sockaddr*)&server_addr, sizeof(server_addr));
+    socklen_t addr_len = sizeof(server_addr);
+    getsockname(server_fd, (sockaddr*)&server_addr, &addr_len);
+    timeval timeout { 1, 0 };
+    setsockopt(server_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::thread server_thread([&] {
+        std::vector<uint8_t> buffer(4096);
+        for(;;) {
+            sockaddr_in client_addr {};
+            socklen_t client_addr_len = sizeof(client_addr);
+            int bytes_received = recvfrom(server_fd, buffer.data(), buffer.size(), 0, (sockaddr*)&client_addr, &client_addr_len);
+            if(bytes_received <= 0) break; // Timed out after the flood
+            std::vector<uint8_t> request(buffer.begin(), buffer.begin() + bytes_received);
+            std::vector<uint8_t> response = (optimized) ? handle_after(request) : handle_before(request);
+            sendto(server_fd, response.data(), response.size(), 0, (sockaddr*)&client_addr, client_addr_len);
+        }
+    });
+
+    int client_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::vector<std::vector<uint8_t>> requests;
+    for(int i = 0; i < 1000; ++i) requests.push_back((i % 10 == 9) ? make_get(i) : make_ping(i)); // 90% pings
+
+    std::vector<uint8_t> buffer(4096);
+    int sent = 0, received = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    while(received < message_count) {
+        while(sent < message_count && (sent - received) < window) {
+            const auto& request = requests[sent % requests.size()];
+            sendto(client_fd, request.data(), request.size(), 0, (sockaddr*)&server_addr, sizeof(server_addr));
+            sent++;
+        }
+        if(recv(client_fd, buffer.data(), buffer.size(), 0) <= 0) break; // Dropped datagrams
+        received++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    close(client_fd);
+    server_thread.join();
+    close(server_fd);
+    if(received < message_count) std::cerr << (message_count - received) << " responses were lost\n";
+    return received / seconds;
+}
+
+int main() {
+    neroshop::set_log_level(neroshop::log_level::info);
+    double before = flood(false);
+    double after = flood(true);
+    std::cerr << "before: " << static_cast<uint64_t>(before) << " requests/s\n";
+    std::cerr << "after:  " << static_cast<uint64_t>(after) << " requests/s (" << (after / before) << "x)\n";
+    return 0;
+}
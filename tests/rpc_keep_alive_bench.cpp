@@ -0,0 +1,217 @@
+// Load test of the JSON-RPC server. "thread per connection" is the model that neromon's rpc_server used before HttpServer: every request
+// comes on a new connection that gets a detached thread, and the requests are handled one at a time behind a global mutex
+// (with the connection passed to the thread, as the old server read from whichever client had connected last).
+// "HttpServer close" serves the same one-request connections on the worker pool, "HttpServer keep-alive" has each client send all of its
+// requests on one connection. Every client sends its next request as soon as it has the response and the sustained req/s is reported.
+// json::process is replaced by a stand-in that does the parsing and serializing of a small SELECT without a database
+// g++ -std=c++17 -O2 rpc_keep_alive_bench.cpp ../src/core/protocol/transport/http_server.cpp ../src/core/protocol/transport/worker_pool.cpp ../src/core/protocol/rpc/http.cpp ../src/core/tools/logger.cpp -I../external/json/single_include -lpthread -o rpc_keep_alive_bench
+// ./rpc_keep_alive_bench [seconds] [clients]
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+// neroshop
+#include "../src/core/protocol/rpc/http.hpp"
+#include "../src/core/protocol/rpc/json_rpc.hpp"
+#include "../src/core/protocol/transport/http_server.hpp"
+
+static const unsigned int legacy_port = 57779;
+static const unsigned int http_server_port = 57780;
+static const int rows_per_result = 10;
+
+bool neroshop::rpc::is_json_rpc(const std::string& str) {
+    nlohmann::json request = nlohmann::json::parse(str, nullptr, false);
+    return request.is_object() && request.contains("jsonrpc") && request.contains("method");
+}
+
+std::string neroshop::rpc::json::process(const std::string& request) {
+    nlohmann::json request_object = nlohmann::json::parse(request);
+    nlohmann::json response_object;
+    response_object["jsonrpc"] = "2.0";
+    for(int i = 0; i < rows_per_result; i++) {
+        response_object["result"].push_back({ { "id", std::to_string(i) }, { "name", "listing " + std::to_string(i) }, { "price", "0.5" } });
+    }
+    response_object["id"] = request_object["id"];
+    return response_object.dump(4);
+}
+
+bool neroshop::rpc::json::process_batch(const std::string& request, const std::function<void(const std::string& response)>& on_response) {
+    return false; // Only single requests are sent
+}
+
+enum class Model { ThreadPerConnection, HttpServerClose, HttpServerKeepAlive };
+
+static const char * get_name(Model model) {
+    switch(model) {
+        case Model::ThreadPerConnection: return "thread per connection";
+        case Model::HttpServerClose: return "HttpServer close";
+        case Model::HttpServerKeepAlive: return "HttpServer keep-alive";
+    }
+    return "";
+}
+
+//-----------------------------------------------------------------------------
+
+class LegacyServer { // The previous rpc_server
+public:
+    LegacyServer() : stopped(false) {
+        sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        ::setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(legacy_port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ::bind(sockfd, (sockaddr *)&addr, sizeof(addr));
+        ::listen(sockfd, SOMAXCONN);
+        thread = std::thread([this] {
+            while(!stopped) {
+                int client_fd = ::accept(sockfd, nullptr, nullptr);
+                if(client_fd == -1) continue;
+                std::thread request_thread([this, client_fd]() {
+                    std::lock_guard<std::mutex> lock(server_mutex);
+                    char buffer[1024];
+                    ssize_t read_result = ::read(client_fd, buffer, sizeof(buffer) - 1);
+                    if(read_result > 0) {
+                        std::string response = neroshop::rpc::http::respond(std::string(buffer, read_result));
+                        ::write(client_fd, response.data(), response.size());
+                    }
+                    ::close(client_fd);
+                });
+                request_thread.detach();
+            }
+        });
+    }
+    ~LegacyServer() {
+        stopped = true;
+        ::shutdown(sockfd, SHUT_RDWR); // Wakes accept up
+        thread.join();
+        ::close(sockfd);
+        std::lock_guard<std::mutex> lock(server_mutex); // Lets the last request threads finish
+    }
+private:
+    int sockfd;
+    std::atomic<bool> stopped;
+    std::mutex server_mutex;
+    std::thread thread;
+};
+
+//-----------------------------------------------------------------------------
+
+static int connect_to(unsigned int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(::connect(fd, (sockaddr *)&addr, sizeof(addr)) == -1) {
+        ::close(fd);
+        return -1;
+    }
+    int no_delay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+    return fd;
+}
+
+// Sends one request and reads the whole response. Returns false if the server closed the connection first
+static bool call(int fd, const std::string& request, std::string& buffer) {
+    if(::send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) return false;
+    buffer.clear();
+    char chunk[16384];
+    while(true) {
+        std::size_t headers_end = buffer.find("\r\n\r\n");
+        if(headers_end != std::string::npos) {
+            std::size_t length_start = buffer.find("Content-Length: ");
+            if(length_start != std::string::npos && length_start < headers_end) {
+                std::size_t content_length = std::stoul(buffer.substr(length_start + 16));
+                if(buffer.size() >= headers_end + 4 + content_length) return true;
+            }
+        }
+        ssize_t bytes_read = ::recv(fd, chunk, sizeof(chunk), 0);
+        if(bytes_read <= 0) return false;
+        buffer.append(chunk, bytes_read);
+    }
+}
+
+static std::string make_request(int id, bool keep_alive) {
+    std::string body = "{\"jsonrpc\":\"2.0\",\"method\":\"query\",\"params\":{\"sql\":\"SELECT * FROM listings LIMIT 10;\"},\"id\":" + std::to_string(id) + "}";
+    return "POST / HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: application/json\r\n" + std::string(keep_alive ? "" : "Connection: close\r\n")
+        + "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+static void bench(Model model, double seconds, int client_count) {
+    std::unique_ptr<LegacyServer> legacy_server;
+    std::unique_ptr<neroshop::HttpServer> http_server;
+    std::thread http_server_thread;
+    unsigned int port = legacy_port;
+    if(model == Model::ThreadPerConnection) {
+        legacy_server = std::make_unique<LegacyServer>();
+    } else {
+        http_server = std::make_unique<neroshop::HttpServer>([](std::string_view request, const neroshop::HttpServer::Writer& write) {
+            neroshop::rpc::http::respond(request, write);
+        });
+        if(!http_server->listen("127.0.0.1", http_server_port)) return;
+        http_server_thread = std::thread([&] { http_server->run(); });
+        port = http_server_port;
+    }
+    const bool keep_alive = (model == Model::HttpServerKeepAlive);
+    std::atomic<uint64_t> completed(0);
+    std::atomic<uint64_t> failed(0);
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    std::vector<std::thread> clients;
+    for(int c = 0; c < client_count; c++) {
+        clients.emplace_back([&, c] {
+            std::string buffer;
+            int fd = -1;
+            for(int id = 0; std::chrono::steady_clock::now() < deadline; id++) {
+                if(fd == -1) fd = connect_to(port);
+                if(fd == -1 || !call(fd, make_request(c * 1000000 + id, keep_alive), buffer)) {
+                    failed++;
+                    if(fd != -1) ::close(fd);
+                    fd = -1;
+                    continue;
+                }
+                completed++;
+                if(!keep_alive) {
+                    ::close(fd);
+                    fd = -1;
+                }
+            }
+            if(fd != -1) ::close(fd);
+        });
+    }
+    for(std::thread& client : clients) client.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::left << std::setw(24) << get_name(model) << std::right << std::fixed << std::setprecision(0)
+              << std::setw(10) << (completed / elapsed) << " req/s";
+    if(failed > 0) std::cout << " (" << failed << " failed)";
+    std::cout << "\n";
+    if(http_server) {
+        http_server->stop();
+        http_server_thread.join();
+    }
+}
+
+int main(int argc, char ** argv) {
+    double seconds = (argc > 1) ? std::stod(argv[1]) : 3.0;
+    int client_count = (argc > 2) ? std::stoi(argv[2]) : 16;
+    std::cout << client_count << " clients, " << seconds << "s per model\n";
+    for(Model model : { Model::ThreadPerConnection, Model::HttpServerClose, Model::HttpServerKeepAlive }) {
+        bench(model, seconds, client_count);
+    }
+    return 0;
+}
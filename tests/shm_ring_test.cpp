@@ -0,0 +1,67 @@
+// Checks the shared-memory ring: wrap-around, full/empty limits and that only rings with a sealed size are attached
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+// neroshop
+#include "../src/core/protocol/transport/shm_ring.hpp"
+
+using namespace neroshop;
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& description) {
+    if(!condition) {
+        std::cerr << "FAILED: " << description << "\n";
+        failures++;
+    }
+}
+
+static std::vector<uint8_t> make_bytes(std::size_t size, uint8_t seed) {
+    std::vector<uint8_t> bytes(size);
+    for(std::size_t i = 0; i < size; i++) bytes[i] = static_cast<uint8_t>(seed + i * 7);
+    return bytes;
+}
+
+int main() {
+    const std::size_t capacity = 4096;
+    std::unique_ptr<ShmRing> producer = ShmRing::create(capacity);
+    check(producer != nullptr, "create");
+    if(!producer) return 1;
+    // The daemon's side maps the same memfd
+    std::unique_ptr<ShmRing> consumer = ShmRing::attach(::dup(producer->get_fd()));
+    check(consumer != nullptr, "attach a ring made by create");
+    if(!consumer) return 1;
+    check(consumer->get_capacity() == capacity, "capacity");
+
+    // Writes that straddle the end of the buffer come out intact on the other side
+    std::vector<uint8_t> read_bytes;
+    for(int i = 0; i < 64; i++) {
+        std::vector<uint8_t> bytes = make_bytes(1000 + i * 13, static_cast<uint8_t>(i));
+        check(producer->write(bytes.data(), bytes.size()), "write " + std::to_string(i));
+        check(consumer->read(read_bytes, bytes.size()) && read_bytes == bytes, "wrapped read " + std::to_string(i));
+    }
+    check(producer->get_free_space() == capacity, "empty after reading everything");
+
+    // A full ring refuses more bytes and a reader cannot read more than was written
+    std::vector<uint8_t> full = make_bytes(capacity, 1);
+    check(producer->write(full.data(), full.size()), "fill the ring");
+    check(!producer->write(full.data(), 1), "write to a full ring");
+    check(!consumer->read(read_bytes, capacity + 1), "read more than was written");
+    check(consumer->read(read_bytes, capacity) && read_bytes == full, "read a full ring");
+
+    // The size of a ring is sealed, so the other process cannot shrink it under the daemon
+    check(::ftruncate(producer->get_fd(), 128) == -1, "shrink a sealed ring");
+
+    // A memfd without the seals is refused
+    int unsealed_fd = ::memfd_create("unsealed", MFD_CLOEXEC);
+    check(unsealed_fd != -1 && ::ftruncate(unsealed_fd, 4096 + 192) == 0, "create an unsealed memfd");
+    check(ShmRing::attach(unsealed_fd) == nullptr, "attach an unsealed memfd");
+
+    if(failures > 0) return 1;
+    std::cout << "shm_ring_test passed\n";
+    return 0;
+}
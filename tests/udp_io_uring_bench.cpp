@@ -0,0 +1,208 @@
+// Compares the DHT node's UDP receive paths on loopback: "select" waits with select and then reads one datagram at a time like Node::run_optimized,
+// "epoll" waits with epoll and drains the socket before waiting again, "io_uring" is IoUringUdp with one multishot recvmsg and the replies batched
+// into the next io_uring_enter. Each server echoes the datagram on its own thread, so the difference is the system calls around it.
+// Several clients each keep a window of datagrams in flight. Reports datagrams/s and the server's system calls per datagram
+// g++ -std=c++17 -O2 -DNEROSHOP_USE_IO_URING udp_io_uring_bench.cpp ../src/core/protocol/transport/io_uring_udp.cpp -lpthread -o udp_io_uring_bench
+// ./udp_io_uring_bench [seconds] [clients] [window]
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+// neroshop
+#include "../src/core/protocol/transport/io_uring_udp.hpp"
+
+static const std::size_t datagram_size = 128; // About the size of a ping or a get
+static const int max_window = 64;
+
+enum class Backend { Select, Epoll, IoUring };
+
+static const char * get_name(Backend backend) {
+    switch(backend) {
+        case Backend::Select: return "select";
+        case Backend::Epoll: return "epoll";
+        case Backend::IoUring: return "io_uring";
+    }
+    return "";
+}
+
+static int bind_socket(struct sockaddr_in& address) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    int buffer_size = 4 * 1024 * 1024;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+    bind(sockfd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(sockfd, reinterpret_cast<struct sockaddr *>(&address), &length);
+    return sockfd;
+}
+
+//-----------------------------------------------------------------------------
+
+class EchoServer { // Any of the backends, run on its own thread
+public:
+    EchoServer(Backend backend) : backend(backend), stopped(false), syscalls(0), echoed(0) {
+        sockfd = bind_socket(address);
+        if(backend == Backend::IoUring) {
+            ring = std::make_unique<neroshop::IoUringUdp>(sockfd);
+        }
+        thread = std::thread([this] { run(); });
+    }
+    ~EchoServer() {
+        stopped = true;
+        if(ring) ring->stop();
+        thread.join();
+        close(sockfd);
+    }
+    const struct sockaddr_in& get_address() const { return address; }
+    uint64_t get_syscalls() const { return ring ? ring->get_enter_count() : syscalls.load(); }
+    uint64_t get_echoed() const { return echoed; }
+private:
+    Backend backend;
+    int sockfd;
+    struct sockaddr_in address;
+    std::unique_ptr<neroshop::IoUringUdp> ring;
+    std::thread thread;
+    std::atomic<bool> stopped;
+    std::atomic<uint64_t> syscalls;
+    std::atomic<uint64_t> echoed;
+
+    // Reads one datagram and echoes it. Returns false once there is nothing left to read
+    bool echo_one() {
+        uint8_t buffer[2048];
+        struct sockaddr_in sender;
+        socklen_t sender_len = sizeof(sender);
+        syscalls++;
+        ssize_t received = recvfrom(sockfd, buffer, sizeof(buffer), MSG_DONTWAIT, reinterpret_cast<struct sockaddr *>(&sender), &sender_len);
+        if(received < 0) return false;
+        syscalls++;
+        sendto(sockfd, buffer, received, 0, reinterpret_cast<struct sockaddr *>(&sender), sender_len);
+        echoed++;
+        return true;
+    }
+
+    void run() {
+        if(backend == Backend::Select) {
+            while(!stopped) {
+                fd_set read_set;
+                FD_ZERO(&read_set);
+                FD_SET(sockfd, &read_set);
+                struct timeval timeout = { 0, 100000 };
+                syscalls++;
+                if(select(sockfd + 1, &read_set, nullptr, nullptr, &timeout) > 0) echo_one();
+            }
+        } else if(backend == Backend::Epoll) {
+            int epoll_fd = epoll_create1(0);
+            struct epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = sockfd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockfd, &event);
+            while(!stopped) {
+                syscalls++;
+                if(epoll_wait(epoll_fd, &event, 1, 100) > 0) {
+                    while(echo_one());
+                }
+            }
+            close(epoll_fd);
+        } else {
+            ring->run([this](const uint8_t * data, std::size_t size, const struct sockaddr_in& sender) {
+                ring->send(sender, std::vector<uint8_t>(data, data + size));
+                echoed++;
+            });
+        }
+    }
+};
+
+//-----------------------------------------------------------------------------
+
+// Keeps window datagrams in flight until the deadline. A datagram that was dropped is replaced after a short wait
+static uint64_t run_client(const struct sockaddr_in& server, int window, std::chrono::steady_clock::time_point deadline) {
+    struct sockaddr_in address;
+    int sockfd = bind_socket(address);
+    connect(sockfd, reinterpret_cast<const struct sockaddr *>(&server), sizeof(server));
+    struct timeval timeout = { 0, 20000 };
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::vector<uint8_t> payload(datagram_size, 'p');
+    std::vector<std::vector<uint8_t>> buffers(window, std::vector<uint8_t>(2048));
+    struct iovec send_iov = { payload.data(), payload.size() };
+    std::vector<struct iovec> receive_iov(window);
+    std::vector<struct mmsghdr> sends(window);
+    std::vector<struct mmsghdr> receives(window);
+    for(int i = 0; i < window; i++) {
+        sends[i] = {};
+        sends[i].msg_hdr.msg_iov = &send_iov;
+        sends[i].msg_hdr.msg_iovlen = 1;
+        receive_iov[i] = { buffers[i].data(), buffers[i].size() };
+        receives[i] = {};
+        receives[i].msg_hdr.msg_iov = &receive_iov[i];
+        receives[i].msg_hdr.msg_iovlen = 1;
+    }
+    uint64_t completed = 0;
+    int to_send = window;
+    while(std::chrono::steady_clock::now() < deadline) {
+        if(to_send > 0) sendmmsg(sockfd, sends.data(), to_send, 0);
+        int received = recvmmsg(sockfd, receives.data(), window, MSG_WAITFORONE, nullptr);
+        if(received <= 0) {
+            to_send = window; // Lost in a full socket buffer, so the window is refilled
+            continue;
+        }
+        completed += received;
+        to_send = received;
+    }
+    close(sockfd);
+    return completed;
+}
+
+static void bench(Backend backend, double seconds, int client_count, int window) {
+    std::unique_ptr<EchoServer> server;
+    try {
+        server = std::make_unique<EchoServer>(backend);
+    } catch(const std::exception& e) {
+        std::cout << std::left << std::setw(10) << get_name(backend) << "unavailable: " << e.what() << "\n";
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const uint64_t syscalls_before = server->get_syscalls();
+    const uint64_t echoed_before = server->get_echoed();
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    std::vector<std::thread> clients;
+    std::atomic<uint64_t> completed(0);
+    for(int i = 0; i < client_count; i++) {
+        clients.emplace_back([&] { completed += run_client(server->get_address(), window, deadline); });
+    }
+    for(std::thread& client : clients) client.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const uint64_t echoed = server->get_echoed() - echoed_before;
+    const uint64_t syscalls = server->get_syscalls() - syscalls_before;
+    std::cout << std::left << std::setw(10) << get_name(backend) << std::right << std::fixed
+              << std::setw(12) << std::setprecision(0) << (completed / elapsed) << " datagrams/s"
+              << std::setw(10) << std::setprecision(3) << (echoed ? double(syscalls) / echoed : 0.0) << " server syscalls/datagram\n";
+}
+
+int main(int argc, char ** argv) {
+    double seconds = (argc > 1) ? std::stod(argv[1]) : 3.0;
+    int client_count = (argc > 2) ? std::stoi(argv[2]) : 4;
+    int window = (argc > 3) ? std::min(std::stoi(argv[3]), max_window) : 32;
+    std::cout << client_count << " clients, " << window << " datagrams of " << datagram_size << " bytes in flight each, " << seconds << "s per backend\n";
+    for(Backend backend : { Backend::Select, Backend::Epoll, Backend::IoUring }) {
+        bench(backend, seconds, client_count, window);
+    }
+    return 0;
+}
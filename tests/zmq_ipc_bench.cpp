@@ -0,0 +1,183 @@
+// Compares the ZeroMQ IPC backend (ZmqServer, Client::connect_zmq) over tcp://, ipc:// and inproc:// with the daemon's TCP loopback path (IpcServer, Client::connect).
+// Both servers answer on the same worker pool with the same handler, so the difference is the transport.
+// "latency" issues small get requests one at a time, "throughput" keeps a window of large responses in flight from one client
+// and "clients" has several clients pipelining small requests at once
+// g++ -std=c++17 -O2 -DNEROSHOP_USE_SYSTEM_SOCKETS -DNEROSHOP_USE_LIBZMQ zmq_ipc_bench.cpp ../src/core/protocol/transport/client.cpp ../src/core/protocol/transport/ipc_server.cpp ../src/core/protocol/transport/zmq_client.cpp ../src/core/protocol/transport/zmq_server.cpp ../src/core/protocol/transport/worker_pool.cpp ../src/core/protocol/transport/framing.cpp ../src/core/protocol/transport/response.cpp ../src/core/protocol/transport/shm_ring.cpp ../src/core/tools/logger.cpp -I../external/json/single_include -lzmq -lpthread -o zmq_ipc_bench
+// ./zmq_ipc_bench
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+// neroshop
+#include "../src/core/protocol/transport/client.hpp"
+#include "../src/core/protocol/transport/ipc_server.hpp"
+#include "../src/core/protocol/transport/zmq_server.hpp"
+
+static const unsigned int tcp_port = 57759;
+static const std::string zmq_tcp_endpoint = "tcp://127.0.0.1:57760";
+static const std::string zmq_ipc_endpoint = "ipc:///tmp/neroshop_zmq_ipc_bench.sock";
+static const std::string zmq_inproc_endpoint = "inproc://neroshop_zmq_ipc_bench";
+static const int latency_calls = 20000;
+static const std::size_t small_value_size = 256;
+static const int throughput_calls = 2000;
+static const std::size_t large_value_size = 256 * 1024;
+static const int window = 32; // Requests in flight per client
+static const int client_count = 8;
+static const int calls_per_client = 20000;
+
+enum class Transport { Tcp, ZmqTcp, ZmqIpc, ZmqInproc };
+
+static const char * get_name(Transport transport) {
+    switch(transport) {
+        case Transport::Tcp: return "tcp (IpcServer)";
+        case Transport::ZmqTcp: return "zmq tcp://";
+        case Transport::ZmqIpc: return "zmq ipc://";
+        case Transport::ZmqInproc: return "zmq inproc://";
+    }
+    return "";
+}
+
+//-----------------------------------------------------------------------------
+
+// Answers every get with a value whose size is given by the key, like the daemon would answer with a stored listing
+static std::vector<uint8_t> handle(uint64_t, const std::vector<uint8_t>& request) {
+    nlohmann::json request_object = nlohmann::json::from_msgpack(request);
+    nlohmann::json response_object;
+    response_object["version"] = "1";
+    if(request_object["query"] == "get") {
+        std::size_t value_size = std::stoul(request_object["args"]["key"].get<std::string>());
+        response_object["response"]["value"] = std::string(value_size, 'v');
+    } else {
+        response_object["response"]["id"] = "bench";
+    }
+    response_object["tid"] = request_object["tid"];
+    return nlohmann::json::to_msgpack(response_object);
+}
+
+class BenchServer { // Either server, run on its own thread
+public:
+    BenchServer(Transport transport) : transport(transport) {
+        if(transport == Transport::Tcp) {
+            ipc_server = std::make_unique<neroshop::IpcServer>(handle);
+            ipc_server->listen("127.0.0.1", tcp_port);
+            thread = std::thread([this] { ipc_server->run(); });
+        } else {
+            zmq_server = std::make_unique<neroshop::ZmqServer>(handle);
+            zmq_server->listen((transport == Transport::ZmqTcp) ? zmq_tcp_endpoint : (transport == Transport::ZmqIpc) ? zmq_ipc_endpoint : zmq_inproc_endpoint);
+            thread = std::thread([this] { zmq_server->run(); });
+        }
+    }
+    ~BenchServer() {
+        if(ipc_server) ipc_server->stop();
+        if(zmq_server) zmq_server->stop();
+        thread.join();
+    }
+    bool connect(neroshop::Client& client) {
+        switch(transport) {
+            case Transport::Tcp: return client.connect(tcp_port, "127.0.0.1");
+            case Transport::ZmqTcp: return client.connect_zmq(zmq_tcp_endpoint);
+            case Transport::ZmqIpc: return client.connect_zmq(zmq_ipc_endpoint);
+            case Transport::ZmqInproc: return client.connect_zmq(zmq_inproc_endpoint, zmq_server->get_context());
+        }
+        return false;
+    }
+private:
+    Transport transport;
+    std::unique_ptr<neroshop::IpcServer> ipc_server;
+    std::unique_ptr<neroshop::ZmqServer> zmq_server;
+    std::thread thread;
+};
+
+// Keeps a window of requests in flight until calls responses have arrived. Returns the bytes of values received
+static std::size_t pipeline(neroshop::Client& client, const std::string& key, int calls) {
+    std::deque<std::future<neroshop::Response>> in_flight;
+    std::size_t received_bytes = 0;
+    int sent = 0, received = 0;
+    while(received < calls) {
+        while(sent < calls && static_cast<int>(in_flight.size()) < window) {
+            in_flight.push_back(client.get_async(key));
+            sent++;
+        }
+        neroshop::Response reply = in_flight.front().get();
+        in_flight.pop_front();
+        if(reply.get_status() == neroshop::Response::Status::NoResponse) break; // Disconnected
+        received_bytes += reply.get_value().size();
+        received++;
+    }
+    return received_bytes;
+}
+
+static void run(Transport transport) {
+    std::cout << get_name(transport) << ":\n";
+    std::unique_ptr<BenchServer> server = std::make_unique<BenchServer>(transport);
+    {
+        neroshop::Client client;
+        bool connected = false;
+        for(int attempt = 0; attempt < 100 && !connected; attempt++) { // The server thread may not be listening yet
+            connected = server->connect(client);
+            if(!connected) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if(!connected) {
+            std::cerr << "  could not connect\n";
+            return;
+        }
+
+        // Latency: one call at a time
+        std::vector<double> latencies;
+        latencies.reserve(latency_calls);
+        const std::string small_key = std::to_string(small_value_size);
+        for(int i = 0; i < latency_calls; i++) {
+            auto start_time = std::chrono::steady_clock::now();
+            client.get(small_key);
+            latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start_time).count());
+        }
+        std::sort(latencies.begin(), latencies.end());
+        double mean = 0.0;
+        for(double latency : latencies) mean += latency;
+        mean /= latencies.size();
+        std::cout << "  latency:    mean " << mean << " us, p50 " << latencies[latencies.size() / 2] << " us, p99 " << latencies[latencies.size() * 99 / 100] << " us\n";
+
+        // Throughput: a window of large responses in flight
+        auto start_time = std::chrono::steady_clock::now();
+        std::size_t received_bytes = pipeline(client, std::to_string(large_value_size), throughput_calls);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        std::cout << "  throughput: " << (received_bytes / large_value_size / seconds) << " calls/s, " << (received_bytes / seconds / (1024 * 1024)) << " MiB/s\n";
+        client.disconnect();
+    }
+
+    // Several clients at once
+    std::vector<std::unique_ptr<neroshop::Client>> clients;
+    for(int i = 0; i < client_count; i++) {
+        clients.push_back(std::make_unique<neroshop::Client>());
+        if(!server->connect(*clients.back())) {
+            std::cerr << "  client " << i << " could not connect\n";
+            return;
+        }
+    }
+    std::atomic<std::size_t> total_bytes { 0 };
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for(auto& client : clients) {
+        threads.emplace_back([&client, &total_bytes] { total_bytes += pipeline(*client, std::to_string(small_value_size), calls_per_client); });
+    }
+    for(auto& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    std::cout << "  clients:    " << client_count << " x " << calls_per_client << " calls, " << (total_bytes / small_value_size / seconds) << " calls/s\n";
+    for(auto& client : clients) client->disconnect(); // Before the server, since inproc clients share its context
+}
+
+int main() {
+    run(Transport::Tcp);
+    run(Transport::ZmqTcp);
+    run(Transport::ZmqIpc);
+    run(Transport::ZmqInproc);
+    return 0;
+}